@@ -0,0 +1,744 @@
+#include "BVH.h"
+
+BVHBuilder::BVHBuilder()
+{
+	m_nMaxLeafSize = BVH_MAX_LEAF_SIZE;
+	m_fIntersectCost = 1.0f;
+	m_nMaxDepth = BVH_STACK_SIZE;
+	m_pNodes = NULL;
+	m_pOrder = NULL;
+	m_nDepth = 0;
+}
+
+void BVHBuilder::Build(const std::vector<AABB> &bounds, std::vector<BVHNode> *pNodes, std::vector<int> *pOrder)
+{
+	pNodes->clear();
+	pOrder->clear();
+	m_nDepth = 0;
+
+	int nCount = bounds.size();
+	if (nCount == 0)
+	{
+		return;
+	}
+
+	m_items.resize(nCount);
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		m_items[i].m_bounds = bounds[i];
+		m_items[i].m_center = m_items[i].m_bounds.GetCenter();
+		m_items[i].m_nIndex = i;
+	}
+
+	m_pNodes = pNodes;
+	m_pOrder = pOrder;
+	pNodes->reserve(nCount * 2);
+	pOrder->reserve(nCount);
+	BuildRecursive(0, nCount, 1);
+
+	m_items.clear();
+	m_pNodes = NULL;
+	m_pOrder = NULL;
+}
+
+int BVHBuilder::GetDepth()
+{
+	return m_nDepth;
+}
+
+int BVHBuilder::BuildRecursive(int nBegin, int nEnd, int nDepth)
+{
+	m_nDepth = MAX_(m_nDepth, nDepth);
+
+	std::vector<BuildItem> &items = m_items;
+	std::vector<BVHNode> &nodes = *m_pNodes;
+	int nNode = nodes.size();
+	nodes.push_back(BVHNode());
+
+	AABB bounds;
+	AABB centerBounds;
+	int i;
+	for (i = nBegin; i < nEnd; i++)
+	{
+		bounds.Extend(items[i].m_bounds);
+		centerBounds.Extend(items[i].m_center);
+	}
+	nodes[nNode].m_bounds = bounds;
+
+	int nCount = nEnd - nBegin;
+	int nAxis = centerBounds.GetLongestAxis();
+	float fMin = (&centerBounds.m_min.m_x)[nAxis];
+	float fExtent = (&centerBounds.m_max.m_x)[nAxis] - fMin;
+	float fScale = fExtent > 0.0f ? BVH_BIN_COUNT / fExtent : 0.0f;
+
+	// An infinite extent gives a zero scale and a denormal one an infinite
+	// scale; neither bins, so such nodes take the median split below.
+	int nSplit = -1;
+	if (nCount > 1 && fScale > 0.0f && fScale <= FLT_MAX && nDepth < m_nMaxDepth)
+	{
+		// Bin the centroids along the longest axis and sweep the bin
+		// boundaries for the cheapest split by surface area.
+		AABB binBounds[BVH_BIN_COUNT];
+		int binCounts[BVH_BIN_COUNT] = { 0 };
+		for (i = nBegin; i < nEnd; i++)
+		{
+			int nBin = (int)(((&items[i].m_center.m_x)[nAxis] - fMin) * fScale);
+			nBin = MIN_(nBin, BVH_BIN_COUNT - 1);
+			binCounts[nBin]++;
+			binBounds[nBin].Extend(items[i].m_bounds);
+		}
+
+		float rightAreas[BVH_BIN_COUNT];
+		int rightCounts[BVH_BIN_COUNT];
+		AABB rightBounds;
+		int nRightCount = 0;
+		for (i = BVH_BIN_COUNT - 1; i > 0; i--)
+		{
+			rightBounds.Extend(binBounds[i]);
+			nRightCount += binCounts[i];
+			rightAreas[i] = rightBounds.GetSurfaceArea();
+			rightCounts[i] = nRightCount;
+		}
+
+		float fBestCost = FLT_MAX;
+		int nBestBin = -1;
+		AABB leftBounds;
+		int nLeftCount = 0;
+		for (i = 1; i < BVH_BIN_COUNT; i++)
+		{
+			leftBounds.Extend(binBounds[i - 1]);
+			nLeftCount += binCounts[i - 1];
+			if (nLeftCount == 0 || rightCounts[i] == 0)
+			{
+				continue;
+			}
+			float fCost = leftBounds.GetSurfaceArea() * nLeftCount + rightAreas[i] * rightCounts[i];
+			if (fCost < fBestCost)
+			{
+				fBestCost = fCost;
+				nBestBin = i;
+			}
+		}
+
+		float fLeafCost = bounds.GetSurfaceArea() * nCount * m_fIntersectCost;
+		float fSplitCost = bounds.GetSurfaceArea() + fBestCost * m_fIntersectCost;
+		if (nBestBin > 0 && (nCount > m_nMaxLeafSize || fSplitCost < fLeafCost))
+		{
+			BuildItem *pMid = std::partition(&items[0] + nBegin, &items[0] + nEnd, [=](const BuildItem &item)
+			{
+				int nBin = (int)(((&item.m_center.m_x)[nAxis] - fMin) * fScale);
+				return MIN_(nBin, BVH_BIN_COUNT - 1) < nBestBin;
+			});
+			nSplit = pMid - &items[0];
+		}
+	}
+
+	if (nSplit < 0 && nCount > m_nMaxLeafSize)
+	{
+		// All centroids coincide, cannot be binned or no split pays off: fall
+		// back to a median split.
+		nSplit = nBegin + nCount / 2;
+		std::nth_element(&items[0] + nBegin, &items[0] + nSplit, &items[0] + nEnd, [=](const BuildItem &a, const BuildItem &b)
+		{
+			return (&a.m_center.m_x)[nAxis] < (&b.m_center.m_x)[nAxis];
+		});
+	}
+
+	if (nSplit < 0)
+	{
+		nodes[nNode].m_nOffset = m_pOrder->size();
+		nodes[nNode].m_nCount = (unsigned short)nCount;
+		nodes[nNode].m_nAxis = 0;
+		for (i = nBegin; i < nEnd; i++)
+		{
+			m_pOrder->push_back(items[i].m_nIndex);
+		}
+		return nNode;
+	}
+
+	BuildRecursive(nBegin, nSplit, nDepth + 1);
+	int nSecond = BuildRecursive(nSplit, nEnd, nDepth + 1);
+	nodes[nNode].m_nOffset = nSecond;
+	nodes[nNode].m_nCount = 0;
+	nodes[nNode].m_nAxis = (unsigned short)nAxis;
+	return nNode;
+}
+
+BVH::BVH()
+{
+	m_fRebuildThreshold = BVH_REBUILD_THRESHOLD;
+	m_nDepth = 0;
+	m_fBuildCost = 0.0f;
+	m_fBuildArea = 0.0f;
+	m_nRefitCount = 0;
+	m_nRebuildCount = 0;
+}
+
+BVH::~BVH()
+{
+
+}
+
+void BVH::AddGeometry(Geometry *geometry)
+{
+	m_geometies.push_back(geometry);
+}
+
+void BVH::Initialize()
+{
+	m_unbounded.clear();
+	m_primitives.clear();
+	m_nodes.clear();
+	m_nDepth = 0;
+
+	int nCount = m_geometies.size();
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		m_geometies[i]->Initialize();
+
+		AABB box;
+		if (m_geometies[i]->GetBounds(&box))
+		{
+			m_primitives.push_back(m_geometies[i]);
+		}
+		else
+		{
+			m_unbounded.push_back(m_geometies[i]);
+		}
+	}
+
+	Build();
+}
+
+void BVH::Build()
+{
+	int nCount = m_primitives.size();
+	std::vector<AABB> bounds(nCount);
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		m_primitives[i]->GetBounds(&bounds[i]);
+	}
+
+	BVHBuilder builder;
+	std::vector<int> order;
+	builder.Build(bounds, &m_nodes, &order);
+	m_nDepth = builder.GetDepth();
+
+	std::vector<Geometry *> primitives(nCount);
+	for (i = 0; i < nCount; i++)
+	{
+		primitives[i] = m_primitives[order[i]];
+	}
+	m_primitives.swap(primitives);
+
+	PrepareUpdate();
+}
+
+void BVH::PrepareUpdate()
+{
+	int nCount = m_primitives.size();
+	m_versions.resize(nCount);
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		m_versions[i] = m_primitives[i]->m_nVersion;
+	}
+	m_dirty.assign(m_nodes.size(), 0);
+	m_subtrees.clear();
+	m_topNodes.clear();
+	if (m_nodes.empty())
+	{
+		m_fBuildCost = 0.0f;
+		m_fBuildArea = 0.0f;
+		return;
+	}
+	m_fBuildArea = m_nodes[0].m_bounds.GetSurfaceArea();
+	m_fBuildCost = GetRangeCost(0, m_nodes.size(), m_fBuildArea);
+
+	// Split the largest subtree until there are enough of them to spread
+	// over the threads; the nodes split go above the cut.
+	std::vector<Subtree> subtrees(1);
+	subtrees[0].m_nNode = 0;
+	subtrees[0].m_nDepth = 1;
+	while ((int)subtrees.size() < BVH_UPDATE_SUBTREES)
+	{
+		int nLargest = -1;
+		int nLargestSize = 0;
+		for (i = 0; i < (int)subtrees.size(); i++)
+		{
+			int nNode = subtrees[i].m_nNode;
+			if (m_nodes[nNode].m_nCount == 0)
+			{
+				int nLast = nNode;
+				while (m_nodes[nLast].m_nCount == 0)
+				{
+					nLast = m_nodes[nLast].m_nOffset;
+				}
+				int nSize = nLast + 1 - nNode;
+				if (nSize > nLargestSize)
+				{
+					nLargest = i;
+					nLargestSize = nSize;
+				}
+			}
+		}
+		if (nLargest < 0)
+		{
+			break;
+		}
+
+		Subtree second = subtrees[nLargest];
+		int nNode = second.m_nNode;
+		m_topNodes.push_back(nNode);
+		subtrees[nLargest].m_nNode = nNode + 1;
+		subtrees[nLargest].m_nDepth++;
+		second.m_nNode = m_nodes[nNode].m_nOffset;
+		second.m_nDepth++;
+		subtrees.push_back(second);
+	}
+
+	std::sort(subtrees.begin(), subtrees.end(), [](const Subtree &a, const Subtree &b)
+	{
+		return a.m_nNode < b.m_nNode;
+	});
+	std::sort(m_topNodes.begin(), m_topNodes.end(), [](int a, int b)
+	{
+		return a > b;
+	});
+
+	for (i = 0; i < (int)subtrees.size(); i++)
+	{
+		Subtree &subtree = subtrees[i];
+		int nLast = subtree.m_nNode;
+		while (m_nodes[nLast].m_nCount == 0)
+		{
+			nLast = m_nodes[nLast].m_nOffset;
+		}
+		int nFirst = subtree.m_nNode;
+		while (m_nodes[nFirst].m_nCount == 0)
+		{
+			nFirst++;
+		}
+		subtree.m_nNodeEnd = nLast + 1;
+		subtree.m_nPrimitive = m_nodes[nFirst].m_nOffset;
+		subtree.m_nPrimitiveEnd = m_nodes[nLast].m_nOffset + m_nodes[nLast].m_nCount;
+		subtree.m_fBuildArea = m_nodes[subtree.m_nNode].m_bounds.GetSurfaceArea();
+		subtree.m_fBuildCost = GetRangeCost(subtree.m_nNode, subtree.m_nNodeEnd, subtree.m_fBuildArea);
+		subtree.m_bDirty = false;
+	}
+	m_subtrees.swap(subtrees);
+}
+
+void BVH::Update(ThreadPool *threadPool)
+{
+	m_nRefitCount = 0;
+	m_nRebuildCount = 0;
+	int i;
+	for (i = 0; i < (int)m_unbounded.size(); i++)
+	{
+		m_unbounded[i]->Update(threadPool);
+	}
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	// Subtrees are refit independently; the ones that degraded are marked.
+	std::atomic<int> nRefitCount(0);
+	ThreadPool::TaskFunc refit = [&](int nTask, int nWorker)
+	{
+		Subtree &subtree = m_subtrees[nTask];
+		int nChanged = RefitRange(subtree.m_nNode, subtree.m_nNodeEnd);
+		subtree.m_bDirty = nChanged > 0 && GetRangeCost(subtree.m_nNode, subtree.m_nNodeEnd, subtree.m_fBuildArea) >
+			subtree.m_fBuildCost * m_fRebuildThreshold;
+		nRefitCount += nChanged;
+	};
+	int nSubtreeCount = m_subtrees.size();
+	if (threadPool)
+	{
+		threadPool->Run(nSubtreeCount, refit);
+	}
+	else
+	{
+		for (i = 0; i < nSubtreeCount; i++)
+		{
+			refit(i, 0);
+		}
+	}
+	m_nRefitCount = nRefitCount;
+	if (m_nRefitCount == 0)
+	{
+		return;
+	}
+
+	// Parents holding this tree refit it in turn.
+	MarkChanged();
+	for (i = 0; i < (int)m_topNodes.size(); i++)
+	{
+		RefitNode(m_topNodes[i]);
+	}
+
+	std::vector<int> vecRebuild;
+	int nRebuildPrimitives = 0;
+	for (i = 0; i < nSubtreeCount; i++)
+	{
+		if (m_subtrees[i].m_bDirty)
+		{
+			vecRebuild.push_back(i);
+			nRebuildPrimitives += m_subtrees[i].m_nPrimitiveEnd - m_subtrees[i].m_nPrimitive;
+		}
+	}
+
+	// Decided before any subtree is rebuilt, so a frame never pays for both.
+	// Motion across the cut shows up only in the nodes above it.
+	if (nRebuildPrimitives > m_primitives.size() * BVH_REBUILD_FRACTION ||
+		GetRangeCost(0, m_nodes.size(), m_fBuildArea) > m_fBuildCost * m_fRebuildThreshold)
+	{
+		Build();
+		m_nRebuildCount = BVH_UPDATE_SUBTREES;
+		return;
+	}
+	if (!vecRebuild.empty())
+	{
+		RebuildSubtrees(vecRebuild, threadPool);
+		m_nRebuildCount = vecRebuild.size();
+	}
+}
+
+// Nodes after their parents in depth-first order, so walking backwards sees
+// children first. Returns the number of primitives that changed.
+int BVH::RefitRange(int nNode, int nNodeEnd)
+{
+	int nChanged = 0;
+	int i;
+	for (i = nNodeEnd - 1; i >= nNode; i--)
+	{
+		BVHNode &node = m_nodes[i];
+		if (node.m_nCount == 0)
+		{
+			RefitNode(i);
+			continue;
+		}
+
+		// Edited primitives are initialized again. Aggregates then update
+		// their own children and mark themselves changed when they did.
+		bool bChanged = false;
+		int j;
+		for (j = node.m_nOffset; j < node.m_nOffset + node.m_nCount; j++)
+		{
+			Geometry *primitive = m_primitives[j];
+			if (primitive->m_nVersion != m_versions[j])
+			{
+				primitive->Initialize();
+			}
+			primitive->Update(NULL);
+			if (primitive->m_nVersion != m_versions[j])
+			{
+				m_versions[j] = primitive->m_nVersion;
+				bChanged = true;
+				nChanged++;
+			}
+		}
+		if (bChanged)
+		{
+			node.m_bounds.Reset();
+			for (j = node.m_nOffset; j < node.m_nOffset + node.m_nCount; j++)
+			{
+				AABB box;
+				m_primitives[j]->GetBounds(&box);
+				node.m_bounds.Extend(box);
+			}
+		}
+		m_dirty[i] = bChanged;
+	}
+	return nChanged;
+}
+
+void BVH::RefitNode(int nNode)
+{
+	BVHNode &node = m_nodes[nNode];
+	m_dirty[nNode] = m_dirty[nNode + 1] | m_dirty[node.m_nOffset];
+	if (m_dirty[nNode])
+	{
+		node.m_bounds = m_nodes[nNode + 1].m_bounds;
+		node.m_bounds.Extend(m_nodes[node.m_nOffset].m_bounds);
+	}
+}
+
+// Against the root area a subtree had when it was built, so a root box that
+// grows into its neighbours raises the cost as much as the boxes below it.
+float BVH::GetRangeCost(int nNode, int nNodeEnd, float fRootArea)
+{
+	if (fRootArea <= 0.0f)
+	{
+		return 0.0f;
+	}
+	float fCost = 0.0f;
+	int i;
+	for (i = nNode; i < nNodeEnd; i++)
+	{
+		BVHNode &node = m_nodes[i];
+		fCost += node.m_bounds.GetSurfaceArea() * (node.m_nCount > 0 ? node.m_nCount : 1);
+	}
+	return fCost / fRootArea;
+}
+
+void BVH::RebuildSubtrees(const std::vector<int> &vecRebuild, ThreadPool *threadPool)
+{
+	// Each subtree is built on its own from the primitives under it, which
+	// keep their run of m_primitives.
+	int nCount = vecRebuild.size();
+	std::vector<std::vector<BVHNode>> vecNodes(nCount);
+	ThreadPool::TaskFunc build = [&](int nTask, int nWorker)
+	{
+		const Subtree &subtree = m_subtrees[vecRebuild[nTask]];
+		int nBegin = subtree.m_nPrimitive;
+		int nPrimitiveCount = subtree.m_nPrimitiveEnd - nBegin;
+		std::vector<AABB> bounds(nPrimitiveCount);
+		int i;
+		for (i = 0; i < nPrimitiveCount; i++)
+		{
+			m_primitives[nBegin + i]->GetBounds(&bounds[i]);
+		}
+
+		BVHBuilder builder;
+		builder.m_nMaxDepth = BVH_STACK_SIZE - subtree.m_nDepth + 1;
+		std::vector<int> order;
+		builder.Build(bounds, &vecNodes[nTask], &order);
+
+		std::vector<Geometry *> primitives(nPrimitiveCount);
+		std::vector<unsigned int> versions(nPrimitiveCount);
+		for (i = 0; i < nPrimitiveCount; i++)
+		{
+			primitives[i] = m_primitives[nBegin + order[i]];
+			versions[i] = m_versions[nBegin + order[i]];
+		}
+		std::copy(primitives.begin(), primitives.end(), m_primitives.begin() + nBegin);
+		std::copy(versions.begin(), versions.end(), m_versions.begin() + nBegin);
+
+		std::vector<BVHNode> &nodes = vecNodes[nTask];
+		for (i = 0; i < (int)nodes.size(); i++)
+		{
+			if (nodes[i].m_nCount > 0)
+			{
+				nodes[i].m_nOffset += nBegin;
+			}
+		}
+	};
+	if (threadPool)
+	{
+		threadPool->Run(nCount, build);
+	}
+	else
+	{
+		int i;
+		for (i = 0; i < nCount; i++)
+		{
+			build(i, 0);
+		}
+	}
+
+	// A node after a rebuilt subtree moves by the change in size of every
+	// rebuilt subtree before it.
+	std::vector<int> vecEnds(nCount);
+	std::vector<int> vecShifts(nCount);
+	int nShift = 0;
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		const Subtree &subtree = m_subtrees[vecRebuild[i]];
+		nShift += (int)vecNodes[i].size() - (subtree.m_nNodeEnd - subtree.m_nNode);
+		vecEnds[i] = subtree.m_nNodeEnd;
+		vecShifts[i] = nShift;
+	}
+	auto shift = [&](int nOld)
+	{
+		int nIndex = (int)(std::upper_bound(vecEnds.begin(), vecEnds.end(), nOld) - vecEnds.begin()) - 1;
+		return nIndex >= 0 ? nOld + vecShifts[nIndex] : nOld;
+	};
+
+	std::vector<BVHNode> nodes;
+	nodes.reserve(m_nodes.size() + nShift);
+	int nRebuilt = 0;
+	int nOld = 0;
+	while (nOld < (int)m_nodes.size())
+	{
+		if (nRebuilt < nCount && nOld == m_subtrees[vecRebuild[nRebuilt]].m_nNode)
+		{
+			int nRoot = nodes.size();
+			int j;
+			for (j = 0; j < (int)vecNodes[nRebuilt].size(); j++)
+			{
+				BVHNode node = vecNodes[nRebuilt][j];
+				if (node.m_nCount == 0)
+				{
+					node.m_nOffset += nRoot;
+				}
+				nodes.push_back(node);
+			}
+			nOld = m_subtrees[vecRebuild[nRebuilt]].m_nNodeEnd;
+			nRebuilt++;
+			continue;
+		}
+
+		BVHNode node = m_nodes[nOld];
+		if (node.m_nCount == 0)
+		{
+			node.m_nOffset = shift(node.m_nOffset);
+		}
+		nodes.push_back(node);
+		nOld++;
+	}
+	m_nodes.swap(nodes);
+	m_dirty.assign(m_nodes.size(), 0);
+
+	nRebuilt = 0;
+	for (i = 0; i < (int)m_subtrees.size(); i++)
+	{
+		Subtree &subtree = m_subtrees[i];
+		int nSize = subtree.m_nNodeEnd - subtree.m_nNode;
+		subtree.m_nNode = shift(subtree.m_nNode);
+		if (nRebuilt < nCount && vecRebuild[nRebuilt] == i)
+		{
+			nSize = vecNodes[nRebuilt].size();
+			subtree.m_nNodeEnd = subtree.m_nNode + nSize;
+			subtree.m_fBuildArea = m_nodes[subtree.m_nNode].m_bounds.GetSurfaceArea();
+			subtree.m_fBuildCost = GetRangeCost(subtree.m_nNode, subtree.m_nNodeEnd, subtree.m_fBuildArea);
+			nRebuilt++;
+		}
+		else
+		{
+			subtree.m_nNodeEnd = subtree.m_nNode + nSize;
+		}
+		subtree.m_bDirty = false;
+	}
+	for (i = 0; i < (int)m_topNodes.size(); i++)
+	{
+		m_topNodes[i] = shift(m_topNodes[i]);
+	}
+	m_nDepth = ComputeDepth();
+}
+
+int BVH::ComputeDepth()
+{
+	if (m_nodes.empty())
+	{
+		return 0;
+	}
+	int nDepth = 0;
+	std::vector<std::pair<int, int>> stack;
+	stack.push_back(std::make_pair(0, 1));
+	while (!stack.empty())
+	{
+		int nNode = stack.back().first;
+		int nNodeDepth = stack.back().second;
+		stack.pop_back();
+		nDepth = MAX_(nDepth, nNodeDepth);
+		if (m_nodes[nNode].m_nCount == 0)
+		{
+			stack.push_back(std::make_pair(nNode + 1, nNodeDepth + 1));
+			stack.push_back(std::make_pair(m_nodes[nNode].m_nOffset, nNodeDepth + 1));
+		}
+	}
+	return nDepth;
+}
+
+bool BVH::Intersect(Ray3 *ray, IntersectResult *intersectResult)
+{
+	bool bHit = false;
+	int nCount = m_unbounded.size();
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		bHit |= m_unbounded[i]->Intersect(ray, intersectResult);
+	}
+
+	if (!m_nodes.empty())
+	{
+		Geometry **pPrimitives = &m_primitives[0];
+		BVH_Traverse(&m_nodes[0], ray, 0.0f, &intersectResult->m_distance, [&](int nOffset, int nLeafCount)
+		{
+			int j;
+			for (j = nOffset; j < nOffset + nLeafCount; j++)
+			{
+				bHit |= pPrimitives[j]->Intersect(ray, intersectResult);
+			}
+			return false;
+		});
+	}
+
+	return bHit;
+}
+
+bool BVH::Occluded(Ray3 *ray, float tMin, float tMax)
+{
+	int nCount = m_unbounded.size();
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		if (m_unbounded[i]->Occluded(ray, tMin, tMax))
+		{
+			return true;
+		}
+	}
+
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	// Any hit ends the query, so the walk never shrinks tMax.
+	Geometry **pPrimitives = &m_primitives[0];
+	return BVH_Traverse(&m_nodes[0], ray, tMin, &tMax, [&](int nOffset, int nLeafCount)
+	{
+		int j;
+		for (j = nOffset; j < nOffset + nLeafCount; j++)
+		{
+			if (pPrimitives[j]->Occluded(ray, tMin, tMax))
+			{
+				return true;
+			}
+		}
+		return false;
+	});
+}
+
+bool BVH::GetBounds(AABB *bounds)
+{
+	if (!m_unbounded.empty())
+	{
+		return false;
+	}
+	if (m_nodes.empty())
+	{
+		bounds->Reset();
+	}
+	else
+	{
+		*bounds = m_nodes[0].m_bounds;
+	}
+	return true;
+}
+
+int BVH::GetDepth()
+{
+	return m_nDepth;
+}
+
+float BVH::GetCost()
+{
+	return m_nodes.empty() ? 0.0f : GetRangeCost(0, m_nodes.size(), m_nodes[0].m_bounds.GetSurfaceArea());
+}
+
+int BVH::GetRefitCount()
+{
+	return m_nRefitCount;
+}
+
+int BVH::GetRebuildCount()
+{
+	return m_nRebuildCount;
+}
\ No newline at end of file
@@ -0,0 +1,197 @@
+#pragma once
+
+// Bounding volume hierarchy over bounded geometries, built with a binned
+// surface area heuristic. Nodes are stored in depth-first order: the first
+// child of an interior node directly follows it, m_nOffset points at the
+// second child. Unbounded geometries such as Plane are tested separately.
+//
+// Update() follows geometries that moved without building the hierarchy
+// again. Every subtree in depth-first order is a contiguous run of nodes whose
+// leaves cover a contiguous run of primitives, so the tree is cut into about
+// BVH_UPDATE_SUBTREES subtrees that are refit bottom-up on the thread pool.
+// Only leaves holding a primitive whose m_nVersion changed (see
+// Geometry::MarkChanged) and their ancestors are refit. Update() is passed on
+// to every primitive first, so aggregates below (a Union, a nested BVH) bring
+// themselves up to date and mark themselves changed, and the tree marks
+// itself changed when it refit anything. A refit subtree whose surface area
+// cost, taken against the area of its root box when it was built, has grown
+// past m_fRebuildThreshold times its cost then is built again from its
+// primitives and spliced in. When the whole tree degrades that far, or the
+// degraded subtrees hold more than BVH_REBUILD_FRACTION of the primitives, the
+// tree is built again instead, so Update() never costs much more than Build(). Surface area cost grows more slowly than the actual ray cost, so
+// the threshold is lower than the ray cost ratio it is meant to allow.
+
+#define BVH_MAX_LEAF_SIZE	4
+#define BVH_BIN_COUNT		16
+#define BVH_STACK_SIZE		64
+#define BVH_UPDATE_SUBTREES	64
+#define BVH_REBUILD_THRESHOLD	1.3f
+// Share of the primitives in degraded subtrees above which the whole tree is
+// built instead.
+#define BVH_REBUILD_FRACTION	0.5f
+
+class BVHNode
+{
+public:
+	AABB m_bounds;
+	int m_nOffset;
+	unsigned short m_nCount;
+	unsigned short m_nAxis;
+};
+
+// Builds the node array over a list of primitive bounds. The result is the
+// nodes plus the primitive order the leaves index into, so geometries with
+// their own primitive storage (SphereSet) can share the builder.
+class BVHBuilder
+{
+public:
+	BVHBuilder();
+	void Build(const std::vector<AABB> &bounds, std::vector<BVHNode> *pNodes, std::vector<int> *pOrder);
+	int GetDepth();
+public:
+	int m_nMaxLeafSize;
+	// Cost of one primitive test relative to one node traversal.
+	float m_fIntersectCost;
+	// Depth below which nodes are not split by cost any more.
+	int m_nMaxDepth;
+private:
+	class BuildItem
+	{
+	public:
+		AABB m_bounds;
+		Vector3 m_center;
+		int m_nIndex;
+	};
+	int BuildRecursive(int nBegin, int nEnd, int nDepth);
+	std::vector<BuildItem> m_items;
+	std::vector<BVHNode> *m_pNodes;
+	std::vector<int> *m_pOrder;
+	int m_nDepth;
+};
+
+// Walks the nodes whose boxes the ray enters within [tMin, *pMaxDistance],
+// near child first. leaf(nOffset, nCount) tests the primitives of a leaf; it
+// may shrink *pMaxDistance to cull farther nodes and returns true to stop.
+template <class LeafFunc>
+inline bool BVH_Traverse(const BVHNode *pNodes, const Ray3 *ray, float tMin, float *pMaxDistance, LeafFunc leaf)
+{
+	const Vector3 &origin = ray->m_origin;
+	const Vector3 invDir(1.0f / ray->m_direction.m_x, 1.0f / ray->m_direction.m_y, 1.0f / ray->m_direction.m_z);
+	const int dirNegative[3] = { invDir.m_x < 0.0f, invDir.m_y < 0.0f, invDir.m_z < 0.0f };
+
+	int stack[BVH_STACK_SIZE];
+	int nStackSize = 0;
+	int nNode = 0;
+
+	while (true)
+	{
+		const BVHNode &node = pNodes[nNode];
+		RT_STAT_INC(STAT_BVH_NODES);
+
+		// Slab test; NaNs from rays lying in a slab plane leave that axis unconstrained.
+		float tx0 = (node.m_bounds.m_min.m_x - origin.m_x) * invDir.m_x;
+		float tx1 = (node.m_bounds.m_max.m_x - origin.m_x) * invDir.m_x;
+		float ty0 = (node.m_bounds.m_min.m_y - origin.m_y) * invDir.m_y;
+		float ty1 = (node.m_bounds.m_max.m_y - origin.m_y) * invDir.m_y;
+		float tz0 = (node.m_bounds.m_min.m_z - origin.m_z) * invDir.m_z;
+		float tz1 = (node.m_bounds.m_max.m_z - origin.m_z) * invDir.m_z;
+		float tNear = MAX_(MIN_(tx0, tx1), -FLT_MAX);
+		tNear = MAX_(MIN_(ty0, ty1), tNear);
+		tNear = MAX_(MIN_(tz0, tz1), tNear);
+		float tFar = MIN_(MAX_(tx0, tx1), *pMaxDistance);
+		tFar = MIN_(MAX_(ty0, ty1), tFar);
+		tFar = MIN_(MAX_(tz0, tz1), tFar);
+
+		if (tNear <= tFar && tFar >= tMin)
+		{
+			if (node.m_nCount > 0)
+			{
+				if (leaf(node.m_nOffset, (int)node.m_nCount))
+				{
+					return true;
+				}
+			}
+			else
+			{
+				// Visit the child on the near side of the split first so the
+				// far child is usually culled by *pMaxDistance.
+				if (dirNegative[node.m_nAxis])
+				{
+					stack[nStackSize++] = nNode + 1;
+					nNode = node.m_nOffset;
+				}
+				else
+				{
+					stack[nStackSize++] = node.m_nOffset;
+					nNode = nNode + 1;
+				}
+				continue;
+			}
+		}
+
+		if (nStackSize == 0)
+		{
+			break;
+		}
+		nNode = stack[--nStackSize];
+	}
+
+	return false;
+}
+
+class BVH : public Geometry
+{
+public:
+	BVH();
+	~BVH();
+	void AddGeometry(Geometry *geometry);
+	void Initialize() override;
+	bool Intersect(Ray3 *ray, IntersectResult *intersectResult) override;
+	bool Occluded(Ray3 *ray, float tMin, float tMax) override;
+	bool GetBounds(AABB *bounds) override;
+	void Update(ThreadPool *threadPool) override;
+	int GetDepth();
+	// Surface area cost of the tree relative to its root box.
+	float GetCost();
+	// Primitives refit and subtrees built again by the last Update(); the
+	// whole tree counts as BVH_UPDATE_SUBTREES.
+	int GetRefitCount();
+	int GetRebuildCount();
+public:
+	std::vector<Geometry *> m_geometies;
+	std::vector<Geometry *> m_unbounded;
+	std::vector<Geometry *> m_primitives;
+	std::vector<BVHNode> m_nodes;
+	float m_fRebuildThreshold;
+private:
+	class Subtree
+	{
+	public:
+		int m_nNode;
+		int m_nNodeEnd;
+		int m_nPrimitive;
+		int m_nPrimitiveEnd;
+		int m_nDepth;
+		float m_fBuildArea;
+		float m_fBuildCost;
+		bool m_bDirty;
+	};
+	void Build();
+	void PrepareUpdate();
+	int RefitRange(int nNode, int nNodeEnd);
+	void RefitNode(int nNode);
+	float GetRangeCost(int nNode, int nNodeEnd, float fRootArea);
+	void RebuildSubtrees(const std::vector<int> &vecRebuild, ThreadPool *threadPool);
+	int ComputeDepth();
+private:
+	int m_nDepth;
+	std::vector<Subtree> m_subtrees;
+	// Interior nodes above the subtrees, deepest first.
+	std::vector<int> m_topNodes;
+	std::vector<unsigned int> m_versions;
+	std::vector<unsigned char> m_dirty;
+	float m_fBuildCost;
+	float m_fBuildArea;
+	int m_nRefitCount;
+	int m_nRebuildCount;
+};
\ No newline at end of file
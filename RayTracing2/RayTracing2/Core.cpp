@@ -0,0 +1,29 @@
+#include "CoreHeaders.h"
+
+#include "Simd.cpp"
+#include "RenderStats.cpp"
+
+#include "RayTracing.cpp"
+
+#include "RayPacket.cpp"
+
+#include "BVH.cpp"
+#include "SphereSet.cpp"
+#include "LightTree.cpp"
+
+#include "ThreadPool.cpp"
+
+#include "MappedFile.cpp"
+#include "TriangleMesh.cpp"
+#include "Instance.cpp"
+#include "Texture.cpp"
+
+#include "SceneArena.cpp"
+#include "Scene.cpp"
+#include "SceneFile.cpp"
+
+#include "Renderer.cpp"
+#include "Heatmap.cpp"
+#include "Wavefront.cpp"
+#include "RenderLibrary.cpp"
+#include "RenderJob.cpp"
\ No newline at end of file
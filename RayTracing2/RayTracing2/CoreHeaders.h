@@ -0,0 +1,93 @@
+#pragma once
+
+#ifdef _MSC_VER
+#pragma warning(disable: 4996)
+#endif
+
+#include <math.h>
+
+#include <float.h>
+
+#ifndef M_PI_F
+#define M_PI_F				3.14159265358979323846f
+#endif
+
+#define EPSILON_VALUE_1		0.001f
+
+#define MAX_DISTANCE		10000.0f
+
+#ifndef MAX_
+#define MAX_(a,b)            (((a) > (b)) ? (a) : (b))
+#endif
+
+#ifndef MIN_
+#define MIN_(a,b)            (((a) < (b)) ? (a) : (b))
+#endif
+
+#define ABS_(a)				((a) < 0 ? (-a) : (a))
+
+#include <time.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include <limits.h>
+
+#include <sys/stat.h>
+
+#include <vector>
+
+#include <string>
+
+#include <memory>
+
+#include <algorithm>
+
+#include <deque>
+
+#include <functional>
+
+#include <atomic>
+
+#include <thread>
+
+#include <mutex>
+
+#include <unordered_map>
+
+#include <condition_variable>
+
+#include <chrono>
+
+#include "Simd.h"
+
+#include "VectorMath.h"
+#include "RenderStats.h"
+
+#include "RayTracing.h"
+
+#include "RayPacket.h"
+
+#include "BVH.h"
+#include "SphereSet.h"
+#include "LightTree.h"
+
+#include "ThreadPool.h"
+
+#include "MappedFile.h"
+#include "TriangleMesh.h"
+#include "Instance.h"
+#include "Texture.h"
+
+#include "SceneArena.h"
+#include "Scene.h"
+#include "SceneFile.h"
+
+#include "Renderer.h"
+#include "Heatmap.h"
+#include "Wavefront.h"
+#include "RenderLibrary.h"
+#include "RenderJob.h"
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "Heatmap.h"
+
+static const char *s_pszHeatmapMetricNames[HEATMAP_METRIC_COUNT] =
+{
+	"cycles",
+	"intersections",
+	"shadow",
+	"reflections",
+};
+
+const char *Heatmap_GetMetricName(int nMetric)
+{
+	return nMetric >= 0 && nMetric < HEATMAP_METRIC_COUNT ? s_pszHeatmapMetricNames[nMetric] : "unknown";
+}
+
+int Heatmap_FindMetric(const char *pszName)
+{
+	int i;
+	for (i = 0; i < HEATMAP_METRIC_COUNT; i++)
+	{
+		if (strcmp(pszName, s_pszHeatmapMetricNames[i]) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+CostBuffer::CostBuffer()
+{
+	m_nWidth = 0;
+	m_nHeight = 0;
+}
+
+void CostBuffer::Create(int nWidth, int nHeight)
+{
+	m_nWidth = nWidth;
+	m_nHeight = nHeight;
+	int i;
+	for (i = 0; i < HEATMAP_METRIC_COUNT; i++)
+	{
+		m_vecCosts[i].assign(nWidth * nHeight, 0);
+	}
+}
+
+void CostBuffer::Clear()
+{
+	int i;
+	for (i = 0; i < HEATMAP_METRIC_COUNT; i++)
+	{
+		std::fill(m_vecCosts[i].begin(), m_vecCosts[i].end(), 0);
+	}
+}
+
+unsigned int CostBuffer::GetCost(int nMetric, int nX, int nY)
+{
+	return m_vecCosts[nMetric][nY * m_nWidth + nX];
+}
+
+unsigned long long CostBuffer::GetTotal(int nMetric)
+{
+	unsigned long long nTotal = 0;
+	int i;
+	for (i = 0; i < (int)m_vecCosts[nMetric].size(); i++)
+	{
+		nTotal += m_vecCosts[nMetric][i];
+	}
+	return nTotal;
+}
+
+unsigned int CostBuffer::GetPercentile(int nMetric, float fFraction)
+{
+	if (m_vecCosts[nMetric].empty())
+	{
+		return 0;
+	}
+	std::vector<unsigned int> vecSorted = m_vecCosts[nMetric];
+	int nIndex = MIN_((int)(fFraction * vecSorted.size()), (int)vecSorted.size() - 1);
+	std::nth_element(vecSorted.begin(), vecSorted.begin() + nIndex, vecSorted.end());
+	return vecSorted[nIndex];
+}
+
+float CostBuffer::Resolve(int nMetric, FrameBuffer *frameBuffer, float fReference)
+{
+	// Black, blue, cyan, green, yellow, red.
+	static const float s_ramp[][3] =
+	{
+		{ 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f },
+		{ 0.0f, 1.0f, 1.0f },
+		{ 0.0f, 1.0f, 0.0f },
+		{ 1.0f, 1.0f, 0.0f },
+		{ 1.0f, 0.0f, 0.0f },
+	};
+	const int nSegments = sizeof(s_ramp) / sizeof(s_ramp[0]) - 1;
+
+	if (fReference <= 0.0f)
+	{
+		fReference = (float)MAX_(GetPercentile(nMetric, HEATMAP_REFERENCE_PERCENTILE), 1u);
+	}
+	float fScale = nSegments / fReference;
+
+	int nY;
+	for (nY = 0; nY < m_nHeight; nY++)
+	{
+		const unsigned int *pSrc = &m_vecCosts[nMetric][nY * m_nWidth];
+		unsigned int *pDst = (unsigned int *)(frameBuffer->m_pPixels + nY * frameBuffer->m_nStride);
+		int nX;
+		for (nX = 0; nX < m_nWidth; nX++)
+		{
+			float t = MIN_(pSrc[nX] * fScale, (float)nSegments);
+			int nSegment = MIN_((int)t, nSegments - 1);
+			float f = t - nSegment;
+			const float *c0 = s_ramp[nSegment];
+			const float *c1 = s_ramp[nSegment + 1];
+			unsigned int r = (unsigned int)((c0[0] + (c1[0] - c0[0]) * f) * 255.0f);
+			unsigned int g = (unsigned int)((c0[1] + (c1[1] - c0[1]) * f) * 255.0f);
+			unsigned int b = (unsigned int)((c0[2] + (c1[2] - c0[2]) * f) * 255.0f);
+			pDst[nX] = 0xFF000000 | b | (g << 8) | (r << 16);
+		}
+	}
+	return fReference;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+// Per-pixel cost of a frame, for finding the expensive parts of a scene. A
+// Renderer given a CostBuffer traces every pixel on its own, without packets
+// or the wavefront pipeline, and records for each one the CPU cycles it took
+// and, from the RenderStats of its thread, the intersection tests and shadow
+// rays it caused. Reflection bounces come from the renderer's own ray count.
+// Intersection tests and shadow rays are counted only in builds with
+// RT_STATS; cycles and reflections are always recorded. Cycles are read with
+// rdtsc on x86 and are nanoseconds elsewhere.
+//
+// Resolve() turns one metric into a false colour image in the 8-bit pixels of
+// a frame buffer, from black for no cost over blue, cyan, green and yellow to
+// red at the reference value and above.
+
+#define HEATMAP_CYCLES			0
+#define HEATMAP_INTERSECTIONS	1
+#define HEATMAP_SHADOW_RAYS		2
+#define HEATMAP_REFLECTIONS		3
+#define HEATMAP_METRIC_COUNT	4
+
+// The reference value of Resolve() defaults to this fraction of pixels, so a
+// few outliers do not turn the rest of the image dark.
+#define HEATMAP_REFERENCE_PERCENTILE	0.99f
+
+inline unsigned long long Heatmap_ReadCycles()
+{
+#ifdef RT_SIMD_X86
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+const char *Heatmap_GetMetricName(int nMetric);
+// Returns -1 for an unknown name.
+int Heatmap_FindMetric(const char *pszName);
+
+class CostBuffer
+{
+public:
+	CostBuffer();
+	void Create(int nWidth, int nHeight);
+	void Clear();
+	inline void SetCost(int nMetric, int nX, int nY, unsigned int nCost);
+	unsigned int GetCost(int nMetric, int nX, int nY);
+	unsigned long long GetTotal(int nMetric);
+	// Cost that the given fraction of pixels do not exceed.
+	unsigned int GetPercentile(int nMetric, float fFraction);
+	// Colours the pixels of frameBuffer, which must have the same size, and
+	// returns the reference value used. With fReference <= 0 it is the
+	// HEATMAP_REFERENCE_PERCENTILE of the metric.
+	float Resolve(int nMetric, FrameBuffer *frameBuffer, float fReference);
+public:
+	int m_nWidth;
+	int m_nHeight;
+	std::vector<unsigned int> m_vecCosts[HEATMAP_METRIC_COUNT];
+};
+
+inline void CostBuffer::SetCost(int nMetric, int nX, int nY, unsigned int nCost)
+{
+	m_vecCosts[nMetric][nY * m_nWidth + nX] = nCost;
+}
\ No newline at end of file
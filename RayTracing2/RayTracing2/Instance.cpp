@@ -0,0 +1,250 @@
+#include "Instance.h"
+
+AffineTransform::AffineTransform()
+{
+	int i;
+	for (i = 0; i < 3; i++)
+	{
+		int j;
+		for (j = 0; j < 4; j++)
+		{
+			m_m[i][j] = i == j ? 1.0f : 0.0f;
+		}
+	}
+}
+
+AffineTransform AffineTransform::Translation(const Vector3 &offset)
+{
+	AffineTransform transform;
+	transform.m_m[0][3] = offset.m_x;
+	transform.m_m[1][3] = offset.m_y;
+	transform.m_m[2][3] = offset.m_z;
+	return transform;
+}
+
+AffineTransform AffineTransform::Scale(const Vector3 &scale)
+{
+	AffineTransform transform;
+	transform.m_m[0][0] = scale.m_x;
+	transform.m_m[1][1] = scale.m_y;
+	transform.m_m[2][2] = scale.m_z;
+	return transform;
+}
+
+AffineTransform AffineTransform::Rotation(const Vector3 &axis, float fDegrees)
+{
+	Vector3 a = axis.Normalize();
+	float fRadians = fDegrees * (M_PI_F / 180.0f);
+	float c = cosf(fRadians);
+	float s = sinf(fRadians);
+	float t = 1.0f - c;
+
+	AffineTransform transform;
+	transform.m_m[0][0] = t * a.m_x * a.m_x + c;
+	transform.m_m[0][1] = t * a.m_x * a.m_y - s * a.m_z;
+	transform.m_m[0][2] = t * a.m_x * a.m_z + s * a.m_y;
+	transform.m_m[1][0] = t * a.m_x * a.m_y + s * a.m_z;
+	transform.m_m[1][1] = t * a.m_y * a.m_y + c;
+	transform.m_m[1][2] = t * a.m_y * a.m_z - s * a.m_x;
+	transform.m_m[2][0] = t * a.m_x * a.m_z - s * a.m_y;
+	transform.m_m[2][1] = t * a.m_y * a.m_z + s * a.m_x;
+	transform.m_m[2][2] = t * a.m_z * a.m_z + c;
+	return transform;
+}
+
+AffineTransform AffineTransform::operator*(const AffineTransform &other) const
+{
+	AffineTransform result;
+	int i;
+	for (i = 0; i < 3; i++)
+	{
+		int j;
+		for (j = 0; j < 4; j++)
+		{
+			result.m_m[i][j] = m_m[i][0] * other.m_m[0][j] + m_m[i][1] * other.m_m[1][j] + m_m[i][2] * other.m_m[2][j];
+		}
+		result.m_m[i][3] += m_m[i][3];
+	}
+	return result;
+}
+
+AffineTransform AffineTransform::Inverse() const
+{
+	const float (*m)[4] = m_m;
+	float c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+	float c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+	float c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+	float fDeterminant = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+	float f = fDeterminant != 0.0f ? 1.0f / fDeterminant : 0.0f;
+
+	// Adjugate over determinant; the translation is undone after the rest.
+	AffineTransform inverse;
+	inverse.m_m[0][0] = c00 * f;
+	inverse.m_m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * f;
+	inverse.m_m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * f;
+	inverse.m_m[1][0] = c01 * f;
+	inverse.m_m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * f;
+	inverse.m_m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * f;
+	inverse.m_m[2][0] = c02 * f;
+	inverse.m_m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * f;
+	inverse.m_m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * f;
+	Vector3 translation = inverse.TransformVector(Vector3(m[0][3], m[1][3], m[2][3]));
+	inverse.m_m[0][3] = -translation.m_x;
+	inverse.m_m[1][3] = -translation.m_y;
+	inverse.m_m[2][3] = -translation.m_z;
+	return inverse;
+}
+
+Vector3 AffineTransform::TransformPoint(const Vector3 &point) const
+{
+	return Vector3(
+		m_m[0][0] * point.m_x + m_m[0][1] * point.m_y + m_m[0][2] * point.m_z + m_m[0][3],
+		m_m[1][0] * point.m_x + m_m[1][1] * point.m_y + m_m[1][2] * point.m_z + m_m[1][3],
+		m_m[2][0] * point.m_x + m_m[2][1] * point.m_y + m_m[2][2] * point.m_z + m_m[2][3]);
+}
+
+Vector3 AffineTransform::TransformVector(const Vector3 &vector) const
+{
+	return Vector3(
+		m_m[0][0] * vector.m_x + m_m[0][1] * vector.m_y + m_m[0][2] * vector.m_z,
+		m_m[1][0] * vector.m_x + m_m[1][1] * vector.m_y + m_m[1][2] * vector.m_z,
+		m_m[2][0] * vector.m_x + m_m[2][1] * vector.m_y + m_m[2][2] * vector.m_z);
+}
+
+Vector3 AffineTransform::TransformTransposed(const Vector3 &vector) const
+{
+	return Vector3(
+		m_m[0][0] * vector.m_x + m_m[1][0] * vector.m_y + m_m[2][0] * vector.m_z,
+		m_m[0][1] * vector.m_x + m_m[1][1] * vector.m_y + m_m[2][1] * vector.m_z,
+		m_m[0][2] * vector.m_x + m_m[1][2] * vector.m_y + m_m[2][2] * vector.m_z);
+}
+
+AABB AffineTransform::TransformBounds(const AABB &bounds) const
+{
+	// Center goes through the transform, the half extent through the
+	// absolute linear part.
+	Vector3 center = (bounds.m_min + bounds.m_max) * 0.5f;
+	Vector3 extent = (bounds.m_max - bounds.m_min) * 0.5f;
+	Vector3 newCenter = TransformPoint(center);
+	Vector3 newExtent(
+		fabsf(m_m[0][0]) * extent.m_x + fabsf(m_m[0][1]) * extent.m_y + fabsf(m_m[0][2]) * extent.m_z,
+		fabsf(m_m[1][0]) * extent.m_x + fabsf(m_m[1][1]) * extent.m_y + fabsf(m_m[1][2]) * extent.m_z,
+		fabsf(m_m[2][0]) * extent.m_x + fabsf(m_m[2][1]) * extent.m_y + fabsf(m_m[2][2]) * extent.m_z);
+	return AABB(newCenter - newExtent, newCenter + newExtent);
+}
+
+Instance::Instance(Geometry *prototype, const AffineTransform &transform)
+{
+	m_prototype = prototype;
+	m_transform = transform;
+	m_nPrototypeVersion = 0;
+}
+
+Instance::~Instance()
+{
+
+}
+
+void Instance::Initialize()
+{
+	m_inverse = m_transform.Inverse();
+	m_nPrototypeVersion = m_prototype->m_nVersion;
+}
+
+inline float Instance::ToPrototype(const Ray3 *ray, Ray3 *prototypeRay)
+{
+	Vector3 direction = m_inverse.TransformVector(ray->m_direction);
+	float fScale = direction.Length();
+	prototypeRay->m_origin = m_inverse.TransformPoint(ray->m_origin);
+	prototypeRay->m_direction = direction * (1.0f / fScale);
+	return fScale;
+}
+
+bool Instance::Intersect(Ray3 *ray, IntersectResult *intersectResult)
+{
+	Ray3 prototypeRay;
+	float fScale = ToPrototype(ray, &prototypeRay);
+
+	IntersectResult prototypeResult;
+	prototypeResult.m_distance = intersectResult->m_distance * fScale;
+	if (!m_prototype->Intersect(&prototypeRay, &prototypeResult))
+	{
+		return false;
+	}
+
+	float fDistance = prototypeResult.m_distance / fScale;
+	if (fDistance >= intersectResult->m_distance)
+	{
+		return false;
+	}
+	intersectResult->m_geometry = this;
+	intersectResult->m_nPrimitive = prototypeResult.m_geometry == m_prototype ? prototypeResult.m_nPrimitive : -1;
+	intersectResult->m_distance = fDistance;
+	intersectResult->m_u = prototypeResult.m_u;
+	intersectResult->m_v = prototypeResult.m_v;
+	return true;
+}
+
+void Instance::ComputeSurfaceInteraction(Ray3 *ray, IntersectResult *intersectResult)
+{
+	Ray3 prototypeRay;
+	float fScale = ToPrototype(ray, &prototypeRay);
+
+	IntersectResult prototypeResult;
+	if (intersectResult->m_nPrimitive >= 0)
+	{
+		prototypeResult.m_geometry = m_prototype;
+		prototypeResult.m_nPrimitive = intersectResult->m_nPrimitive;
+		prototypeResult.m_distance = intersectResult->m_distance * fScale;
+		prototypeResult.m_u = intersectResult->m_u;
+		prototypeResult.m_v = intersectResult->m_v;
+	}
+	else
+	{
+		// The closest hit does not depend on the starting distance, so this
+		// finds the same geometry Intersect() did.
+		prototypeResult.m_distance = FLT_MAX;
+		m_prototype->Intersect(&prototypeRay, &prototypeResult);
+	}
+
+	if (prototypeResult.m_geometry == NULL)
+	{
+		intersectResult->m_material = m_material;
+		intersectResult->m_position = ray->GetPoint(intersectResult->m_distance);
+		intersectResult->m_normal = -ray->m_direction;
+		return;
+	}
+
+	prototypeResult.m_geometry->ComputeSurfaceInteraction(&prototypeRay, &prototypeResult);
+	intersectResult->m_material = m_material ? m_material : prototypeResult.m_material;
+	intersectResult->m_position = m_transform.TransformPoint(prototypeResult.m_position);
+	intersectResult->m_normal = m_inverse.TransformTransposed(prototypeResult.m_normal).Normalize();
+}
+
+bool Instance::Occluded(Ray3 *ray, float tMin, float tMax)
+{
+	Ray3 prototypeRay;
+	float fScale = ToPrototype(ray, &prototypeRay);
+	return m_prototype->Occluded(&prototypeRay, tMin * fScale, tMax * fScale);
+}
+
+bool Instance::GetBounds(AABB *bounds)
+{
+	AABB prototypeBounds;
+	if (!m_prototype->GetBounds(&prototypeBounds))
+	{
+		return false;
+	}
+	*bounds = m_transform.TransformBounds(prototypeBounds);
+	return true;
+}
+
+// The prototype is brought up to date by its owner, never here.
+void Instance::Update(ThreadPool *threadPool)
+{
+	if (m_prototype->m_nVersion != m_nPrototypeVersion)
+	{
+		m_nPrototypeVersion = m_prototype->m_nVersion;
+		MarkChanged();
+	}
+}
\ No newline at end of file
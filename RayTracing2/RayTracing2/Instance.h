@@ -0,0 +1,70 @@
+#pragma once
+
+// Placement of a shared prototype geometry. An Instance holds no geometry of
+// its own, only the prototype pointer and an affine transform from prototype
+// space to world space, so a forest of a million trees costs a million small
+// objects plus one tree. Put instances into a BVH and give each prototype its
+// own acceleration structure (a SphereSet, a TriangleMesh or a BVH): the
+// scene's BVH is then the top level over instance boxes and every instance
+// continues the ray into the bottom level of its prototype.
+//
+// Rays are taken into prototype space with the inverse transform. The
+// direction is normalized there and distances are scaled back, so hits are
+// reported at world space distances and the usual closest-hit rules hold.
+// A hit on a prototype that reports itself as the hit geometry keeps its
+// primitive and barycentrics; for aggregate prototypes m_nPrimitive is -1 and
+// ComputeSurfaceInteraction() finds the hit geometry again by tracing the one
+// ray through the prototype. Normals go back to world space with the inverse
+// transpose, so non-uniform scales shade correctly. m_material, when set,
+// replaces the material of the prototype.
+//
+// Prototypes are shared, so an instance never initializes its prototype; create
+// them with Scene::CreatePrototype, which initializes them before the root.
+// After editing m_transform call MarkChanged() so a BVH::Update picks up the
+// new bounds. A prototype that changes (an animated BVH refit by
+// Scene::Update) changes its m_nVersion, and Update() marks every instance of
+// it changed, so the boxes of the instances move with it.
+
+class AffineTransform
+{
+public:
+	AffineTransform();
+	static AffineTransform Translation(const Vector3 &offset);
+	static AffineTransform Scale(const Vector3 &scale);
+	// Rotation by fDegrees around axis, counter-clockwise looking down the axis.
+	static AffineTransform Rotation(const Vector3 &axis, float fDegrees);
+	// Applies other first, then this.
+	AffineTransform operator*(const AffineTransform &other) const;
+	AffineTransform Inverse() const;
+	Vector3 TransformPoint(const Vector3 &point) const;
+	Vector3 TransformVector(const Vector3 &vector) const;
+	// Multiplies by the transposed linear part; with the inverse transform this
+	// takes normals across.
+	Vector3 TransformTransposed(const Vector3 &vector) const;
+	AABB TransformBounds(const AABB &bounds) const;
+public:
+	// Rows of the 3x4 matrix; column 3 is the translation.
+	float m_m[3][4];
+};
+
+class Instance : public Geometry
+{
+public:
+	Instance(Geometry *prototype, const AffineTransform &transform);
+	~Instance();
+	void Initialize() override;
+	bool Intersect(Ray3 *ray, IntersectResult *intersectResult) override;
+	void ComputeSurfaceInteraction(Ray3 *ray, IntersectResult *intersectResult) override;
+	bool Occluded(Ray3 *ray, float tMin, float tMax) override;
+	bool GetBounds(AABB *bounds) override;
+	void Update(ThreadPool *threadPool) override;
+public:
+	Geometry *m_prototype;
+	AffineTransform m_transform;
+private:
+	// Returns the length of the prototype space direction before it was
+	// normalized, the factor from world to prototype space distances.
+	inline float ToPrototype(const Ray3 *ray, Ray3 *prototypeRay);
+	AffineTransform m_inverse;
+	unsigned int m_nPrototypeVersion;
+};
\ No newline at end of file
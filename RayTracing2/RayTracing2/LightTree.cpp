@@ -0,0 +1,254 @@
+#include "LightTree.h"
+
+// Smallest cone around the cones (axisA, thetaA) and (axisB, thetaB).
+static void LightTree_UnionCone(const Vector3 &axisA, float thetaA, const Vector3 &axisB, float thetaB,
+	Vector3 *pAxis, float *pTheta)
+{
+	if (thetaA < thetaB)
+	{
+		LightTree_UnionCone(axisB, thetaB, axisA, thetaA, pAxis, pTheta);
+		return;
+	}
+
+	float thetaD = acosf(MIN_(MAX_(axisA.Dot(axisB), -1.0f), 1.0f));
+	if (MIN_(thetaD + thetaB, M_PI_F) <= thetaA)
+	{
+		*pAxis = axisA;
+		*pTheta = thetaA;
+		return;
+	}
+
+	float thetaO = (thetaA + thetaD + thetaB) * 0.5f;
+	float sinD = sinf(thetaD);
+	if (thetaO >= M_PI_F || sinD < 1e-4f)
+	{
+		*pAxis = axisA;
+		*pTheta = M_PI_F;
+		return;
+	}
+
+	// Turn axisA towards axisB by the part of the new spread it does not cover.
+	float thetaR = thetaO - thetaA;
+	*pAxis = (axisA * sinf(thetaD - thetaR) + axisB * sinf(thetaR)) * (1.0f / sinD);
+	*pTheta = thetaO;
+}
+
+LightTree::LightTree()
+{
+}
+
+void LightTree::Build(const std::vector<Light *> &lights)
+{
+	Release();
+
+	std::vector<BuildItem> items;
+	int i;
+	for (i = 0; i < (int)lights.size(); i++)
+	{
+		BuildItem item;
+		if (!lights[i]->GetBounds(&item.m_bounds))
+		{
+			m_vecUnbounded.push_back(lights[i]);
+			continue;
+		}
+		// Lights that emit nothing can never be picked.
+		if (item.m_bounds.m_intensity <= 0.0f)
+		{
+			continue;
+		}
+		item.m_nLight = (int)m_vecLights.size();
+		m_vecLights.push_back(lights[i]);
+		items.push_back(item);
+	}
+
+	if (!items.empty())
+	{
+		m_vecNodes.reserve(items.size() * 2 - 1);
+		BuildRecursive(items, 0, (int)items.size());
+	}
+}
+
+int LightTree::BuildRecursive(std::vector<BuildItem> &items, int nBegin, int nEnd)
+{
+	int nNode = (int)m_vecNodes.size();
+	m_vecNodes.push_back(LightTreeNode());
+
+	if (nEnd - nBegin == 1)
+	{
+		const LightBounds &bounds = items[nBegin].m_bounds;
+		LightTreeNode &node = m_vecNodes[nNode];
+		node.m_bounds = AABB(bounds.m_position, bounds.m_position);
+		node.m_axis = bounds.m_axis;
+		node.m_thetaO = bounds.m_thetaO;
+		node.m_thetaE = bounds.m_thetaE;
+		node.m_intensity = bounds.m_intensity;
+		node.m_nOffset = items[nBegin].m_nLight;
+		node.m_bLeaf = true;
+		return nNode;
+	}
+
+	// Median split along the longest axis of the light positions.
+	AABB centerBounds;
+	int i;
+	for (i = nBegin; i < nEnd; i++)
+	{
+		centerBounds.Extend(items[i].m_bounds.m_position);
+	}
+	int nAxis = centerBounds.GetLongestAxis();
+	int nMid = (nBegin + nEnd) / 2;
+	std::nth_element(items.begin() + nBegin, items.begin() + nMid, items.begin() + nEnd,
+		[nAxis](const BuildItem &a, const BuildItem &b)
+	{
+		return (&a.m_bounds.m_position.m_x)[nAxis] < (&b.m_bounds.m_position.m_x)[nAxis];
+	});
+
+	int nLeft = BuildRecursive(items, nBegin, nMid);
+	int nRight = BuildRecursive(items, nMid, nEnd);
+
+	const LightTreeNode &left = m_vecNodes[nLeft];
+	const LightTreeNode &right = m_vecNodes[nRight];
+	LightTreeNode node;
+	node.m_bounds = left.m_bounds;
+	node.m_bounds.Extend(right.m_bounds);
+	LightTree_UnionCone(left.m_axis, left.m_thetaO, right.m_axis, right.m_thetaO, &node.m_axis, &node.m_thetaO);
+	node.m_thetaE = MAX_(left.m_thetaE, right.m_thetaE);
+	node.m_intensity = left.m_intensity + right.m_intensity;
+	node.m_nOffset = nRight;
+	node.m_bLeaf = false;
+	m_vecNodes[nNode] = node;
+	return nNode;
+}
+
+void LightTree::Release()
+{
+	m_vecUnbounded.clear();
+	m_vecLights.clear();
+	m_vecNodes.clear();
+}
+
+int LightTree::GetLightCount()
+{
+	return (int)m_vecLights.size();
+}
+
+// Upper bound on the irradiance the lights of node can deliver to position,
+// up to the common factor. The box is widened to the cone it subtends, so no
+// light that reaches the point gets an importance of zero.
+float LightTree::Importance(const LightTreeNode &node, const Vector3 &position, const Vector3 &normal)
+{
+	Vector3 center = (node.m_bounds.m_min + node.m_bounds.m_max) * 0.5f;
+	Vector3 delta = position - center;
+	float dd = delta.SqrLength();
+	float rr = (node.m_bounds.m_max - center).SqrLength();
+	if (dd <= rr)
+	{
+		// Inside the box every direction is possible.
+		return node.m_intensity / MAX_(rr, 1e-6f);
+	}
+
+	float d = sqrtf(dd);
+	Vector3 direction = delta * (1.0f / d);
+	float thetaU = asinf(MIN_(sqrtf(rr) / d, 1.0f));
+
+	float theta = acosf(MIN_(MAX_(node.m_axis.Dot(direction), -1.0f), 1.0f));
+	if (MAX_(theta - node.m_thetaO - thetaU, 0.0f) > node.m_thetaE)
+	{
+		return 0.0f;
+	}
+
+	float thetaI = acosf(MIN_(MAX_(-normal.Dot(direction), -1.0f), 1.0f));
+	float thetaIP = MAX_(thetaI - thetaU, 0.0f);
+	if (thetaIP >= M_PI_F * 0.5f)
+	{
+		return 0.0f;
+	}
+	return node.m_intensity * cosf(thetaIP) / MAX_(dd, 1e-6f);
+}
+
+Light *LightTree::Sample(const Vector3 &position, const Vector3 &normal, double u, float *pPdf)
+{
+	if (m_vecNodes.empty())
+	{
+		return NULL;
+	}
+
+	float pdf = 1.0f;
+	int nNode = 0;
+	while (!m_vecNodes[nNode].m_bLeaf)
+	{
+		int nLeft = nNode + 1;
+		int nRight = m_vecNodes[nNode].m_nOffset;
+		float fLeft = Importance(m_vecNodes[nLeft], position, normal);
+		float fRight = Importance(m_vecNodes[nRight], position, normal);
+		if (fLeft + fRight <= 0.0f)
+		{
+			return NULL;
+		}
+
+		// u is rescaled to [0, 1) within the chosen interval and reused below.
+		float p = fLeft / (fLeft + fRight);
+		if (u < p)
+		{
+			u = u / p;
+			pdf *= p;
+			nNode = nLeft;
+		}
+		else
+		{
+			u = (u - p) / (1.0 - p);
+			pdf *= 1.0f - p;
+			nNode = nRight;
+		}
+		u = MIN_(u, 1.0 - DBL_EPSILON);
+	}
+
+	if (nNode == 0 && Importance(m_vecNodes[0], position, normal) <= 0.0f)
+	{
+		return NULL;
+	}
+	*pPdf = pdf;
+	return m_vecLights[m_vecNodes[nNode].m_nOffset];
+}
+
+float LightTree::GetProbability(const Vector3 &position, const Vector3 &normal, int nLight)
+{
+	if (m_vecNodes.empty())
+	{
+		return 0.0f;
+	}
+
+	int stack[LIGHTTREE_STACK_SIZE];
+	float probabilities[LIGHTTREE_STACK_SIZE];
+	int nStackSize = 0;
+	int nNode = 0;
+	float fProbability = Importance(m_vecNodes[0], position, normal) > 0.0f ? 1.0f : 0.0f;
+	while (true)
+	{
+		const LightTreeNode &node = m_vecNodes[nNode];
+		if (node.m_bLeaf)
+		{
+			if (node.m_nOffset == nLight)
+			{
+				return fProbability;
+			}
+			if (nStackSize == 0)
+			{
+				return 0.0f;
+			}
+			nStackSize--;
+			nNode = stack[nStackSize];
+			fProbability = probabilities[nStackSize];
+			continue;
+		}
+
+		float fLeft = Importance(m_vecNodes[nNode + 1], position, normal);
+		float fRight = Importance(m_vecNodes[node.m_nOffset], position, normal);
+		float p = fLeft + fRight > 0.0f ? fLeft / (fLeft + fRight) : 0.0f;
+		float fRightProbability = fLeft + fRight > 0.0f ? fProbability * (1.0f - p) : 0.0f;
+		stack[nStackSize] = node.m_nOffset;
+		probabilities[nStackSize] = fRightProbability;
+		nStackSize++;
+		nNode = nNode + 1;
+		fProbability *= p;
+	}
+}
\ No newline at end of file
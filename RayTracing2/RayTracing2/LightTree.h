@@ -0,0 +1,57 @@
+#pragma once
+
+// Hierarchy over the point and spot lights of a scene for many-light
+// rendering. Every node bounds the positions of its lights with a box, their
+// emission directions with a cone (the axes lie within m_thetaO of m_axis and
+// light leaves them at most m_thetaE further out) and their summed intensity.
+// Sample() walks from the root to one light, choosing between the children of
+// each node in proportion to a conservative estimate of what they can add at
+// the shading point, and returns the probability of the light it reached, so
+// a shading point can cast a few shadow rays instead of one per light and
+// still converge to the full sum. Lights without a position, such as
+// DirectionalLight, are kept in m_vecUnbounded and are always sampled.
+//
+// Nodes are stored in depth-first order like BVHNode: the first child of an
+// interior node directly follows it and m_nOffset points at the second; in a
+// leaf it is the index of the light.
+
+#define LIGHTTREE_STACK_SIZE	64
+
+class LightTreeNode
+{
+public:
+	AABB m_bounds;
+	Vector3 m_axis;
+	float m_thetaO;
+	float m_thetaE;
+	float m_intensity;
+	int m_nOffset;
+	bool m_bLeaf;
+};
+
+class LightTree
+{
+public:
+	LightTree();
+	void Build(const std::vector<Light *> &lights);
+	void Release();
+	int GetLightCount();
+	// Picks one bounded light for a point with surface normal normal using
+	// u in [0, 1). Returns NULL if no light can reach the point.
+	Light *Sample(const Vector3 &position, const Vector3 &normal, double u, float *pPdf);
+	// Probability of Sample() returning light, for tests and tools.
+	float GetProbability(const Vector3 &position, const Vector3 &normal, int nLight);
+public:
+	std::vector<Light *> m_vecUnbounded;
+	std::vector<Light *> m_vecLights;
+	std::vector<LightTreeNode> m_vecNodes;
+private:
+	class BuildItem
+	{
+	public:
+		LightBounds m_bounds;
+		int m_nLight;
+	};
+	int BuildRecursive(std::vector<BuildItem> &items, int nBegin, int nEnd);
+	static float Importance(const LightTreeNode &node, const Vector3 &position, const Vector3 &normal);
+};
\ No newline at end of file
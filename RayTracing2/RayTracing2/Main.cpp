@@ -1,8 +1,7 @@
-
 #include "Headers.h"
 
 #include "Soft3DEngine/CSoft3DEngine.cpp"
 
-#include "RayTracing.cpp"
+#include "Core.cpp"
 
 #include "Soft3DEngine.cpp"
\ No newline at end of file
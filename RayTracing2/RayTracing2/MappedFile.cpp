@@ -0,0 +1,136 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	m_pData = NULL;
+	m_nSize = 0;
+#ifdef _WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char *pszFileName)
+{
+	Close();
+
+	m_hFile = CreateFileA(pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	m_pData = (const unsigned char *)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_pData == NULL)
+	{
+		Close();
+		return false;
+	}
+	m_nSize = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+		m_pData = NULL;
+	}
+	if (m_hMapping)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = NULL;
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+	m_nSize = 0;
+}
+
+#else
+
+bool MappedFile::Open(const char *pszFileName)
+{
+	Close();
+
+	int nFile = open(pszFileName, O_RDONLY);
+	if (nFile < 0)
+	{
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(nFile, &st) != 0 || st.st_size == 0)
+	{
+		close(nFile);
+		return false;
+	}
+
+	// The mapping keeps its own reference to the file.
+	void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, nFile, 0);
+	close(nFile);
+	if (p == MAP_FAILED)
+	{
+		return false;
+	}
+
+	m_pData = (const unsigned char *)p;
+	m_nSize = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData)
+	{
+		munmap((void *)m_pData, m_nSize);
+		m_pData = NULL;
+	}
+	m_nSize = 0;
+}
+
+#endif
+
+const unsigned char *MappedFile::GetData()
+{
+	return m_pData;
+}
+
+size_t MappedFile::GetSize()
+{
+	return m_nSize;
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+// Read-only memory mapping of a whole file. The pages are shared with the
+// operating system's file cache, so data laid out for direct use (binary mesh
+// caches, scene files) is available without copying or parsing.
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	bool Open(const char *pszFileName);
+	void Close();
+	const unsigned char *GetData();
+	size_t GetSize();
+private:
+	const unsigned char *m_pData;
+	size_t m_nSize;
+#ifdef _WIN32
+	void *m_hFile;
+	void *m_hMapping;
+#endif
+};
+
+// True if nCount elements of nElementSize bytes starting at nOffset lie within
+// the first nSize bytes. Offsets and counts come from the file itself, so the
+// test is written so that nothing can wrap around.
+inline bool MappedFile_IsInRange(unsigned long long nOffset, unsigned long long nCount, unsigned long long nElementSize, unsigned long long nSize)
+{
+	return nOffset <= nSize && nCount <= (nSize - nOffset) / nElementSize;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "RayPacket.h"
+
+RayPacket::RayPacket()
+{
+	Reset(0, 0);
+}
+
+void RayPacket::Reset(int nSize, unsigned int nActiveMask)
+{
+	m_pKernels = Simd_GetKernels();
+	m_nSize = nSize;
+	m_nActiveMask = nActiveMask;
+	m_nOccludedMask = 0;
+
+	int i;
+	for (i = 0; i < SIMD_MAX_WIDTH; i++)
+	{
+		m_distance[i] = MAX_DISTANCE;
+		m_geometry[i] = NULL;
+		m_nPrimitive[i] = 0;
+		m_u[i] = 0.0f;
+		m_v[i] = 0.0f;
+	}
+}
+
+void RayPacket::SetRay(int nLane, const Ray3 &ray)
+{
+	m_originX[nLane] = ray.m_origin.m_x;
+	m_originY[nLane] = ray.m_origin.m_y;
+	m_originZ[nLane] = ray.m_origin.m_z;
+	m_directionX[nLane] = ray.m_direction.m_x;
+	m_directionY[nLane] = ray.m_direction.m_y;
+	m_directionZ[nLane] = ray.m_direction.m_z;
+}
+
+void RayPacket::GetRay(int nLane, Ray3 *ray)
+{
+	ray->m_origin = Vector3(m_originX[nLane], m_originY[nLane], m_originZ[nLane]);
+	ray->m_direction = Vector3(m_directionX[nLane], m_directionY[nLane], m_directionZ[nLane]);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+// Structure-of-arrays bundle of up to SIMD_MAX_WIDTH coherent rays. Lanes whose
+// bit is clear in m_nActiveMask are skipped by every kernel. m_distance,
+// m_geometry, m_nPrimitive and m_u/m_v hold the closest hit found so far, the
+// per-lane equivalent of IntersectResult.
+
+class RayPacket
+{
+public:
+	RayPacket();
+	void Reset(int nSize, unsigned int nActiveMask);
+	void SetRay(int nLane, const Ray3 &ray);
+	void GetRay(int nLane, Ray3 *ray);
+public:
+	int m_nSize;
+	unsigned int m_nActiveMask;
+	// Lanes found blocked by OccludedPacket.
+	unsigned int m_nOccludedMask;
+	alignas(64) float m_originX[SIMD_MAX_WIDTH];
+	alignas(64) float m_originY[SIMD_MAX_WIDTH];
+	alignas(64) float m_originZ[SIMD_MAX_WIDTH];
+	alignas(64) float m_directionX[SIMD_MAX_WIDTH];
+	alignas(64) float m_directionY[SIMD_MAX_WIDTH];
+	alignas(64) float m_directionZ[SIMD_MAX_WIDTH];
+	alignas(64) float m_distance[SIMD_MAX_WIDTH];
+	alignas(64) int m_nX[SIMD_MAX_WIDTH];
+	alignas(64) int m_nY[SIMD_MAX_WIDTH];
+	alignas(64) int m_nPrimitive[SIMD_MAX_WIDTH];
+	alignas(64) float m_u[SIMD_MAX_WIDTH];
+	alignas(64) float m_v[SIMD_MAX_WIDTH];
+	Geometry *m_geometry[SIMD_MAX_WIDTH];
+	const SimdKernels *m_pKernels;
+};
\ No newline at end of file
@@ -0,0 +1,201 @@
+// Packet kernels written once against vfloat/vmask and compiled for every
+// instruction set by Simd.cpp. The arithmetic follows the scalar code in
+// RayTracing.cpp operation by operation, so each lane produces bit-identical
+// results to the single ray path.
+
+static void GeneratePrimary(PerspectiveCamera *camera, RayPacket *packet, float fWidth, float fHeight)
+{
+	vfloat half = Set1(0.5f);
+	vfloat one = Set1(1.0f);
+	vfloat fovScale = Set1(camera->m_fovScale);
+	vfloat width = Set1(fWidth);
+	vfloat height = Set1(fHeight);
+
+	int nBase;
+	for (nBase = 0; nBase < packet->m_nSize; nBase += SIMD_LANES)
+	{
+		vfloat sx = LoadInt(packet->m_nX + nBase) / width;
+		vfloat sy = one - LoadInt(packet->m_nY + nBase) / height;
+		vfloat fRight = (sx - half) * fovScale;
+		vfloat fUp = (sy - half) * fovScale;
+
+		vfloat dx = (Set1(camera->m_front.m_x) + Set1(camera->m_right.m_x) * fRight) + Set1(camera->m_up.m_x) * fUp;
+		vfloat dy = (Set1(camera->m_front.m_y) + Set1(camera->m_right.m_y) * fRight) + Set1(camera->m_up.m_y) * fUp;
+		vfloat dz = (Set1(camera->m_front.m_z) + Set1(camera->m_right.m_z) * fRight) + Set1(camera->m_up.m_z) * fUp;
+
+		vfloat inv = one / Sqrt(dx * dx + dy * dy + dz * dz);
+
+		Store(packet->m_directionX + nBase, dx * inv);
+		Store(packet->m_directionY + nBase, dy * inv);
+		Store(packet->m_directionZ + nBase, dz * inv);
+		Store(packet->m_originX + nBase, Set1(camera->m_eye.m_x));
+		Store(packet->m_originY + nBase, Set1(camera->m_eye.m_y));
+		Store(packet->m_originZ + nBase, Set1(camera->m_eye.m_z));
+	}
+}
+
+static void IntersectSphere(RayPacket *packet, const Vector3 &center, float sqrRadius, Geometry *geometry)
+{
+	vfloat zero = Set1(0.0f);
+	vfloat cx = Set1(center.m_x);
+	vfloat cy = Set1(center.m_y);
+	vfloat cz = Set1(center.m_z);
+	vfloat r2 = Set1(sqrRadius);
+	alignas(64) float distances[SIMD_LANES];
+
+	int nBase;
+	for (nBase = 0; nBase < packet->m_nSize; nBase += SIMD_LANES)
+	{
+		unsigned int nActive = (packet->m_nActiveMask >> nBase) & SIMD_LANE_MASK;
+		if (nActive == 0)
+		{
+			continue;
+		}
+
+		vfloat vx = Load(packet->m_originX + nBase) - cx;
+		vfloat vy = Load(packet->m_originY + nBase) - cy;
+		vfloat vz = Load(packet->m_originZ + nBase) - cz;
+		vfloat dx = Load(packet->m_directionX + nBase);
+		vfloat dy = Load(packet->m_directionY + nBase);
+		vfloat dz = Load(packet->m_directionZ + nBase);
+
+		vfloat a0 = (vx * vx + vy * vy + vz * vz) - r2;
+		vfloat DdotV = dx * vx + dy * vy + dz * vz;
+		vfloat discr = DdotV * DdotV - a0;
+		vfloat t = Negate(DdotV) - Sqrt(discr);
+
+		vmask hit = CmpLE(DdotV, zero) & CmpGE(discr, zero) & CmpLT(t, Load(packet->m_distance + nBase));
+		unsigned int nHits = ToBits(hit) & nActive;
+		if (nHits == 0)
+		{
+			continue;
+		}
+
+		Store(distances, t);
+		int i;
+		for (i = 0; nHits; i++, nHits >>= 1)
+		{
+			if (nHits & 1)
+			{
+				packet->m_distance[nBase + i] = distances[i];
+				packet->m_geometry[nBase + i] = geometry;
+				packet->m_nPrimitive[nBase + i] = 0;
+			}
+		}
+	}
+}
+
+static void IntersectPlane(RayPacket *packet, const Vector3 &normal, const Vector3 &position, Geometry *geometry)
+{
+	vfloat zero = Set1(0.0f);
+	vfloat nx = Set1(normal.m_x);
+	vfloat ny = Set1(normal.m_y);
+	vfloat nz = Set1(normal.m_z);
+	vfloat px = Set1(position.m_x);
+	vfloat py = Set1(position.m_y);
+	vfloat pz = Set1(position.m_z);
+	alignas(64) float distances[SIMD_LANES];
+
+	int nBase;
+	for (nBase = 0; nBase < packet->m_nSize; nBase += SIMD_LANES)
+	{
+		unsigned int nActive = (packet->m_nActiveMask >> nBase) & SIMD_LANE_MASK;
+		if (nActive == 0)
+		{
+			continue;
+		}
+
+		vfloat a = Load(packet->m_directionX + nBase) * nx + Load(packet->m_directionY + nBase) * ny +
+			Load(packet->m_directionZ + nBase) * nz;
+		vfloat b = nx * (Load(packet->m_originX + nBase) - px) + ny * (Load(packet->m_originY + nBase) - py) +
+			nz * (Load(packet->m_originZ + nBase) - pz);
+		vfloat t = Negate(b) / a;
+
+		vmask hit = CmpLT(a, zero) & CmpLT(t, Load(packet->m_distance + nBase));
+		unsigned int nHits = ToBits(hit) & nActive;
+		if (nHits == 0)
+		{
+			continue;
+		}
+
+		Store(distances, t);
+		int i;
+		for (i = 0; nHits; i++, nHits >>= 1)
+		{
+			if (nHits & 1)
+			{
+				packet->m_distance[nBase + i] = distances[i];
+				packet->m_geometry[nBase + i] = geometry;
+				packet->m_nPrimitive[nBase + i] = 0;
+			}
+		}
+	}
+}
+
+// Shadow ray variants: lanes get their bit set in m_nOccludedMask when the hit
+// lies in [tMin, m_distance], the same test as Sphere::Occluded.
+static void OccludedSphere(RayPacket *packet, const Vector3 &center, float sqrRadius, float tMin)
+{
+	vfloat zero = Set1(0.0f);
+	vfloat cx = Set1(center.m_x);
+	vfloat cy = Set1(center.m_y);
+	vfloat cz = Set1(center.m_z);
+	vfloat r2 = Set1(sqrRadius);
+	vfloat vMin = Set1(tMin);
+
+	int nBase;
+	for (nBase = 0; nBase < packet->m_nSize; nBase += SIMD_LANES)
+	{
+		unsigned int nActive = ((packet->m_nActiveMask & ~packet->m_nOccludedMask) >> nBase) & SIMD_LANE_MASK;
+		if (nActive == 0)
+		{
+			continue;
+		}
+
+		vfloat vx = Load(packet->m_originX + nBase) - cx;
+		vfloat vy = Load(packet->m_originY + nBase) - cy;
+		vfloat vz = Load(packet->m_originZ + nBase) - cz;
+		vfloat dx = Load(packet->m_directionX + nBase);
+		vfloat dy = Load(packet->m_directionY + nBase);
+		vfloat dz = Load(packet->m_directionZ + nBase);
+
+		vfloat a0 = (vx * vx + vy * vy + vz * vz) - r2;
+		vfloat DdotV = dx * vx + dy * vy + dz * vz;
+		vfloat discr = DdotV * DdotV - a0;
+		vfloat t = Negate(DdotV) - Sqrt(discr);
+
+		vmask hit = CmpLE(DdotV, zero) & CmpGE(discr, zero) & CmpGE(t, vMin) & CmpLE(t, Load(packet->m_distance + nBase));
+		packet->m_nOccludedMask |= (ToBits(hit) & nActive) << nBase;
+	}
+}
+
+static void OccludedPlane(RayPacket *packet, const Vector3 &normal, const Vector3 &position, float tMin)
+{
+	vfloat zero = Set1(0.0f);
+	vfloat nx = Set1(normal.m_x);
+	vfloat ny = Set1(normal.m_y);
+	vfloat nz = Set1(normal.m_z);
+	vfloat px = Set1(position.m_x);
+	vfloat py = Set1(position.m_y);
+	vfloat pz = Set1(position.m_z);
+	vfloat vMin = Set1(tMin);
+
+	int nBase;
+	for (nBase = 0; nBase < packet->m_nSize; nBase += SIMD_LANES)
+	{
+		unsigned int nActive = ((packet->m_nActiveMask & ~packet->m_nOccludedMask) >> nBase) & SIMD_LANE_MASK;
+		if (nActive == 0)
+		{
+			continue;
+		}
+
+		vfloat a = Load(packet->m_directionX + nBase) * nx + Load(packet->m_directionY + nBase) * ny +
+			Load(packet->m_directionZ + nBase) * nz;
+		vfloat b = nx * (Load(packet->m_originX + nBase) - px) + ny * (Load(packet->m_originY + nBase) - py) +
+			nz * (Load(packet->m_originZ + nBase) - pz);
+		vfloat t = Negate(b) / a;
+
+		vmask hit = CmpLT(a, zero) & CmpGE(t, vMin) & CmpLE(t, Load(packet->m_distance + nBase));
+		packet->m_nOccludedMask |= (ToBits(hit) & nActive) << nBase;
+	}
+}
\ No newline at end of file
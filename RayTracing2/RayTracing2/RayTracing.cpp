@@ -1,122 +1,174 @@
 #include "RayTracing.h"
-Vector3::Vector3()
+Vector3 Vector3::s_zero = Vector3(0, 0, 0);
+
+Ray3::Ray3()
 {
-	m_x = 0.0f;
-	m_y = 0.0f;
-	m_z = 0.0f;
+	m_origin = Vector3(0, 0, 0);
+	m_direction = Vector3(1, 0, 0);
 }
 
-Vector3::Vector3(float x, float y, float z)
+Ray3::Ray3(const Vector3 &origin, const Vector3 &direction)
 {
-	m_x = x;
-	m_y = y;
-	m_z = z;
+	m_origin = origin;
+	m_direction = direction;
 }
 
-Vector3::~Vector3()
+Vector3 Ray3::GetPoint(float t)
 {
-
+	return m_origin + m_direction * t;
 }
 
-Vector3 Vector3::Copy()
+AABB::AABB()
 {
-	return Vector3(m_x, m_y, m_z);
+	Reset();
 }
 
-float Vector3::Length()
+AABB::AABB(const Vector3 &min, const Vector3 &max)
 {
-	return sqrtf(m_x * m_x + m_y * m_y + m_z * m_z);
+	m_min = min;
+	m_max = max;
 }
 
-float Vector3::SqrLength()
+void AABB::Reset()
 {
-	return m_x * m_x + m_y * m_y + m_z * m_z;
+	m_min = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+	m_max = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 }
 
-Vector3 Vector3::Normalize()
+void AABB::Extend(const Vector3 &point)
 {
-	float inv = 1.0f / Length();
-	return Vector3(m_x * inv, m_y * inv, m_z * inv);
+	m_min = Vector3(MIN_(m_min.m_x, point.m_x), MIN_(m_min.m_y, point.m_y), MIN_(m_min.m_z, point.m_z));
+	m_max = Vector3(MAX_(m_max.m_x, point.m_x), MAX_(m_max.m_y, point.m_y), MAX_(m_max.m_z, point.m_z));
 }
 
-Vector3 Vector3::Negate()
+void AABB::Extend(const AABB &box)
 {
-	return Vector3(-m_x, -m_y, -m_z);
+	Extend(box.m_min);
+	Extend(box.m_max);
 }
 
-Vector3 Vector3::Add(const Vector3 &v)
+bool AABB::IsEmpty()
 {
-	return Vector3(m_x + v.m_x, m_y + v.m_y, m_z + v.m_z);
+	return m_min.m_x > m_max.m_x || m_min.m_y > m_max.m_y || m_min.m_z > m_max.m_z;
 }
 
-Vector3 Vector3::Subtract(const Vector3 &v)
+Vector3 AABB::GetCenter()
 {
-	return Vector3(m_x - v.m_x, m_y - v.m_y, m_z - v.m_z);
+	return (m_min + m_max) * 0.5f;
 }
 
-Vector3 Vector3::Multiply(float f)
+float AABB::GetSurfaceArea()
 {
-	return Vector3(m_x * f, m_y * f, m_z * f);
+	if (IsEmpty())
+	{
+		return 0.0f;
+	}
+	Vector3 d = m_max - m_min;
+	return 2.0f * (d.m_x * d.m_y + d.m_y * d.m_z + d.m_z * d.m_x);
 }
 
-Vector3 Vector3::Divide(float f)
+int AABB::GetLongestAxis()
 {
-	float inv = 1.0f / f;
-	return Vector3(m_x * inv, m_y * inv, m_z * inv);
+	Vector3 d = m_max - m_min;
+	if (d.m_x >= d.m_y && d.m_x >= d.m_z)
+	{
+		return 0;
+	}
+	return d.m_y >= d.m_z ? 1 : 2;
 }
 
-float Vector3::Dot(const Vector3 &v)
+IntersectResult::IntersectResult()
 {
-	return m_x * v.m_x + m_y * v.m_y + m_z * v.m_z;
+	m_geometry = NULL;
+	m_nPrimitive = 0;
+	m_distance = MAX_DISTANCE;
+	m_u = 0.0f;
+	m_v = 0.0f;
+	m_material = NULL;
 }
 
-Vector3 Vector3::Cross(const Vector3 &v)
+IntersectResult::~IntersectResult()
 {
-	return Vector3(-m_z * v.m_y + m_y * v.m_z,
-		m_z * v.m_x - m_x * v.m_z,
-		-m_y * v.m_x + m_x * v.m_y);
-}
 
-Vector3 Vector3::s_zero = Vector3(0, 0, 0);
+}
 
-Ray3::Ray3()
+Geometry::Geometry()
 {
-	m_origin = Vector3(0, 0, 0);
-	m_direction = Vector3(1, 0, 0);
+	m_material = NULL;
+	m_nVersion = 0;
 }
 
-Ray3::Ray3(const Vector3 &origin, const Vector3 &direction)
+Geometry::~Geometry()
 {
-	m_origin = origin;
-	m_direction = direction;
+
 }
 
-Ray3::~Ray3()
+void Geometry::MarkChanged()
 {
-
+	m_nVersion++;
 }
 
-Vector3 Ray3::GetPoint(float t)
+void Geometry::ComputeSurfaceInteraction(Ray3 *ray, IntersectResult *intersectResult)
 {
-	return m_origin.Add(m_direction.Multiply(t));
+	// Aggregates never report themselves as the hit geometry.
 }
 
-IntersectResult::IntersectResult()
+bool Geometry::Occluded(Ray3 *ray, float tMin, float tMax)
 {
-	m_geometry = NULL;
-	m_distance = 0;
+	IntersectResult result;
+	return Intersect(ray, &result) && result.m_distance >= tMin && result.m_distance <= tMax;
 }
 
-IntersectResult::~IntersectResult()
+void Geometry::IntersectPacket(RayPacket *packet)
 {
+	// Trace the lanes one by one for geometries without a packet kernel.
+	int i;
+	for (i = 0; i < packet->m_nSize; i++)
+	{
+		if (packet->m_nActiveMask & (1u << i))
+		{
+			Ray3 ray;
+			packet->GetRay(i, &ray);
+			IntersectResult result;
+			result.m_distance = packet->m_distance[i];
+			if (Intersect(&ray, &result))
+			{
+				packet->m_distance[i] = result.m_distance;
+				packet->m_geometry[i] = result.m_geometry;
+				packet->m_nPrimitive[i] = result.m_nPrimitive;
+				packet->m_u[i] = result.m_u;
+				packet->m_v[i] = result.m_v;
+			}
+		}
+	}
+}
 
+void Geometry::OccludedPacket(RayPacket *packet, float tMin)
+{
+	int i;
+	for (i = 0; i < packet->m_nSize; i++)
+	{
+		unsigned int nBit = 1u << i;
+		if ((packet->m_nActiveMask & nBit) && !(packet->m_nOccludedMask & nBit))
+		{
+			Ray3 ray;
+			packet->GetRay(i, &ray);
+			if (Occluded(&ray, tMin, packet->m_distance[i]))
+			{
+				packet->m_nOccludedMask |= nBit;
+			}
+		}
+	}
 }
 
-IntersectResult IntersectResult::s_noHit = IntersectResult();
+bool Geometry::GetBounds(AABB *bounds)
+{
+	// Unbounded unless the geometry says otherwise.
+	return false;
+}
 
-Geometry::Geometry()
+void Geometry::Update(ThreadPool *threadPool)
 {
-	m_material = NULL;
 }
 
 Sphere::Sphere(Vector3 center, float radius)
@@ -136,9 +188,45 @@ void Sphere::Initialize()
 	m_sqrRadius = m_radius * m_radius;
 }
 
-void Sphere::Intersect(Ray3 *ray, IntersectResult *intersectResult)
+bool Sphere::Intersect(Ray3 *ray, IntersectResult *intersectResult)
+{
+	RT_STAT_INC(STAT_SPHERE_TESTS);
+	Vector3 v = ray->m_origin - m_center;
+
+	float a0 = v.SqrLength() - m_sqrRadius;
+
+	float DdotV = ray->m_direction.Dot(v);
+
+	if (DdotV <= 0.0f)
+	{
+		float discr = DdotV * DdotV - a0;
+		if (discr >= 0.0f)
+		{
+			float t = -DdotV - sqrtf(discr);
+			if (t < intersectResult->m_distance)
+			{
+				intersectResult->m_geometry = this;
+				intersectResult->m_nPrimitive = 0;
+				intersectResult->m_distance = t;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void Sphere::ComputeSurfaceInteraction(Ray3 *ray, IntersectResult *intersectResult)
+{
+	intersectResult->m_material = m_material;
+	intersectResult->m_position = ray->GetPoint(intersectResult->m_distance);
+	intersectResult->m_normal = (intersectResult->m_position - m_center).Normalize();
+}
+
+bool Sphere::Occluded(Ray3 *ray, float tMin, float tMax)
 {
-	Vector3 v = ray->m_origin.Subtract(m_center);
+	RT_STAT_INC(STAT_SPHERE_TESTS);
+	Vector3 v = ray->m_origin - m_center;
 
 	float a0 = v.SqrLength() - m_sqrRadius;
 
@@ -149,17 +237,45 @@ void Sphere::Intersect(Ray3 *ray, IntersectResult *intersectResult)
 		float discr = DdotV * DdotV - a0;
 		if (discr >= 0.0f)
 		{
-			intersectResult->m_geometry = this;
-			intersectResult->m_distance = -DdotV - sqrtf(discr);
-			intersectResult->m_position = ray->GetPoint(intersectResult->m_distance);
-			intersectResult->m_normal = intersectResult->m_position.Subtract(m_center).Normalize();
-			return;
+			float t = -DdotV - sqrtf(discr);
+			return t >= tMin && t <= tMax;
 		}
 	}
 
-	*intersectResult = IntersectResult::s_noHit;
+	return false;
+}
+
+void Sphere::IntersectPacket(RayPacket *packet)
+{
+	if (packet->m_pKernels)
+	{
+		RT_STAT_ADD(STAT_SPHERE_TESTS, packet->m_nSize);
+		packet->m_pKernels->m_pfnIntersectSphere(packet, m_center, m_sqrRadius, this);
+	}
+	else
+	{
+		Geometry::IntersectPacket(packet);
+	}
+}
+
+void Sphere::OccludedPacket(RayPacket *packet, float tMin)
+{
+	if (packet->m_pKernels)
+	{
+		RT_STAT_ADD(STAT_SPHERE_TESTS, packet->m_nSize);
+		packet->m_pKernels->m_pfnOccludedSphere(packet, m_center, m_sqrRadius, tMin);
+	}
+	else
+	{
+		Geometry::OccludedPacket(packet, tMin);
+	}
+}
 
-	return;
+bool Sphere::GetBounds(AABB *bounds)
+{
+	Vector3 extent(m_radius, m_radius, m_radius);
+	*bounds = AABB(m_center - extent, m_center + extent);
+	return true;
 }
 
 Plane::Plane(Vector3 normal, float d)
@@ -175,30 +291,85 @@ Plane::~Plane()
 
 void Plane::Initialize() 
 {
-	m_position = m_normal.Multiply(m_d);
+	m_position = m_normal * m_d;
 }
 
-void Plane::Intersect(Ray3 *ray, IntersectResult *intersectResult) 
+bool Plane::Intersect(Ray3 *ray, IntersectResult *intersectResult) 
 {
+	RT_STAT_INC(STAT_PLANE_TESTS);
 	float a = ray->m_direction.Dot(m_normal);
 
 	if (a >= 0)
 	{
-		*intersectResult = IntersectResult::s_noHit;
-		return;
+		return false;
+	}
+
+	float b = m_normal.Dot(ray->m_origin - m_position);
+
+	float t = -b / a;
+	if (t < intersectResult->m_distance)
+	{
+		intersectResult->m_geometry = this;
+		intersectResult->m_nPrimitive = 0;
+		intersectResult->m_distance = t;
+		return true;
 	}
 
-	float b = m_normal.Dot(ray->m_origin.Subtract(m_position));
+	return false;
+}
 
-	intersectResult->m_geometry = this;
-	intersectResult->m_distance = -b / a;
+void Plane::ComputeSurfaceInteraction(Ray3 *ray, IntersectResult *intersectResult)
+{
+	intersectResult->m_material = m_material;
 	intersectResult->m_position = ray->GetPoint(intersectResult->m_distance);
 	intersectResult->m_normal = m_normal;
 }
 
-Union::Union() 
+bool Plane::Occluded(Ray3 *ray, float tMin, float tMax)
 {
+	RT_STAT_INC(STAT_PLANE_TESTS);
+	float a = ray->m_direction.Dot(m_normal);
+
+	if (a >= 0)
+	{
+		return false;
+	}
+
+	float b = m_normal.Dot(ray->m_origin - m_position);
 
+	float t = -b / a;
+	return t >= tMin && t <= tMax;
+}
+
+void Plane::IntersectPacket(RayPacket *packet)
+{
+	if (packet->m_pKernels)
+	{
+		RT_STAT_ADD(STAT_PLANE_TESTS, packet->m_nSize);
+		packet->m_pKernels->m_pfnIntersectPlane(packet, m_normal, m_position, this);
+	}
+	else
+	{
+		Geometry::IntersectPacket(packet);
+	}
+}
+
+void Plane::OccludedPacket(RayPacket *packet, float tMin)
+{
+	if (packet->m_pKernels)
+	{
+		RT_STAT_ADD(STAT_PLANE_TESTS, packet->m_nSize);
+		packet->m_pKernels->m_pfnOccludedPlane(packet, m_normal, m_position, tMin);
+	}
+	else
+	{
+		Geometry::OccludedPacket(packet, tMin);
+	}
+}
+
+Union::Union() 
+{
+	m_nChildVersion = 0;
 }
 
 Union::~Union() 
@@ -219,28 +390,102 @@ void Union::Initialize()
 	{
 		m_geometies[i]->Initialize();
 	}
+	m_nChildVersion = GetChildVersion();
+}
+
+bool Union::Intersect(Ray3 *ray, IntersectResult *intersectResult) 
+{
+	// Each child only records a hit closer than the ones before it.
+	bool bHit = false;
+	int nCount = m_geometies.size();
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		bHit |= m_geometies[i]->Intersect(ray, intersectResult);
+	}
+	return bHit;
 }
 
-void Union::Intersect(Ray3 *ray, IntersectResult *intersectResult) 
+bool Union::Occluded(Ray3 *ray, float tMin, float tMax)
 {
-	float minDistance = 10000.0f;
-	IntersectResult minResult = IntersectResult::s_noHit;
+	int nCount = m_geometies.size();
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		if (m_geometies[i]->Occluded(ray, tMin, tMax))
+		{
+			return true;
+		}
+	}
+	return false;
+}
 
+void Union::IntersectPacket(RayPacket *packet)
+{
+	// Each child only replaces lanes it hits closer than the current hit.
 	int nCount = m_geometies.size();
 	int i;
 	for (i = 0; i < nCount; i++)
 	{
-		IntersectResult result;
-		m_geometies[i]->Intersect(ray, &result);
+		m_geometies[i]->IntersectPacket(packet);
+	}
+}
+
+void Union::OccludedPacket(RayPacket *packet, float tMin)
+{
+	int nCount = m_geometies.size();
+	int i;
+	for (i = 0; i < nCount && (packet->m_nActiveMask & ~packet->m_nOccludedMask) != 0; i++)
+	{
+		m_geometies[i]->OccludedPacket(packet, tMin);
+	}
+}
+
+bool Union::GetBounds(AABB *bounds)
+{
+	bounds->Reset();
 
-		if (result.m_geometry && result.m_distance < minDistance)
+	int nCount = m_geometies.size();
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		AABB box;
+		if (!m_geometies[i]->GetBounds(&box))
 		{
-			minDistance = result.m_distance;
-			minResult = result;
+			return false;
 		}
+		bounds->Extend(box);
 	}
+	return true;
+}
 
-	*intersectResult = minResult;
+void Union::Update(ThreadPool *threadPool)
+{
+	int nCount = m_geometies.size();
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		m_geometies[i]->Update(threadPool);
+	}
+	unsigned int nChildVersion = GetChildVersion();
+	if (nChildVersion != m_nChildVersion)
+	{
+		m_nChildVersion = nChildVersion;
+		MarkChanged();
+	}
+}
+
+// Versions only grow, so the sum changes whenever one of them does.
+unsigned int Union::GetChildVersion()
+{
+	unsigned int nVersion = 0;
+	int nCount = m_geometies.size();
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		nVersion += m_geometies[i]->m_nVersion;
+	}
+	return nVersion;
 }
 
 PerspectiveCamera::PerspectiveCamera(const Vector3 &eye, const Vector3 &front, const Vector3 &up, float fov)
@@ -249,6 +494,7 @@ PerspectiveCamera::PerspectiveCamera(const Vector3 &eye, const Vector3 &front, c
 	m_front = front;
 	m_refUp = up;
 	m_fov = fov;
+	m_nVersion = 0;
 }
 
 PerspectiveCamera::~PerspectiveCamera()
@@ -261,64 +507,45 @@ void PerspectiveCamera::Initialize()
 	m_right = m_front.Cross(m_refUp);
 	m_up = m_right.Cross(m_front);
 	m_fovScale = tanf(m_fov * 0.5f * M_PI_F / 180) * 2;
+	MarkChanged();
 }
 
-void PerspectiveCamera::GenerateRay(float x, float y, Ray3 *ray)
+void PerspectiveCamera::MarkChanged()
 {
-	Vector3 r = m_right.Multiply((x - 0.5f) * m_fovScale);
-	Vector3 u = m_up.Multiply((y - 0.5f) * m_fovScale);
-	ray->m_origin = m_eye;
-	ray->m_direction = m_front.Add(r).Add(u).Normalize();
+	m_nVersion++;
 }
 
-Color::Color()
-{
-	m_r = 0.0f;
-	m_g = 0.0f;
-	m_b = 0.0f;
-}
-
-Color::Color(float r, float g, float b)
+void PerspectiveCamera::GenerateRay(float x, float y, Ray3 *ray)
 {
-	m_r = r;
-	m_g = g;
-	m_b = b;
+	Vector3 r = m_right * ((x - 0.5f) * m_fovScale);
+	Vector3 u = m_up * ((y - 0.5f) * m_fovScale);
+	ray->m_origin = m_eye;
+	ray->m_direction = (m_front + r + u).Normalize();
 }
 
-Color::~Color()
-{
-
-}
+Color Color::s_black = Color(0.0f, 0.0f, 0.0f);
+Color Color::s_white = Color(1.0f, 1.0f, 1.0f);
+Color Color::s_red = Color(1.0f, 0.0f, 0.0f);
+Color Color::s_green = Color(0.0f, 1.0f, 0.0f);
+Color Color::s_blue = Color(0.0f, 0.0f, 1.0f);
+Color Color::s_yellow = Color(1.0f, 1.0f, 0.0f);
 
-Color Color::Add(const Color &c)
+Material::Material()
 {
-	return Color(m_r + c.m_r, m_g + c.m_g, m_b + c.m_b);
+	m_reflectiveness = 0.0f;
+	m_nVersion = 0;
 }
 
-Color Color::Multiply(float s)
+Material::~Material()
 {
-	return Color(m_r * s, m_g * s, m_b * s);
-}
 
-Color Color::Modulate(const Color &c)
-{
-	return Color(m_r * c.m_r, m_g * c.m_g, m_b * c.m_b);
 }
 
-void Color::Saturate()
+void Material::MarkChanged()
 {
-	m_r = MIN_(m_r, 1.0f);
-	m_g = MIN_(m_g, 1.0f);
-	m_b = MIN_(m_b, 1.0f);
+	m_nVersion++;
 }
 
-Color Color::s_black = Color(0.0f, 0.0f, 0.0f);
-Color Color::s_white = Color(1.0f, 1.0f, 1.0f);
-Color Color::s_red = Color(1.0f, 0.0f, 0.0f);
-Color Color::s_green = Color(0.0f, 1.0f, 0.0f);
-Color Color::s_blue = Color(0.0f, 0.0f, 1.0f);
-Color Color::s_yellow = Color(1.0f, 1.0f, 0.0f);
-
 CheckerMaterial::CheckerMaterial(float scale, float reflectiveness)
 {
 	m_scale = scale;
@@ -374,40 +601,68 @@ LightSample LightSample::s_zero = LightSample(Vector3::s_zero, Color::s_black);
 Light::Light()
 {
 	m_shadow = true;
+	m_nVersion = 0;
 }
 
-DirectionalLight::DirectionalLight(const Color &irradiance, const Vector3 &direction)
+Light::~Light()
 {
-	m_irradiance = irradiance;
-	m_direction = direction;
+
 }
 
-DirectionalLight::~DirectionalLight()
+bool Light::GetBounds(LightBounds *bounds)
 {
-
+	return false;
 }
 
-void DirectionalLight::Initialize()
+void Light::MarkChanged()
 {
-	m_L = m_direction.Normalize().Negate();
+	m_nVersion++;
 }
 
-void DirectionalLight::Sample(LightSample *lightSample, Geometry *scene, const Vector3 &position)
+void Light::Sample(LightSample *lightSample, Geometry *scene, const Vector3 &position)
 {
+	RT_STAT_INC(STAT_LIGHT_SAMPLES);
+	float distance;
+	if (!Illuminate(lightSample, position, &distance))
+	{
+		*lightSample = LightSample::s_zero;
+		return;
+	}
+
 	if (m_shadow)
 	{
-		Ray3 shadowRay(position, m_L);
-		IntersectResult shadowResult;
-		scene->Intersect(&shadowRay, &shadowResult);
-		if (shadowResult.m_geometry)
+		RT_STAT_INC(STAT_SHADOW_RAYS);
+		RT_STAT_TIMER(STAT_TIMER_TRAVERSE);
+		Ray3 shadowRay(position, lightSample->m_L);
+		if (scene->Occluded(&shadowRay, 0.0f, distance))
 		{
 			*lightSample = LightSample::s_zero;
-			return;
 		}
 	}
+}
+
+DirectionalLight::DirectionalLight(const Color &irradiance, const Vector3 &direction)
+{
+	m_irradiance = irradiance;
+	m_direction = direction;
+}
+
+DirectionalLight::~DirectionalLight()
+{
+
+}
 
+void DirectionalLight::Initialize()
+{
+	m_L = -m_direction.Normalize();
+}
+
+bool DirectionalLight::Illuminate(LightSample *lightSample, const Vector3 &position, float *pDistance)
+{
 	lightSample->m_L = m_L;
 	lightSample->m_EL = m_irradiance;
+	*pDistance = MAX_DISTANCE;
+	return true;
 }
 
 PointLight::PointLight(const Color &intensity, const Vector3 &position)
@@ -426,39 +681,40 @@ void PointLight::Initialize()
 
 }
 
-void PointLight::Sample(LightSample *lightSample, Geometry *scene, const Vector3 &position)
+bool PointLight::Illuminate(LightSample *lightSample, const Vector3 &position, float *pDistance)
 {
-	Vector3 delta = m_position.Subtract(position);
+	Vector3 delta = m_position - position;
 	float rr = delta.SqrLength();
 	float r = sqrtf(rr);
-	Vector3 L = delta.Divide(r);
+	Vector3 L = delta / r;
 
 	float attenuation = 1.0f / rr;
 
-	Color EL = m_intensity.Multiply(attenuation);
+	Color EL = m_intensity * attenuation;
 
 	if (EL.m_r < EPSILON_VALUE_1 &&
 		EL.m_g < EPSILON_VALUE_1 &&
 		EL.m_b < EPSILON_VALUE_1)
 	{
-		*lightSample = LightSample::s_zero;
-		return;
-	}
-
-	if (m_shadow)
-	{
-		Ray3 shadowRay(position, L);
-		IntersectResult shadowResult;
-		scene->Intersect(&shadowRay, &shadowResult);
-		if (shadowResult.m_geometry)
-		{
-			*lightSample = LightSample::s_zero;
-			return;
-		}
+		RT_STAT_INC(STAT_LIGHT_CULLED);
+		return false;
 	}
 
 	lightSample->m_L = L;
 	lightSample->m_EL = EL;
+	// Occluders behind the light do not cast a shadow.
+	*pDistance = r;
+	return true;
+}
+
+bool PointLight::GetBounds(LightBounds *bounds)
+{
+	bounds->m_position = m_position;
+	bounds->m_axis = Vector3(0.0f, 0.0f, 1.0f);
+	bounds->m_thetaO = M_PI_F;
+	bounds->m_thetaE = M_PI_F * 0.5f;
+	bounds->m_intensity = (m_intensity.m_r + m_intensity.m_g + m_intensity.m_b) * (1.0f / 3.0f);
+	return true;
 }
 
 SpotLight::SpotLight(const Color &intensity, const Vector3 &position, const Vector3 &direction,
@@ -479,18 +735,18 @@ SpotLight::~SpotLight()
 
 void SpotLight::Initialize()
 {
-	m_S = m_direction.Normalize().Negate();
+	m_S = -m_direction.Normalize();
 	m_cosTheta = cosf(m_theta * M_PI_F / 180 / 2);
 	m_cosPhi = cosf(m_phi * M_PI_F / 180 / 2);
 	m_baseMultiplier = 1.0f / (m_cosTheta - m_cosPhi);
 }
 
-void SpotLight::Sample(LightSample *lightSample, Geometry *scene, const Vector3 &position)
+bool SpotLight::Illuminate(LightSample *lightSample, const Vector3 &position, float *pDistance)
 {
-	Vector3 delta = m_position.Subtract(position);
+	Vector3 delta = m_position - position;
 	float rr = delta.SqrLength();
 	float r = sqrtf(rr);
-	Vector3 L = delta.Divide(r);
+	Vector3 L = delta / r;
 
 	float spot = 0.0f;
 	float SdotL = m_S.Dot(L);
@@ -502,8 +758,7 @@ void SpotLight::Sample(LightSample *lightSample, Geometry *scene, const Vector3
 	{
 		spot = 0.0f;
 
-		*lightSample = LightSample::s_zero;
-		return;
+		return false;
 	}
 	else
 	{
@@ -512,28 +767,29 @@ void SpotLight::Sample(LightSample *lightSample, Geometry *scene, const Vector3
 
 	float attenuation = 1.0f / rr;
 
-	Color EL = m_intensity.Multiply(attenuation * spot);
+	Color EL = m_intensity * (attenuation * spot);
 
 	if (EL.m_r < EPSILON_VALUE_1 &&
 		EL.m_g < EPSILON_VALUE_1 &&
 		EL.m_b < EPSILON_VALUE_1)
 	{
-		*lightSample = LightSample::s_zero;
-		return;
-	}
-
-	if (m_shadow)
-	{
-		Ray3 shadowRay(position, L);
-		IntersectResult shadowResult;
-		scene->Intersect(&shadowRay, &shadowResult);
-		if (shadowResult.m_geometry)
-		{
-			*lightSample = LightSample::s_zero;
-			return;
-		}
+		RT_STAT_INC(STAT_LIGHT_CULLED);
+		return false;
 	}
 
 	lightSample->m_L = L;
 	lightSample->m_EL = EL;
+	// Occluders behind the light do not cast a shadow.
+	*pDistance = r;
+	return true;
+}
+
+bool SpotLight::GetBounds(LightBounds *bounds)
+{
+	bounds->m_position = m_position;
+	bounds->m_axis = -m_S;
+	bounds->m_thetaO = 0.0f;
+	bounds->m_thetaE = m_phi * M_PI_F / 180 / 2;
+	bounds->m_intensity = (m_intensity.m_r + m_intensity.m_g + m_intensity.m_b) * (1.0f / 3.0f);
+	return true;
 }
\ No newline at end of file
@@ -1,44 +1,47 @@
 
 #pragma once
 
-class Vector3
-{
-public:
-	Vector3();
-	Vector3(float x, float y, float z);
-	~Vector3();
-	Vector3 Copy();
-	float Length();
-	float SqrLength();
-	Vector3 Normalize();
-	Vector3 Negate();
-	Vector3 Add(const Vector3 &v);
-	Vector3 Subtract(const Vector3 &v);
-	Vector3 Multiply(float f);
-	Vector3 Divide(float f);
-	float Dot(const Vector3 &v);
-	Vector3 Cross(const Vector3 &v);
-	static Vector3 s_zero;
-public:
-	float m_x;
-	float m_y;
-	float m_z;
-};
-
 class Ray3
 {
 public:
 	Ray3();
 	Ray3(const Vector3 &origin, const Vector3 &direction);
-	~Ray3();
 	Vector3 GetPoint(float t);
 public:
 	Vector3 m_origin;
 	Vector3 m_direction;
 };
 
+class AABB
+{
+public:
+	AABB();
+	AABB(const Vector3 &min, const Vector3 &max);
+	void Reset();
+	void Extend(const Vector3 &point);
+	void Extend(const AABB &box);
+	bool IsEmpty();
+	Vector3 GetCenter();
+	float GetSurfaceArea();
+	int GetLongestAxis();
+public:
+	Vector3 m_min;
+	Vector3 m_max;
+};
+
 class Geometry;
 
+class RayPacket;
+
+class Material;
+
+class ThreadPool;
+
+// Intersection runs in two phases. Traversal only records the closest hit
+// (m_geometry, m_nPrimitive, m_distance and, for triangles, the barycentrics
+// m_u/m_v); m_distance starts at MAX_DISTANCE and is the running minimum every
+// Intersect call tests against. Once the closest hit is known, the geometry's
+// ComputeSurfaceInteraction fills in m_position, m_normal and m_material.
 class IntersectResult
 {
 public:
@@ -46,23 +49,40 @@ public:
 	~IntersectResult();
 public:
 	Geometry *m_geometry;
+	int m_nPrimitive;
 	float m_distance;
+	float m_u;
+	float m_v;
+public:
+	Material *m_material;
 	Vector3 m_position;
 	Vector3 m_normal;
-public:
-	static IntersectResult s_noHit;
 };
 
-class Material;
-
 class Geometry
 {
 public:
 	Geometry();
+	virtual ~Geometry();
 	virtual void Initialize() = 0;
-	virtual void Intersect(Ray3 *ray, IntersectResult *intersectResult) = 0;
+	// Records a hit closer than intersectResult->m_distance and returns true if
+	// there is one; leaves intersectResult untouched otherwise.
+	virtual bool Intersect(Ray3 *ray, IntersectResult *intersectResult) = 0;
+	virtual void ComputeSurfaceInteraction(Ray3 *ray, IntersectResult *intersectResult);
+	virtual bool Occluded(Ray3 *ray, float tMin, float tMax);
+	virtual void IntersectPacket(RayPacket *packet);
+	// Sets m_nOccludedMask bits of lanes blocked in [tMin, m_distance].
+	virtual void OccludedPacket(RayPacket *packet, float tMin);
+	virtual bool GetBounds(AABB *bounds);
+	// Brings acceleration structures up to date with the children that
+	// reported an edit through MarkChanged(). threadPool may be NULL.
+	virtual void Update(ThreadPool *threadPool);
+	// Call after editing public fields so cached frames of scenes holding
+	// this object are rendered again.
+	void MarkChanged();
 public:
 	Material *m_material;
+	unsigned int m_nVersion;
 };
 
 class Sphere : public Geometry
@@ -71,7 +91,12 @@ public:
 	Sphere(Vector3 center, float radius);
 	~Sphere();
 	void Initialize() override;
-	void Intersect(Ray3 *ray, IntersectResult *intersectResult) override;
+	bool Intersect(Ray3 *ray, IntersectResult *intersectResult) override;
+	void ComputeSurfaceInteraction(Ray3 *ray, IntersectResult *intersectResult) override;
+	bool Occluded(Ray3 *ray, float tMin, float tMax) override;
+	void IntersectPacket(RayPacket *packet) override;
+	void OccludedPacket(RayPacket *packet, float tMin) override;
+	bool GetBounds(AABB *bounds) override;
 public:
 	Vector3 m_center;
 	float m_radius;
@@ -85,7 +110,11 @@ public:
 	Plane(Vector3 normal, float d);
 	~Plane();
 	void Initialize() override;
-	void Intersect(Ray3 *ray, IntersectResult *intersectResult) override;
+	bool Intersect(Ray3 *ray, IntersectResult *intersectResult) override;
+	void ComputeSurfaceInteraction(Ray3 *ray, IntersectResult *intersectResult) override;
+	bool Occluded(Ray3 *ray, float tMin, float tMax) override;
+	void IntersectPacket(RayPacket *packet) override;
+	void OccludedPacket(RayPacket *packet, float tMin) override;
 public:
 	Vector3 m_normal;
 	float m_d;
@@ -100,9 +129,19 @@ public:
 	~Union();
 	void AddGeometry(Geometry *geometry);
 	void Initialize() override;
-	void Intersect(Ray3 *ray, IntersectResult *intersectResult) override;
+	bool Intersect(Ray3 *ray, IntersectResult *intersectResult) override;
+	bool Occluded(Ray3 *ray, float tMin, float tMax) override;
+	void IntersectPacket(RayPacket *packet) override;
+	void OccludedPacket(RayPacket *packet, float tMin) override;
+	bool GetBounds(AABB *bounds) override;
+	// Marks the union changed when a child changed, so a BVH holding it
+	// refits its box.
+	void Update(ThreadPool *threadPool) override;
 public:
 	std::vector<Geometry *> m_geometies;
+private:
+	unsigned int GetChildVersion();
+	unsigned int m_nChildVersion;
 };
 
 class PerspectiveCamera
@@ -112,6 +151,7 @@ public:
 	~PerspectiveCamera();
 	void Initialize();
 	void GenerateRay(float x, float y, Ray3 *ray);
+	void MarkChanged();
 public:
 	Vector3 m_eye;
 	Vector3 m_front;
@@ -121,37 +161,19 @@ public:
 	Vector3 m_right;
 	Vector3 m_up;
 	float m_fovScale;
-};
-
-class Color
-{
-public:
-	Color();
-	Color(float r, float g, float b);
-	~Color();
-	Color Add(const Color &c);
-	Color Multiply(float s);
-	Color Modulate(const Color &c);
-	void Saturate();
-public:
-	float m_r;
-	float m_g;
-	float m_b;
-public:
-	static Color s_black;
-	static Color s_white;
-	static Color s_red;
-	static Color s_green;
-	static Color s_blue;
-	static Color s_yellow;
+	unsigned int m_nVersion;
 };
 
 class Material
 {
 public:
+	Material();
+	virtual ~Material();
 	virtual Color Sample(Ray3 *ray, Vector3 *position, Vector3 *normal) = 0;
+	void MarkChanged();
 public:
 	float m_reflectiveness;
+	unsigned int m_nVersion;
 };
 
 class CheckerMaterial : public Material
@@ -188,13 +210,37 @@ public:
 	Color m_EL;
 };
 
+// Where a light sits and where it shines, for LightTree. Emission leaves
+// within m_thetaE of directions that lie within m_thetaO of m_axis (angles in
+// radians); m_intensity is the mean of the intensity channels.
+class LightBounds
+{
+public:
+	Vector3 m_position;
+	Vector3 m_axis;
+	float m_thetaO;
+	float m_thetaE;
+	float m_intensity;
+};
+
 class Light
 {
 public:
 	Light();
+	virtual ~Light();
 	virtual void Initialize() = 0;
-	virtual void Sample(LightSample *lightSample, Geometry *scene, const Vector3 &position) = 0;
+	// Unshadowed sample at position plus the distance to the light, the
+	// segment a shadow ray has to test. Returns false if the light cannot
+	// reach position at all.
+	virtual bool Illuminate(LightSample *lightSample, const Vector3 &position, float *pDistance) = 0;
+	void Sample(LightSample *lightSample, Geometry *scene, const Vector3 &position);
+	// False for lights without a position. Valid after Initialize().
+	virtual bool GetBounds(LightBounds *bounds);
+	// Call after editing public fields; Scene::Update() initializes the light
+	// again and moves it in the light tree.
+	void MarkChanged();
 	bool m_shadow;
+	unsigned int m_nVersion;
 };
 
 class DirectionalLight : public Light
@@ -203,10 +249,11 @@ public:
 	DirectionalLight(const Color &irradiance, const Vector3 &direction);
 	~DirectionalLight();
 	void Initialize() override;
-	void Sample(LightSample *lightSample, Geometry *scene, const Vector3 &position) override;
-private:
+	bool Illuminate(LightSample *lightSample, const Vector3 &position, float *pDistance) override;
+public:
 	Color m_irradiance;
 	Vector3 m_direction;
+private:
 	Vector3 m_L;
 };
 
@@ -216,8 +263,9 @@ public:
 	PointLight(const Color &intensity, const Vector3 &position);
 	~PointLight();
 	void Initialize() override;
-	void Sample(LightSample *lightSample, Geometry *scene, const Vector3 &position) override;
-private:
+	bool Illuminate(LightSample *lightSample, const Vector3 &position, float *pDistance) override;
+	bool GetBounds(LightBounds *bounds) override;
+public:
 	Color m_intensity;
 	Vector3 m_position;
 };
@@ -229,8 +277,9 @@ public:
 		float theta, float phi, float falloff);
 	~SpotLight();
 	void Initialize() override;
-	void Sample(LightSample *lightSample, Geometry *scene, const Vector3 &position) override;
-private:
+	bool Illuminate(LightSample *lightSample, const Vector3 &position, float *pDistance) override;
+	bool GetBounds(LightBounds *bounds) override;
+public:
 	Color m_intensity;
 	Vector3 m_position;
 	Vector3 m_direction;
@@ -0,0 +1,222 @@
+#include "RenderJob.h"
+
+RenderJob::RenderJob(Scene *scene, const PerspectiveCamera &camera, FrameBuffer *frameBuffer, const RenderOptions &options)
+	: m_camera(camera)
+	, m_options(options)
+{
+	m_pScene = scene;
+	m_pFrameBuffer = frameBuffer;
+	m_nId = 0;
+	int nTileSize = MAX_(options.m_nTileSize, 1);
+	int nPasses = 1;
+	if (options.m_bProgressive)
+	{
+		nTileSize = Renderer_GetPassTileSize(nTileSize);
+		nPasses = RENDER_PROGRESSIVE_PASSES;
+	}
+	m_nTileCount = ((frameBuffer->m_nWidth + nTileSize - 1) / nTileSize) * ((frameBuffer->m_nHeight + nTileSize - 1) / nTileSize) * nPasses;
+	m_nTilesDone = 0;
+	m_bCancel = false;
+	m_nRayCount = 0;
+	m_nState = RENDERJOB_QUEUED;
+	m_bFinished = false;
+}
+
+int RenderJob::GetState()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_nState;
+}
+
+bool RenderJob::IsFinished()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_bFinished;
+}
+
+int RenderJob::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cvState.wait(lock, [this]() { return m_bFinished; });
+	return m_nState;
+}
+
+void RenderJob::Cancel()
+{
+	m_bCancel = true;
+}
+
+unsigned int RenderJob::GetId()
+{
+	return m_nId;
+}
+
+int RenderJob::GetTileCount()
+{
+	return m_nTileCount;
+}
+
+int RenderJob::GetTilesDone()
+{
+	return m_nTilesDone;
+}
+
+unsigned long long RenderJob::GetRayCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_nRayCount;
+}
+
+void RenderJob::SetState(int nState)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_nState = nState;
+}
+
+void RenderJob::Finish()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_bFinished = true;
+	m_cvState.notify_all();
+}
+
+AsyncRenderer::AsyncRenderer()
+{
+	m_nNextId = 0;
+	m_bStop = false;
+}
+
+AsyncRenderer::~AsyncRenderer()
+{
+	CancelAll();
+	if (m_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bStop = true;
+		}
+		m_cvWork.notify_all();
+		m_thread.join();
+	}
+}
+
+std::shared_ptr<RenderJob> AsyncRenderer::Submit(Scene *scene, const PerspectiveCamera &camera, FrameBuffer *frameBuffer,
+	const RenderOptions &options, const RenderJob::TileFunc &onTile, const RenderJob::DoneFunc &onDone)
+{
+	std::shared_ptr<RenderJob> job = std::make_shared<RenderJob>(scene, camera, frameBuffer, options);
+	job->m_camera.Initialize();
+	job->m_onTile = onTile;
+	job->m_onDone = onDone;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		job->m_nId = ++m_nNextId;
+		if (m_running)
+		{
+			m_running->Cancel();
+		}
+		int i;
+		for (i = 0; i < (int)m_queue.size(); i++)
+		{
+			m_queue[i]->Cancel();
+		}
+		m_queue.push_back(job);
+		if (!m_thread.joinable())
+		{
+			m_thread = std::thread(&AsyncRenderer::ThreadMain, this);
+		}
+	}
+	m_cvWork.notify_one();
+	return job;
+}
+
+void AsyncRenderer::CancelAll()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_running)
+		{
+			m_running->Cancel();
+		}
+		int i;
+		for (i = 0; i < (int)m_queue.size(); i++)
+		{
+			m_queue[i]->Cancel();
+		}
+	}
+	WaitIdle();
+}
+
+void AsyncRenderer::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cvIdle.wait(lock, [this]() { return m_queue.empty() && !m_running; });
+}
+
+void AsyncRenderer::ThreadMain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_cvWork.wait(lock, [this]() { return m_bStop || !m_queue.empty(); });
+		if (m_bStop)
+		{
+			break;
+		}
+		m_running = m_queue.front();
+		m_queue.pop_front();
+		lock.unlock();
+
+		RunJob(m_running.get());
+
+		lock.lock();
+		m_running.reset();
+		if (m_queue.empty())
+		{
+			m_cvIdle.notify_all();
+		}
+	}
+}
+
+// Cancelled jobs that never started end without tracing anything. A job whose
+// flag comes up after its last tile still counts as done.
+void AsyncRenderer::RunJob(RenderJob *job)
+{
+	if (!job->m_bCancel)
+	{
+		job->SetState(RENDERJOB_RUNNING);
+
+		const RenderOptions &options = job->m_options;
+		m_renderer.SetThreadCount(options.m_nThreadCount);
+		m_renderer.SetTileSize(options.m_nTileSize);
+		m_renderer.SetPacketTracing(options.m_bPacketTracing);
+		m_renderer.SetWavefront(options.m_bWavefront);
+		m_renderer.SetResolveSettings(options.m_resolveSettings);
+		m_renderer.SetSampleSettings(options.m_sampleSettings);
+		m_renderer.SetProgressive(options.m_bProgressive, Renderer::PassFunc());
+		m_renderer.SetCamera(&job->m_camera);
+		m_renderer.SetProgress(&job->m_bCancel, [job](const FrameRect &rect)
+		{
+			job->m_nTilesDone++;
+			if (job->m_onTile)
+			{
+				job->m_onTile(job, rect);
+			}
+		});
+
+		unsigned long long nRaysBefore = m_renderer.GetRayCount();
+		m_renderer.RenderScene(job->m_pScene, job->m_pFrameBuffer);
+		m_renderer.SetProgress(NULL, Renderer::TileFunc());
+		m_renderer.SetCamera(NULL);
+
+		std::lock_guard<std::mutex> lock(job->m_mutex);
+		job->m_nRayCount = m_renderer.GetRayCount() - nRaysBefore;
+	}
+
+	job->SetState(job->m_nTilesDone == job->m_nTileCount ? RENDERJOB_DONE : RENDERJOB_CANCELLED);
+	if (job->m_onDone)
+	{
+		job->m_onDone(job);
+	}
+	job->Finish();
+}
\ No newline at end of file
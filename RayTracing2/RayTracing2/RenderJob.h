@@ -0,0 +1,96 @@
+#pragma once
+
+// Background rendering for interactive front ends. An AsyncRenderer owns a
+// render thread and a Renderer; Submit() queues a frame and returns at once
+// with a RenderJob, which the caller can wait on, poll or cancel, and which
+// calls back when it ends. Every tile is resolved into the frame buffer as
+// soon as it is traced and passed to the job's tile callback, so a viewer can
+// show the frame while it fills in.
+//
+// Cancellation is cooperative: workers look at the job's flag before they
+// start a tile, so a cancelled job stops once the tiles in flight, at most
+// one per worker, are done. Submit() cancels every older job that has not
+// ended, which is what a camera move wants: the stale frame stops within a
+// tile and the new one starts, so the delay from a camera change to its first
+// pixels is about one tile, not the rest of a frame.
+//
+// A job renders through its own copy of the camera, so the caller may move
+// the scene's camera while it runs. The scene is only read, but must not be
+// edited during a job: call CancelAll() first and submit again afterwards.
+// Callbacks run on the render threads; the job is finished once its done
+// callback has returned, so Wait() never returns while callbacks still run.
+
+#define RENDERJOB_QUEUED		0
+#define RENDERJOB_RUNNING		1
+#define RENDERJOB_DONE			2
+#define RENDERJOB_CANCELLED		3
+
+class RenderJob
+{
+public:
+	typedef std::function<void(RenderJob *job, const FrameRect &rect)> TileFunc;
+	typedef std::function<void(RenderJob *job)> DoneFunc;
+	RenderJob(Scene *scene, const PerspectiveCamera &camera, FrameBuffer *frameBuffer, const RenderOptions &options);
+	// RENDERJOB_DONE or RENDERJOB_CANCELLED already in the done callback.
+	int GetState();
+	bool IsFinished();
+	// Blocks until the job is done or cancelled and returns the final state.
+	int Wait();
+	void Cancel();
+	unsigned int GetId();
+	// Progressive jobs count the tiles of every pass.
+	int GetTileCount();
+	int GetTilesDone();
+	// Primary and reflection rays, as Renderer::GetRayCount().
+	unsigned long long GetRayCount();
+public:
+	Scene *m_pScene;
+	PerspectiveCamera m_camera;
+	FrameBuffer *m_pFrameBuffer;
+	RenderOptions m_options;
+	TileFunc m_onTile;
+	DoneFunc m_onDone;
+private:
+	void SetState(int nState);
+	void Finish();
+	friend class AsyncRenderer;
+private:
+	unsigned int m_nId;
+	int m_nTileCount;
+	std::atomic<int> m_nTilesDone;
+	std::atomic<bool> m_bCancel;
+	unsigned long long m_nRayCount;
+	std::mutex m_mutex;
+	std::condition_variable m_cvState;
+	int m_nState;
+	bool m_bFinished;
+};
+
+class AsyncRenderer
+{
+public:
+	AsyncRenderer();
+	// Cancels what is left and waits for the render thread.
+	~AsyncRenderer();
+	// Cancels every unfinished job and queues a new one.
+	std::shared_ptr<RenderJob> Submit(Scene *scene, const PerspectiveCamera &camera, FrameBuffer *frameBuffer,
+		const RenderOptions &options, const RenderJob::TileFunc &onTile = RenderJob::TileFunc(),
+		const RenderJob::DoneFunc &onDone = RenderJob::DoneFunc());
+	// Cancels every unfinished job and returns once the render thread is idle.
+	void CancelAll();
+	// Returns once every submitted job has ended.
+	void WaitIdle();
+private:
+	void ThreadMain();
+	void RunJob(RenderJob *job);
+private:
+	Renderer m_renderer;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cvWork;
+	std::condition_variable m_cvIdle;
+	std::deque<std::shared_ptr<RenderJob> > m_queue;
+	std::shared_ptr<RenderJob> m_running;
+	unsigned int m_nNextId;
+	bool m_bStop;
+};
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "RenderLibrary.h"
+
+RenderTarget::RenderTarget()
+{
+	m_nWidth = 0;
+	m_nHeight = 0;
+	m_nStride = 0;
+	m_pPixels = NULL;
+	m_pColors = NULL;
+}
+
+RenderOptions::RenderOptions()
+{
+	m_nThreadCount = 1;
+	m_nTileSize = 32;
+	m_bPacketTracing = true;
+	m_bWavefront = false;
+	m_bProgressive = false;
+}
+
+RenderSceneHandle Render_LoadScene(const char *pszFileName, int nThreadCount, std::string *pError)
+{
+	SceneFile sceneFile;
+	std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+	if (!sceneFile.Load(pszFileName) || !sceneFile.CreateScene(scene.get(), nThreadCount))
+	{
+		if (pError)
+		{
+			*pError = sceneFile.GetError();
+		}
+		return RenderSceneHandle();
+	}
+	return scene;
+}
+
+RenderSceneHandle Render_CreateDefaultScene()
+{
+	std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+	scene->CreateDefault();
+	return scene;
+}
+
+PerspectiveCamera Render_GetSceneCamera(const RenderSceneHandle &scene)
+{
+	return *scene->m_camera;
+}
+
+bool Render_Frame(const RenderSceneHandle &scene, const PerspectiveCamera &camera, const RenderOptions &options,
+	RenderTarget *target, unsigned long long *pRayCount, unsigned long long *pSampleCount)
+{
+	if (!scene || target == NULL || target->m_pPixels == NULL || target->m_nWidth <= 0 || target->m_nHeight <= 0)
+	{
+		return false;
+	}
+
+	PerspectiveCamera jobCamera = camera;
+	jobCamera.Initialize();
+
+	std::vector<Color> scratch;
+	Color *pColors = target->m_pColors;
+	if (pColors == NULL)
+	{
+		scratch.resize(target->m_nWidth * target->m_nHeight);
+		pColors = &scratch[0];
+	}
+
+	FrameBuffer frameBuffer;
+	frameBuffer.Attach(target->m_nWidth, target->m_nHeight, target->m_nStride, target->m_pPixels, pColors);
+
+	// Rendering only reads the scene; the camera and all scratch state belong
+	// to this call.
+	Renderer renderer;
+	renderer.SetThreadCount(options.m_nThreadCount);
+	renderer.SetTileSize(options.m_nTileSize);
+	renderer.SetPacketTracing(options.m_bPacketTracing);
+	renderer.SetWavefront(options.m_bWavefront);
+	renderer.SetResolveSettings(options.m_resolveSettings);
+	renderer.SetSampleSettings(options.m_sampleSettings);
+	renderer.SetCamera(&jobCamera);
+	renderer.RenderScene((Scene *)scene.get(), &frameBuffer);
+
+	if (pRayCount)
+	{
+		*pRayCount = renderer.GetRayCount();
+	}
+	if (pSampleCount)
+	{
+		*pSampleCount = renderer.GetSampleCount();
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+// Reentrant rendering for processes that run many independent jobs. A
+// RenderSceneHandle is built once and never changes afterwards, so any number
+// of threads may pass the same handle to Render_Frame() at the same time, each
+// with its own camera and output memory. A call keeps its state in a Renderer
+// and a FrameBuffer of its own; nothing but the read-only scene is shared
+// between calls, so no locking is needed. The handle keeps the scene, and the
+// mapping of a compiled scene file, alive until the last job holding it ends.
+
+typedef std::shared_ptr<const Scene> RenderSceneHandle;
+
+// Output of one frame, owned by the caller. m_pPixels receives m_nHeight rows
+// of m_nStride bytes in the FrameBuffer layout; m_pColors, if set, receives
+// the m_nWidth * m_nHeight HDR values, otherwise the call uses scratch memory.
+class RenderTarget
+{
+public:
+	RenderTarget();
+public:
+	int m_nWidth;
+	int m_nHeight;
+	int m_nStride;
+	unsigned char *m_pPixels;
+	Color *m_pColors;
+};
+
+class RenderOptions
+{
+public:
+	RenderOptions();
+public:
+	// 1 traces on the calling thread only, for services that already run one
+	// job per thread; 0 uses every core.
+	int m_nThreadCount;
+	int m_nTileSize;
+	bool m_bPacketTracing;
+	bool m_bWavefront;
+	// Progressive passes for jobs that show the frame while it is traced
+	// (see Renderer.h); Render_Frame() ignores it.
+	bool m_bProgressive;
+	ResolveSettings m_resolveSettings;
+	SampleSettings m_sampleSettings;
+};
+
+RenderSceneHandle Render_LoadScene(const char *pszFileName, int nThreadCount, std::string *pError);
+RenderSceneHandle Render_CreateDefaultScene();
+// The camera stored with the scene, as a starting point for job cameras.
+PerspectiveCamera Render_GetSceneCamera(const RenderSceneHandle &scene);
+// *pRayCount receives the primary and reflection rays of the frame.
+bool Render_Frame(const RenderSceneHandle &scene, const PerspectiveCamera &camera, const RenderOptions &options,
+	RenderTarget *target, unsigned long long *pRayCount, unsigned long long *pSampleCount = NULL);
\ No newline at end of file
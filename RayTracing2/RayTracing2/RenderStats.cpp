@@ -0,0 +1,169 @@
+#include "RenderStats.h"
+
+thread_local RenderStats *t_pRenderStats = NULL;
+
+static const char *s_pszCounterNames[STAT_DEPTH_0] =
+{
+	"primary_rays", "reflection_rays", "shadow_rays",
+	"sphere_tests", "plane_tests", "triangle_tests", "bvh_nodes",
+	"light_samples", "light_culled",
+};
+
+static const char *s_pszTimerNames[STAT_TIMER_COUNT] =
+{
+	"generate", "traverse", "shade", "resolve",
+};
+
+long long RenderStats_Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Time one reading of the clock adds to every interval it closes, measured
+// once so intervals as short as a ray are not dominated by the clock.
+static long long RenderStats_GetClockCost()
+{
+	struct ClockCost
+	{
+		ClockCost()
+		{
+			const int nReads = 1000;
+			long long nStart = RenderStats_Now();
+			int i;
+			for (i = 0; i < nReads; i++)
+			{
+				RenderStats_Now();
+			}
+			m_nCost = (RenderStats_Now() - nStart) / nReads;
+		}
+		long long m_nCost;
+	};
+	static ClockCost s_cost;
+	return s_cost.m_nCost;
+}
+
+static long long RenderStats_Elapsed(long long nStart, long long nEnd)
+{
+	return MAX_(nEnd - nStart - RenderStats_GetClockCost(), 0LL);
+}
+
+RenderStats::RenderStats()
+{
+	Reset();
+}
+
+void RenderStats::Reset()
+{
+	memset(m_nCounters, 0, sizeof(m_nCounters));
+	memset(m_nTimes, 0, sizeof(m_nTimes));
+	m_nActiveTimer = -1;
+	m_nTimerStart = 0;
+	m_nTimerDepth = 0;
+	m_nTimerInterval = 1;
+	m_bTiming = false;
+	m_nTimerRandom = 0x9e3779b9u;
+}
+
+void RenderStats::Add(const RenderStats &stats)
+{
+	int i;
+	for (i = 0; i < STAT_COUNTER_COUNT; i++)
+	{
+		m_nCounters[i] += stats.m_nCounters[i];
+	}
+	for (i = 0; i < STAT_TIMER_COUNT; i++)
+	{
+		m_nTimes[i] += stats.m_nTimes[i];
+	}
+}
+
+bool RenderStats::WriteJSON(FILE *pFile, int nFrame)
+{
+	fprintf(pFile, "{\"frame\": %d, \"enabled\": %s", nFrame, IsEnabled() ? "true" : "false");
+	int i;
+	for (i = 0; i < STAT_DEPTH_0; i++)
+	{
+		fprintf(pFile, ", \"%s\": %llu", s_pszCounterNames[i], m_nCounters[i]);
+	}
+
+	// Depths past the deepest one the renderer traces are always empty.
+	fprintf(pFile, ", \"paths_by_depth\": [");
+	for (i = 0; i <= MIN_(RENDER_MAX_REFLECT, STAT_DEPTH_COUNT - 1); i++)
+	{
+		fprintf(pFile, i > 0 ? ", %llu" : "%llu", m_nCounters[STAT_DEPTH_0 + i]);
+	}
+	fprintf(pFile, "], \"thread_ms\": {");
+	for (i = 0; i < STAT_TIMER_COUNT; i++)
+	{
+		fprintf(pFile, i > 0 ? ", \"%s\": %.3f" : "\"%s\": %.3f", s_pszTimerNames[i], m_nTimes[i] * 1e-6);
+	}
+	fprintf(pFile, "}}");
+	return ferror(pFile) == 0;
+}
+
+bool RenderStats::IsEnabled()
+{
+#ifdef RT_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+RenderStatsBinding::RenderStatsBinding(RenderStats *stats, int nTimerInterval)
+{
+	m_pStats = stats;
+	m_pPrevious = t_pRenderStats;
+	t_pRenderStats = stats;
+	stats->m_nTimerInterval = MAX_(nTimerInterval, 1);
+	if (stats->m_nTimerInterval > 1)
+	{
+		memcpy(m_nTimes, stats->m_nTimes, sizeof(m_nTimes));
+		m_nStart = RenderStats_Now();
+	}
+}
+
+RenderStatsBinding::~RenderStatsBinding()
+{
+	t_pRenderStats = m_pPrevious;
+	if (m_pStats->m_nTimerInterval <= 1)
+	{
+		return;
+	}
+
+	double fElapsed = (double)RenderStats_Elapsed(m_nStart, RenderStats_Now());
+	double fSampled = 0.0;
+	int i;
+	for (i = 0; i < STAT_TIMER_COUNT; i++)
+	{
+		fSampled += (double)(m_pStats->m_nTimes[i] - m_nTimes[i]);
+	}
+	if (fSampled > 0.0)
+	{
+		for (i = 0; i < STAT_TIMER_COUNT; i++)
+		{
+			m_pStats->m_nTimes[i] = m_nTimes[i] + (unsigned long long)((m_pStats->m_nTimes[i] - m_nTimes[i]) * fElapsed / fSampled);
+		}
+	}
+}
+
+void RenderStatsTimer::Start()
+{
+	long long nNow = RenderStats_Now();
+	if (m_pStats->m_nActiveTimer >= 0)
+	{
+		m_pStats->m_nTimes[m_pStats->m_nActiveTimer] += RenderStats_Elapsed(m_pStats->m_nTimerStart, nNow) * m_pStats->m_nTimerInterval;
+	}
+	m_nPrevious = m_pStats->m_nActiveTimer;
+	m_pStats->m_nActiveTimer = m_nTimer;
+	m_pStats->m_nTimerStart = nNow;
+	m_bActive = true;
+}
+
+void RenderStatsTimer::Stop()
+{
+	long long nNow = RenderStats_Now();
+	m_pStats->m_nTimes[m_nTimer] += RenderStats_Elapsed(m_pStats->m_nTimerStart, nNow) * m_pStats->m_nTimerInterval;
+	m_pStats->m_nActiveTimer = m_nPrevious;
+	m_pStats->m_nTimerStart = nNow;
+}
\ No newline at end of file
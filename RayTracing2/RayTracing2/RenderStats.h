@@ -0,0 +1,149 @@
+#pragma once
+
+// Per-frame ray, intersection and timing statistics. They are compiled in
+// only when RT_STATS is defined (make STATS=1 builds the batch renderer and
+// the benchmarks with them); otherwise the RT_STAT_* macros expand to nothing
+// and the renderer reports zeros. Each render thread counts into a RenderStats
+// of its own, bound with RT_STATS_BIND for the duration of a task, so counting
+// needs no atomics and concurrent renderers keep separate totals. Timers are
+// exclusive: a nested timer pauses the one it interrupts, so the traversal of
+// a shadow ray counts as traversal and not as shading. Reading the clock for
+// every ray would cost more than the work it measures, so a binding may time
+// only a random one in nTimerInterval outermost timer scopes; the time of the
+// whole binding is then split between the timers in the proportions they
+// sampled. The per-ray paths use RENDERSTATS_RAY_TIMER_INTERVAL.
+
+#define RENDERSTATS_RAY_TIMER_INTERVAL	64
+
+#define STAT_PRIMARY_RAYS		0
+#define STAT_REFLECTION_RAYS	1
+#define STAT_SHADOW_RAYS		2
+#define STAT_SPHERE_TESTS		3
+#define STAT_PLANE_TESTS		4
+#define STAT_TRIANGLE_TESTS		5
+#define STAT_BVH_NODES			6
+#define STAT_LIGHT_SAMPLES		7
+// Light samples dropped below EPSILON_VALUE_1.
+#define STAT_LIGHT_CULLED		8
+// Paths by the number of reflections they went through.
+#define STAT_DEPTH_0			9
+#define STAT_DEPTH_COUNT		8
+#define STAT_COUNTER_COUNT		(STAT_DEPTH_0 + STAT_DEPTH_COUNT)
+
+#define STAT_TIMER_GENERATE		0
+#define STAT_TIMER_TRAVERSE		1
+#define STAT_TIMER_SHADE		2
+#define STAT_TIMER_RESOLVE		3
+#define STAT_TIMER_COUNT		4
+
+class RenderStats
+{
+public:
+	RenderStats();
+	void Reset();
+	void Add(const RenderStats &stats);
+	// Writes the frame as one line of JSON.
+	bool WriteJSON(FILE *pFile, int nFrame);
+	static bool IsEnabled();
+public:
+	unsigned long long m_nCounters[STAT_COUNTER_COUNT];
+	// Nanoseconds, summed over the threads.
+	unsigned long long m_nTimes[STAT_TIMER_COUNT];
+	int m_nActiveTimer;
+	long long m_nTimerStart;
+	int m_nTimerDepth;
+	int m_nTimerInterval;
+	bool m_bTiming;
+	unsigned int m_nTimerRandom;
+};
+
+extern thread_local RenderStats *t_pRenderStats;
+
+long long RenderStats_Now();
+
+inline void RenderStats_Add(int nCounter, unsigned long long nValue)
+{
+	RenderStats *stats = t_pRenderStats;
+	if (stats)
+	{
+		stats->m_nCounters[nCounter] += nValue;
+	}
+}
+
+class RenderStatsBinding
+{
+public:
+	RenderStatsBinding(RenderStats *stats, int nTimerInterval);
+	~RenderStatsBinding();
+private:
+	RenderStats *m_pStats;
+	RenderStats *m_pPrevious;
+	unsigned long long m_nTimes[STAT_TIMER_COUNT];
+	long long m_nStart;
+};
+
+class RenderStatsTimer
+{
+public:
+	inline RenderStatsTimer(int nTimer);
+	inline ~RenderStatsTimer();
+private:
+	void Start();
+	void Stop();
+private:
+	RenderStats *m_pStats;
+	int m_nTimer;
+	int m_nPrevious;
+	bool m_bActive;
+};
+
+// Scopes that are not sampled cost a few instructions.
+inline RenderStatsTimer::RenderStatsTimer(int nTimer)
+{
+	m_pStats = t_pRenderStats;
+	m_nTimer = nTimer;
+	m_bActive = false;
+	if (m_pStats == NULL)
+	{
+		return;
+	}
+
+	// The outermost scope decides whether the whole nest is timed.
+	if (m_pStats->m_nTimerDepth++ == 0)
+	{
+		unsigned int n = m_pStats->m_nTimerRandom;
+		n ^= n << 13;
+		n ^= n >> 17;
+		n ^= n << 5;
+		m_pStats->m_nTimerRandom = n;
+		m_pStats->m_bTiming = n % m_pStats->m_nTimerInterval == 0;
+	}
+	if (m_pStats->m_bTiming)
+	{
+		Start();
+	}
+}
+
+inline RenderStatsTimer::~RenderStatsTimer()
+{
+	if (m_pStats)
+	{
+		if (m_bActive)
+		{
+			Stop();
+		}
+		m_pStats->m_nTimerDepth--;
+	}
+}
+
+#ifdef RT_STATS
+#define RT_STAT_ADD(nCounter, nValue)	RenderStats_Add(nCounter, nValue)
+#define RT_STAT_INC(nCounter)			RenderStats_Add(nCounter, 1)
+#define RT_STAT_TIMER(nTimer)			RenderStatsTimer statsTimer(nTimer)
+#define RT_STATS_BIND(stats, nInterval)	RenderStatsBinding statsBinding(stats, nInterval)
+#else
+#define RT_STAT_ADD(nCounter, nValue)
+#define RT_STAT_INC(nCounter)
+#define RT_STAT_TIMER(nTimer)
+#define RT_STATS_BIND(stats, nInterval)
+#endif
\ No newline at end of file
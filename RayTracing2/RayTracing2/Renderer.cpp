@@ -0,0 +1,1193 @@
+#include "Renderer.h"
+
+ResolveSettings::ResolveSettings()
+{
+	m_fExposure = 1.0f;
+	m_nTonemap = TONEMAP_CLAMP;
+	m_bSRGB = false;
+}
+
+const unsigned char *Resolve_GetSRGBTable()
+{
+	class SRGBTable
+	{
+	public:
+		SRGBTable()
+		{
+			int i;
+			for (i = 0; i < RESOLVE_SRGB_TABLE_SIZE; i++)
+			{
+				float x = i / (float)(RESOLVE_SRGB_TABLE_SIZE - 1);
+				float s = x <= 0.0031308f ? x * 12.92f : 1.055f * powf(x, 1.0f / 2.4f) - 0.055f;
+				m_table[i] = (unsigned char)(s * 255.0f + 0.5f);
+			}
+		}
+	public:
+		unsigned char m_table[RESOLVE_SRGB_TABLE_SIZE];
+	};
+	static SRGBTable s_table;
+	return s_table.m_table;
+}
+
+FrameBuffer::FrameBuffer()
+{
+	m_nWidth = 0;
+	m_nHeight = 0;
+	m_nStride = 0;
+	m_pPixels = NULL;
+	m_pColors = NULL;
+	m_bOwner = false;
+}
+
+FrameBuffer::~FrameBuffer()
+{
+	Release();
+}
+
+void FrameBuffer::Create(int nWidth, int nHeight, int nStride)
+{
+	Release();
+
+	m_nWidth = nWidth;
+	m_nHeight = nHeight;
+	m_nStride = MAX_(nStride, m_nWidth * 4);
+
+	m_pPixels = new unsigned char[m_nStride * m_nHeight];
+	m_pColors = new Color[m_nWidth * m_nHeight];
+	m_bOwner = true;
+}
+
+void FrameBuffer::Attach(int nWidth, int nHeight, int nStride, unsigned char *pPixels, Color *pColors)
+{
+	Release();
+
+	m_nWidth = nWidth;
+	m_nHeight = nHeight;
+	m_nStride = MAX_(nStride, m_nWidth * 4);
+	m_pPixels = pPixels;
+	m_pColors = pColors;
+	m_bOwner = false;
+}
+
+void FrameBuffer::Release()
+{
+	if (m_bOwner)
+	{
+		delete [] m_pPixels;
+		delete [] m_pColors;
+	}
+	m_pPixels = NULL;
+	m_pColors = NULL;
+	m_bOwner = false;
+}
+
+void FrameBuffer::SetPixel(int nX, int nY, unsigned int dwColor)
+{
+	if (nX >= 0 && nY >= 0 && nX < m_nWidth && nY < m_nHeight)
+	{
+		*((unsigned int *)(m_pPixels + nY * m_nStride + (nX << 2))) = dwColor;
+	}
+}
+
+void FrameBuffer::Clear(unsigned int dwColor)
+{
+	int nX;
+	int nY;
+	for (nY = 0; nY < m_nHeight; nY++)
+	{
+		for (nX = 0; nX < m_nWidth; nX++)
+		{
+			SetPixel(nX, nY, dwColor);
+		}
+	}
+}
+
+void FrameBuffer::Resolve(const ResolveSettings &settings, int nY0, int nY1, const SimdKernels *pKernels)
+{
+	ResolveRect(settings, 0, nY0, m_nWidth, nY1, pKernels);
+}
+
+void FrameBuffer::ResolveRect(const ResolveSettings &settings, int nX0, int nY0, int nX1, int nY1, const SimdKernels *pKernels)
+{
+	const unsigned char *pSRGBTable = Resolve_GetSRGBTable();
+	int nY;
+	for (nY = nY0; nY < nY1; nY++)
+	{
+		const float *pSrc = (const float *)(m_pColors + nY * m_nWidth);
+		unsigned int *pDst = (unsigned int *)(m_pPixels + nY * m_nStride);
+		if (pKernels)
+		{
+			pKernels->m_pfnResolveRow(pSrc + nX0 * 3, nX1 - nX0, &settings, pSRGBTable, pDst + nX0);
+			continue;
+		}
+
+		int nX;
+		for (nX = nX0; nX < nX1; nX++)
+		{
+			unsigned int r = (unsigned int)Resolve_QuantizeChannel(pSrc[nX * 3 + 0], &settings, pSRGBTable);
+			unsigned int g = (unsigned int)Resolve_QuantizeChannel(pSrc[nX * 3 + 1], &settings, pSRGBTable);
+			unsigned int b = (unsigned int)Resolve_QuantizeChannel(pSrc[nX * 3 + 2], &settings, pSRGBTable);
+			pDst[nX] = 0xFF000000 | b | (g << 8) | (r << 16);
+		}
+	}
+}
+
+bool FrameBuffer::SavePPM(const char *pszFileName)
+{
+	FILE *pFile = fopen(pszFileName, "wb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+
+	fprintf(pFile, "P6\n%d %d\n255\n", m_nWidth, m_nHeight);
+
+	std::vector<unsigned char> vecRow(m_nWidth * 3);
+	int nX;
+	int nY;
+	for (nY = 0; nY < m_nHeight; nY++)
+	{
+		unsigned char *pSrc = m_pPixels + nY * m_nStride;
+		for (nX = 0; nX < m_nWidth; nX++)
+		{
+			vecRow[nX * 3 + 0] = pSrc[nX * 4 + 2];
+			vecRow[nX * 3 + 1] = pSrc[nX * 4 + 1];
+			vecRow[nX * 3 + 2] = pSrc[nX * 4 + 0];
+		}
+		fwrite(&vecRow[0], 1, vecRow.size(), pFile);
+	}
+
+	bool bResult = ferror(pFile) == 0;
+	fclose(pFile);
+	return bResult;
+}
+
+bool FrameBuffer::SavePFM(const char *pszFileName)
+{
+	FILE *pFile = fopen(pszFileName, "wb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+
+	// A negative scale marks little endian data; PFM stores rows bottom to top.
+	fprintf(pFile, "PF\n%d %d\n-1.0\n", m_nWidth, m_nHeight);
+
+	std::vector<float> vecRow(m_nWidth * 3);
+	int nX;
+	int nY;
+	for (nY = m_nHeight - 1; nY >= 0; nY--)
+	{
+		Color *pSrc = m_pColors + nY * m_nWidth;
+		for (nX = 0; nX < m_nWidth; nX++)
+		{
+			vecRow[nX * 3 + 0] = pSrc[nX].m_r;
+			vecRow[nX * 3 + 1] = pSrc[nX].m_g;
+			vecRow[nX * 3 + 2] = pSrc[nX].m_b;
+		}
+		fwrite(&vecRow[0], sizeof(float), vecRow.size(), pFile);
+	}
+
+	bool bResult = ferror(pFile) == 0;
+	fclose(pFile);
+	return bResult;
+}
+
+// Little endian helpers for the OpenEXR header.
+static void FrameBuffer_AppendBytes(std::vector<unsigned char> *pBuffer, const void *pData, int nSize)
+{
+	const unsigned char *pBytes = (const unsigned char *)pData;
+	pBuffer->insert(pBuffer->end(), pBytes, pBytes + nSize);
+}
+
+static void FrameBuffer_AppendString(std::vector<unsigned char> *pBuffer, const char *psz)
+{
+	FrameBuffer_AppendBytes(pBuffer, psz, (int)strlen(psz) + 1);
+}
+
+static void FrameBuffer_AppendInt(std::vector<unsigned char> *pBuffer, int n)
+{
+	FrameBuffer_AppendBytes(pBuffer, &n, sizeof(n));
+}
+
+static void FrameBuffer_AppendFloat(std::vector<unsigned char> *pBuffer, float f)
+{
+	FrameBuffer_AppendBytes(pBuffer, &f, sizeof(f));
+}
+
+static void FrameBuffer_AppendAttribute(std::vector<unsigned char> *pBuffer, const char *pszName, const char *pszType, int nSize)
+{
+	FrameBuffer_AppendString(pBuffer, pszName);
+	FrameBuffer_AppendString(pBuffer, pszType);
+	FrameBuffer_AppendInt(pBuffer, nSize);
+}
+
+bool FrameBuffer::SaveEXR(const char *pszFileName)
+{
+	FILE *pFile = fopen(pszFileName, "wb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+
+	// Single part scanline image, one line per block, no compression and
+	// 32-bit float B, G, R channels (channel lists are sorted by name).
+	std::vector<unsigned char> vecHeader;
+	FrameBuffer_AppendInt(&vecHeader, 20000630);
+	FrameBuffer_AppendInt(&vecHeader, 2);
+
+	const char *pszChannels[3] = { "B", "G", "R" };
+	FrameBuffer_AppendAttribute(&vecHeader, "channels", "chlist", 3 * 18 + 1);
+	int i;
+	for (i = 0; i < 3; i++)
+	{
+		FrameBuffer_AppendString(&vecHeader, pszChannels[i]);
+		FrameBuffer_AppendInt(&vecHeader, 2);
+		FrameBuffer_AppendInt(&vecHeader, 0);
+		FrameBuffer_AppendInt(&vecHeader, 1);
+		FrameBuffer_AppendInt(&vecHeader, 1);
+	}
+	vecHeader.push_back(0);
+
+	FrameBuffer_AppendAttribute(&vecHeader, "compression", "compression", 1);
+	vecHeader.push_back(0);
+
+	const char *pszWindows[2] = { "dataWindow", "displayWindow" };
+	for (i = 0; i < 2; i++)
+	{
+		FrameBuffer_AppendAttribute(&vecHeader, pszWindows[i], "box2i", 16);
+		FrameBuffer_AppendInt(&vecHeader, 0);
+		FrameBuffer_AppendInt(&vecHeader, 0);
+		FrameBuffer_AppendInt(&vecHeader, m_nWidth - 1);
+		FrameBuffer_AppendInt(&vecHeader, m_nHeight - 1);
+	}
+
+	FrameBuffer_AppendAttribute(&vecHeader, "lineOrder", "lineOrder", 1);
+	vecHeader.push_back(0);
+
+	FrameBuffer_AppendAttribute(&vecHeader, "pixelAspectRatio", "float", 4);
+	FrameBuffer_AppendFloat(&vecHeader, 1.0f);
+
+	FrameBuffer_AppendAttribute(&vecHeader, "screenWindowCenter", "v2f", 8);
+	FrameBuffer_AppendFloat(&vecHeader, 0.0f);
+	FrameBuffer_AppendFloat(&vecHeader, 0.0f);
+
+	FrameBuffer_AppendAttribute(&vecHeader, "screenWindowWidth", "float", 4);
+	FrameBuffer_AppendFloat(&vecHeader, 1.0f);
+
+	vecHeader.push_back(0);
+
+	// The offset table points at every scanline block: y, byte count, then
+	// the row of each channel in channel list order.
+	int nLineSize = m_nWidth * 3 * sizeof(float);
+	unsigned long long nOffset = vecHeader.size() + m_nHeight * sizeof(unsigned long long);
+	int nY;
+	for (nY = 0; nY < m_nHeight; nY++)
+	{
+		FrameBuffer_AppendBytes(&vecHeader, &nOffset, sizeof(nOffset));
+		nOffset += 8 + nLineSize;
+	}
+	fwrite(&vecHeader[0], 1, vecHeader.size(), pFile);
+
+	std::vector<float> vecRow(m_nWidth * 3);
+	for (nY = 0; nY < m_nHeight; nY++)
+	{
+		Color *pSrc = m_pColors + nY * m_nWidth;
+		int nX;
+		for (nX = 0; nX < m_nWidth; nX++)
+		{
+			vecRow[nX] = pSrc[nX].m_b;
+			vecRow[m_nWidth + nX] = pSrc[nX].m_g;
+			vecRow[m_nWidth * 2 + nX] = pSrc[nX].m_r;
+		}
+		fwrite(&nY, sizeof(int), 1, pFile);
+		fwrite(&nLineSize, sizeof(int), 1, pFile);
+		fwrite(&vecRow[0], sizeof(float), vecRow.size(), pFile);
+	}
+
+	bool bResult = ferror(pFile) == 0;
+	fclose(pFile);
+	return bResult;
+}
+
+SampleSettings::SampleSettings()
+{
+	m_nMode = SAMPLING_SINGLE;
+	m_nBaseGrid = 2;
+	m_nMaxGrid = 4;
+	m_fThreshold = 0.05f;
+	m_nLightSamples = 0;
+	m_nSeed = 0;
+}
+
+// Integer hash that jitters samples within their strata.
+static unsigned int Sampling_Hash(unsigned int n)
+{
+	n ^= n >> 16;
+	n *= 0x7feb352du;
+	n ^= n >> 15;
+	n *= 0x846ca68bu;
+	n ^= n >> 16;
+	return n;
+}
+
+// Angle one pixel spans at the center of the frame, for texture footprints.
+static float Renderer_GetTextureSpread(PerspectiveCamera *camera, FrameBuffer *frameBuffer)
+{
+	return camera->m_fovScale * 2.0f / (frameBuffer->m_nWidth + frameBuffer->m_nHeight);
+}
+
+Renderer::Renderer()
+{
+	m_nThreadCount = 0;
+	m_nTileSize = 32;
+	m_bPacketTracing = true;
+	m_bWavefront = false;
+	m_pCamera = NULL;
+	m_pCostBuffer = NULL;
+	m_pCancel = NULL;
+	m_bProgressive = false;
+	m_bResolveDirty = false;
+	m_bFrameValid = false;
+	m_pCachedScene = NULL;
+	m_pCachedFrame = NULL;
+	m_nCachedVersion = 0;
+	m_nCachedWidth = 0;
+	m_nCachedHeight = 0;
+	m_nRayCount = 0;
+	m_nSampleCount = 0;
+}
+
+Renderer::~Renderer()
+{
+	m_threadPool.Stop();
+
+	int i;
+	for (i = 0; i < (int)m_vecWavefront.size(); i++)
+	{
+		delete m_vecWavefront[i];
+	}
+}
+
+void Renderer::SetThreadCount(int nThreadCount)
+{
+	m_nThreadCount = nThreadCount;
+}
+
+void Renderer::SetTileSize(int nTileSize)
+{
+	m_nTileSize = MAX_(nTileSize, 1);
+}
+
+void Renderer::SetPacketTracing(bool bPacketTracing)
+{
+	m_bPacketTracing = bPacketTracing;
+}
+
+void Renderer::SetWavefront(bool bWavefront)
+{
+	m_bWavefront = bWavefront;
+}
+
+void Renderer::SetResolveSettings(const ResolveSettings &settings)
+{
+	m_resolveSettings = settings;
+	m_bResolveDirty = true;
+}
+
+void Renderer::SetSampleSettings(const SampleSettings &settings)
+{
+	m_sampleSettings = settings;
+	m_sampleSettings.m_nBaseGrid = MAX_(settings.m_nBaseGrid, 1);
+	m_sampleSettings.m_nMaxGrid = MAX_(settings.m_nMaxGrid / m_sampleSettings.m_nBaseGrid, 1) * m_sampleSettings.m_nBaseGrid;
+	m_sampleSettings.m_nLightSamples = MAX_(settings.m_nLightSamples, 0);
+	m_bFrameValid = false;
+}
+
+void Renderer::SetCamera(PerspectiveCamera *camera)
+{
+	m_pCamera = camera;
+	m_bFrameValid = false;
+}
+
+void Renderer::SetCostBuffer(CostBuffer *costBuffer)
+{
+	m_pCostBuffer = costBuffer;
+	m_bFrameValid = false;
+}
+
+void Renderer::SetProgress(const std::atomic<bool> *pCancel, const TileFunc &onTile)
+{
+	m_pCancel = pCancel;
+	m_onTile = onTile;
+}
+
+void Renderer::SetProgressive(bool bProgressive, const PassFunc &onPass)
+{
+	m_bProgressive = bProgressive;
+	m_onPass = onPass;
+}
+
+void Renderer::Invalidate()
+{
+	m_bFrameValid = false;
+}
+
+void Renderer::InvalidateRect(int nX0, int nY0, int nX1, int nY1)
+{
+	FrameRect rect;
+	rect.m_nX0 = nX0;
+	rect.m_nY0 = nY0;
+	rect.m_nX1 = nX1;
+	rect.m_nY1 = nY1;
+	m_vecDirtyRects.push_back(rect);
+}
+
+bool Renderer::Update(Scene *scene, FrameBuffer *frameBuffer)
+{
+	if (!m_bFrameValid ||
+		scene != m_pCachedScene ||
+		frameBuffer != m_pCachedFrame ||
+		frameBuffer->m_nWidth != m_nCachedWidth ||
+		frameBuffer->m_nHeight != m_nCachedHeight ||
+		GetFrameVersion(scene) != m_nCachedVersion)
+	{
+		RenderScene(scene, frameBuffer);
+		return true;
+	}
+
+	if (m_vecDirtyRects.empty() && !m_bResolveDirty)
+	{
+		return false;
+	}
+
+	ResetStats();
+
+	// Rectangles are clipped here; overlapping ones are simply traced twice.
+	int i;
+	for (i = 0; i < (int)m_vecDirtyRects.size(); i++)
+	{
+		FrameRect &rect = m_vecDirtyRects[i];
+		int nX0 = MAX_(rect.m_nX0, 0);
+		int nY0 = MAX_(rect.m_nY0, 0);
+		int nX1 = MIN_(rect.m_nX1, frameBuffer->m_nWidth);
+		int nY1 = MIN_(rect.m_nY1, frameBuffer->m_nHeight);
+		if (nX0 < nX1 && nY0 < nY1)
+		{
+			if (!RenderRegion(scene, frameBuffer, nX0, nY0, nX1, nY1))
+			{
+				m_bFrameValid = false;
+			}
+			else if (!m_bResolveDirty)
+			{
+				ResolveRows(frameBuffer, nY0, nY1);
+			}
+		}
+	}
+	m_vecDirtyRects.clear();
+
+	if (m_bResolveDirty)
+	{
+		Resolve(frameBuffer);
+	}
+	return true;
+}
+
+void Renderer::UpdateScene(Scene *scene)
+{
+	StartThreadPool();
+	scene->Update(&m_threadPool);
+}
+
+Color Renderer::RayTraceRecursive(Scene *scene, Ray3 *ray, int maxReflect, unsigned int *pRayCount)
+{
+	(*pRayCount)++;
+
+	IntersectResult result;
+	bool bHit;
+	{
+		RT_STAT_TIMER(STAT_TIMER_TRAVERSE);
+		bHit = scene->m_root->Intersect(ray, &result);
+	}
+	if (bHit)
+	{
+		RT_STAT_TIMER(STAT_TIMER_SHADE);
+		result.m_geometry->ComputeSurfaceInteraction(ray, &result);
+	}
+	return Shade(scene, ray, &result, maxReflect, pRayCount);
+}
+
+Color Renderer::Shade(Scene *scene, Ray3 *ray, IntersectResult *result, int maxReflect, unsigned int *pRayCount)
+{
+	RT_STAT_TIMER(STAT_TIMER_SHADE);
+	if (result->m_geometry)
+	{
+		float reflectiveness = result->m_material->m_reflectiveness;
+		Color color = result->m_material->Sample(ray, &(result->m_position), &(result->m_normal));
+
+		LightSample lightSample;
+		Color light = Color::s_black;
+
+		if (m_sampleSettings.m_nLightSamples > 0 && scene->m_lightTree.GetLightCount() > 0)
+		{
+			light = SampleLightTree(scene, result);
+		}
+		else
+		{
+			int i;
+			int nCount = scene->m_vecLightList.size();
+			for (i = 0; i < nCount; i++)
+			{
+				scene->m_vecLightList[i]->Sample(&lightSample, scene->m_root, result->m_position);
+				if (lightSample.m_EL.m_r > 0.0f ||
+					lightSample.m_EL.m_g > 0.0f ||
+					lightSample.m_EL.m_b > 0.0f)
+				{
+					float NdotL = result->m_normal.Dot(lightSample.m_L);
+					if (NdotL > 0.0f)
+					{
+						light = light.Add(lightSample.m_EL.Multiply(NdotL));
+					}
+				}
+			}
+		}
+		color = color.Modulate(light);
+
+		color = color.Multiply(1 - reflectiveness);
+
+		if (reflectiveness > 0 && maxReflect > 0)
+		{
+			RT_STAT_INC(STAT_REFLECTION_RAYS);
+			Vector3 r = result->m_normal.Multiply(-2.0f * result->m_normal.Dot(ray->m_direction)).Add(ray->m_direction);
+			Ray3 ray1(result->m_position, r);
+			Color reflectedColor = RayTraceRecursive(scene, &ray1, maxReflect - 1, pRayCount);
+			color = color.Add(reflectedColor.Multiply(reflectiveness));
+		}
+		else
+		{
+			RT_STAT_INC(STAT_DEPTH_0 + RENDER_MAX_REFLECT - maxReflect);
+		}
+		return color;
+	}
+	else
+	{
+		RT_STAT_INC(STAT_DEPTH_0 + RENDER_MAX_REFLECT - maxReflect);
+		return Color::s_black;
+	}
+}
+
+Color Renderer::SampleLightTree(Scene *scene, IntersectResult *result)
+{
+	LightTree &tree = scene->m_lightTree;
+	LightSample lightSample;
+	Color light = Color::s_black;
+	int i;
+	for (i = 0; i < (int)tree.m_vecUnbounded.size(); i++)
+	{
+		tree.m_vecUnbounded[i]->Sample(&lightSample, scene->m_root, result->m_position);
+		float NdotL = result->m_normal.Dot(lightSample.m_L);
+		if (NdotL > 0.0f)
+		{
+			light = light.Add(lightSample.m_EL.Multiply(NdotL));
+		}
+	}
+
+	// The picks are stratified over [0, 1) and hashed from the bits of the
+	// hit point, so they do not depend on threads, tiles or packets.
+	unsigned int nBits[3];
+	memcpy(nBits, &result->m_position.m_x, sizeof(nBits));
+	unsigned int nHash = Sampling_Hash(Sampling_Hash(Sampling_Hash(nBits[0] ^ m_sampleSettings.m_nSeed) + nBits[1]) + nBits[2]);
+	int nSamples = m_sampleSettings.m_nLightSamples;
+	for (i = 0; i < nSamples; i++)
+	{
+		nHash = Sampling_Hash(nHash + i);
+		double u = (i + nHash * (1.0 / 4294967296.0)) / nSamples;
+		float pdf;
+		Light *sampled = tree.Sample(result->m_position, result->m_normal, u, &pdf);
+		if (sampled == NULL)
+		{
+			continue;
+		}
+		sampled->Sample(&lightSample, scene->m_root, result->m_position);
+		float NdotL = result->m_normal.Dot(lightSample.m_L);
+		if (NdotL > 0.0f)
+		{
+			light = light.Add(lightSample.m_EL.Multiply(NdotL / (pdf * nSamples)));
+		}
+	}
+	return light;
+}
+
+void Renderer::RenderTile(Scene *scene, FrameBuffer *frameBuffer, int nX0, int nY0, int nX1, int nY1)
+{
+	PerspectiveCamera *camera = GetCamera(scene);
+	int nWidth = frameBuffer->m_nWidth;
+	int nHeight = frameBuffer->m_nHeight;
+	unsigned int nRayCount = 0;
+	Ray3 ray;
+	int y;
+	for (y = nY0; y < nY1; y++)
+	{
+		float sy = 1 - y / (float)nHeight;
+		int x;
+		for (x = nX0; x < nX1; x++)
+		{
+			float sx = x / (float)nWidth;
+			{
+				RT_STAT_TIMER(STAT_TIMER_GENERATE);
+				camera->GenerateRay(sx, sy, &ray);
+			}
+			RT_STAT_INC(STAT_PRIMARY_RAYS);
+
+			Color color = RayTraceRecursive(scene, &ray, RENDER_MAX_REFLECT, &nRayCount);
+			frameBuffer->SetColor(x, y, color);
+		}
+	}
+	m_nRayCount += nRayCount;
+	m_nSampleCount += (nX1 - nX0) * (nY1 - nY0);
+}
+
+Color Renderer::TraceSample(Scene *scene, PerspectiveCamera *camera, FrameBuffer *frameBuffer, int x, int y, int nCellX, int nCellY,
+	unsigned int *pRayCount)
+{
+	int nGrid = m_sampleSettings.m_nMaxGrid;
+	unsigned int nHash = Sampling_Hash(Sampling_Hash(Sampling_Hash(x) + y) + nCellY * nGrid + nCellX);
+	float fJitterX = (nHash & 0xffff) * (1.0f / 65536.0f);
+	float fJitterY = (nHash >> 16) * (1.0f / 65536.0f);
+	float sx = (x + (nCellX + fJitterX) / nGrid) / (float)frameBuffer->m_nWidth;
+	float sy = 1 - (y + (nCellY + fJitterY) / nGrid) / (float)frameBuffer->m_nHeight;
+
+	Ray3 ray;
+	{
+		RT_STAT_TIMER(STAT_TIMER_GENERATE);
+		camera->GenerateRay(sx, sy, &ray);
+	}
+	RT_STAT_INC(STAT_PRIMARY_RAYS);
+	return RayTraceRecursive(scene, &ray, RENDER_MAX_REFLECT, pRayCount);
+}
+
+Color Renderer::SamplePixel(Scene *scene, PerspectiveCamera *camera, FrameBuffer *frameBuffer, int x, int y,
+	unsigned int *pRayCount, unsigned int *pSampleCount)
+{
+	int nGrid = m_sampleSettings.m_nMaxGrid;
+	int nStep = nGrid / m_sampleSettings.m_nBaseGrid;
+	bool bAdaptive = m_sampleSettings.m_nMode == SAMPLING_ADAPTIVE;
+
+	// The coarse strata are traced first, in the same order as by the
+	// uniform mode, so refined pixels sum to the same value.
+	Color sum;
+	Color minimum(1.0f, 1.0f, 1.0f);
+	Color maximum(0.0f, 0.0f, 0.0f);
+	int nCellY;
+	for (nCellY = 0; nCellY < nGrid; nCellY += nStep)
+	{
+		int nCellX;
+		for (nCellX = 0; nCellX < nGrid; nCellX += nStep)
+		{
+			Color color = TraceSample(scene, camera, frameBuffer, x, y, nCellX, nCellY, pRayCount);
+			sum += color;
+			minimum = Color(MIN_(minimum.m_r, color.m_r), MIN_(minimum.m_g, color.m_g), MIN_(minimum.m_b, color.m_b));
+			maximum = Color(MAX_(maximum.m_r, color.m_r), MAX_(maximum.m_g, color.m_g), MAX_(maximum.m_b, color.m_b));
+		}
+	}
+	maximum.Saturate();
+	float fContrast = MAX_(MAX_(maximum.m_r - minimum.m_r, maximum.m_g - minimum.m_g), maximum.m_b - minimum.m_b);
+
+	int nCount = m_sampleSettings.m_nBaseGrid * m_sampleSettings.m_nBaseGrid;
+	if (!bAdaptive || fContrast > m_sampleSettings.m_fThreshold)
+	{
+		for (nCellY = 0; nCellY < nGrid; nCellY++)
+		{
+			int nCellX;
+			for (nCellX = 0; nCellX < nGrid; nCellX++)
+			{
+				if (nCellX % nStep != 0 || nCellY % nStep != 0)
+				{
+					sum += TraceSample(scene, camera, frameBuffer, x, y, nCellX, nCellY, pRayCount);
+				}
+			}
+		}
+		nCount = nGrid * nGrid;
+	}
+	*pSampleCount += nCount;
+	return sum * (1.0f / nCount);
+}
+
+void Renderer::RenderTileSampled(Scene *scene, FrameBuffer *frameBuffer, int nX0, int nY0, int nX1, int nY1)
+{
+	PerspectiveCamera *camera = GetCamera(scene);
+	unsigned int nRayCount = 0;
+	unsigned int nSampleCount = 0;
+	int y;
+	for (y = nY0; y < nY1; y++)
+	{
+		int x;
+		for (x = nX0; x < nX1; x++)
+		{
+			frameBuffer->SetColor(x, y, SamplePixel(scene, camera, frameBuffer, x, y, &nRayCount, &nSampleCount));
+		}
+	}
+	m_nRayCount += nRayCount;
+	m_nSampleCount += nSampleCount;
+}
+
+void Renderer::RenderTileCost(Scene *scene, FrameBuffer *frameBuffer, int nX0, int nY0, int nX1, int nY1)
+{
+	PerspectiveCamera *camera = GetCamera(scene);
+	CostBuffer *costBuffer = m_pCostBuffer;
+	bool bSampled = m_sampleSettings.m_nMode != SAMPLING_SINGLE;
+	RenderStats *stats = t_pRenderStats;
+	unsigned int nRayCount = 0;
+	unsigned int nSampleCount = 0;
+	int y;
+	for (y = nY0; y < nY1; y++)
+	{
+		int x;
+		for (x = nX0; x < nX1; x++)
+		{
+			unsigned long long nTests = 0;
+			unsigned long long nShadowRays = 0;
+			if (stats)
+			{
+				nTests = stats->m_nCounters[STAT_SPHERE_TESTS] + stats->m_nCounters[STAT_PLANE_TESTS] +
+					stats->m_nCounters[STAT_TRIANGLE_TESTS] + stats->m_nCounters[STAT_BVH_NODES];
+				nShadowRays = stats->m_nCounters[STAT_SHADOW_RAYS];
+			}
+			unsigned int nRaysBefore = nRayCount;
+			unsigned int nSamplesBefore = nSampleCount;
+			unsigned long long nStart = Heatmap_ReadCycles();
+
+			Color color;
+			if (bSampled)
+			{
+				color = SamplePixel(scene, camera, frameBuffer, x, y, &nRayCount, &nSampleCount);
+			}
+			else
+			{
+				Ray3 ray;
+				camera->GenerateRay(x / (float)frameBuffer->m_nWidth, 1 - y / (float)frameBuffer->m_nHeight, &ray);
+				RT_STAT_INC(STAT_PRIMARY_RAYS);
+				color = RayTraceRecursive(scene, &ray, RENDER_MAX_REFLECT, &nRayCount);
+				nSampleCount++;
+			}
+
+			costBuffer->SetCost(HEATMAP_CYCLES, x, y, (unsigned int)MIN_(Heatmap_ReadCycles() - nStart, (unsigned long long)UINT_MAX));
+			if (stats)
+			{
+				nTests = stats->m_nCounters[STAT_SPHERE_TESTS] + stats->m_nCounters[STAT_PLANE_TESTS] +
+					stats->m_nCounters[STAT_TRIANGLE_TESTS] + stats->m_nCounters[STAT_BVH_NODES] - nTests;
+				nShadowRays = stats->m_nCounters[STAT_SHADOW_RAYS] - nShadowRays;
+			}
+			costBuffer->SetCost(HEATMAP_INTERSECTIONS, x, y, (unsigned int)nTests);
+			costBuffer->SetCost(HEATMAP_SHADOW_RAYS, x, y, (unsigned int)nShadowRays);
+			// Every ray beyond the camera samples is a reflection.
+			costBuffer->SetCost(HEATMAP_REFLECTIONS, x, y, (nRayCount - nRaysBefore) - (nSampleCount - nSamplesBefore));
+			frameBuffer->SetColor(x, y, color);
+		}
+	}
+	m_nRayCount += nRayCount;
+	m_nSampleCount += nSampleCount;
+}
+
+void Renderer::RenderTilePackets(Scene *scene, FrameBuffer *frameBuffer, int nX0, int nY0, int nX1, int nY1)
+{
+	const SimdKernels *pKernels = Simd_GetKernels();
+	PerspectiveCamera *camera = GetCamera(scene);
+	unsigned int nRayCount = 0;
+
+	// Packets cover square-ish pixel blocks: 2x2 for SSE, 4x2 for AVX2 and 4x4 for AVX-512.
+	int nPacketWidth = pKernels->m_nWidth >= 8 ? 4 : 2;
+	int nPacketHeight = pKernels->m_nWidth / nPacketWidth;
+
+	RayPacket packet;
+	int nBlockY;
+	for (nBlockY = nY0; nBlockY < nY1; nBlockY += nPacketHeight)
+	{
+		int nBlockX;
+		for (nBlockX = nX0; nBlockX < nX1; nBlockX += nPacketWidth)
+		{
+			unsigned int nActiveMask = 0;
+			int i;
+			for (i = 0; i < pKernels->m_nWidth; i++)
+			{
+				int x = nBlockX + i % nPacketWidth;
+				int y = nBlockY + i / nPacketWidth;
+				packet.m_nX[i] = x;
+				packet.m_nY[i] = y;
+				if (x < nX1 && y < nY1)
+				{
+					nActiveMask |= 1u << i;
+				}
+			}
+			TracePacket(scene, camera, frameBuffer, &packet, nActiveMask, &nRayCount);
+		}
+	}
+	m_nRayCount += nRayCount;
+	m_nSampleCount += (nX1 - nX0) * (nY1 - nY0);
+}
+
+// Traces the pixels m_nX/m_nY of the active lanes and stores their colors.
+void Renderer::TracePacket(Scene *scene, PerspectiveCamera *camera, FrameBuffer *frameBuffer, RayPacket *packet,
+	unsigned int nActiveMask, unsigned int *pRayCount)
+{
+	const SimdKernels *pKernels = Simd_GetKernels();
+	packet->Reset(pKernels->m_nWidth, nActiveMask);
+	{
+		RT_STAT_TIMER(STAT_TIMER_GENERATE);
+		pKernels->m_pfnGeneratePrimary(camera, packet, (float)frameBuffer->m_nWidth, (float)frameBuffer->m_nHeight);
+	}
+	{
+		RT_STAT_TIMER(STAT_TIMER_TRAVERSE);
+		scene->m_root->IntersectPacket(packet);
+	}
+
+	// Shading, shadows and reflections diverge per lane, so every lane
+	// continues as a single ray from here.
+	int i;
+	for (i = 0; i < pKernels->m_nWidth; i++)
+	{
+		if ((nActiveMask & (1u << i)) == 0)
+		{
+			continue;
+		}
+
+		Ray3 ray;
+		packet->GetRay(i, &ray);
+		(*pRayCount)++;
+		RT_STAT_INC(STAT_PRIMARY_RAYS);
+
+		IntersectResult result;
+		if (packet->m_geometry[i])
+		{
+			result.m_geometry = packet->m_geometry[i];
+			result.m_nPrimitive = packet->m_nPrimitive[i];
+			result.m_distance = packet->m_distance[i];
+			result.m_u = packet->m_u[i];
+			result.m_v = packet->m_v[i];
+			RT_STAT_TIMER(STAT_TIMER_SHADE);
+			result.m_geometry->ComputeSurfaceInteraction(&ray, &result);
+		}
+		Color color = Shade(scene, &ray, &result, RENDER_MAX_REFLECT, pRayCount);
+		frameBuffer->SetColor(packet->m_nX[i], packet->m_nY[i], color);
+	}
+}
+
+// One pass of a progressive frame over a tile whose corner lies on the
+// lattice of nStep. Traces the lattice pixels that the coarser passes left
+// out, then fills the rest of every nStep x nStep block with the color of
+// its corner pixel.
+void Renderer::RenderTilePass(Scene *scene, FrameBuffer *frameBuffer, int nX0, int nY0, int nX1, int nY1, int nStep)
+{
+	PerspectiveCamera *camera = GetCamera(scene);
+	const SimdKernels *pKernels = Simd_GetKernels();
+	bool bPackets = m_bPacketTracing && pKernels != NULL && m_sampleSettings.m_nMode == SAMPLING_SINGLE;
+	int nCoarseStep = nStep < RENDER_PROGRESSIVE_STEP ? nStep * 2 : 0;
+	unsigned int nRayCount = 0;
+	unsigned int nSampleCount = 0;
+
+	// Lattice pixels go into packets in row order.
+	RayPacket packet;
+	int nLaneCount = 0;
+	int y;
+	for (y = nY0; y < nY1; y += nStep)
+	{
+		int x;
+		for (x = nX0; x < nX1; x += nStep)
+		{
+			if (nCoarseStep != 0 && x % nCoarseStep == 0 && y % nCoarseStep == 0)
+			{
+				continue;
+			}
+			if (!bPackets)
+			{
+				frameBuffer->SetColor(x, y, TracePixel(scene, camera, frameBuffer, x, y, &nRayCount, &nSampleCount));
+				continue;
+			}
+			packet.m_nX[nLaneCount] = x;
+			packet.m_nY[nLaneCount] = y;
+			nSampleCount++;
+			if (++nLaneCount == pKernels->m_nWidth)
+			{
+				TracePacket(scene, camera, frameBuffer, &packet, (1u << nLaneCount) - 1, &nRayCount);
+				nLaneCount = 0;
+			}
+		}
+	}
+	if (nLaneCount > 0)
+	{
+		TracePacket(scene, camera, frameBuffer, &packet, (1u << nLaneCount) - 1, &nRayCount);
+	}
+	m_nRayCount += nRayCount;
+	m_nSampleCount += nSampleCount;
+
+	if (nStep == 1)
+	{
+		return;
+	}
+	for (y = nY0; y < nY1; y++)
+	{
+		const Color *pSource = frameBuffer->m_pColors + (y - y % nStep) * frameBuffer->m_nWidth;
+		int x;
+		for (x = nX0; x < nX1; x++)
+		{
+			if (x % nStep != 0 || y % nStep != 0)
+			{
+				frameBuffer->SetColor(x, y, pSource[x - x % nStep]);
+			}
+		}
+	}
+}
+
+Color Renderer::TracePixel(Scene *scene, PerspectiveCamera *camera, FrameBuffer *frameBuffer, int x, int y,
+	unsigned int *pRayCount, unsigned int *pSampleCount)
+{
+	if (m_sampleSettings.m_nMode != SAMPLING_SINGLE)
+	{
+		return SamplePixel(scene, camera, frameBuffer, x, y, pRayCount, pSampleCount);
+	}
+
+	// The same arithmetic as RenderTile().
+	Ray3 ray;
+	{
+		RT_STAT_TIMER(STAT_TIMER_GENERATE);
+		camera->GenerateRay(x / (float)frameBuffer->m_nWidth, 1 - y / (float)frameBuffer->m_nHeight, &ray);
+	}
+	RT_STAT_INC(STAT_PRIMARY_RAYS);
+	(*pSampleCount)++;
+	return RayTraceRecursive(scene, &ray, RENDER_MAX_REFLECT, pRayCount);
+}
+
+bool Renderer::RenderScene(Scene *scene, FrameBuffer *frameBuffer)
+{
+	int nThreadCount = StartThreadPool();
+	ResetStats();
+
+	// The whole frame is traced, so earlier invalidations are covered.
+	m_bFrameValid = true;
+	m_pCachedScene = scene;
+	m_pCachedFrame = frameBuffer;
+	m_nCachedVersion = GetFrameVersion(scene);
+	m_nCachedWidth = frameBuffer->m_nWidth;
+	m_nCachedHeight = frameBuffer->m_nHeight;
+	m_vecDirtyRects.clear();
+
+	// Renderers only fill the HDR buffer; the resolve pass below produces the
+	// 8-bit pixels for the whole frame. Multisampled frames and frames that
+	// record their cost are traced by tiles, and so are frames that pick from
+	// the light tree.
+	if (m_bProgressive && m_pCostBuffer == NULL)
+	{
+		int nStep;
+		for (nStep = RENDER_PROGRESSIVE_STEP; nStep >= 1; nStep /= 2)
+		{
+			if (!RenderRegion(scene, frameBuffer, 0, 0, frameBuffer->m_nWidth, frameBuffer->m_nHeight, nStep))
+			{
+				m_bFrameValid = false;
+				return false;
+			}
+			if (!m_onTile)
+			{
+				Resolve(frameBuffer);
+			}
+			if (m_onPass)
+			{
+				m_onPass(nStep);
+			}
+		}
+		m_bResolveDirty = false;
+		return true;
+	}
+	if (m_bWavefront && m_sampleSettings.m_nMode == SAMPLING_SINGLE && m_sampleSettings.m_nLightSamples == 0 &&
+		m_pCostBuffer == NULL && m_pCancel == NULL && !m_onTile)
+	{
+		// The wavefront stages want long queues, so work is split into runs
+		// of scanline pixels instead of tiles. Each worker keeps its queues.
+		int nWidth = frameBuffer->m_nWidth;
+		int nHeight = frameBuffer->m_nHeight;
+		while ((int)m_vecWavefront.size() < nThreadCount)
+		{
+			m_vecWavefront.push_back(new WavefrontRenderer());
+		}
+		int nPixelCount = nWidth * nHeight;
+		int nChunks = (nPixelCount + WAVEFRONT_CHUNK_SIZE - 1) / WAVEFRONT_CHUNK_SIZE;
+		PerspectiveCamera *camera = GetCamera(scene);
+		float fSpread = Renderer_GetTextureSpread(camera, frameBuffer);
+		m_threadPool.Run(nChunks, [=](int nChunk, int nWorker)
+		{
+			int nBegin = nChunk * WAVEFRONT_CHUNK_SIZE;
+			int nEnd = MIN_(nBegin + WAVEFRONT_CHUNK_SIZE, nPixelCount);
+			RT_STATS_BIND(&m_vecStats[nWorker], 1);
+			TextureSpreadBinding spreadBinding(fSpread);
+			m_nRayCount += m_vecWavefront[nWorker]->RenderChunk(scene, camera, frameBuffer, nBegin, nEnd, m_bPacketTracing);
+			m_nSampleCount += nEnd - nBegin;
+		});
+	}
+	else if (!RenderRegion(scene, frameBuffer, 0, 0, frameBuffer->m_nWidth, frameBuffer->m_nHeight))
+	{
+		m_bFrameValid = false;
+		return false;
+	}
+
+	// Tiles reported to a callback are resolved already, with the current settings.
+	if (m_onTile)
+	{
+		m_bResolveDirty = false;
+		return true;
+	}
+	Resolve(frameBuffer);
+	return true;
+}
+
+bool Renderer::RenderRegion(Scene *scene, FrameBuffer *frameBuffer, int nX0, int nY0, int nX1, int nY1, int nPassStep)
+{
+	StartThreadPool();
+
+	// Every pixel is traced independently, so the tile order does not change the image.
+	int nTileSize = nPassStep > 0 ? Renderer_GetPassTileSize(m_nTileSize) : m_nTileSize;
+	int nTilesX = (nX1 - nX0 + nTileSize - 1) / nTileSize;
+	int nTilesY = (nY1 - nY0 + nTileSize - 1) / nTileSize;
+	bool bPackets = m_bPacketTracing && Simd_GetKernels() != NULL;
+	bool bSampled = m_sampleSettings.m_nMode != SAMPLING_SINGLE;
+	bool bCost = m_pCostBuffer != NULL &&
+		m_pCostBuffer->m_nWidth == frameBuffer->m_nWidth && m_pCostBuffer->m_nHeight == frameBuffer->m_nHeight;
+	float fSpread = Renderer_GetTextureSpread(GetCamera(scene), frameBuffer);
+	const std::atomic<bool> *pCancel = m_pCancel;
+	const SimdKernels *pKernels = Simd_GetKernels();
+	std::atomic<bool> bSkipped(false);
+	m_threadPool.Run(nTilesX * nTilesY, [=, &bSkipped](int nTile, int nWorker)
+	{
+		if (pCancel && pCancel->load(std::memory_order_relaxed))
+		{
+			bSkipped = true;
+			return;
+		}
+		FrameRect rect;
+		rect.m_nX0 = nX0 + (nTile % nTilesX) * nTileSize;
+		rect.m_nY0 = nY0 + (nTile / nTilesX) * nTileSize;
+		rect.m_nX1 = MIN_(rect.m_nX0 + nTileSize, nX1);
+		rect.m_nY1 = MIN_(rect.m_nY0 + nTileSize, nY1);
+		{
+			TextureSpreadBinding spreadBinding(fSpread);
+			if (bCost)
+			{
+				// Sampled timers would add their own cost to some pixels.
+				RT_STATS_BIND(&m_vecStats[nWorker], INT_MAX);
+				RenderTileCost(scene, frameBuffer, rect.m_nX0, rect.m_nY0, rect.m_nX1, rect.m_nY1);
+			}
+			else
+			{
+				RT_STATS_BIND(&m_vecStats[nWorker], RENDERSTATS_RAY_TIMER_INTERVAL);
+				if (nPassStep > 0)
+				{
+					RenderTilePass(scene, frameBuffer, rect.m_nX0, rect.m_nY0, rect.m_nX1, rect.m_nY1, nPassStep);
+				}
+				else if (bSampled)
+				{
+					RenderTileSampled(scene, frameBuffer, rect.m_nX0, rect.m_nY0, rect.m_nX1, rect.m_nY1);
+				}
+				else if (bPackets)
+				{
+					RenderTilePackets(scene, frameBuffer, rect.m_nX0, rect.m_nY0, rect.m_nX1, rect.m_nY1);
+				}
+				else
+				{
+					RenderTile(scene, frameBuffer, rect.m_nX0, rect.m_nY0, rect.m_nX1, rect.m_nY1);
+				}
+			}
+		}
+		if (m_onTile)
+		{
+			{
+				RT_STATS_BIND(&m_vecStats[nWorker], 1);
+				RT_STAT_TIMER(STAT_TIMER_RESOLVE);
+				frameBuffer->ResolveRect(m_resolveSettings, rect.m_nX0, rect.m_nY0, rect.m_nX1, rect.m_nY1, pKernels);
+			}
+			m_onTile(rect);
+		}
+	});
+	return !bSkipped;
+}
+
+void Renderer::Resolve(FrameBuffer *frameBuffer)
+{
+	m_bResolveDirty = false;
+	ResolveRows(frameBuffer, 0, frameBuffer->m_nHeight);
+}
+
+void Renderer::ResolveRows(FrameBuffer *frameBuffer, int nY0, int nY1)
+{
+	StartThreadPool();
+
+	// Rows are independent; bands of rows keep the task count low.
+	const int nBandHeight = 16;
+	const SimdKernels *pKernels = Simd_GetKernels();
+	ResolveSettings settings = m_resolveSettings;
+	int nBands = (nY1 - nY0 + nBandHeight - 1) / nBandHeight;
+	m_threadPool.Run(nBands, [=](int nBand, int nWorker)
+	{
+		int nBandY0 = nY0 + nBand * nBandHeight;
+		int nBandY1 = MIN_(nBandY0 + nBandHeight, nY1);
+		RT_STATS_BIND(&m_vecStats[nWorker], 1);
+		RT_STAT_TIMER(STAT_TIMER_RESOLVE);
+		frameBuffer->Resolve(settings, nBandY0, nBandY1, pKernels);
+	});
+}
+
+int Renderer::StartThreadPool()
+{
+	int nThreadCount = m_nThreadCount > 0 ? m_nThreadCount : ThreadPool::GetHardwareThreadCount();
+	if (m_threadPool.GetThreadCount() != nThreadCount)
+	{
+		m_threadPool.Start(nThreadCount);
+	}
+	if ((int)m_vecStats.size() < nThreadCount)
+	{
+		m_vecStats.resize(nThreadCount);
+	}
+	return nThreadCount;
+}
+
+void Renderer::ResetStats()
+{
+	int i;
+	for (i = 0; i < (int)m_vecStats.size(); i++)
+	{
+		m_vecStats[i].Reset();
+	}
+}
+
+void Renderer::GetFrameStats(RenderStats *stats)
+{
+	stats->Reset();
+	int i;
+	for (i = 0; i < (int)m_vecStats.size(); i++)
+	{
+		stats->Add(m_vecStats[i]);
+	}
+}
+
+PerspectiveCamera *Renderer::GetCamera(Scene *scene)
+{
+	return m_pCamera ? m_pCamera : scene->m_camera;
+}
+
+// A renderer with its own camera never reads the scene's, which front ends
+// may move while a job renders.
+unsigned int Renderer::GetFrameVersion(Scene *scene)
+{
+	if (m_pCamera)
+	{
+		return scene->GetObjectVersion() + m_pCamera->m_nVersion;
+	}
+	return scene->GetVersion();
+}
+
+unsigned long long Renderer::GetRayCount()
+{
+	return m_nRayCount;
+}
+
+unsigned long long Renderer::GetSampleCount()
+{
+	return m_nSampleCount;
+}
\ No newline at end of file
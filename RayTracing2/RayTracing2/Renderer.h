@@ -0,0 +1,252 @@
+#pragma once
+
+// Platform independent frame buffer. Renderers write the unclamped radiance
+// of every pixel into the HDR buffer m_pColors; Resolve() turns rows of it into
+// m_pPixels, 32-bit pixels in the layout of PixelFormat32bppARGB (B, G, R, A in
+// memory) so the Win32 front end can wrap them in a Gdiplus::Bitmap. The HDR
+// buffer outlives the resolve, so frames can be re-exposed, accumulated or
+// written as PFM/EXR without tracing again.
+
+#define TONEMAP_CLAMP		0
+#define TONEMAP_REINHARD	1
+#define TONEMAP_ACES		2
+
+// Entries of the sRGB encoding table, indexed by the clamped linear value.
+#define RESOLVE_SRGB_TABLE_SIZE	4096
+
+class ResolveSettings
+{
+public:
+	ResolveSettings();
+public:
+	float m_fExposure;
+	int m_nTonemap;
+	bool m_bSRGB;
+};
+
+class SimdKernels;
+
+class FrameBuffer
+{
+public:
+	FrameBuffer();
+	~FrameBuffer();
+	void Create(int nWidth, int nHeight, int nStride = 0);
+	// Uses memory owned by the caller; Release() leaves it alone.
+	void Attach(int nWidth, int nHeight, int nStride, unsigned char *pPixels, Color *pColors);
+	void Release();
+	inline void SetPixel(int nX, int nY, unsigned int dwColor);
+	inline void SetColor(int nX, int nY, const Color &color);
+	void Clear(unsigned int dwColor);
+	void Resolve(const ResolveSettings &settings, int nY0, int nY1, const SimdKernels *pKernels);
+	// Pixels are resolved one by one, so a rectangle gives the same pixels as
+	// the rows it lies in.
+	void ResolveRect(const ResolveSettings &settings, int nX0, int nY0, int nX1, int nY1, const SimdKernels *pKernels);
+	bool SavePPM(const char *pszFileName);
+	bool SavePFM(const char *pszFileName);
+	bool SaveEXR(const char *pszFileName);
+public:
+	int m_nWidth;
+	int m_nHeight;
+	int m_nStride;
+	unsigned char *m_pPixels;
+	Color *m_pColors;
+	bool m_bOwner;
+};
+
+inline void FrameBuffer::SetColor(int nX, int nY, const Color &color)
+{
+	m_pColors[nY * m_nWidth + nX] = color;
+}
+
+const unsigned char *Resolve_GetSRGBTable();
+
+// Scalar form of one channel of the resolve; the SIMD kernels in
+// ResolveKernels.inl perform the same operations in the same order.
+inline int Resolve_QuantizeChannel(float x, const ResolveSettings *settings, const unsigned char *pSRGBTable)
+{
+	x = x * settings->m_fExposure;
+	if (settings->m_nTonemap == TONEMAP_REINHARD)
+	{
+		x = x / (1.0f + x);
+	}
+	else if (settings->m_nTonemap == TONEMAP_ACES)
+	{
+		x = (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+	}
+	x = MIN_(MAX_(x, 0.0f), 1.0f);
+	if (settings->m_bSRGB)
+	{
+		return pSRGBTable[(int)(x * (RESOLVE_SRGB_TABLE_SIZE - 1) + 0.5f)];
+	}
+	return (int)(x * 255.0f);
+}
+
+// Reflection bounces traced after the camera ray.
+#define RENDER_MAX_REFLECT	3
+
+#define SAMPLING_SINGLE		0
+#define SAMPLING_UNIFORM	1
+#define SAMPLING_ADAPTIVE	2
+
+// Camera samples per pixel. SAMPLING_SINGLE traces one ray through the pixel
+// corner. The other modes split the pixel into m_nMaxGrid x m_nMaxGrid strata
+// and place one jittered sample in each; SAMPLING_UNIFORM traces all of them.
+// SAMPLING_ADAPTIVE first traces a coarse m_nBaseGrid x m_nBaseGrid subset and
+// traces the remaining strata only when the samples of the pixel differ by
+// more than m_fThreshold in some channel of the displayable range, which
+// happens at silhouettes, texture edges and shadow boundaries. Jitter depends
+// only on the pixel and the stratum, so images do not depend on threads or
+// tiles, and a pixel that is refined gets exactly the uniform result.
+//
+// m_nLightSamples 0 shades every hit with every light. Otherwise each hit sums
+// the lights without a position and picks m_nLightSamples of the point and
+// spot lights from the scene's LightTree, one shadow ray each. The picks
+// depend only on the hit point and m_nSeed; frames rendered with different
+// seeds have independent noise and average to the full sum.
+class SampleSettings
+{
+public:
+	SampleSettings();
+public:
+	int m_nMode;
+	int m_nBaseGrid;
+	int m_nMaxGrid;
+	float m_fThreshold;
+	int m_nLightSamples;
+	unsigned int m_nSeed;
+};
+
+class WavefrontRenderer;
+class CostBuffer;
+
+// Pixels [m_nX0, m_nX1) x [m_nY0, m_nY1) of a frame.
+class FrameRect
+{
+public:
+	int m_nX0;
+	int m_nY0;
+	int m_nX1;
+	int m_nY1;
+};
+
+// RenderScene() always traces the whole frame. Update() is the cached form for
+// interactive front ends: it traces again only when the scene version, the
+// scene or the frame buffer changed since the last frame, re-traces just the
+// rectangles passed to InvalidateRect() otherwise, and re-resolves the kept
+// HDR buffer when only the resolve settings changed. It returns false when the
+// frame buffer already holds the current image. Call Invalidate() after
+// re-creating the frame buffer. SetCamera() renders through a camera other
+// than the scene's, so renderers sharing one scene can each use their own;
+// the scene's camera is then never read and may change while they render.
+// SetCostBuffer() makes every frame also record the cost of each pixel (see
+// Heatmap.h); the buffer must have the size of the frame buffer.
+//
+// SetProgress() is for frames rendered in the background (see RenderJob.h).
+// With a tile callback every tile is resolved as soon as it is traced and
+// then reported, from the thread that traced it. Once *pCancel becomes true
+// no further tile is started; the frame is left partly traced and unresolved,
+// and the next Update() traces it again. Both make the frame go by tiles
+// even when the wavefront pipeline is on.
+//
+// SetProgressive() traces whole frames in passes of coarser pixel steps
+// first, 4 and then 2, which take 1/16 and 3/16 of the samples. Each pass
+// traces only the pixels the passes before it left out and fills the rest of
+// its step x step blocks from their traced corner pixel, so the frame buffer
+// holds a blocky preview after every pass and the pass callback runs with
+// the step just done. The last pass traces every remaining pixel, so the
+// final image is the one a plain frame gets, at the cost of one frame. Tiles
+// are rounded up to a multiple of the first step. Cost buffers turn it off.
+#define RENDER_PROGRESSIVE_STEP		4
+#define RENDER_PROGRESSIVE_PASSES	3
+
+inline int Renderer_GetPassTileSize(int nTileSize)
+{
+	return (nTileSize + RENDER_PROGRESSIVE_STEP - 1) / RENDER_PROGRESSIVE_STEP * RENDER_PROGRESSIVE_STEP;
+}
+
+
+class Renderer
+{
+public:
+	typedef std::function<void(const FrameRect &rect)> TileFunc;
+	typedef std::function<void(int nStep)> PassFunc;
+	Renderer();
+	~Renderer();
+	void SetThreadCount(int nThreadCount);
+	void SetTileSize(int nTileSize);
+	void SetPacketTracing(bool bPacketTracing);
+	void SetWavefront(bool bWavefront);
+	void SetResolveSettings(const ResolveSettings &settings);
+	void SetSampleSettings(const SampleSettings &settings);
+	void SetCamera(PerspectiveCamera *camera);
+	void SetCostBuffer(CostBuffer *costBuffer);
+	void SetProgress(const std::atomic<bool> *pCancel, const TileFunc &onTile);
+	void SetProgressive(bool bProgressive, const PassFunc &onPass);
+	void Invalidate();
+	void InvalidateRect(int nX0, int nY0, int nX1, int nY1);
+	bool Update(Scene *scene, FrameBuffer *frameBuffer);
+	// Scene::Update() on the render threads, for animated scenes.
+	void UpdateScene(Scene *scene);
+	Color RayTraceRecursive(Scene *scene, Ray3 *ray, int maxReflect, unsigned int *pRayCount);
+	Color Shade(Scene *scene, Ray3 *ray, IntersectResult *result, int maxReflect, unsigned int *pRayCount);
+	void RenderTile(Scene *scene, FrameBuffer *frameBuffer, int nX0, int nY0, int nX1, int nY1);
+	void RenderTilePackets(Scene *scene, FrameBuffer *frameBuffer, int nX0, int nY0, int nX1, int nY1);
+	void RenderTileSampled(Scene *scene, FrameBuffer *frameBuffer, int nX0, int nY0, int nX1, int nY1);
+	void RenderTileCost(Scene *scene, FrameBuffer *frameBuffer, int nX0, int nY0, int nX1, int nY1);
+	void RenderTilePass(Scene *scene, FrameBuffer *frameBuffer, int nX0, int nY0, int nX1, int nY1, int nStep);
+	// Returns false if tiles were skipped because the frame was cancelled.
+	// nPassStep > 0 traces one progressive pass instead of every pixel.
+	bool RenderRegion(Scene *scene, FrameBuffer *frameBuffer, int nX0, int nY0, int nX1, int nY1, int nPassStep = 0);
+	// Returns false if the frame was cancelled before it was complete.
+	bool RenderScene(Scene *scene, FrameBuffer *frameBuffer);
+	void Resolve(FrameBuffer *frameBuffer);
+	void ResolveRows(FrameBuffer *frameBuffer, int nY0, int nY1);
+	// Primary and reflection rays traced so far. Shadow rays are not counted;
+	// a STATS=1 build reports them in RenderStats.
+	unsigned long long GetRayCount();
+	// Camera samples traced, one per pixel unless multisampling is on.
+	unsigned long long GetSampleCount();
+	// Statistics of the last frame traced; zeros unless built with RT_STATS.
+	void GetFrameStats(RenderStats *stats);
+private:
+	int StartThreadPool();
+	void ResetStats();
+	PerspectiveCamera *GetCamera(Scene *scene);
+	Color TraceSample(Scene *scene, PerspectiveCamera *camera, FrameBuffer *frameBuffer, int x, int y, int nCellX, int nCellY,
+		unsigned int *pRayCount);
+	Color SampleLightTree(Scene *scene, IntersectResult *result);
+	Color SamplePixel(Scene *scene, PerspectiveCamera *camera, FrameBuffer *frameBuffer, int x, int y,
+		unsigned int *pRayCount, unsigned int *pSampleCount);
+	Color TracePixel(Scene *scene, PerspectiveCamera *camera, FrameBuffer *frameBuffer, int x, int y,
+		unsigned int *pRayCount, unsigned int *pSampleCount);
+	void TracePacket(Scene *scene, PerspectiveCamera *camera, FrameBuffer *frameBuffer, RayPacket *packet,
+		unsigned int nActiveMask, unsigned int *pRayCount);
+	unsigned int GetFrameVersion(Scene *scene);
+private:
+	int m_nThreadCount;
+	int m_nTileSize;
+	bool m_bPacketTracing;
+	bool m_bWavefront;
+	ResolveSettings m_resolveSettings;
+	SampleSettings m_sampleSettings;
+	PerspectiveCamera *m_pCamera;
+	CostBuffer *m_pCostBuffer;
+	const std::atomic<bool> *m_pCancel;
+	TileFunc m_onTile;
+	bool m_bProgressive;
+	PassFunc m_onPass;
+	bool m_bResolveDirty;
+	bool m_bFrameValid;
+	Scene *m_pCachedScene;
+	FrameBuffer *m_pCachedFrame;
+	unsigned int m_nCachedVersion;
+	int m_nCachedWidth;
+	int m_nCachedHeight;
+	std::vector<FrameRect> m_vecDirtyRects;
+	ThreadPool m_threadPool;
+	std::vector<WavefrontRenderer *> m_vecWavefront;
+	std::atomic<unsigned long long> m_nRayCount;
+	std::atomic<unsigned long long> m_nSampleCount;
+	std::vector<RenderStats> m_vecStats;
+};
\ No newline at end of file
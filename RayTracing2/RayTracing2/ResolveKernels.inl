@@ -0,0 +1,86 @@
+// Resolve of one row of HDR colors to ARGB8 pixels, compiled for every
+// instruction set by Simd.cpp. Exposure, tone mapping and clamping act on each
+// channel alone, so blocks of pixels are processed as a flat float stream and
+// only the final packing looks at whole pixels. The per-lane arithmetic matches
+// Resolve_QuantizeChannel, which also handles the pixels after the last block.
+
+#define RESOLVE_BLOCK_PIXELS	16
+
+static void ResolveRow(const float *pSrc, int nCount, const ResolveSettings *settings,
+	const unsigned char *pSRGBTable, unsigned int *pDst)
+{
+	vfloat zero = Set1(0.0f);
+	vfloat one = Set1(1.0f);
+	vfloat exposure = Set1(settings->m_fExposure);
+	vfloat acesA = Set1(2.51f);
+	vfloat acesB = Set1(0.03f);
+	vfloat acesC = Set1(2.43f);
+	vfloat acesD = Set1(0.59f);
+	vfloat acesE = Set1(0.14f);
+	int nTonemap = settings->m_nTonemap;
+	bool bSRGB = settings->m_bSRGB;
+
+	// The sRGB path rounds to a table index, the linear path truncates like
+	// the scalar code always has.
+	vfloat scale = Set1(bSRGB ? (float)(RESOLVE_SRGB_TABLE_SIZE - 1) : 255.0f);
+
+	alignas(64) int quantized[RESOLVE_BLOCK_PIXELS * 3];
+
+	int nPixel = 0;
+	for (; nPixel + RESOLVE_BLOCK_PIXELS <= nCount; nPixel += RESOLVE_BLOCK_PIXELS)
+	{
+		const float *pBlock = pSrc + nPixel * 3;
+		int i;
+		for (i = 0; i < RESOLVE_BLOCK_PIXELS * 3; i += SIMD_LANES)
+		{
+			vfloat x = LoadU(pBlock + i) * exposure;
+			if (nTonemap == TONEMAP_REINHARD)
+			{
+				x = x / (one + x);
+			}
+			else if (nTonemap == TONEMAP_ACES)
+			{
+				x = (x * (acesA * x + acesB)) / (x * (acesC * x + acesD) + acesE);
+			}
+			x = Min(Max(x, zero), one);
+			x = x * scale;
+			if (bSRGB)
+			{
+				x = x + Set1(0.5f);
+			}
+			StoreTruncInt(quantized + i, x);
+		}
+
+		unsigned int *pBlockDst = pDst + nPixel;
+		if (bSRGB)
+		{
+			for (i = 0; i < RESOLVE_BLOCK_PIXELS; i++)
+			{
+				unsigned int r = pSRGBTable[quantized[i * 3 + 0]];
+				unsigned int g = pSRGBTable[quantized[i * 3 + 1]];
+				unsigned int b = pSRGBTable[quantized[i * 3 + 2]];
+				pBlockDst[i] = 0xFF000000 | b | (g << 8) | (r << 16);
+			}
+		}
+		else
+		{
+			for (i = 0; i < RESOLVE_BLOCK_PIXELS; i++)
+			{
+				unsigned int r = (unsigned int)quantized[i * 3 + 0];
+				unsigned int g = (unsigned int)quantized[i * 3 + 1];
+				unsigned int b = (unsigned int)quantized[i * 3 + 2];
+				pBlockDst[i] = 0xFF000000 | b | (g << 8) | (r << 16);
+			}
+		}
+	}
+
+	for (; nPixel < nCount; nPixel++)
+	{
+		unsigned int r = (unsigned int)Resolve_QuantizeChannel(pSrc[nPixel * 3 + 0], settings, pSRGBTable);
+		unsigned int g = (unsigned int)Resolve_QuantizeChannel(pSrc[nPixel * 3 + 1], settings, pSRGBTable);
+		unsigned int b = (unsigned int)Resolve_QuantizeChannel(pSrc[nPixel * 3 + 2], settings, pSRGBTable);
+		pDst[nPixel] = 0xFF000000 | b | (g << 8) | (r << 16);
+	}
+}
+
+#undef RESOLVE_BLOCK_PIXELS
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "Scene.h"
+
+Scene::Scene()
+{
+	m_camera = NULL;
+	m_root = NULL;
+	m_nVersion = 0;
+}
+
+Scene::~Scene()
+{
+	Release();
+}
+
+void Scene::CreateDefault()
+{
+	Release();
+
+	CreateCamera<PerspectiveCamera>(
+		Vector3(0, 5, 25),
+		Vector3(0, 0, -1),
+		Vector3(0, 1, 0),
+		90);
+
+	Plane *plane = CreateGeometry<Plane>(Vector3(0, 1, 0), 0);
+	plane->m_material = CreateMaterial<CheckerMaterial>(0.1f, 0.5f);
+	Sphere *sphere1 = CreateGeometry<Sphere>(Vector3(-10, 10, 0), 10);
+	sphere1->m_material = CreateMaterial<PhongMaterial>(Color::s_red, Color::s_white, 16, 0.25f);
+	Sphere *sphere2 = CreateGeometry<Sphere>(Vector3(10, 10, 0), 10);
+	sphere2->m_material = CreateMaterial<PhongMaterial>(Color::s_yellow, Color::s_white, 16, 0.25f);
+	Union *scene = CreateGeometry<Union>();
+	scene->AddGeometry(plane);
+	scene->AddGeometry(sphere1);
+	scene->AddGeometry(sphere2);
+
+	m_root = scene;
+
+	CreateLight<DirectionalLight>(Color::s_white, Vector3(-1.75f, -2.0f, -1.5f));
+
+	//CreateLight<PointLight>(Color::s_white.Multiply(1000), Vector3(0, 30.0f, 0));
+
+	CreateLight<SpotLight>(Color::s_white.Multiply(2000), Vector3(0, 50.0f, 0), Vector3(0.0f, -1.0f, 0.0f),
+		20.0f, 30.0f, 0.5f);
+
+	Initialize();
+}
+
+void Scene::Initialize()
+{
+	m_camera->Initialize();
+
+	int i;
+	int nCount = m_vecPrototypeList.size();
+	for (i = 0; i < nCount; i++)
+	{
+		m_vecPrototypeList[i]->Initialize();
+	}
+
+	m_root->Initialize();
+
+	UpdateLights(true);
+
+	MarkChanged();
+}
+
+// Initializes the lights that changed since the light tree was built, or all
+// of them, and builds the tree again if any was.
+void Scene::UpdateLights(bool bAll)
+{
+	int nCount = m_vecLightList.size();
+	bool bChanged = bAll || (int)m_vecLightVersions.size() != nCount;
+	m_vecLightVersions.resize(nCount);
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		Light *light = m_vecLightList[i];
+		if (bChanged || light->m_nVersion != m_vecLightVersions[i])
+		{
+			light->Initialize();
+			m_vecLightVersions[i] = light->m_nVersion;
+			bChanged = true;
+		}
+	}
+	if (bChanged)
+	{
+		m_lightTree.Build(m_vecLightList);
+	}
+}
+
+void Scene::Update(ThreadPool *threadPool)
+{
+	int i;
+	for (i = 0; i < (int)m_vecPrototypeList.size(); i++)
+	{
+		m_vecPrototypeList[i]->Update(threadPool);
+	}
+	if (m_root)
+	{
+		m_root->Update(threadPool);
+	}
+	UpdateLights(false);
+}
+
+void Scene::Release()
+{
+	// Keep the version growing although the objects adding to it go away.
+	unsigned int nVersion = GetVersion();
+
+	// Objects that point into the mapped file end before it is closed.
+	m_vecLightList.clear();
+	m_vecLightVersions.clear();
+	m_lightTree.Release();
+	m_vecGeometryList.clear();
+	m_vecPrototypeList.clear();
+	m_vecMaterialList.clear();
+	m_vecTextureList.clear();
+	m_camera = NULL;
+	m_root = NULL;
+	m_arena.Reset();
+	m_textureCache.Clear();
+	m_mappedFile.reset();
+
+	m_nVersion = nVersion + 1;
+}
+
+Texture *Scene::CreateTexture()
+{
+	Texture *texture = m_arena.Create<Texture>(&m_textureCache);
+	m_vecTextureList.push_back(texture);
+	return texture;
+}
+
+void Scene::MarkChanged()
+{
+	m_nVersion++;
+}
+
+unsigned int Scene::GetVersion()
+{
+	return GetObjectVersion() + (m_camera ? m_camera->m_nVersion : 0);
+}
+
+unsigned int Scene::GetObjectVersion()
+{
+	// Object versions only grow, so the sum changes whenever any one does.
+	unsigned int nVersion = m_nVersion;
+	int i;
+	int nCount = m_vecGeometryList.size();
+	for (i = 0; i < nCount; i++)
+	{
+		nVersion += m_vecGeometryList[i]->m_nVersion;
+	}
+	nCount = m_vecMaterialList.size();
+	for (i = 0; i < nCount; i++)
+	{
+		nVersion += m_vecMaterialList[i]->m_nVersion;
+	}
+	nCount = m_vecLightList.size();
+	for (i = 0; i < nCount; i++)
+	{
+		nVersion += m_vecLightList[i]->m_nVersion;
+	}
+	return nVersion;
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+// A renderable scene: the camera, the root geometry traced by the renderer and
+// the lights. Objects are created in the scene's arena by the Create methods
+// and all end together in Release(), which keeps the arena's memory for the
+// next scene. GetVersion() changes whenever an object is added, the scene is
+// initialized or an object reports an edit through MarkChanged(); the
+// renderer's frame cache compares it to decide whether to trace again.
+// Animation edits objects in place, calls their MarkChanged() and then
+// Update(), which refits the acceleration structures instead of building them
+// again (see BVH::Update).
+//
+// Lights that report an edit are initialized again by Update(), which then
+// builds the light tree again.
+//
+// Prototypes are geometries shared by Instance objects. They are not part of
+// the root; Initialize() and Update() handle them before the root so instance
+// bounds see the prototypes as they are.
+//
+// Textures are read through the scene's texture cache, whose budget bounds
+// the memory they take while rendering (see Texture.h).
+
+class Scene
+{
+public:
+	Scene();
+	~Scene();
+	void CreateDefault();
+	void Initialize();
+	void Update(ThreadPool *threadPool);
+	void Release();
+	template <class T, class... Args>
+	T *CreateCamera(Args&&... args);
+	template <class T, class... Args>
+	T *CreateGeometry(Args&&... args);
+	template <class T, class... Args>
+	T *CreatePrototype(Args&&... args);
+	template <class T, class... Args>
+	T *CreateMaterial(Args&&... args);
+	template <class T, class... Args>
+	T *CreateLight(Args&&... args);
+	Texture *CreateTexture();
+	void MarkChanged();
+	unsigned int GetVersion();
+	// GetVersion() without the camera, for renderers with a camera of their own.
+	unsigned int GetObjectVersion();
+public:
+	PerspectiveCamera *m_camera;
+	Geometry *m_root;
+	std::vector<Light *> m_vecLightList;
+	std::vector<Geometry *> m_vecGeometryList;
+	std::vector<Geometry *> m_vecPrototypeList;
+	std::vector<Material *> m_vecMaterialList;
+	std::vector<Texture *> m_vecTextureList;
+	TextureCache m_textureCache;
+	// Built from the lights by Initialize() and by Update() after a light changed.
+	LightTree m_lightTree;
+	// Compiled scene file the objects may point into; see SceneFile.
+	std::shared_ptr<MappedFile> m_mappedFile;
+	SceneArena m_arena;
+private:
+	void UpdateLights(bool bAll);
+private:
+	unsigned int m_nVersion;
+	// Light versions the light tree was built from.
+	std::vector<unsigned int> m_vecLightVersions;
+};
+
+template <class T, class... Args>
+T *Scene::CreateCamera(Args&&... args)
+{
+	m_camera = m_arena.Create<T>(std::forward<Args>(args)...);
+	MarkChanged();
+	return (T *)m_camera;
+}
+
+template <class T, class... Args>
+T *Scene::CreateGeometry(Args&&... args)
+{
+	T *geometry = m_arena.Create<T>(std::forward<Args>(args)...);
+	m_vecGeometryList.push_back(geometry);
+	MarkChanged();
+	return geometry;
+}
+
+template <class T, class... Args>
+T *Scene::CreatePrototype(Args&&... args)
+{
+	T *prototype = CreateGeometry<T>(std::forward<Args>(args)...);
+	m_vecPrototypeList.push_back(prototype);
+	return prototype;
+}
+
+template <class T, class... Args>
+T *Scene::CreateMaterial(Args&&... args)
+{
+	T *material = m_arena.Create<T>(std::forward<Args>(args)...);
+	m_vecMaterialList.push_back(material);
+	MarkChanged();
+	return material;
+}
+
+template <class T, class... Args>
+T *Scene::CreateLight(Args&&... args)
+{
+	T *light = m_arena.Create<T>(std::forward<Args>(args)...);
+	m_vecLightList.push_back(light);
+	MarkChanged();
+	return light;
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "SceneArena.h"
+
+int SceneArena_NextTypeIndex()
+{
+	static std::atomic<int> s_nTypeCount(0);
+	return s_nTypeCount++;
+}
+
+SceneArena::SceneArena()
+{
+}
+
+SceneArena::~SceneArena()
+{
+	Release();
+}
+
+void SceneArena::Reset()
+{
+	int nPoolCount = m_vecPools.size();
+	int i;
+	for (i = 0; i < nPoolCount; i++)
+	{
+		Pool *pool = m_vecPools[i];
+		if (pool == NULL)
+		{
+			continue;
+		}
+		if (pool->m_pfnDestroy)
+		{
+			int nObject;
+			for (nObject = 0; nObject < pool->m_nCount; nObject++)
+			{
+				int nBlock = nObject / pool->m_nObjectsPerBlock;
+				int nSlot = nObject % pool->m_nObjectsPerBlock;
+				pool->m_pfnDestroy(pool->m_vecBlocks[nBlock] + nSlot * pool->m_nObjectSize);
+			}
+		}
+		pool->m_nCount = 0;
+	}
+}
+
+void SceneArena::Release()
+{
+	Reset();
+
+	int nPoolCount = m_vecPools.size();
+	int i;
+	for (i = 0; i < nPoolCount; i++)
+	{
+		Pool *pool = m_vecPools[i];
+		if (pool == NULL)
+		{
+			continue;
+		}
+		int nBlock;
+		for (nBlock = 0; nBlock < (int)pool->m_vecBlocks.size(); nBlock++)
+		{
+			Simd_AlignedFree(pool->m_vecBlocks[nBlock]);
+		}
+		delete pool;
+	}
+	m_vecPools.clear();
+}
+
+size_t SceneArena::GetUsedSize()
+{
+	size_t nSize = 0;
+	int i;
+	for (i = 0; i < (int)m_vecPools.size(); i++)
+	{
+		if (m_vecPools[i])
+		{
+			nSize += m_vecPools[i]->m_nCount * m_vecPools[i]->m_nObjectSize;
+		}
+	}
+	return nSize;
+}
+
+size_t SceneArena::GetReservedSize()
+{
+	size_t nSize = 0;
+	int i;
+	for (i = 0; i < (int)m_vecPools.size(); i++)
+	{
+		if (m_vecPools[i])
+		{
+			nSize += m_vecPools[i]->m_vecBlocks.size() * m_vecPools[i]->m_nObjectsPerBlock * m_vecPools[i]->m_nObjectSize;
+		}
+	}
+	return nSize;
+}
\ No newline at end of file
@@ -0,0 +1,144 @@
+#pragma once
+
+// Storage for the objects of a scene. Every type gets its own run of blocks,
+// so objects of one type are created next to each other in the order they
+// are added: a Union walks spheres that share cache lines, and materials are
+// packed together instead of being spread over the heap. Blocks never move,
+// so pointers stay valid, and Get<T>(nIndex) addresses an object by its
+// position among the objects of its type.
+//
+// Reset() ends the lifetime of all objects and keeps the blocks for the next
+// scene, so reloading reuses the same memory. Destructors are run only for
+// types that own memory of their own; types listed with
+// SCENEARENA_TRIVIAL_TEARDOWN are simply forgotten, which makes teardown cost
+// independent of the number of spheres, planes, materials and lights.
+
+#define SCENEARENA_BLOCK_SIZE	(64 * 1024)
+
+template <class T>
+class SceneArenaTraits
+{
+public:
+	enum { TRIVIAL_TEARDOWN = 0 };
+};
+
+// For types whose destructors release nothing.
+#define SCENEARENA_TRIVIAL_TEARDOWN(T)							\
+	template <>													\
+	class SceneArenaTraits<T>									\
+	{															\
+	public:														\
+		enum { TRIVIAL_TEARDOWN = 1 };							\
+	}
+
+SCENEARENA_TRIVIAL_TEARDOWN(Sphere);
+SCENEARENA_TRIVIAL_TEARDOWN(Plane);
+SCENEARENA_TRIVIAL_TEARDOWN(Instance);
+SCENEARENA_TRIVIAL_TEARDOWN(PerspectiveCamera);
+SCENEARENA_TRIVIAL_TEARDOWN(CheckerMaterial);
+SCENEARENA_TRIVIAL_TEARDOWN(PhongMaterial);
+SCENEARENA_TRIVIAL_TEARDOWN(TextureMaterial);
+SCENEARENA_TRIVIAL_TEARDOWN(DirectionalLight);
+SCENEARENA_TRIVIAL_TEARDOWN(PointLight);
+SCENEARENA_TRIVIAL_TEARDOWN(SpotLight);
+
+int SceneArena_NextTypeIndex();
+
+template <class T>
+int SceneArena_GetTypeIndex()
+{
+	static const int s_nIndex = SceneArena_NextTypeIndex();
+	return s_nIndex;
+}
+
+class SceneArena
+{
+public:
+	SceneArena();
+	~SceneArena();
+	template <class T, class... Args>
+	T *Create(Args&&... args);
+	template <class T>
+	int GetCount();
+	template <class T>
+	T *Get(int nIndex);
+	void Reset();
+	void Release();
+	size_t GetUsedSize();
+	size_t GetReservedSize();
+private:
+	typedef void (*DestroyFunc)(void *p);
+	class Pool
+	{
+	public:
+		std::vector<unsigned char *> m_vecBlocks;
+		size_t m_nObjectSize;
+		int m_nObjectsPerBlock;
+		int m_nCount;
+		DestroyFunc m_pfnDestroy;
+	};
+	template <class T>
+	static void Destroy(void *p);
+	template <class T>
+	Pool *GetPool();
+	std::vector<Pool *> m_vecPools;
+};
+
+template <class T>
+void SceneArena::Destroy(void *p)
+{
+	((T *)p)->~T();
+}
+
+template <class T>
+SceneArena::Pool *SceneArena::GetPool()
+{
+	int nType = SceneArena_GetTypeIndex<T>();
+	if (nType >= (int)m_vecPools.size())
+	{
+		m_vecPools.resize(nType + 1, NULL);
+	}
+	Pool *pool = m_vecPools[nType];
+	if (pool == NULL)
+	{
+		pool = new Pool();
+		pool->m_nObjectSize = sizeof(T);
+		pool->m_nObjectsPerBlock = MAX_((int)(SCENEARENA_BLOCK_SIZE / sizeof(T)), 1);
+		pool->m_nCount = 0;
+		pool->m_pfnDestroy = SceneArenaTraits<T>::TRIVIAL_TEARDOWN ? NULL : &SceneArena::Destroy<T>;
+		m_vecPools[nType] = pool;
+	}
+	return pool;
+}
+
+template <class T, class... Args>
+T *SceneArena::Create(Args&&... args)
+{
+	static_assert(alignof(T) <= SIMD_ALIGNMENT, "scene objects must fit the block alignment");
+
+	Pool *pool = GetPool<T>();
+	int nBlock = pool->m_nCount / pool->m_nObjectsPerBlock;
+	int nSlot = pool->m_nCount % pool->m_nObjectsPerBlock;
+	if (nBlock == (int)pool->m_vecBlocks.size())
+	{
+		pool->m_vecBlocks.push_back((unsigned char *)Simd_AlignedAlloc(pool->m_nObjectsPerBlock * sizeof(T)));
+	}
+
+	T *object = new (pool->m_vecBlocks[nBlock] + nSlot * sizeof(T)) T(std::forward<Args>(args)...);
+	pool->m_nCount++;
+	return object;
+}
+
+template <class T>
+int SceneArena::GetCount()
+{
+	int nType = SceneArena_GetTypeIndex<T>();
+	return nType < (int)m_vecPools.size() && m_vecPools[nType] ? m_vecPools[nType]->m_nCount : 0;
+}
+
+template <class T>
+T *SceneArena::Get(int nIndex)
+{
+	Pool *pool = m_vecPools[SceneArena_GetTypeIndex<T>()];
+	return (T *)(pool->m_vecBlocks[nIndex / pool->m_nObjectsPerBlock] + nIndex % pool->m_nObjectsPerBlock * sizeof(T));
+}
\ No newline at end of file
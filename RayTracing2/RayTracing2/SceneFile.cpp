@@ -0,0 +1,742 @@
+#include "SceneFile.h"
+
+// Compiled layout: this header, then the material, geometry, light, texture
+// and mesh record arrays and the embedded mesh caches, every block starting on a 64
+// byte boundary. The record sizes reject files written by a build with a
+// different layout.
+
+#define SCENEFILE_ALIGNMENT		64
+
+class SceneFileHeader
+{
+public:
+	char m_szMagic[8];
+	int m_nVersion;
+	int m_nMaterialSize;
+	int m_nGeometrySize;
+	int m_nLightSize;
+	int m_nTextureSize;
+	int m_nMeshSize;
+	int m_nMaterialCount;
+	int m_nGeometryCount;
+	int m_nLightCount;
+	int m_nTextureCount;
+	int m_nMeshCount;
+	SceneCameraRecord m_camera;
+	unsigned long long m_nMaterialOffset;
+	unsigned long long m_nGeometryOffset;
+	unsigned long long m_nLightOffset;
+	unsigned long long m_nTextureOffset;
+	unsigned long long m_nMeshOffset;
+	unsigned long long m_nFileSize;
+};
+
+static const char s_szSceneMagic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', 0 };
+
+static unsigned long long SceneFile_AlignOffset(unsigned long long nOffset)
+{
+	return (nOffset + SCENEFILE_ALIGNMENT - 1) / SCENEFILE_ALIGNMENT * SCENEFILE_ALIGNMENT;
+}
+
+static bool SceneFile_Pad(FILE *pFile)
+{
+	static const char s_padding[SCENEFILE_ALIGNMENT] = { 0 };
+	long nPosition = ftell(pFile);
+	if (nPosition < 0)
+	{
+		return false;
+	}
+	size_t nPadding = (size_t)(SceneFile_AlignOffset(nPosition) - nPosition);
+	return fwrite(s_padding, 1, nPadding, pFile) == nPadding;
+}
+
+static bool SceneFile_WriteBlock(FILE *pFile, const void *pData, size_t nSize, unsigned long long *pOffset)
+{
+	if (!SceneFile_Pad(pFile))
+	{
+		return false;
+	}
+	*pOffset = (unsigned long long)ftell(pFile);
+	return nSize == 0 || fwrite(pData, 1, nSize, pFile) == nSize;
+}
+
+// Splits a line at white space; double quotes keep paths with spaces together.
+static void SceneFile_Tokenize(const char *pszLine, std::vector<std::string> *pTokens)
+{
+	pTokens->clear();
+	const char *p = pszLine;
+	while (true)
+	{
+		while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		{
+			p++;
+		}
+		if (*p == '\0' || *p == '#')
+		{
+			break;
+		}
+		const char *pBegin = p;
+		if (*p == '"')
+		{
+			pBegin = ++p;
+			while (*p != '\0' && *p != '"')
+			{
+				p++;
+			}
+			pTokens->push_back(std::string(pBegin, p));
+			if (*p == '"')
+			{
+				p++;
+			}
+		}
+		else
+		{
+			while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+			{
+				p++;
+			}
+			pTokens->push_back(std::string(pBegin, p));
+		}
+	}
+}
+
+static bool SceneFile_ParseFloats(const std::vector<std::string> &tokens, int nFirst, int nCount, float *pValues)
+{
+	if (nFirst + nCount > (int)tokens.size())
+	{
+		return false;
+	}
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		const char *pszToken = tokens[nFirst + i].c_str();
+		char *pEnd = NULL;
+		pValues[i] = strtof(pszToken, &pEnd);
+		if (pEnd == pszToken || *pEnd != '\0')
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+SceneFile::SceneFile()
+{
+	m_pMaterials = NULL;
+	m_pGeometries = NULL;
+	m_pLights = NULL;
+	m_pTextures = NULL;
+	m_pMeshes = NULL;
+	Release();
+}
+
+SceneFile::~SceneFile()
+{
+	Release();
+}
+
+void SceneFile::Release()
+{
+	m_camera = SceneCameraRecord();
+	m_materials.clear();
+	m_geometries.clear();
+	m_lights.clear();
+	m_textures.clear();
+	m_materialNames.clear();
+	m_textureNames.clear();
+	m_meshPaths.clear();
+	m_bHasCamera = false;
+	m_mappedFile.reset();
+	m_pMeshes = NULL;
+	m_fileName.clear();
+	m_directory.clear();
+	m_nLine = 0;
+	SetViews();
+}
+
+void SceneFile::SetViews()
+{
+	m_pMaterials = m_materials.empty() ? NULL : &m_materials[0];
+	m_pGeometries = m_geometries.empty() ? NULL : &m_geometries[0];
+	m_pLights = m_lights.empty() ? NULL : &m_lights[0];
+	m_pTextures = m_textures.empty() ? NULL : &m_textures[0];
+	m_nMaterialCount = m_materials.size();
+	m_nGeometryCount = m_geometries.size();
+	m_nLightCount = m_lights.size();
+	m_nTextureCount = m_textures.size();
+	m_nMeshCount = m_meshPaths.size();
+}
+
+bool SceneFile::IsBinary()
+{
+	return m_mappedFile != NULL;
+}
+
+const char *SceneFile::GetError()
+{
+	return m_error.c_str();
+}
+
+bool SceneFile::SetError(const char *pszMessage, const char *pszDetail)
+{
+	char szLine[32] = "";
+	if (m_nLine > 0)
+	{
+		snprintf(szLine, sizeof(szLine), ":%d", m_nLine);
+	}
+	m_error = m_fileName + szLine + ": " + pszMessage;
+	if (pszDetail)
+	{
+		m_error = m_error + " " + pszDetail;
+	}
+	return false;
+}
+
+bool SceneFile::Load(const char *pszFileName)
+{
+	char szMagic[sizeof(s_szSceneMagic)] = { 0 };
+	FILE *pFile = fopen(pszFileName, "rb");
+	if (pFile)
+	{
+		fread(szMagic, 1, sizeof(szMagic), pFile);
+		fclose(pFile);
+	}
+
+	if (memcmp(szMagic, s_szSceneMagic, sizeof(szMagic)) == 0)
+	{
+		return LoadBinary(pszFileName);
+	}
+	return LoadText(pszFileName);
+}
+
+// Relative paths in either form are taken from the directory of pszFileName.
+void SceneFile::SetFileName(const char *pszFileName)
+{
+	m_fileName = pszFileName;
+	m_directory.clear();
+	const char *pszSlash = strrchr(pszFileName, '/');
+	const char *pszBackslash = strrchr(pszFileName, '\\');
+	if (pszBackslash && (pszSlash == NULL || pszBackslash > pszSlash))
+	{
+		pszSlash = pszBackslash;
+	}
+	if (pszSlash)
+	{
+		m_directory.assign(pszFileName, pszSlash + 1);
+	}
+}
+
+bool SceneFile::LoadText(const char *pszFileName)
+{
+	Release();
+	m_error.clear();
+	SetFileName(pszFileName);
+
+	FILE *pFile = fopen(pszFileName, "rb");
+	if (pFile == NULL)
+	{
+		return SetError("cannot open", NULL);
+	}
+
+	std::vector<std::string> tokens;
+	std::string line;
+	char szBuffer[1024];
+	bool bResult = true;
+	while (bResult && fgets(szBuffer, sizeof(szBuffer), pFile))
+	{
+		// Lines longer than the buffer arrive in pieces.
+		line += szBuffer;
+		if (line.back() != '\n' && !feof(pFile))
+		{
+			continue;
+		}
+		m_nLine++;
+		SceneFile_Tokenize(line.c_str(), &tokens);
+		line.clear();
+		if (!tokens.empty())
+		{
+			bResult = ParseLine(tokens);
+		}
+	}
+	fclose(pFile);
+
+	if (bResult && !m_bHasCamera)
+	{
+		m_nLine = 0;
+		bResult = SetError("no camera", NULL);
+	}
+	if (!bResult)
+	{
+		std::string error = m_error;
+		Release();
+		m_error = error;
+		return false;
+	}
+
+	SetViews();
+	return true;
+}
+
+std::string SceneFile::ResolvePath(const std::string &path)
+{
+	bool bAbsolute = path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':');
+	return bAbsolute ? path : m_directory + path;
+}
+
+bool SceneFile::ParseLine(const std::vector<std::string> &tokens)
+{
+	const std::string &keyword = tokens[0];
+	int nCount = tokens.size();
+	float values[13];
+
+	if (keyword == "camera")
+	{
+		if (nCount != 11 || !SceneFile_ParseFloats(tokens, 1, 10, values))
+		{
+			return SetError("expected camera <eye xyz> <front xyz> <up xyz> <fov>", NULL);
+		}
+		m_camera.m_eye = Vector3(values[0], values[1], values[2]);
+		m_camera.m_front = Vector3(values[3], values[4], values[5]);
+		m_camera.m_up = Vector3(values[6], values[7], values[8]);
+		m_camera.m_fov = values[9];
+		m_bHasCamera = true;
+		return true;
+	}
+
+	if (keyword == "material")
+	{
+		if (nCount < 3)
+		{
+			return SetError("expected material <type> <name> ...", NULL);
+		}
+		if (std::find(m_materialNames.begin(), m_materialNames.end(), tokens[2]) != m_materialNames.end())
+		{
+			return SetError("duplicate material", tokens[2].c_str());
+		}
+
+		SceneMaterialRecord material = SceneMaterialRecord();
+		if (tokens[1] == "checker")
+		{
+			if (nCount != 5 || !SceneFile_ParseFloats(tokens, 3, 2, values))
+			{
+				return SetError("expected material checker <name> <scale> <reflectiveness>", NULL);
+			}
+			material.m_nType = SCENE_MATERIAL_CHECKER;
+			material.m_scale = values[0];
+			material.m_reflectiveness = values[1];
+		}
+		else if (tokens[1] == "phong")
+		{
+			if (nCount != 11 || !SceneFile_ParseFloats(tokens, 3, 8, values))
+			{
+				return SetError("expected material phong <name> <diffuse rgb> <specular rgb> <shininess> <reflectiveness>", NULL);
+			}
+			material.m_nType = SCENE_MATERIAL_PHONG;
+			material.m_diffuse = Color(values[0], values[1], values[2]);
+			material.m_specular = Color(values[3], values[4], values[5]);
+			material.m_shininess = values[6];
+			material.m_reflectiveness = values[7];
+		}
+		else if (tokens[1] == "texture")
+		{
+			if (nCount != 7 || (tokens[4] != "planar" && tokens[4] != "spherical") || !SceneFile_ParseFloats(tokens, 5, 2, values))
+			{
+				return SetError("expected material texture <name> <texture> planar|spherical <scale> <reflectiveness>", NULL);
+			}
+			std::vector<std::string>::iterator it = std::find(m_textureNames.begin(), m_textureNames.end(), tokens[3]);
+			if (it == m_textureNames.end())
+			{
+				return SetError("unknown texture", tokens[3].c_str());
+			}
+			material.m_nType = SCENE_MATERIAL_TEXTURE;
+			material.m_nTexture = it - m_textureNames.begin();
+			material.m_nProjection = tokens[4] == "planar" ? TEXTURE_PROJECTION_PLANAR : TEXTURE_PROJECTION_SPHERICAL;
+			material.m_scale = values[0];
+			material.m_reflectiveness = values[1];
+		}
+		else
+		{
+			return SetError("unknown material type", tokens[1].c_str());
+		}
+		m_materials.push_back(material);
+		m_materialNames.push_back(tokens[2]);
+		return true;
+	}
+
+	if (keyword == "texture")
+	{
+		if (nCount != 3)
+		{
+			return SetError("expected texture <name> <file>", NULL);
+		}
+		if (std::find(m_textureNames.begin(), m_textureNames.end(), tokens[1]) != m_textureNames.end())
+		{
+			return SetError("duplicate texture", tokens[1].c_str());
+		}
+		// Kept as written and resolved by CreateScene(), so a compiled copy
+		// finds the textures next to itself.
+		const std::string &path = tokens[2];
+		SceneTextureRecord texture = SceneTextureRecord();
+		if (path.size() >= sizeof(texture.m_szPath))
+		{
+			return SetError("texture path too long", path.c_str());
+		}
+		memcpy(texture.m_szPath, path.c_str(), path.size());
+		m_textures.push_back(texture);
+		m_textureNames.push_back(tokens[1]);
+		return true;
+	}
+
+	if (keyword == "sphere" || keyword == "plane" || keyword == "mesh")
+	{
+		SceneGeometryRecord geometry = SceneGeometryRecord();
+		if (keyword == "mesh")
+		{
+			if (nCount != 3)
+			{
+				return SetError("expected mesh <file.obj> <material>", NULL);
+			}
+			geometry.m_nType = SCENE_GEOMETRY_MESH;
+			geometry.m_nMesh = m_meshPaths.size();
+			m_meshPaths.push_back(ResolvePath(tokens[1]));
+		}
+		else
+		{
+			if (nCount != 6 || !SceneFile_ParseFloats(tokens, 1, 4, values))
+			{
+				return SetError(keyword == "sphere" ? "expected sphere <center xyz> <radius> <material>" :
+					"expected plane <normal xyz> <d> <material>", NULL);
+			}
+			geometry.m_nType = keyword == "sphere" ? SCENE_GEOMETRY_SPHERE : SCENE_GEOMETRY_PLANE;
+			geometry.m_vector = Vector3(values[0], values[1], values[2]);
+			geometry.m_fScalar = values[3];
+		}
+
+		const std::string &materialName = tokens[nCount - 1];
+		std::vector<std::string>::iterator it = std::find(m_materialNames.begin(), m_materialNames.end(), materialName);
+		if (it == m_materialNames.end())
+		{
+			return SetError("unknown material", materialName.c_str());
+		}
+		geometry.m_nMaterial = it - m_materialNames.begin();
+		m_geometries.push_back(geometry);
+		return true;
+	}
+
+	if (keyword == "light")
+	{
+		SceneLightRecord light = SceneLightRecord();
+		light.m_nShadow = 1;
+		if (nCount > 2 && tokens[nCount - 1] == "noshadow")
+		{
+			light.m_nShadow = 0;
+			nCount--;
+		}
+
+		if (nCount > 1 && tokens[1] == "directional")
+		{
+			if (nCount != 8 || !SceneFile_ParseFloats(tokens, 2, 6, values))
+			{
+				return SetError("expected light directional <irradiance rgb> <direction xyz>", NULL);
+			}
+			light.m_nType = SCENE_LIGHT_DIRECTIONAL;
+			light.m_direction = Vector3(values[3], values[4], values[5]);
+		}
+		else if (nCount > 1 && tokens[1] == "point")
+		{
+			if (nCount != 8 || !SceneFile_ParseFloats(tokens, 2, 6, values))
+			{
+				return SetError("expected light point <intensity rgb> <position xyz>", NULL);
+			}
+			light.m_nType = SCENE_LIGHT_POINT;
+			light.m_position = Vector3(values[3], values[4], values[5]);
+		}
+		else if (nCount > 1 && tokens[1] == "spot")
+		{
+			if (nCount != 14 || !SceneFile_ParseFloats(tokens, 2, 12, values))
+			{
+				return SetError("expected light spot <intensity rgb> <position xyz> <direction xyz> <theta> <phi> <falloff>", NULL);
+			}
+			light.m_nType = SCENE_LIGHT_SPOT;
+			light.m_position = Vector3(values[3], values[4], values[5]);
+			light.m_direction = Vector3(values[6], values[7], values[8]);
+			light.m_theta = values[9];
+			light.m_phi = values[10];
+			light.m_falloff = values[11];
+		}
+		else
+		{
+			return SetError("unknown light type", nCount > 1 ? tokens[1].c_str() : NULL);
+		}
+		light.m_color = Color(values[0], values[1], values[2]);
+		m_lights.push_back(light);
+		return true;
+	}
+
+	return SetError("unknown keyword", keyword.c_str());
+}
+
+bool SceneFile::LoadBinary(const char *pszFileName)
+{
+	Release();
+	m_error.clear();
+	SetFileName(pszFileName);
+
+	std::shared_ptr<MappedFile> mappedFile(new MappedFile());
+	if (!mappedFile->Open(pszFileName))
+	{
+		return SetError("cannot open", NULL);
+	}
+
+	const unsigned char *pData = mappedFile->GetData();
+	unsigned long long nSize = mappedFile->GetSize();
+	SceneFileHeader header;
+	if (nSize < sizeof(header))
+	{
+		return SetError("truncated scene file", NULL);
+	}
+	memcpy(&header, pData, sizeof(header));
+
+	if (memcmp(header.m_szMagic, s_szSceneMagic, sizeof(header.m_szMagic)) != 0 ||
+		header.m_nVersion != SCENEFILE_VERSION ||
+		header.m_nMaterialSize != (int)sizeof(SceneMaterialRecord) ||
+		header.m_nGeometrySize != (int)sizeof(SceneGeometryRecord) ||
+		header.m_nLightSize != (int)sizeof(SceneLightRecord) ||
+		header.m_nTextureSize != (int)sizeof(SceneTextureRecord) ||
+		header.m_nMeshSize != (int)sizeof(SceneMeshRecord))
+	{
+		return SetError("unsupported scene file version", NULL);
+	}
+	if (header.m_nFileSize != nSize ||
+		header.m_nMaterialCount < 0 || header.m_nGeometryCount < 0 || header.m_nLightCount < 0 ||
+		header.m_nTextureCount < 0 || header.m_nMeshCount < 0 ||
+		!MappedFile_IsInRange(header.m_nMaterialOffset, header.m_nMaterialCount, sizeof(SceneMaterialRecord), nSize) ||
+		!MappedFile_IsInRange(header.m_nGeometryOffset, header.m_nGeometryCount, sizeof(SceneGeometryRecord), nSize) ||
+		!MappedFile_IsInRange(header.m_nLightOffset, header.m_nLightCount, sizeof(SceneLightRecord), nSize) ||
+		!MappedFile_IsInRange(header.m_nTextureOffset, header.m_nTextureCount, sizeof(SceneTextureRecord), nSize) ||
+		!MappedFile_IsInRange(header.m_nMeshOffset, header.m_nMeshCount, sizeof(SceneMeshRecord), nSize))
+	{
+		return SetError("corrupt scene file", NULL);
+	}
+
+	// The only fixup: section offsets become pointers into the mapping.
+	m_camera = header.m_camera;
+	m_pMaterials = (const SceneMaterialRecord *)(pData + header.m_nMaterialOffset);
+	m_pGeometries = (const SceneGeometryRecord *)(pData + header.m_nGeometryOffset);
+	m_pLights = (const SceneLightRecord *)(pData + header.m_nLightOffset);
+	m_pTextures = (const SceneTextureRecord *)(pData + header.m_nTextureOffset);
+	m_pMeshes = (const SceneMeshRecord *)(pData + header.m_nMeshOffset);
+	m_nMaterialCount = header.m_nMaterialCount;
+	m_nGeometryCount = header.m_nGeometryCount;
+	m_nLightCount = header.m_nLightCount;
+	m_nTextureCount = header.m_nTextureCount;
+	m_nMeshCount = header.m_nMeshCount;
+	m_mappedFile = mappedFile;
+	return true;
+}
+
+bool SceneFile::LoadMesh(int nMesh, TriangleMesh *mesh, int nThreadCount)
+{
+	if (m_mappedFile)
+	{
+		const SceneMeshRecord &record = m_pMeshes[nMesh];
+		if (!MappedFile_IsInRange(record.m_nOffset, record.m_nSize, 1, m_mappedFile->GetSize()) ||
+			!mesh->AttachCache(m_mappedFile->GetData() + record.m_nOffset, (size_t)record.m_nSize))
+		{
+			return SetError("corrupt mesh in scene file", NULL);
+		}
+		return true;
+	}
+
+	if (!mesh->Load(m_meshPaths[nMesh].c_str(), nThreadCount))
+	{
+		return SetError("cannot load mesh", m_meshPaths[nMesh].c_str());
+	}
+	return true;
+}
+
+bool SceneFile::SaveBinary(const char *pszFileName, int nThreadCount)
+{
+	m_nLine = 0;
+
+	SceneFileHeader header = SceneFileHeader();
+	memcpy(header.m_szMagic, s_szSceneMagic, sizeof(header.m_szMagic));
+	header.m_nVersion = SCENEFILE_VERSION;
+	header.m_nMaterialSize = sizeof(SceneMaterialRecord);
+	header.m_nGeometrySize = sizeof(SceneGeometryRecord);
+	header.m_nLightSize = sizeof(SceneLightRecord);
+	header.m_nTextureSize = sizeof(SceneTextureRecord);
+	header.m_nMeshSize = sizeof(SceneMeshRecord);
+	header.m_nMaterialCount = m_nMaterialCount;
+	header.m_nGeometryCount = m_nGeometryCount;
+	header.m_nLightCount = m_nLightCount;
+	header.m_nTextureCount = m_nTextureCount;
+	header.m_nMeshCount = m_nMeshCount;
+	header.m_camera = m_camera;
+
+	// The mesh table is written last, once the cache extents are known.
+	std::string tempName = std::string(pszFileName) + ".tmp";
+	FILE *pFile = fopen(tempName.c_str(), "wb");
+	if (pFile == NULL)
+	{
+		return SetError("cannot write", tempName.c_str());
+	}
+
+	std::vector<SceneMeshRecord> meshes(m_nMeshCount);
+	bool bResult = fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+		SceneFile_WriteBlock(pFile, m_pMaterials, m_nMaterialCount * sizeof(SceneMaterialRecord), &header.m_nMaterialOffset) &&
+		SceneFile_WriteBlock(pFile, m_pGeometries, m_nGeometryCount * sizeof(SceneGeometryRecord), &header.m_nGeometryOffset) &&
+		SceneFile_WriteBlock(pFile, m_pLights, m_nLightCount * sizeof(SceneLightRecord), &header.m_nLightOffset) &&
+		SceneFile_WriteBlock(pFile, m_pTextures, m_nTextureCount * sizeof(SceneTextureRecord), &header.m_nTextureOffset);
+
+	int i;
+	for (i = 0; bResult && i < m_nMeshCount; i++)
+	{
+		bResult = SceneFile_Pad(pFile);
+		meshes[i].m_nOffset = (unsigned long long)ftell(pFile);
+		if (bResult && m_mappedFile)
+		{
+			// Recompiling a compiled file copies the caches as they are.
+			bResult = fwrite(m_mappedFile->GetData() + m_pMeshes[i].m_nOffset, 1, (size_t)m_pMeshes[i].m_nSize, pFile) ==
+				m_pMeshes[i].m_nSize;
+		}
+		else if (bResult)
+		{
+			TriangleMesh mesh;
+			bResult = LoadMesh(i, &mesh, nThreadCount) && mesh.WriteCache(pFile);
+		}
+		meshes[i].m_nSize = (unsigned long long)ftell(pFile) - meshes[i].m_nOffset;
+	}
+
+	bResult = bResult &&
+		SceneFile_WriteBlock(pFile, meshes.empty() ? NULL : &meshes[0], m_nMeshCount * sizeof(SceneMeshRecord), &header.m_nMeshOffset);
+	header.m_nFileSize = (unsigned long long)ftell(pFile);
+	bResult = bResult && fseek(pFile, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, pFile) == 1;
+	bResult = ferror(pFile) == 0 && bResult;
+	fclose(pFile);
+
+	if (bResult)
+	{
+		remove(pszFileName);
+		bResult = rename(tempName.c_str(), pszFileName) == 0;
+	}
+	if (!bResult)
+	{
+		remove(tempName.c_str());
+		if (m_error.empty())
+		{
+			SetError("cannot write", pszFileName);
+		}
+	}
+	return bResult;
+}
+
+bool SceneFile::CreateScene(Scene *scene, int nThreadCount)
+{
+	scene->Release();
+	m_nLine = 0;
+
+	scene->CreateCamera<PerspectiveCamera>(m_camera.m_eye, m_camera.m_front, m_camera.m_up, m_camera.m_fov);
+
+	std::vector<Texture *> textures(m_nTextureCount);
+	int i;
+	for (i = 0; i < m_nTextureCount; i++)
+	{
+		const SceneTextureRecord &record = m_pTextures[i];
+		std::string path = ResolvePath(std::string(record.m_szPath, strnlen(record.m_szPath, sizeof(record.m_szPath))));
+		textures[i] = scene->CreateTexture();
+		if (!textures[i]->Load(path.c_str()))
+		{
+			scene->Release();
+			return SetError("cannot load texture", path.c_str());
+		}
+	}
+
+	std::vector<Material *> materials(m_nMaterialCount);
+	for (i = 0; i < m_nMaterialCount; i++)
+	{
+		const SceneMaterialRecord &record = m_pMaterials[i];
+		if (record.m_nType == SCENE_MATERIAL_TEXTURE && (record.m_nTexture < 0 || record.m_nTexture >= m_nTextureCount))
+		{
+			scene->Release();
+			return SetError("corrupt scene file", NULL);
+		}
+
+		if (record.m_nType == SCENE_MATERIAL_CHECKER)
+		{
+			materials[i] = scene->CreateMaterial<CheckerMaterial>(record.m_scale, record.m_reflectiveness);
+		}
+		else if (record.m_nType == SCENE_MATERIAL_TEXTURE)
+		{
+			materials[i] = scene->CreateMaterial<TextureMaterial>(textures[record.m_nTexture], record.m_nProjection,
+				record.m_scale, record.m_reflectiveness);
+		}
+		else
+		{
+			materials[i] = scene->CreateMaterial<PhongMaterial>(record.m_diffuse, record.m_specular,
+				record.m_shininess, record.m_reflectiveness);
+		}
+	}
+
+	// Planes go to the BVH's unbounded list, everything else into the tree.
+	// The mapping has to be in place before meshes point into it.
+	scene->m_mappedFile = m_mappedFile;
+
+	BVH *root = scene->CreateGeometry<BVH>();
+	scene->m_root = root;
+	for (i = 0; i < m_nGeometryCount; i++)
+	{
+		const SceneGeometryRecord &record = m_pGeometries[i];
+		if (record.m_nMaterial < 0 || record.m_nMaterial >= m_nMaterialCount ||
+			(record.m_nType == SCENE_GEOMETRY_MESH && (record.m_nMesh < 0 || record.m_nMesh >= m_nMeshCount)))
+		{
+			scene->Release();
+			return SetError("corrupt scene file", NULL);
+		}
+
+		Geometry *geometry;
+		if (record.m_nType == SCENE_GEOMETRY_SPHERE)
+		{
+			geometry = scene->CreateGeometry<Sphere>(record.m_vector, record.m_fScalar);
+		}
+		else if (record.m_nType == SCENE_GEOMETRY_PLANE)
+		{
+			geometry = scene->CreateGeometry<Plane>(record.m_vector, record.m_fScalar);
+		}
+		else
+		{
+			TriangleMesh *mesh = scene->CreateGeometry<TriangleMesh>();
+			if (!LoadMesh(record.m_nMesh, mesh, nThreadCount))
+			{
+				scene->Release();
+				return false;
+			}
+			geometry = mesh;
+		}
+		geometry->m_material = materials[record.m_nMaterial];
+		root->AddGeometry(geometry);
+	}
+
+	for (i = 0; i < m_nLightCount; i++)
+	{
+		const SceneLightRecord &record = m_pLights[i];
+		Light *light;
+		if (record.m_nType == SCENE_LIGHT_DIRECTIONAL)
+		{
+			light = scene->CreateLight<DirectionalLight>(record.m_color, record.m_direction);
+		}
+		else if (record.m_nType == SCENE_LIGHT_POINT)
+		{
+			light = scene->CreateLight<PointLight>(record.m_color, record.m_position);
+		}
+		else
+		{
+			light = scene->CreateLight<SpotLight>(record.m_color, record.m_position, record.m_direction,
+				record.m_theta, record.m_phi, record.m_falloff);
+		}
+		light->m_shadow = record.m_nShadow != 0;
+	}
+
+	scene->Initialize();
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,159 @@
+#pragma once
+
+// Scene description files. The text form is line based and meant to be
+// edited by hand:
+//
+//   # comment
+//   camera <eye xyz> <front xyz> <up xyz> <fov>
+//   material checker <name> <scale> <reflectiveness>
+//   material phong <name> <diffuse rgb> <specular rgb> <shininess> <reflectiveness>
+//   texture <name> <file.ppm|file.rttex>
+//   material texture <name> <texture> planar|spherical <scale> <reflectiveness>
+//   sphere <center xyz> <radius> <material>
+//   plane <normal xyz> <d> <material>
+//   mesh <file.obj> <material>
+//   light directional <irradiance rgb> <direction xyz> [noshadow]
+//   light point <intensity rgb> <position xyz> [noshadow]
+//   light spot <intensity rgb> <position xyz> <direction xyz> <theta> <phi> <falloff> [noshadow]
+//
+// Paths are relative to the scene file. SaveBinary() compiles a scene into a
+// file that holds the same records as flat arrays plus every mesh as an
+// embedded TriangleMesh cache. Loading it maps the file and turns the section
+// offsets of the header into pointers; records and meshes are then used in
+// place, so nothing is parsed and no mesh is loaded or built. Textures are
+// not embedded: the compiled file keeps their paths as written, relative to
+// the compiled file wherever it is loaded from, and their tiled files are
+// mapped when the scene is created. Compile next to the text file, or ship
+// the textures at the same relative paths.
+
+#define SCENEFILE_VERSION			2
+#define SCENEFILE_MAX_PATH			260
+
+#define SCENE_MATERIAL_CHECKER		0
+#define SCENE_MATERIAL_PHONG		1
+#define SCENE_MATERIAL_TEXTURE		2
+
+#define SCENE_GEOMETRY_SPHERE		0
+#define SCENE_GEOMETRY_PLANE		1
+#define SCENE_GEOMETRY_MESH			2
+
+#define SCENE_LIGHT_DIRECTIONAL		0
+#define SCENE_LIGHT_POINT			1
+#define SCENE_LIGHT_SPOT			2
+
+class SceneCameraRecord
+{
+public:
+	Vector3 m_eye;
+	Vector3 m_front;
+	Vector3 m_up;
+	float m_fov;
+};
+
+class SceneMaterialRecord
+{
+public:
+	int m_nType;
+	float m_reflectiveness;
+	// Checker and texture
+	float m_scale;
+	// Texture
+	int m_nTexture;
+	int m_nProjection;
+	// Phong
+	Color m_diffuse;
+	Color m_specular;
+	float m_shininess;
+};
+
+class SceneGeometryRecord
+{
+public:
+	int m_nType;
+	int m_nMaterial;
+	// Sphere center and radius, plane normal and distance.
+	Vector3 m_vector;
+	float m_fScalar;
+	// Index into the meshes for SCENE_GEOMETRY_MESH.
+	int m_nMesh;
+};
+
+class SceneLightRecord
+{
+public:
+	int m_nType;
+	int m_nShadow;
+	Color m_color;
+	Vector3 m_position;
+	Vector3 m_direction;
+	float m_theta;
+	float m_phi;
+	float m_falloff;
+};
+
+class SceneTextureRecord
+{
+public:
+	char m_szPath[SCENEFILE_MAX_PATH];
+};
+
+// Extent of an embedded mesh cache in a compiled file.
+class SceneMeshRecord
+{
+public:
+	unsigned long long m_nOffset;
+	unsigned long long m_nSize;
+};
+
+class SceneFile
+{
+public:
+	SceneFile();
+	~SceneFile();
+	// Reads either form, telling them apart by the compiled file's magic.
+	bool Load(const char *pszFileName);
+	bool LoadText(const char *pszFileName);
+	bool LoadBinary(const char *pszFileName);
+	bool SaveBinary(const char *pszFileName, int nThreadCount);
+	// Replaces the contents of scene. Scenes built from a compiled file share
+	// its mapping, which stays open until the last of them is released.
+	bool CreateScene(Scene *scene, int nThreadCount);
+	bool IsBinary();
+	const char *GetError();
+	void Release();
+public:
+	SceneCameraRecord m_camera;
+	const SceneMaterialRecord *m_pMaterials;
+	const SceneGeometryRecord *m_pGeometries;
+	const SceneLightRecord *m_pLights;
+	const SceneTextureRecord *m_pTextures;
+	int m_nMaterialCount;
+	int m_nGeometryCount;
+	int m_nLightCount;
+	int m_nTextureCount;
+	int m_nMeshCount;
+private:
+	bool ParseLine(const std::vector<std::string> &tokens);
+	void SetFileName(const char *pszFileName);
+	std::string ResolvePath(const std::string &path);
+	bool SetError(const char *pszMessage, const char *pszDetail);
+	bool LoadMesh(int nMesh, TriangleMesh *mesh, int nThreadCount);
+	void SetViews();
+private:
+	// Text form
+	std::vector<SceneMaterialRecord> m_materials;
+	std::vector<SceneGeometryRecord> m_geometries;
+	std::vector<SceneLightRecord> m_lights;
+	std::vector<SceneTextureRecord> m_textures;
+	std::vector<std::string> m_materialNames;
+	std::vector<std::string> m_textureNames;
+	std::vector<std::string> m_meshPaths;
+	bool m_bHasCamera;
+	// Compiled form
+	std::shared_ptr<MappedFile> m_mappedFile;
+	const SceneMeshRecord *m_pMeshes;
+	std::string m_fileName;
+	std::string m_directory;
+	int m_nLine;
+	std::string m_error;
+};
\ No newline at end of file
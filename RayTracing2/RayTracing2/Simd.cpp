@@ -0,0 +1,334 @@
+#include "Simd.h"
+
+#ifdef RT_SIMD_X86
+
+#ifdef _MSC_VER
+
+static bool Simd_CpuSupports(int nLeaf, int nRegister, int nBit)
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < nLeaf)
+	{
+		return false;
+	}
+	__cpuidex(info, nLeaf, 0);
+	return (info[nRegister] & (1 << nBit)) != 0;
+}
+
+static int Simd_DetectWidth()
+{
+	// OSXSAVE and the OS must save the YMM (and for AVX-512 the ZMM) state.
+	if (!Simd_CpuSupports(1, 2, 27))
+	{
+		return SIMD_WIDTH_SSE;
+	}
+	unsigned long long xcr0 = _xgetbv(0);
+	bool bAVX2 = (xcr0 & 0x6) == 0x6 && Simd_CpuSupports(7, 1, 5);
+	bool bAVX512 = (xcr0 & 0xE6) == 0xE6 && Simd_CpuSupports(7, 1, 16);
+	if (bAVX512)
+	{
+		return SIMD_WIDTH_AVX512;
+	}
+	return bAVX2 ? SIMD_WIDTH_AVX2 : SIMD_WIDTH_SSE;
+}
+
+#else
+
+static int Simd_DetectWidth()
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return SIMD_WIDTH_AVX512;
+	}
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return SIMD_WIDTH_AVX2;
+	}
+	return SIMD_WIDTH_SSE;
+}
+
+#endif
+
+#else
+
+static int Simd_DetectWidth()
+{
+	return SIMD_WIDTH_SCALAR;
+}
+
+#endif
+
+static int Simd_ResolveWidth()
+{
+	int nWidth = Simd_DetectWidth();
+
+	// RT_SIMD_WIDTH forces a narrower path for testing, never a wider one.
+	const char *pszOverride = getenv("RT_SIMD_WIDTH");
+	if (pszOverride)
+	{
+		int nOverride = atoi(pszOverride);
+		if (nOverride == SIMD_WIDTH_SCALAR || nOverride == SIMD_WIDTH_SSE ||
+			nOverride == SIMD_WIDTH_AVX2 || nOverride == SIMD_WIDTH_AVX512)
+		{
+			nWidth = MIN_(nWidth, nOverride);
+		}
+	}
+	return nWidth;
+}
+
+int Simd_GetNativeWidth()
+{
+	static int s_nWidth = Simd_ResolveWidth();
+	return s_nWidth;
+}
+
+const char *Simd_GetWidthName(int nWidth)
+{
+	switch (nWidth)
+	{
+	case SIMD_WIDTH_SSE:
+		return "SSE";
+	case SIMD_WIDTH_AVX2:
+		return "AVX2";
+	case SIMD_WIDTH_AVX512:
+		return "AVX-512";
+	default:
+		return "scalar";
+	}
+}
+
+void *Simd_AlignedAlloc(size_t nSize)
+{
+#ifdef _MSC_VER
+	return _aligned_malloc(nSize, SIMD_ALIGNMENT);
+#else
+	void *p = NULL;
+	if (posix_memalign(&p, SIMD_ALIGNMENT, nSize) != 0)
+	{
+		return NULL;
+	}
+	return p;
+#endif
+}
+
+void Simd_AlignedFree(void *p)
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+#ifdef RT_SIMD_X86
+
+// Every instruction set gets its own namespace with a vfloat/vmask wrapper and
+// a copy of the kernel files. GCC and Clang compile each copy for its
+// target through pragmas, so the binary needs no -mavx flags and picks the
+// kernels at run time. Contraction into FMA is disabled so the lanes round
+// exactly like the scalar code.
+
+#if defined(__clang__)
+#define RT_SIMD_PRAGMA(x)				_Pragma(#x)
+#define RT_SIMD_TARGET_BEGIN(isa)	RT_SIMD_PRAGMA(clang attribute push (__attribute__((target(isa))), apply_to = function))
+#define RT_SIMD_TARGET_END()			RT_SIMD_PRAGMA(clang attribute pop)
+#elif defined(__GNUC__)
+#define RT_SIMD_PRAGMA(x)				_Pragma(#x)
+#define RT_SIMD_TARGET_BEGIN(isa)	RT_SIMD_PRAGMA(GCC push_options) RT_SIMD_PRAGMA(GCC target(isa)) RT_SIMD_PRAGMA(GCC optimize("fp-contract=off"))
+#define RT_SIMD_TARGET_END()			RT_SIMD_PRAGMA(GCC pop_options)
+// GCC 12's avx512fintrin.h trips -Wmaybe-uninitialized on its own undefined placeholders.
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#else
+#define RT_SIMD_TARGET_BEGIN(isa)
+#define RT_SIMD_TARGET_END()
+#endif
+
+RT_SIMD_TARGET_BEGIN("sse2")
+namespace SimdSSE
+{
+	#define SIMD_LANES		4
+	#define SIMD_LANE_MASK	0xFu
+
+	struct vfloat { __m128 v; };
+	struct vmask { __m128 m; };
+
+	static inline vfloat Load(const float *p) { vfloat r = { _mm_load_ps(p) }; return r; }
+	static inline vfloat LoadInt(const int *p) { vfloat r = { _mm_cvtepi32_ps(_mm_load_si128((const __m128i *)p)) }; return r; }
+	static inline vfloat LoadU(const float *p) { vfloat r = { _mm_loadu_ps(p) }; return r; }
+	static inline void Store(float *p, vfloat a) { _mm_store_ps(p, a.v); }
+	static inline void StoreTruncInt(int *p, vfloat a) { _mm_store_si128((__m128i *)p, _mm_cvttps_epi32(a.v)); }
+	static inline vfloat Set1(float f) { vfloat r = { _mm_set1_ps(f) }; return r; }
+	static inline vfloat operator+(vfloat a, vfloat b) { vfloat r = { _mm_add_ps(a.v, b.v) }; return r; }
+	static inline vfloat operator-(vfloat a, vfloat b) { vfloat r = { _mm_sub_ps(a.v, b.v) }; return r; }
+	static inline vfloat operator*(vfloat a, vfloat b) { vfloat r = { _mm_mul_ps(a.v, b.v) }; return r; }
+	static inline vfloat operator/(vfloat a, vfloat b) { vfloat r = { _mm_div_ps(a.v, b.v) }; return r; }
+	static inline vfloat Negate(vfloat a) { vfloat r = { _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)) }; return r; }
+	static inline vfloat Sqrt(vfloat a) { vfloat r = { _mm_sqrt_ps(a.v) }; return r; }
+	static inline vmask CmpLT(vfloat a, vfloat b) { vmask r = { _mm_cmplt_ps(a.v, b.v) }; return r; }
+	static inline vmask CmpLE(vfloat a, vfloat b) { vmask r = { _mm_cmple_ps(a.v, b.v) }; return r; }
+	static inline vmask CmpGE(vfloat a, vfloat b) { vmask r = { _mm_cmpge_ps(a.v, b.v) }; return r; }
+	static inline vmask operator&(vmask a, vmask b) { vmask r = { _mm_and_ps(a.m, b.m) }; return r; }
+	static inline unsigned int ToBits(vmask a) { return (unsigned int)_mm_movemask_ps(a.m); }
+	static inline vmask CmpEQ(vfloat a, vfloat b) { vmask r = { _mm_cmpeq_ps(a.v, b.v) }; return r; }
+	static inline vfloat Min(vfloat a, vfloat b) { vfloat r = { _mm_min_ps(a.v, b.v) }; return r; }
+	static inline vfloat Max(vfloat a, vfloat b) { vfloat r = { _mm_max_ps(a.v, b.v) }; return r; }
+	static inline vfloat Select(vmask m, vfloat a, vfloat b) { vfloat r = { _mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v)) }; return r; }
+	static inline float HMin(vfloat a)
+	{
+		__m128 m = _mm_min_ps(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1, 0, 3, 2)));
+		m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(m);
+	}
+
+	#include "RayPacketKernels.inl"
+
+	#include "SphereSetKernels.inl"
+
+	#include "ResolveKernels.inl"
+
+	#undef SIMD_LANES
+	#undef SIMD_LANE_MASK
+}
+RT_SIMD_TARGET_END()
+
+RT_SIMD_TARGET_BEGIN("avx2")
+namespace SimdAVX2
+{
+	#define SIMD_LANES		8
+	#define SIMD_LANE_MASK	0xFFu
+
+	struct vfloat { __m256 v; };
+	struct vmask { __m256 m; };
+
+	static inline vfloat Load(const float *p) { vfloat r = { _mm256_load_ps(p) }; return r; }
+	static inline vfloat LoadInt(const int *p) { vfloat r = { _mm256_cvtepi32_ps(_mm256_load_si256((const __m256i *)p)) }; return r; }
+	static inline vfloat LoadU(const float *p) { vfloat r = { _mm256_loadu_ps(p) }; return r; }
+	static inline void Store(float *p, vfloat a) { _mm256_store_ps(p, a.v); }
+	static inline void StoreTruncInt(int *p, vfloat a) { _mm256_store_si256((__m256i *)p, _mm256_cvttps_epi32(a.v)); }
+	static inline vfloat Set1(float f) { vfloat r = { _mm256_set1_ps(f) }; return r; }
+	static inline vfloat operator+(vfloat a, vfloat b) { vfloat r = { _mm256_add_ps(a.v, b.v) }; return r; }
+	static inline vfloat operator-(vfloat a, vfloat b) { vfloat r = { _mm256_sub_ps(a.v, b.v) }; return r; }
+	static inline vfloat operator*(vfloat a, vfloat b) { vfloat r = { _mm256_mul_ps(a.v, b.v) }; return r; }
+	static inline vfloat operator/(vfloat a, vfloat b) { vfloat r = { _mm256_div_ps(a.v, b.v) }; return r; }
+	static inline vfloat Negate(vfloat a) { vfloat r = { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)) }; return r; }
+	static inline vfloat Sqrt(vfloat a) { vfloat r = { _mm256_sqrt_ps(a.v) }; return r; }
+	static inline vmask CmpLT(vfloat a, vfloat b) { vmask r = { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; return r; }
+	static inline vmask CmpLE(vfloat a, vfloat b) { vmask r = { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; return r; }
+	static inline vmask CmpGE(vfloat a, vfloat b) { vmask r = { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; return r; }
+	static inline vmask operator&(vmask a, vmask b) { vmask r = { _mm256_and_ps(a.m, b.m) }; return r; }
+	static inline unsigned int ToBits(vmask a) { return (unsigned int)_mm256_movemask_ps(a.m); }
+	static inline vmask CmpEQ(vfloat a, vfloat b) { vmask r = { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; return r; }
+	static inline vfloat Min(vfloat a, vfloat b) { vfloat r = { _mm256_min_ps(a.v, b.v) }; return r; }
+	static inline vfloat Max(vfloat a, vfloat b) { vfloat r = { _mm256_max_ps(a.v, b.v) }; return r; }
+	static inline vfloat Select(vmask m, vfloat a, vfloat b) { vfloat r = { _mm256_blendv_ps(b.v, a.v, m.m) }; return r; }
+	static inline float HMin(vfloat a)
+	{
+		__m128 m = _mm_min_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+		m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+		m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(m);
+	}
+
+	#include "RayPacketKernels.inl"
+
+	#include "SphereSetKernels.inl"
+
+	#include "ResolveKernels.inl"
+
+	#undef SIMD_LANES
+	#undef SIMD_LANE_MASK
+}
+RT_SIMD_TARGET_END()
+
+RT_SIMD_TARGET_BEGIN("avx512f")
+namespace SimdAVX512
+{
+	#define SIMD_LANES		16
+	#define SIMD_LANE_MASK	0xFFFFu
+
+	struct vfloat { __m512 v; };
+	struct vmask { __mmask16 m; };
+
+	static inline vfloat Load(const float *p) { vfloat r = { _mm512_load_ps(p) }; return r; }
+	static inline vfloat LoadInt(const int *p) { vfloat r = { _mm512_cvtepi32_ps(_mm512_load_si512((const void *)p)) }; return r; }
+	static inline vfloat LoadU(const float *p) { vfloat r = { _mm512_loadu_ps(p) }; return r; }
+	static inline void Store(float *p, vfloat a) { _mm512_store_ps(p, a.v); }
+	static inline void StoreTruncInt(int *p, vfloat a) { _mm512_store_si512((void *)p, _mm512_cvttps_epi32(a.v)); }
+	static inline vfloat Set1(float f) { vfloat r = { _mm512_set1_ps(f) }; return r; }
+	static inline vfloat operator+(vfloat a, vfloat b) { vfloat r = { _mm512_add_ps(a.v, b.v) }; return r; }
+	static inline vfloat operator-(vfloat a, vfloat b) { vfloat r = { _mm512_sub_ps(a.v, b.v) }; return r; }
+	static inline vfloat operator*(vfloat a, vfloat b) { vfloat r = { _mm512_mul_ps(a.v, b.v) }; return r; }
+	static inline vfloat operator/(vfloat a, vfloat b) { vfloat r = { _mm512_div_ps(a.v, b.v) }; return r; }
+	static inline vfloat Negate(vfloat a) { vfloat r = { _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a.v), _mm512_set1_epi32((int)0x80000000))) }; return r; }
+	static inline vfloat Sqrt(vfloat a) { vfloat r = { _mm512_sqrt_ps(a.v) }; return r; }
+	static inline vmask CmpLT(vfloat a, vfloat b) { vmask r = { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ) }; return r; }
+	static inline vmask CmpLE(vfloat a, vfloat b) { vmask r = { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ) }; return r; }
+	static inline vmask CmpGE(vfloat a, vfloat b) { vmask r = { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ) }; return r; }
+	static inline vmask operator&(vmask a, vmask b) { vmask r = { (__mmask16)(a.m & b.m) }; return r; }
+	static inline unsigned int ToBits(vmask a) { return (unsigned int)a.m; }
+	static inline vmask CmpEQ(vfloat a, vfloat b) { vmask r = { _mm512_cmp_ps_mask(a.v, b.v, _CMP_EQ_OQ) }; return r; }
+	static inline vfloat Min(vfloat a, vfloat b) { vfloat r = { _mm512_min_ps(a.v, b.v) }; return r; }
+	static inline vfloat Max(vfloat a, vfloat b) { vfloat r = { _mm512_max_ps(a.v, b.v) }; return r; }
+	static inline vfloat Select(vmask m, vfloat a, vfloat b) { vfloat r = { _mm512_mask_blend_ps(m.m, b.v, a.v) }; return r; }
+	static inline float HMin(vfloat a) { return _mm512_reduce_min_ps(a.v); }
+
+	#include "RayPacketKernels.inl"
+
+	#include "SphereSetKernels.inl"
+
+	#include "ResolveKernels.inl"
+
+	#undef SIMD_LANES
+	#undef SIMD_LANE_MASK
+}
+RT_SIMD_TARGET_END()
+
+static const SimdKernels s_kernelsSSE =
+{
+	SIMD_WIDTH_SSE, SimdSSE::GeneratePrimary, SimdSSE::IntersectSphere, SimdSSE::IntersectPlane,
+	SimdSSE::OccludedSphere, SimdSSE::OccludedPlane,
+	SimdSSE::IntersectSphereSet, SimdSSE::OccludedSphereSet,
+	SimdSSE::ResolveRow
+};
+
+static const SimdKernels s_kernelsAVX2 =
+{
+	SIMD_WIDTH_AVX2, SimdAVX2::GeneratePrimary, SimdAVX2::IntersectSphere, SimdAVX2::IntersectPlane,
+	SimdAVX2::OccludedSphere, SimdAVX2::OccludedPlane,
+	SimdAVX2::IntersectSphereSet, SimdAVX2::OccludedSphereSet,
+	SimdAVX2::ResolveRow
+};
+
+static const SimdKernels s_kernelsAVX512 =
+{
+	SIMD_WIDTH_AVX512, SimdAVX512::GeneratePrimary, SimdAVX512::IntersectSphere, SimdAVX512::IntersectPlane,
+	SimdAVX512::OccludedSphere, SimdAVX512::OccludedPlane,
+	SimdAVX512::IntersectSphereSet, SimdAVX512::OccludedSphereSet,
+	SimdAVX512::ResolveRow
+};
+
+const SimdKernels *Simd_GetKernels()
+{
+	switch (Simd_GetNativeWidth())
+	{
+	case SIMD_WIDTH_AVX512:
+		return &s_kernelsAVX512;
+	case SIMD_WIDTH_AVX2:
+		return &s_kernelsAVX2;
+	case SIMD_WIDTH_SSE:
+		return &s_kernelsSSE;
+	default:
+		return NULL;
+	}
+}
+
+#else
+
+const SimdKernels *Simd_GetKernels()
+{
+	return NULL;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+// Runtime selection of the widest SIMD instruction set the CPU supports.
+// Kernels for every width are compiled into the same binary; x86 builds
+// without AVX flags enable the wider sets per function (see Simd.cpp).
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RT_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#define SIMD_WIDTH_SCALAR	1
+#define SIMD_WIDTH_SSE		4
+#define SIMD_WIDTH_AVX2		8
+#define SIMD_WIDTH_AVX512	16
+
+#define SIMD_MAX_WIDTH		16
+
+class Vector3;
+class Ray3;
+class Geometry;
+class PerspectiveCamera;
+class RayPacket;
+class ResolveSettings;
+
+// Kernels compiled for one instruction set. RayPacketKernels.inl holds the
+// packet kernels, SphereSetKernels.inl the one-ray-many-spheres kernels and
+// ResolveKernels.inl the HDR to ARGB8 resolve.
+class SimdKernels
+{
+public:
+	int m_nWidth;
+	void (*m_pfnGeneratePrimary)(PerspectiveCamera *camera, RayPacket *packet, float fWidth, float fHeight);
+	void (*m_pfnIntersectSphere)(RayPacket *packet, const Vector3 &center, float sqrRadius, Geometry *geometry);
+	void (*m_pfnIntersectPlane)(RayPacket *packet, const Vector3 &normal, const Vector3 &position, Geometry *geometry);
+	void (*m_pfnOccludedSphere)(RayPacket *packet, const Vector3 &center, float sqrRadius, float tMin);
+	void (*m_pfnOccludedPlane)(RayPacket *packet, const Vector3 &normal, const Vector3 &position, float tMin);
+	int (*m_pfnIntersectSphereSet)(const float *pCenterX, const float *pCenterY, const float *pCenterZ,
+		const float *pSqrRadius, int nCount, Ray3 *ray, float *pDistance);
+	bool (*m_pfnOccludedSphereSet)(const float *pCenterX, const float *pCenterY, const float *pCenterZ,
+		const float *pSqrRadius, int nCount, Ray3 *ray, float tMin, float tMax);
+	void (*m_pfnResolveRow)(const float *pSrc, int nCount, const ResolveSettings *settings,
+		const unsigned char *pSRGBTable, unsigned int *pDst);
+};
+
+int Simd_GetNativeWidth();
+const char *Simd_GetWidthName(int nWidth);
+
+// Returns the kernels for the native SIMD width, or NULL when the CPU has no
+// supported instruction set.
+const SimdKernels *Simd_GetKernels();
+
+void *Simd_AlignedAlloc(size_t nSize);
+void Simd_AlignedFree(void *p);
+
+#define SIMD_ALIGNMENT		64
\ No newline at end of file
@@ -20,7 +20,7 @@ void CreateConsole()
 HINSTANCE hInst;
 
 ATOM				MyRegisterClass(HINSTANCE hInstance);
-BOOL				InitInstance(HINSTANCE, int);
+BOOL				InitInstance(HINSTANCE, int, CSoft3DEngine *);
 LRESULT CALLBACK	WndProc(HWND, UINT, WPARAM, LPARAM);
 
 int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
@@ -29,9 +29,18 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 
 	MSG msg;
 
+	// The window keeps a pointer to the engine in its user data.
+	CSoft3DEngine engine;
+
+	// The command line names an optional scene file.
+	if (lpCmdLine && lpCmdLine[0])
+	{
+		engine.SetSceneFile(lpCmdLine);
+	}
+
 	MyRegisterClass(hInstance);
 
-	if (!InitInstance (hInstance, nCmdShow))
+	if (!InitInstance (hInstance, nCmdShow, &engine))
 	{
 		return FALSE;
 	}
@@ -91,7 +100,7 @@ ATOM MyRegisterClass(HINSTANCE hInstance)
 //        ڴ˺Уȫֱбʵ
 //        ʾ򴰿ڡ
 //
-BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
+BOOL InitInstance(HINSTANCE hInstance, int nCmdShow, CSoft3DEngine *engine)
 {
    HWND hWnd;
 
@@ -105,7 +114,8 @@ BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
       return FALSE;
    }
 
-   CSoft3DEngine_GetInstance()->Initilize(hWnd);
+   SetWindowLongPtr(hWnd, GWLP_USERDATA, (LONG_PTR)engine);
+   engine->Initilize(hWnd);
 
    ShowWindow(hWnd, nCmdShow);
    UpdateWindow(hWnd);
@@ -127,17 +137,35 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
 	PAINTSTRUCT ps;
 	HDC hdc;
+	CSoft3DEngine *engine = (CSoft3DEngine *)GetWindowLongPtr(hWnd, GWLP_USERDATA);
 
 	switch (message)
 	{
 	case WM_COMMAND:
 		break;
 	case WM_PAINT:
-		CSoft3DEngine_GetInstance()->RenderScene();
 		hdc = BeginPaint(hWnd, &ps);
-		CSoft3DEngine_GetInstance()->Draw(hdc);
+		if (engine)
+		{
+			engine->RenderScene();
+			engine->Draw(hdc);
+		}
 		EndPaint(hWnd, &ps);
 		break;
+	case WM_KEYDOWN:
+		if (engine)
+		{
+			// Arrow keys turn left and right and move forward and back.
+			if (wParam == VK_LEFT || wParam == VK_RIGHT)
+			{
+				engine->MoveCamera(wParam == VK_LEFT ? 5.0f : -5.0f, 0.0f);
+			}
+			else if (wParam == VK_UP || wParam == VK_DOWN)
+			{
+				engine->MoveCamera(0.0f, wParam == VK_UP ? 2.0f : -2.0f);
+			}
+		}
+		break;
 	case WM_ERASEBKGND:
 		break;
 	case WM_DESTROY:
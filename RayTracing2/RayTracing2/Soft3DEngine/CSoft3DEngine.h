@@ -8,24 +8,20 @@ public:
 	void Draw(HDC hDC);
 public:
 	void CreateFrameBuffer();
-	inline void SetPixel(int nX, int nY, unsigned int dwColor);
-	void Clear(unsigned int dwColor);
-	Color RayTraceRecursive(Geometry *scene, Ray3 *ray, int maxReflect);
 	void RenderScene();
+	void SetThreadCount(int nThreadCount);
+	void SetTileSize(int nTileSize);
+	void SetSceneFile(const char *pszFileName);
+	void MoveCamera(float fTurnDegrees, float fDistance);
 private:
 	HWND m_hWnd;
-	int m_nWidth;
-	int m_nHeight;
-	int m_nStride;
-	int m_nShiftX;
-	int m_nShiftY;
-	BYTE *m_pPixels;
+	FrameBuffer m_frameBuffer;
 	Gdiplus::Bitmap *m_pBitmap;
-	PerspectiveCamera *m_camera;
-	Plane *m_plane;
-	Sphere *m_sphere1;
-	Geometry *m_scene;
-	std::vector<Light *> m_vecLightList;
-};
-
-CSoft3DEngine *CSoft3DEngine_GetInstance();
\ No newline at end of file
+	Scene m_scene;
+	RenderOptions m_renderOptions;
+	unsigned int m_nSubmittedVersion;
+	bool m_bSubmitted;
+	std::string m_sceneFileName;
+	// Last, so jobs end before the scene and frame buffer go away.
+	AsyncRenderer m_asyncRenderer;
+};
\ No newline at end of file
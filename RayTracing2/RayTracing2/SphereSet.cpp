@@ -0,0 +1,262 @@
+#include "SphereSet.h"
+
+static int SphereSet_IntersectScalar(const float *pCenterX, const float *pCenterY, const float *pCenterZ,
+	const float *pSqrRadius, int nCount, Ray3 *ray, float *pDistance)
+{
+	int nNearest = -1;
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		Vector3 v = ray->m_origin.Subtract(Vector3(pCenterX[i], pCenterY[i], pCenterZ[i]));
+		float a0 = v.SqrLength() - pSqrRadius[i];
+		float DdotV = ray->m_direction.Dot(v);
+		if (DdotV <= 0.0f)
+		{
+			float discr = DdotV * DdotV - a0;
+			if (discr >= 0.0f)
+			{
+				float t = -DdotV - sqrtf(discr);
+				if (t < *pDistance)
+				{
+					*pDistance = t;
+					nNearest = i;
+				}
+			}
+		}
+	}
+	return nNearest;
+}
+
+static bool SphereSet_OccludedScalar(const float *pCenterX, const float *pCenterY, const float *pCenterZ,
+	const float *pSqrRadius, int nCount, Ray3 *ray, float tMin, float tMax)
+{
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		Vector3 v = ray->m_origin.Subtract(Vector3(pCenterX[i], pCenterY[i], pCenterZ[i]));
+		float a0 = v.SqrLength() - pSqrRadius[i];
+		float DdotV = ray->m_direction.Dot(v);
+		if (DdotV <= 0.0f)
+		{
+			float discr = DdotV * DdotV - a0;
+			if (discr >= 0.0f)
+			{
+				float t = -DdotV - sqrtf(discr);
+				if (t >= tMin && t <= tMax)
+				{
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+SphereSet::SphereSet()
+{
+	m_pCenterX = NULL;
+	m_pCenterY = NULL;
+	m_pCenterZ = NULL;
+	m_pSqrRadius = NULL;
+	m_pMaterialIndex = NULL;
+	m_nSlotCount = 0;
+	m_nLaneWidth = 1;
+	m_pKernels = NULL;
+}
+
+SphereSet::~SphereSet()
+{
+	ReleaseArrays();
+}
+
+void SphereSet::ReleaseArrays()
+{
+	Simd_AlignedFree(m_pCenterX);
+	Simd_AlignedFree(m_pCenterY);
+	Simd_AlignedFree(m_pCenterZ);
+	Simd_AlignedFree(m_pSqrRadius);
+	Simd_AlignedFree(m_pMaterialIndex);
+	m_pCenterX = NULL;
+	m_pCenterY = NULL;
+	m_pCenterZ = NULL;
+	m_pSqrRadius = NULL;
+	m_pMaterialIndex = NULL;
+	m_nSlotCount = 0;
+}
+
+int SphereSet::AddMaterial(Material *material)
+{
+	m_materials.push_back(material);
+	return m_materials.size() - 1;
+}
+
+int SphereSet::AddSphere(const Vector3 &center, float radius, int nMaterial)
+{
+	m_centers.push_back(center);
+	m_radii.push_back(radius);
+	m_materialIndices.push_back(nMaterial);
+	return m_centers.size() - 1;
+}
+
+int SphereSet::GetSphereCount()
+{
+	return m_centers.size();
+}
+
+void SphereSet::Initialize()
+{
+	ReleaseArrays();
+	m_nodes.clear();
+
+	m_pKernels = Simd_GetKernels();
+	m_nLaneWidth = m_pKernels ? m_pKernels->m_nWidth : 1;
+
+	int nCount = m_centers.size();
+	std::vector<AABB> bounds(nCount);
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		Vector3 extent(m_radii[i], m_radii[i], m_radii[i]);
+		bounds[i] = AABB(m_centers[i].Subtract(extent), m_centers[i].Add(extent));
+	}
+
+	// A leaf costs one SIMD test per m_nLaneWidth spheres.
+	BVHBuilder builder;
+	builder.m_nMaxLeafSize = SPHERESET_MAX_LEAF_SIZE;
+	builder.m_fIntersectCost = 1.0f / m_nLaneWidth;
+	std::vector<int> order;
+	builder.Build(bounds, &m_nodes, &order);
+
+	int nNodeCount = m_nodes.size();
+	int nSlotCount = 0;
+	for (i = 0; i < nNodeCount; i++)
+	{
+		if (m_nodes[i].m_nCount > 0)
+		{
+			nSlotCount += (m_nodes[i].m_nCount + m_nLaneWidth - 1) / m_nLaneWidth * m_nLaneWidth;
+		}
+	}
+	if (nSlotCount == 0)
+	{
+		return;
+	}
+
+	m_pCenterX = (float *)Simd_AlignedAlloc(nSlotCount * sizeof(float));
+	m_pCenterY = (float *)Simd_AlignedAlloc(nSlotCount * sizeof(float));
+	m_pCenterZ = (float *)Simd_AlignedAlloc(nSlotCount * sizeof(float));
+	m_pSqrRadius = (float *)Simd_AlignedAlloc(nSlotCount * sizeof(float));
+	m_pMaterialIndex = (int *)Simd_AlignedAlloc(nSlotCount * sizeof(int));
+	m_nSlotCount = nSlotCount;
+
+	// Lay the leaves out one after another, each starting on a lane boundary.
+	// Padding slots get NaN centers so no compare ever reports them as hits.
+	float fNaN = sqrtf(-1.0f);
+	int nSlot = 0;
+	for (i = 0; i < nNodeCount; i++)
+	{
+		BVHNode &node = m_nodes[i];
+		if (node.m_nCount == 0)
+		{
+			continue;
+		}
+
+		int nPadded = (node.m_nCount + m_nLaneWidth - 1) / m_nLaneWidth * m_nLaneWidth;
+		int j;
+		for (j = 0; j < nPadded; j++)
+		{
+			if (j < node.m_nCount)
+			{
+				int nSphere = order[node.m_nOffset + j];
+				m_pCenterX[nSlot + j] = m_centers[nSphere].m_x;
+				m_pCenterY[nSlot + j] = m_centers[nSphere].m_y;
+				m_pCenterZ[nSlot + j] = m_centers[nSphere].m_z;
+				m_pSqrRadius[nSlot + j] = m_radii[nSphere] * m_radii[nSphere];
+				m_pMaterialIndex[nSlot + j] = m_materialIndices[nSphere];
+			}
+			else
+			{
+				m_pCenterX[nSlot + j] = fNaN;
+				m_pCenterY[nSlot + j] = fNaN;
+				m_pCenterZ[nSlot + j] = fNaN;
+				m_pSqrRadius[nSlot + j] = 0.0f;
+				m_pMaterialIndex[nSlot + j] = -1;
+			}
+		}
+		node.m_nOffset = nSlot;
+		node.m_nCount = (unsigned short)nPadded;
+		nSlot += nPadded;
+	}
+}
+
+bool SphereSet::Intersect(Ray3 *ray, IntersectResult *intersectResult)
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	int (*pfnIntersect)(const float *, const float *, const float *, const float *, int, Ray3 *, float *) =
+		m_pKernels ? m_pKernels->m_pfnIntersectSphereSet : SphereSet_IntersectScalar;
+
+	int nNearest = -1;
+	BVH_Traverse(&m_nodes[0], ray, 0.0f, &intersectResult->m_distance, [&](int nOffset, int nCount)
+	{
+		RT_STAT_ADD(STAT_SPHERE_TESTS, nCount);
+		int nHit = pfnIntersect(m_pCenterX + nOffset, m_pCenterY + nOffset, m_pCenterZ + nOffset,
+			m_pSqrRadius + nOffset, nCount, ray, &intersectResult->m_distance);
+		if (nHit >= 0)
+		{
+			nNearest = nOffset + nHit;
+		}
+		return false;
+	});
+
+	if (nNearest < 0)
+	{
+		return false;
+	}
+
+	intersectResult->m_geometry = this;
+	intersectResult->m_nPrimitive = nNearest;
+	return true;
+}
+
+void SphereSet::ComputeSurfaceInteraction(Ray3 *ray, IntersectResult *intersectResult)
+{
+	int nSlot = intersectResult->m_nPrimitive;
+	Vector3 center(m_pCenterX[nSlot], m_pCenterY[nSlot], m_pCenterZ[nSlot]);
+	intersectResult->m_material = m_materials[m_pMaterialIndex[nSlot]];
+	intersectResult->m_position = ray->GetPoint(intersectResult->m_distance);
+	intersectResult->m_normal = intersectResult->m_position.Subtract(center).Normalize();
+}
+
+bool SphereSet::Occluded(Ray3 *ray, float tMin, float tMax)
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	bool (*pfnOccluded)(const float *, const float *, const float *, const float *, int, Ray3 *, float, float) =
+		m_pKernels ? m_pKernels->m_pfnOccludedSphereSet : SphereSet_OccludedScalar;
+
+	return BVH_Traverse(&m_nodes[0], ray, tMin, &tMax, [&](int nOffset, int nCount)
+	{
+		RT_STAT_ADD(STAT_SPHERE_TESTS, nCount);
+		return pfnOccluded(m_pCenterX + nOffset, m_pCenterY + nOffset, m_pCenterZ + nOffset,
+			m_pSqrRadius + nOffset, nCount, ray, tMin, tMax);
+	});
+}
+
+bool SphereSet::GetBounds(AABB *bounds)
+{
+	if (m_nodes.empty())
+	{
+		bounds->Reset();
+	}
+	else
+	{
+		*bounds = m_nodes[0].m_bounds;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+// Many spheres in one geometry. Centers, squared radii and material indices
+// live in aligned structure-of-arrays storage, reordered into the leaves of
+// an internal BVH and padded to the SIMD width, so a leaf is tested with one
+// ray against 4, 8 or 16 spheres per instruction. Only the nearest sphere of
+// a query gets its position and normal computed, from the same slot arrays
+// the intersection test read.
+
+#define SPHERESET_MAX_LEAF_SIZE	16
+
+class SphereSet : public Geometry
+{
+public:
+	SphereSet();
+	~SphereSet();
+	int AddMaterial(Material *material);
+	int AddSphere(const Vector3 &center, float radius, int nMaterial);
+	int GetSphereCount();
+	void Initialize() override;
+	bool Intersect(Ray3 *ray, IntersectResult *intersectResult) override;
+	void ComputeSurfaceInteraction(Ray3 *ray, IntersectResult *intersectResult) override;
+	bool Occluded(Ray3 *ray, float tMin, float tMax) override;
+	bool GetBounds(AABB *bounds) override;
+public:
+	// Spheres in insertion order, copied into the slot arrays by
+	// Initialize(). m_nPrimitive of a hit is the sphere's slot, not its index
+	// here.
+	std::vector<Vector3> m_centers;
+	std::vector<float> m_radii;
+	std::vector<int> m_materialIndices;
+	std::vector<Material *> m_materials;
+private:
+	void ReleaseArrays();
+	std::vector<BVHNode> m_nodes;
+	float *m_pCenterX;
+	float *m_pCenterY;
+	float *m_pCenterZ;
+	float *m_pSqrRadius;
+	int *m_pMaterialIndex;
+	int m_nSlotCount;
+	int m_nLaneWidth;
+	const SimdKernels *m_pKernels;
+};
\ No newline at end of file
@@ -0,0 +1,90 @@
+// One ray against a run of spheres stored as structure of arrays, compiled for
+// every instruction set by Simd.cpp. nCount is a multiple of SIMD_LANES and the
+// arrays are SIMD_ALIGNMENT aligned; padding lanes hold NaN centers, which fail
+// every ordered compare. The per-lane arithmetic matches Sphere::Intersect.
+
+static int IntersectSphereSet(const float *pCenterX, const float *pCenterY, const float *pCenterZ,
+	const float *pSqrRadius, int nCount, Ray3 *ray, float *pDistance)
+{
+	vfloat zero = Set1(0.0f);
+	vfloat noHit = Set1(FLT_MAX);
+	vfloat ox = Set1(ray->m_origin.m_x);
+	vfloat oy = Set1(ray->m_origin.m_y);
+	vfloat oz = Set1(ray->m_origin.m_z);
+	vfloat dx = Set1(ray->m_direction.m_x);
+	vfloat dy = Set1(ray->m_direction.m_y);
+	vfloat dz = Set1(ray->m_direction.m_z);
+
+	float fMinDistance = *pDistance;
+	int nNearest = -1;
+
+	int nBase;
+	for (nBase = 0; nBase < nCount; nBase += SIMD_LANES)
+	{
+		vfloat vx = ox - Load(pCenterX + nBase);
+		vfloat vy = oy - Load(pCenterY + nBase);
+		vfloat vz = oz - Load(pCenterZ + nBase);
+
+		vfloat a0 = (vx * vx + vy * vy + vz * vz) - Load(pSqrRadius + nBase);
+		vfloat DdotV = dx * vx + dy * vy + dz * vz;
+		vfloat discr = DdotV * DdotV - a0;
+		vfloat t = Negate(DdotV) - Sqrt(discr);
+
+		vmask hit = CmpLE(DdotV, zero) & CmpGE(discr, zero) & CmpLT(t, Set1(fMinDistance));
+		if (ToBits(hit) == 0)
+		{
+			continue;
+		}
+
+		// Reduce to the nearest lane; ties go to the lowest index like Union.
+		vfloat tHit = Select(hit, t, noHit);
+		float fBlockMin = HMin(tHit);
+		unsigned int nLanes = ToBits(CmpEQ(tHit, Set1(fBlockMin)));
+		int nLane = 0;
+		while ((nLanes & 1) == 0)
+		{
+			nLanes >>= 1;
+			nLane++;
+		}
+		fMinDistance = fBlockMin;
+		nNearest = nBase + nLane;
+	}
+
+	*pDistance = fMinDistance;
+	return nNearest;
+}
+
+static bool OccludedSphereSet(const float *pCenterX, const float *pCenterY, const float *pCenterZ,
+	const float *pSqrRadius, int nCount, Ray3 *ray, float tMin, float tMax)
+{
+	vfloat zero = Set1(0.0f);
+	vfloat vMin = Set1(tMin);
+	vfloat vMax = Set1(tMax);
+	vfloat ox = Set1(ray->m_origin.m_x);
+	vfloat oy = Set1(ray->m_origin.m_y);
+	vfloat oz = Set1(ray->m_origin.m_z);
+	vfloat dx = Set1(ray->m_direction.m_x);
+	vfloat dy = Set1(ray->m_direction.m_y);
+	vfloat dz = Set1(ray->m_direction.m_z);
+
+	int nBase;
+	for (nBase = 0; nBase < nCount; nBase += SIMD_LANES)
+	{
+		vfloat vx = ox - Load(pCenterX + nBase);
+		vfloat vy = oy - Load(pCenterY + nBase);
+		vfloat vz = oz - Load(pCenterZ + nBase);
+
+		vfloat a0 = (vx * vx + vy * vy + vz * vz) - Load(pSqrRadius + nBase);
+		vfloat DdotV = dx * vx + dy * vy + dz * vz;
+		vfloat discr = DdotV * DdotV - a0;
+		vfloat t = Negate(DdotV) - Sqrt(discr);
+
+		vmask hit = CmpLE(DdotV, zero) & CmpGE(discr, zero) & CmpGE(t, vMin) & CmpLE(t, vMax);
+		if (ToBits(hit) != 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
\ No newline at end of file
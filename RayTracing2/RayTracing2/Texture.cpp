@@ -0,0 +1,707 @@
+#include "Texture.h"
+
+// Tiled file layout: this header, then the tiles of every level from the
+// finest to the coarsest, each level in rows of tiles and every tile block
+// starting on a TEXTURE_TILE_BYTES boundary. Tiles reaching past the edge of
+// a level repeat its last row and column.
+
+class TextureFileHeader
+{
+public:
+	char m_szMagic[8];
+	int m_nVersion;
+	int m_nTileSize;
+	int m_nLevelSize;
+	int m_nWidth;
+	int m_nHeight;
+	int m_nLevelCount;
+	long long m_nSourceSize;
+	long long m_nSourceTime;
+	TextureLevel m_levels[TEXTURE_MAX_LEVELS];
+	unsigned long long m_nFileSize;
+};
+
+static const char s_szTextureMagic[8] = { 'R', 'T', 'T', 'E', 'X', 0, 0, 0 };
+
+thread_local float t_fTextureSpread = 0.0f;
+
+// Spreads the low 16 bits of n to the even bits, for Morton order in a tile.
+static inline unsigned int Texture_SpreadBits(unsigned int n)
+{
+	n = (n | (n << 8)) & 0x00FF00FF;
+	n = (n | (n << 4)) & 0x0F0F0F0F;
+	n = (n | (n << 2)) & 0x33333333;
+	return (n | (n << 1)) & 0x55555555;
+}
+
+static inline unsigned int Texture_Morton(int nX, int nY)
+{
+	return Texture_SpreadBits(nX) | (Texture_SpreadBits(nY) << 1);
+}
+
+static inline unsigned long long Texture_AlignOffset(unsigned long long nOffset)
+{
+	return (nOffset + TEXTURE_TILE_BYTES - 1) / TEXTURE_TILE_BYTES * TEXTURE_TILE_BYTES;
+}
+
+TextureCache::TextureCache()
+{
+	m_nBudget = TEXTURECACHE_DEFAULT_BUDGET;
+	m_nNextTextureId = 0;
+	int i;
+	for (i = 0; i < TEXTURECACHE_SHARD_COUNT; i++)
+	{
+		m_shards[i].m_pMemory = NULL;
+	}
+	Allocate();
+}
+
+TextureCache::~TextureCache()
+{
+	Free();
+}
+
+// Slot memory is only allocated on a shard's first miss, so scenes without
+// textures cost nothing.
+void TextureCache::Allocate()
+{
+	int nCapacity = MAX_((int)(m_nBudget / TEXTURE_TILE_BYTES / TEXTURECACHE_SHARD_COUNT), 1);
+	int i;
+	for (i = 0; i < TEXTURECACHE_SHARD_COUNT; i++)
+	{
+		Shard &shard = m_shards[i];
+		shard.m_slots.clear();
+		shard.m_keys.clear();
+		shard.m_prev.clear();
+		shard.m_next.clear();
+		shard.m_nHead = -1;
+		shard.m_nTail = -1;
+		shard.m_nUsed = 0;
+		shard.m_nCapacity = nCapacity;
+		shard.m_nHits = 0;
+		shard.m_nMisses = 0;
+	}
+}
+
+void TextureCache::Free()
+{
+	int i;
+	for (i = 0; i < TEXTURECACHE_SHARD_COUNT; i++)
+	{
+		if (m_shards[i].m_pMemory)
+		{
+			Simd_AlignedFree(m_shards[i].m_pMemory);
+			m_shards[i].m_pMemory = NULL;
+		}
+	}
+}
+
+void TextureCache::SetBudget(size_t nBytes)
+{
+	Free();
+	m_nBudget = nBytes;
+	Allocate();
+}
+
+size_t TextureCache::GetBudget()
+{
+	return m_nBudget;
+}
+
+void TextureCache::Clear()
+{
+	Free();
+	Allocate();
+}
+
+// Called with the shard locked. Returns the tile's copy in the shard, paging
+// it in from the texture's mapping over the least recently used tile on a miss.
+unsigned char *TextureCache::Lookup(Shard *shard, Texture *texture, int nLevel, int nTile, unsigned long long nKey)
+{
+	int nSlot;
+	std::unordered_map<unsigned long long, int>::iterator it = shard->m_slots.find(nKey);
+	if (it != shard->m_slots.end())
+	{
+		shard->m_nHits++;
+		nSlot = it->second;
+		if (nSlot == shard->m_nHead)
+		{
+			return shard->m_pMemory + (size_t)nSlot * TEXTURE_TILE_BYTES;
+		}
+		// Unlink; the slot is not the head, so it has a predecessor.
+		shard->m_next[shard->m_prev[nSlot]] = shard->m_next[nSlot];
+		if (shard->m_next[nSlot] >= 0)
+		{
+			shard->m_prev[shard->m_next[nSlot]] = shard->m_prev[nSlot];
+		}
+		else
+		{
+			shard->m_nTail = shard->m_prev[nSlot];
+		}
+	}
+	else
+	{
+		shard->m_nMisses++;
+		if (shard->m_pMemory == NULL)
+		{
+			shard->m_pMemory = (unsigned char *)Simd_AlignedAlloc((size_t)shard->m_nCapacity * TEXTURE_TILE_BYTES);
+			shard->m_keys.resize(shard->m_nCapacity);
+			shard->m_prev.resize(shard->m_nCapacity);
+			shard->m_next.resize(shard->m_nCapacity);
+		}
+		if (shard->m_nUsed < shard->m_nCapacity)
+		{
+			nSlot = shard->m_nUsed++;
+		}
+		else
+		{
+			nSlot = shard->m_nTail;
+			shard->m_slots.erase(shard->m_keys[nSlot]);
+			shard->m_nTail = shard->m_prev[nSlot];
+			if (shard->m_nTail >= 0)
+			{
+				shard->m_next[shard->m_nTail] = -1;
+			}
+			else
+			{
+				shard->m_nHead = -1;
+			}
+		}
+		memcpy(shard->m_pMemory + (size_t)nSlot * TEXTURE_TILE_BYTES, texture->GetTileData(nLevel, nTile), TEXTURE_TILE_BYTES);
+		shard->m_keys[nSlot] = nKey;
+		shard->m_slots[nKey] = nSlot;
+	}
+
+	// Link in as the most recently used.
+	shard->m_prev[nSlot] = -1;
+	shard->m_next[nSlot] = shard->m_nHead;
+	if (shard->m_nHead >= 0)
+	{
+		shard->m_prev[shard->m_nHead] = nSlot;
+	}
+	shard->m_nHead = nSlot;
+	if (shard->m_nTail < 0)
+	{
+		shard->m_nTail = nSlot;
+	}
+	return shard->m_pMemory + (size_t)nSlot * TEXTURE_TILE_BYTES;
+}
+
+void TextureCache::ReadTexels(Texture *texture, int nLevel, const int *pX, const int *pY, int nCount, unsigned int *pTexels)
+{
+	const TextureLevel &level = texture->GetLevel(nLevel);
+	unsigned long long nTextureKey = (unsigned long long)(unsigned int)texture->GetId() << 32 | (unsigned long long)nLevel << 27;
+	Shard *shard = NULL;
+	unsigned long long nLoadedKey = ~0ull;
+	const unsigned char *pTile = NULL;
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		int nTile = pY[i] / TEXTURE_TILE_SIZE * level.m_nTilesX + pX[i] / TEXTURE_TILE_SIZE;
+		unsigned long long nKey = nTextureKey | (unsigned long long)nTile;
+		if (nKey != nLoadedKey)
+		{
+			Shard *next = &m_shards[(nKey * 0x9E3779B97F4A7C15ull) >> 60];
+			if (next != shard)
+			{
+				if (shard)
+				{
+					shard->m_mutex.unlock();
+				}
+				next->m_mutex.lock();
+				shard = next;
+			}
+			pTile = Lookup(shard, texture, nLevel, nTile, nKey);
+			nLoadedKey = nKey;
+		}
+		memcpy(&pTexels[i], pTile + Texture_Morton(pX[i] & (TEXTURE_TILE_SIZE - 1), pY[i] & (TEXTURE_TILE_SIZE - 1)) * 4, 4);
+	}
+	if (shard)
+	{
+		shard->m_mutex.unlock();
+	}
+}
+
+unsigned long long TextureCache::GetHitCount()
+{
+	unsigned long long nCount = 0;
+	int i;
+	for (i = 0; i < TEXTURECACHE_SHARD_COUNT; i++)
+	{
+		std::lock_guard<std::mutex> lock(m_shards[i].m_mutex);
+		nCount += m_shards[i].m_nHits;
+	}
+	return nCount;
+}
+
+unsigned long long TextureCache::GetMissCount()
+{
+	unsigned long long nCount = 0;
+	int i;
+	for (i = 0; i < TEXTURECACHE_SHARD_COUNT; i++)
+	{
+		std::lock_guard<std::mutex> lock(m_shards[i].m_mutex);
+		nCount += m_shards[i].m_nMisses;
+	}
+	return nCount;
+}
+
+size_t TextureCache::GetResidentSize()
+{
+	size_t nSize = 0;
+	int i;
+	for (i = 0; i < TEXTURECACHE_SHARD_COUNT; i++)
+	{
+		std::lock_guard<std::mutex> lock(m_shards[i].m_mutex);
+		nSize += (size_t)m_shards[i].m_nUsed * TEXTURE_TILE_BYTES;
+	}
+	return nSize;
+}
+
+void TextureCache::ResetStats()
+{
+	int i;
+	for (i = 0; i < TEXTURECACHE_SHARD_COUNT; i++)
+	{
+		std::lock_guard<std::mutex> lock(m_shards[i].m_mutex);
+		m_shards[i].m_nHits = 0;
+		m_shards[i].m_nMisses = 0;
+	}
+}
+
+int TextureCache::NextTextureId()
+{
+	return m_nNextTextureId++;
+}
+
+Texture::Texture(TextureCache *cache)
+{
+	m_pCache = cache;
+	m_nLevelCount = 0;
+	m_nId = 0;
+	m_nSourceSize = 0;
+	m_nSourceTime = 0;
+}
+
+Texture::~Texture()
+{
+	Close();
+}
+
+bool Texture::Open(const char *pszFileName)
+{
+	Close();
+
+	if (!m_mappedFile.Open(pszFileName))
+	{
+		return false;
+	}
+
+	TextureFileHeader header;
+	size_t nSize = m_mappedFile.GetSize();
+	if (nSize < sizeof(header))
+	{
+		Close();
+		return false;
+	}
+	memcpy(&header, m_mappedFile.GetData(), sizeof(header));
+	if (memcmp(header.m_szMagic, s_szTextureMagic, sizeof(header.m_szMagic)) != 0 ||
+		header.m_nVersion != TEXTURE_FILE_VERSION ||
+		header.m_nTileSize != TEXTURE_TILE_SIZE ||
+		header.m_nLevelSize != (int)sizeof(TextureLevel) ||
+		header.m_nFileSize != nSize ||
+		header.m_nLevelCount <= 0 || header.m_nLevelCount > TEXTURE_MAX_LEVELS)
+	{
+		Close();
+		return false;
+	}
+
+	int i;
+	for (i = 0; i < header.m_nLevelCount; i++)
+	{
+		const TextureLevel &level = header.m_levels[i];
+		if (level.m_nWidth <= 0 || level.m_nHeight <= 0 ||
+			level.m_nTilesX != (level.m_nWidth + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE ||
+			level.m_nTilesY != (level.m_nHeight + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE ||
+			!MappedFile_IsInRange(level.m_nOffset, (unsigned long long)level.m_nTilesX * level.m_nTilesY, TEXTURE_TILE_BYTES, nSize))
+		{
+			Close();
+			return false;
+		}
+		m_levels[i] = level;
+	}
+	m_nLevelCount = header.m_nLevelCount;
+	m_nSourceSize = header.m_nSourceSize;
+	m_nSourceTime = header.m_nSourceTime;
+	m_nId = m_pCache->NextTextureId();
+	return true;
+}
+
+bool Texture::Load(const char *pszFileName)
+{
+	if (Open(pszFileName))
+	{
+		return true;
+	}
+
+	// Without its source the tiled file is used as it is, so scenes can ship
+	// only their tiled files.
+	std::string tiledName = std::string(pszFileName) + ".rttex";
+	struct stat st;
+	if (stat(pszFileName, &st) != 0)
+	{
+		return Open(tiledName.c_str());
+	}
+	if (Open(tiledName.c_str()) &&
+		m_nSourceSize == (long long)st.st_size &&
+		m_nSourceTime == (long long)st.st_mtime)
+	{
+		return true;
+	}
+	Close();
+
+	int nWidth;
+	int nHeight;
+	std::vector<unsigned int> pixels;
+	if (!LoadPPM(pszFileName, &nWidth, &nHeight, &pixels) ||
+		!SaveTiled(tiledName.c_str(), nWidth, nHeight, &pixels[0], (long long)st.st_size, (long long)st.st_mtime))
+	{
+		return false;
+	}
+	return Open(tiledName.c_str());
+}
+
+void Texture::Close()
+{
+	m_mappedFile.Close();
+	m_nLevelCount = 0;
+}
+
+int Texture::GetWidth()
+{
+	return m_nLevelCount > 0 ? m_levels[0].m_nWidth : 0;
+}
+
+int Texture::GetHeight()
+{
+	return m_nLevelCount > 0 ? m_levels[0].m_nHeight : 0;
+}
+
+int Texture::GetLevelCount()
+{
+	return m_nLevelCount;
+}
+
+const TextureLevel &Texture::GetLevel(int nLevel)
+{
+	return m_levels[nLevel];
+}
+
+int Texture::GetId()
+{
+	return m_nId;
+}
+
+const unsigned char *Texture::GetTileData(int nLevel, int nTile)
+{
+	return m_mappedFile.GetData() + m_levels[nLevel].m_nOffset + (size_t)nTile * TEXTURE_TILE_BYTES;
+}
+
+Color Texture::Sample(float u, float v, float fFootprint)
+{
+	if (m_nLevelCount == 0)
+	{
+		return Color::s_black;
+	}
+
+	// Level 0 fits a footprint of one texel; every level up doubles it.
+	float fTexels = fFootprint * MAX_(m_levels[0].m_nWidth, m_levels[0].m_nHeight);
+	float fLevel = fTexels > 1.0f ? MIN_(log2f(fTexels), (float)(m_nLevelCount - 1)) : 0.0f;
+	int nLevel = (int)fLevel;
+	float f = fLevel - nLevel;
+	Color color = SampleLevel(nLevel, u, v);
+	if (f > 0.0f && nLevel + 1 < m_nLevelCount)
+	{
+		color = color * (1.0f - f) + SampleLevel(nLevel + 1, u, v) * f;
+	}
+	return color;
+}
+
+Color Texture::SampleLevel(int nLevel, float u, float v)
+{
+	const TextureLevel &level = m_levels[nLevel];
+	u -= floorf(u);
+	v -= floorf(v);
+	if (!(u >= 0.0f && u < 1.0f))
+	{
+		u = 0.0f;
+	}
+	if (!(v >= 0.0f && v < 1.0f))
+	{
+		v = 0.0f;
+	}
+
+	float x = u * level.m_nWidth - 0.5f;
+	float y = v * level.m_nHeight - 0.5f;
+	float fx = floorf(x);
+	float fy = floorf(y);
+	float ax = x - fx;
+	float ay = y - fy;
+	int nX0 = (int)fx;
+	int nY0 = (int)fy;
+	nX0 = nX0 < 0 ? nX0 + level.m_nWidth : nX0;
+	nY0 = nY0 < 0 ? nY0 + level.m_nHeight : nY0;
+	int nX1 = nX0 + 1 < level.m_nWidth ? nX0 + 1 : 0;
+	int nY1 = nY0 + 1 < level.m_nHeight ? nY0 + 1 : 0;
+
+	int pX[4] = { nX0, nX1, nX0, nX1 };
+	int pY[4] = { nY0, nY0, nY1, nY1 };
+	unsigned int texels[4];
+	m_pCache->ReadTexels(this, nLevel, pX, pY, 4, texels);
+
+	float weights[4] = { (1.0f - ax) * (1.0f - ay), ax * (1.0f - ay), (1.0f - ax) * ay, ax * ay };
+	float r = 0.0f;
+	float g = 0.0f;
+	float b = 0.0f;
+	int i;
+	for (i = 0; i < 4; i++)
+	{
+		r += ((texels[i] >> 16) & 0xFF) * weights[i];
+		g += ((texels[i] >> 8) & 0xFF) * weights[i];
+		b += (texels[i] & 0xFF) * weights[i];
+	}
+	const float fScale = 1.0f / 255.0f;
+	return Color(r * fScale, g * fScale, b * fScale);
+}
+
+static bool Texture_ReadPPMValue(FILE *pFile, int *pValue)
+{
+	int c = fgetc(pFile);
+	while (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#')
+	{
+		if (c == '#')
+		{
+			while (c != '\n' && c != EOF)
+			{
+				c = fgetc(pFile);
+			}
+		}
+		c = fgetc(pFile);
+	}
+	if (c < '0' || c > '9')
+	{
+		return false;
+	}
+	int nValue = 0;
+	while (c >= '0' && c <= '9')
+	{
+		nValue = nValue * 10 + (c - '0');
+		if (nValue > 65535)
+		{
+			return false;
+		}
+		c = fgetc(pFile);
+	}
+	// One white space character separates the header from the pixels.
+	*pValue = nValue;
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool Texture::LoadPPM(const char *pszFileName, int *pWidth, int *pHeight, std::vector<unsigned int> *pPixels)
+{
+	FILE *pFile = fopen(pszFileName, "rb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+
+	int nWidth = 0;
+	int nHeight = 0;
+	int nMax = 0;
+	bool bResult = fgetc(pFile) == 'P' && fgetc(pFile) == '6' &&
+		Texture_ReadPPMValue(pFile, &nWidth) && Texture_ReadPPMValue(pFile, &nHeight) &&
+		Texture_ReadPPMValue(pFile, &nMax) && nWidth > 0 && nHeight > 0 && nMax == 255;
+
+	std::vector<unsigned char> row(nWidth * 3);
+	if (bResult)
+	{
+		pPixels->resize((size_t)nWidth * nHeight);
+	}
+	int nY;
+	for (nY = 0; bResult && nY < nHeight; nY++)
+	{
+		bResult = fread(&row[0], 1, row.size(), pFile) == row.size();
+		int nX;
+		for (nX = 0; bResult && nX < nWidth; nX++)
+		{
+			(*pPixels)[(size_t)nY * nWidth + nX] = 0xFF000000 | (row[nX * 3] << 16) | (row[nX * 3 + 1] << 8) | row[nX * 3 + 2];
+		}
+	}
+	fclose(pFile);
+
+	*pWidth = nWidth;
+	*pHeight = nHeight;
+	return bResult;
+}
+
+bool Texture::SaveTiled(const char *pszFileName, int nWidth, int nHeight, const unsigned int *pPixels,
+	long long nSourceSize, long long nSourceTime)
+{
+	TextureFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.m_szMagic, s_szTextureMagic, sizeof(header.m_szMagic));
+	header.m_nVersion = TEXTURE_FILE_VERSION;
+	header.m_nTileSize = TEXTURE_TILE_SIZE;
+	header.m_nLevelSize = sizeof(TextureLevel);
+	header.m_nWidth = nWidth;
+	header.m_nHeight = nHeight;
+	header.m_nSourceSize = nSourceSize;
+	header.m_nSourceTime = nSourceTime;
+
+	// Box filtered pyramid down to 1x1.
+	std::vector<std::vector<unsigned int>> levels(1, std::vector<unsigned int>(pPixels, pPixels + (size_t)nWidth * nHeight));
+	unsigned long long nOffset = Texture_AlignOffset(sizeof(header));
+	int nLevelWidth = nWidth;
+	int nLevelHeight = nHeight;
+	while (true)
+	{
+		TextureLevel &level = header.m_levels[header.m_nLevelCount++];
+		level.m_nWidth = nLevelWidth;
+		level.m_nHeight = nLevelHeight;
+		level.m_nTilesX = (nLevelWidth + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+		level.m_nTilesY = (nLevelHeight + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+		level.m_nOffset = nOffset;
+		nOffset += (unsigned long long)level.m_nTilesX * level.m_nTilesY * TEXTURE_TILE_BYTES;
+		if ((nLevelWidth == 1 && nLevelHeight == 1) || header.m_nLevelCount == TEXTURE_MAX_LEVELS)
+		{
+			break;
+		}
+
+		const std::vector<unsigned int> &source = levels.back();
+		int nSourceWidth = nLevelWidth;
+		int nSourceHeight = nLevelHeight;
+		nLevelWidth = MAX_(nLevelWidth / 2, 1);
+		nLevelHeight = MAX_(nLevelHeight / 2, 1);
+		std::vector<unsigned int> next((size_t)nLevelWidth * nLevelHeight);
+		int nY;
+		for (nY = 0; nY < nLevelHeight; nY++)
+		{
+			int nY0 = MIN_(nY * 2, nSourceHeight - 1);
+			int nY1 = MIN_(nY * 2 + 1, nSourceHeight - 1);
+			int nX;
+			for (nX = 0; nX < nLevelWidth; nX++)
+			{
+				int nX0 = MIN_(nX * 2, nSourceWidth - 1);
+				int nX1 = MIN_(nX * 2 + 1, nSourceWidth - 1);
+				unsigned int quad[4] =
+				{
+					source[(size_t)nY0 * nSourceWidth + nX0], source[(size_t)nY0 * nSourceWidth + nX1],
+					source[(size_t)nY1 * nSourceWidth + nX0], source[(size_t)nY1 * nSourceWidth + nX1],
+				};
+				unsigned int nTexel = 0;
+				int nShift;
+				for (nShift = 0; nShift < 32; nShift += 8)
+				{
+					unsigned int nSum = ((quad[0] >> nShift) & 0xFF) + ((quad[1] >> nShift) & 0xFF) +
+						((quad[2] >> nShift) & 0xFF) + ((quad[3] >> nShift) & 0xFF);
+					nTexel |= ((nSum + 2) / 4) << nShift;
+				}
+				next[(size_t)nY * nLevelWidth + nX] = nTexel;
+			}
+		}
+		levels.push_back(std::move(next));
+	}
+	header.m_nFileSize = nOffset;
+
+	// Write to a temporary name first so a reader never maps a partial file.
+	std::string tempName = std::string(pszFileName) + ".tmp";
+	FILE *pFile = fopen(tempName.c_str(), "wb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> padding((size_t)(Texture_AlignOffset(sizeof(header)) - sizeof(header)) + 1, 0);
+	bool bResult = fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+		fwrite(&padding[0], 1, padding.size() - 1, pFile) == padding.size() - 1;
+	unsigned int tile[TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE];
+	int i;
+	for (i = 0; bResult && i < header.m_nLevelCount; i++)
+	{
+		const TextureLevel &level = header.m_levels[i];
+		const std::vector<unsigned int> &texels = levels[i];
+		int nTile;
+		for (nTile = 0; bResult && nTile < level.m_nTilesX * level.m_nTilesY; nTile++)
+		{
+			int nTileX = nTile % level.m_nTilesX * TEXTURE_TILE_SIZE;
+			int nTileY = nTile / level.m_nTilesX * TEXTURE_TILE_SIZE;
+			int nY;
+			for (nY = 0; nY < TEXTURE_TILE_SIZE; nY++)
+			{
+				const unsigned int *pRow = &texels[(size_t)MIN_(nTileY + nY, level.m_nHeight - 1) * level.m_nWidth];
+				int nX;
+				for (nX = 0; nX < TEXTURE_TILE_SIZE; nX++)
+				{
+					tile[Texture_Morton(nX, nY)] = pRow[MIN_(nTileX + nX, level.m_nWidth - 1)];
+				}
+			}
+			bResult = fwrite(tile, sizeof(tile), 1, pFile) == 1;
+		}
+	}
+	bResult = ferror(pFile) == 0 && bResult;
+	fclose(pFile);
+
+	if (bResult)
+	{
+		remove(pszFileName);
+		bResult = rename(tempName.c_str(), pszFileName) == 0;
+	}
+	if (!bResult)
+	{
+		remove(tempName.c_str());
+	}
+	return bResult;
+}
+
+TextureSpreadBinding::TextureSpreadBinding(float fSpread)
+{
+	m_fPrevious = t_fTextureSpread;
+	t_fTextureSpread = fSpread;
+}
+
+TextureSpreadBinding::~TextureSpreadBinding()
+{
+	t_fTextureSpread = m_fPrevious;
+}
+
+TextureMaterial::TextureMaterial(Texture *texture, int nProjection, float scale, float reflectiveness)
+	: m_tint(Color::s_white)
+{
+	m_texture = texture;
+	m_nProjection = nProjection;
+	m_scale = scale;
+	m_reflectiveness = reflectiveness;
+}
+
+Color TextureMaterial::Sample(Ray3 *ray, Vector3 *position, Vector3 *normal)
+{
+	// The pixel's cone widens with distance and stretches on slanted
+	// surfaces; the square root keeps grazing hits from blurring too much.
+	float fDistance = (*position - ray->m_origin).Length();
+	float fCos = MAX_(fabsf(normal->Dot(ray->m_direction)), 1e-3f);
+	float fFootprint = fDistance * t_fTextureSpread / sqrtf(fCos) * m_scale;
+
+	float u;
+	float v;
+	if (m_nProjection == TEXTURE_PROJECTION_SPHERICAL)
+	{
+		u = atan2f(normal->m_z, normal->m_x) * (0.5f / M_PI_F) + 0.5f;
+		v = acosf(MIN_(MAX_(normal->m_y, -1.0f), 1.0f)) * (1.0f / M_PI_F);
+	}
+	else
+	{
+		u = position->m_x * m_scale;
+		v = position->m_z * m_scale;
+	}
+	return m_texture->Sample(u, v, fFootprint).Modulate(m_tint);
+}
\ No newline at end of file
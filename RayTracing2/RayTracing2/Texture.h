@@ -0,0 +1,155 @@
+#pragma once
+
+// Image textures for materials. A texture lives in a tiled file (.rttex)
+// holding its whole mip pyramid: every level is cut into square tiles of
+// TEXTURE_TILE_SIZE texels, and the texels of a tile are stored in Morton
+// order, so the 2x2 footprint of a bilinear lookup nearly always falls into
+// one tile and usually into one cache line. Texels are 0xAARRGGBB like the
+// frame buffer's pixels. Load() converts a binary PPM into a tiled file next
+// to it the first time, and again when the PPM's size or time changes. When
+// the PPM is missing, Load() opens its tiled file as it is.
+//
+// Tiled files are memory-mapped, but lookups never touch the mapping
+// directly: they go through a TextureCache, which copies tiles into a fixed
+// number of slots on first use and evicts the least recently used tile when
+// full. The memory texturing takes is therefore the cache budget, however
+// many gigabytes the scene's textures add up to; the pages of the mappings
+// that were read are the operating system's file cache, which it reclaims
+// as needed. The cache is split into shards with a lock each, so render
+// threads rarely wait for one another.
+//
+// Sample() filters trilinearly between the two mip levels that fit the
+// footprint of the lookup. The renderer binds the angle one pixel spans for
+// the duration of each task with TextureSpreadBinding, and TextureMaterial
+// turns it into a footprint from the hit distance and angle.
+
+#define TEXTURE_FILE_VERSION		1
+#define TEXTURE_TILE_SIZE			32
+#define TEXTURE_TILE_BYTES			(TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE * 4)
+#define TEXTURE_MAX_LEVELS			24
+
+#define TEXTURECACHE_SHARD_COUNT	16
+#define TEXTURECACHE_DEFAULT_BUDGET	(64 * 1024 * 1024)
+
+#define TEXTURE_PROJECTION_PLANAR		0
+#define TEXTURE_PROJECTION_SPHERICAL	1
+
+class Texture;
+
+class TextureCache
+{
+public:
+	TextureCache();
+	~TextureCache();
+	// Drops every tile. At least one tile per shard is kept.
+	void SetBudget(size_t nBytes);
+	size_t GetBudget();
+	void Clear();
+	// Reads nCount texels of one level; runs of texels from the same tile
+	// take the tile's shard lock once.
+	void ReadTexels(Texture *texture, int nLevel, const int *pX, const int *pY, int nCount, unsigned int *pTexels);
+	unsigned long long GetHitCount();
+	unsigned long long GetMissCount();
+	size_t GetResidentSize();
+	void ResetStats();
+	int NextTextureId();
+private:
+	class Shard
+	{
+	public:
+		std::mutex m_mutex;
+		std::unordered_map<unsigned long long, int> m_slots;
+		// Per slot: its key and its neighbours in the use order.
+		std::vector<unsigned long long> m_keys;
+		std::vector<int> m_prev;
+		std::vector<int> m_next;
+		// Most and least recently used slots.
+		int m_nHead;
+		int m_nTail;
+		int m_nUsed;
+		int m_nCapacity;
+		unsigned char *m_pMemory;
+		unsigned long long m_nHits;
+		unsigned long long m_nMisses;
+	};
+	unsigned char *Lookup(Shard *shard, Texture *texture, int nLevel, int nTile, unsigned long long nKey);
+	void Allocate();
+	void Free();
+	Shard m_shards[TEXTURECACHE_SHARD_COUNT];
+	size_t m_nBudget;
+	std::atomic<int> m_nNextTextureId;
+};
+
+class TextureLevel
+{
+public:
+	int m_nWidth;
+	int m_nHeight;
+	int m_nTilesX;
+	int m_nTilesY;
+	unsigned long long m_nOffset;
+};
+
+class Texture
+{
+public:
+	Texture(TextureCache *cache);
+	~Texture();
+	bool Open(const char *pszFileName);
+	bool Load(const char *pszFileName);
+	void Close();
+	int GetWidth();
+	int GetHeight();
+	int GetLevelCount();
+	// Repeats outside [0, 1). fFootprint is the width of the filtered area in
+	// texture coordinates.
+	Color Sample(float u, float v, float fFootprint);
+	// Bilinear lookup in one level.
+	Color SampleLevel(int nLevel, float u, float v);
+	const TextureLevel &GetLevel(int nLevel);
+	const unsigned char *GetTileData(int nLevel, int nTile);
+	int GetId();
+	static bool LoadPPM(const char *pszFileName, int *pWidth, int *pHeight, std::vector<unsigned int> *pPixels);
+	// Writes pixels, nWidth x nHeight rows of 0xAARRGGBB, as a tiled file with
+	// the full mip pyramid. The source size and time are kept for Load().
+	static bool SaveTiled(const char *pszFileName, int nWidth, int nHeight, const unsigned int *pPixels,
+		long long nSourceSize, long long nSourceTime);
+private:
+	TextureCache *m_pCache;
+	MappedFile m_mappedFile;
+	TextureLevel m_levels[TEXTURE_MAX_LEVELS];
+	int m_nLevelCount;
+	int m_nId;
+	long long m_nSourceSize;
+	long long m_nSourceTime;
+};
+
+// Angle in radians that one pixel of the frame spans, for texture
+// footprints. Bound per task by the renderer; zero samples the finest level.
+extern thread_local float t_fTextureSpread;
+
+class TextureSpreadBinding
+{
+public:
+	TextureSpreadBinding(float fSpread);
+	~TextureSpreadBinding();
+private:
+	float m_fPrevious;
+};
+
+// Diffuse colour from a texture. Planar projection maps world x and z times
+// m_scale to u and v, like CheckerMaterial; spherical projection maps the
+// surface normal to longitude and latitude, which wraps a texture once around
+// a sphere. m_scale is also the texture coordinate change per world unit the
+// footprint is computed with.
+class TextureMaterial : public Material
+{
+public:
+	TextureMaterial(Texture *texture, int nProjection, float scale, float reflectiveness);
+	Color Sample(Ray3 *ray, Vector3 *position, Vector3 *normal) override;
+public:
+	Texture *m_texture;
+	int m_nProjection;
+	float m_scale;
+	Color m_tint;
+};
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool()
+{
+	m_nThreadCount = 0;
+	m_nGeneration = 0;
+	m_nActiveWorkers = 0;
+	m_bStop = false;
+	m_nRemaining = 0;
+	m_pTask = NULL;
+}
+
+ThreadPool::~ThreadPool()
+{
+	Stop();
+}
+
+int ThreadPool::GetHardwareThreadCount()
+{
+	int nCount = (int)std::thread::hardware_concurrency();
+	return MAX_(nCount, 1);
+}
+
+void ThreadPool::Start(int nThreadCount)
+{
+	Stop();
+
+	if (nThreadCount <= 0)
+	{
+		nThreadCount = GetHardwareThreadCount();
+	}
+
+	m_nThreadCount = nThreadCount;
+	m_bStop = false;
+
+	int i;
+	for (i = 0; i < m_nThreadCount; i++)
+	{
+		m_vecQueues.push_back(new WorkerQueue());
+	}
+
+	// Worker 0 is the thread calling Run().
+	for (i = 1; i < m_nThreadCount; i++)
+	{
+		m_vecThreads.push_back(std::thread(&ThreadPool::WorkerMain, this, i));
+	}
+}
+
+void ThreadPool::Stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_bStop = true;
+	}
+	m_cvWork.notify_all();
+
+	int i;
+	int nCount = m_vecThreads.size();
+	for (i = 0; i < nCount; i++)
+	{
+		m_vecThreads[i].join();
+	}
+	m_vecThreads.clear();
+
+	nCount = m_vecQueues.size();
+	for (i = 0; i < nCount; i++)
+	{
+		delete m_vecQueues[i];
+	}
+	m_vecQueues.clear();
+
+	m_nThreadCount = 0;
+}
+
+int ThreadPool::GetThreadCount()
+{
+	return m_nThreadCount;
+}
+
+void ThreadPool::Run(int nTaskCount, const TaskFunc &task)
+{
+	if (nTaskCount <= 0)
+	{
+		return;
+	}
+
+	if (m_nThreadCount <= 1)
+	{
+		int i;
+		for (i = 0; i < nTaskCount; i++)
+		{
+			task(i, 0);
+		}
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_pTask = &task;
+		m_nRemaining = nTaskCount;
+	}
+
+	// Hand every worker a contiguous run of tasks so neighbouring tiles stay
+	// on one core; stealing evens out the expensive ones.
+	int i;
+	for (i = 0; i < m_nThreadCount; i++)
+	{
+		int nBegin = (int)((long long)nTaskCount * i / m_nThreadCount);
+		int nEnd = (int)((long long)nTaskCount * (i + 1) / m_nThreadCount);
+		std::unique_lock<std::mutex> lock(m_vecQueues[i]->m_mutex);
+		int nTask;
+		for (nTask = nBegin; nTask < nEnd; nTask++)
+		{
+			m_vecQueues[i]->m_tasks.push_back(nTask);
+		}
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_nGeneration++;
+	}
+	m_cvWork.notify_all();
+
+	ExecuteTasks(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_nRemaining > 0 || m_nActiveWorkers > 0)
+	{
+		m_cvDone.wait(lock);
+	}
+	m_pTask = NULL;
+}
+
+void ThreadPool::WorkerMain(int nWorker)
+{
+	unsigned int nGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_bStop && nGeneration == m_nGeneration)
+			{
+				m_cvWork.wait(lock);
+			}
+			if (m_bStop)
+			{
+				return;
+			}
+			nGeneration = m_nGeneration;
+			m_nActiveWorkers++;
+		}
+
+		ExecuteTasks(nWorker);
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_nActiveWorkers--;
+		}
+		m_cvDone.notify_all();
+	}
+}
+
+void ThreadPool::ExecuteTasks(int nWorker)
+{
+	int nTask;
+	while (PopTask(nWorker, &nTask) || StealTask(nWorker, &nTask))
+	{
+		(*m_pTask)(nTask, nWorker);
+
+		if (--m_nRemaining == 0)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cvDone.notify_all();
+		}
+	}
+}
+
+bool ThreadPool::PopTask(int nWorker, int *pTask)
+{
+	WorkerQueue *queue = m_vecQueues[nWorker];
+	std::unique_lock<std::mutex> lock(queue->m_mutex);
+	if (queue->m_tasks.empty())
+	{
+		return false;
+	}
+	*pTask = queue->m_tasks.front();
+	queue->m_tasks.pop_front();
+	return true;
+}
+
+bool ThreadPool::StealTask(int nWorker, int *pTask)
+{
+	int i;
+	for (i = 1; i < m_nThreadCount; i++)
+	{
+		WorkerQueue *queue = m_vecQueues[(nWorker + i) % m_nThreadCount];
+		std::unique_lock<std::mutex> lock(queue->m_mutex);
+		if (!queue->m_tasks.empty())
+		{
+			*pTask = queue->m_tasks.back();
+			queue->m_tasks.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+// Persistent worker pool used by the tile renderer. Every worker owns a deque of
+// task indices; a worker pops from the front of its own deque and, once that is
+// empty, steals from the back of the other workers' deques. The calling thread
+// takes part in Run() as worker 0, so a pool of one thread runs inline.
+
+class ThreadPool
+{
+public:
+	typedef std::function<void(int nTask, int nWorker)> TaskFunc;
+	ThreadPool();
+	~ThreadPool();
+	void Start(int nThreadCount);
+	void Stop();
+	int GetThreadCount();
+	void Run(int nTaskCount, const TaskFunc &task);
+	static int GetHardwareThreadCount();
+private:
+	class WorkerQueue
+	{
+	public:
+		std::mutex m_mutex;
+		std::deque<int> m_tasks;
+	};
+	void WorkerMain(int nWorker);
+	void ExecuteTasks(int nWorker);
+	bool PopTask(int nWorker, int *pTask);
+	bool StealTask(int nWorker, int *pTask);
+private:
+	int m_nThreadCount;
+	std::vector<std::thread> m_vecThreads;
+	std::vector<WorkerQueue *> m_vecQueues;
+	std::mutex m_mutex;
+	std::condition_variable m_cvWork;
+	std::condition_variable m_cvDone;
+	unsigned int m_nGeneration;
+	int m_nActiveWorkers;
+	bool m_bStop;
+	std::atomic<int> m_nRemaining;
+	const TaskFunc *m_pTask;
+};
\ No newline at end of file
@@ -0,0 +1,957 @@
+#include "TriangleMesh.h"
+
+// A ray transformed for the watertight test: the axis the direction is
+// largest along becomes z, and a shear maps the direction onto +z so every
+// triangle is tested in 2D at the ray origin.
+class TriangleRay
+{
+public:
+	Vector3 m_origin;
+	int m_nX;
+	int m_nY;
+	int m_nZ;
+	float m_fShearX;
+	float m_fShearY;
+	float m_fShearZ;
+};
+
+static inline float TriangleMesh_Axis(const Vector3 &v, int nAxis)
+{
+	return (&v.m_x)[nAxis];
+}
+
+static void TriangleMesh_SetupRay(const Ray3 *ray, TriangleRay *triangleRay)
+{
+	const Vector3 &d = ray->m_direction;
+	float ax = fabsf(d.m_x);
+	float ay = fabsf(d.m_y);
+	float az = fabsf(d.m_z);
+	int nZ = ax > ay ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+	int nX = (nZ + 1) % 3;
+	int nY = (nX + 1) % 3;
+
+	// Keep the winding of the 2D edge tests independent of the direction sign.
+	float dz = TriangleMesh_Axis(d, nZ);
+	if (dz < 0.0f)
+	{
+		int nSwap = nX;
+		nX = nY;
+		nY = nSwap;
+	}
+
+	triangleRay->m_origin = ray->m_origin;
+	triangleRay->m_nX = nX;
+	triangleRay->m_nY = nY;
+	triangleRay->m_nZ = nZ;
+	triangleRay->m_fShearX = TriangleMesh_Axis(d, nX) / dz;
+	triangleRay->m_fShearY = TriangleMesh_Axis(d, nY) / dz;
+	triangleRay->m_fShearZ = 1.0f / dz;
+}
+
+// Returns true for a hit with tMin < t < tMax; *pU and *pV are the barycentric
+// weights of the second and third vertex.
+static inline bool TriangleMesh_IntersectTriangle(const TriangleRay &ray, const Vector3 &p0, const Vector3 &p1,
+	const Vector3 &p2, float tMin, float tMax, float *pT, float *pU, float *pV)
+{
+	Vector3 a = p0 - ray.m_origin;
+	Vector3 b = p1 - ray.m_origin;
+	Vector3 c = p2 - ray.m_origin;
+
+	float az = TriangleMesh_Axis(a, ray.m_nZ);
+	float bz = TriangleMesh_Axis(b, ray.m_nZ);
+	float cz = TriangleMesh_Axis(c, ray.m_nZ);
+	float ax = TriangleMesh_Axis(a, ray.m_nX) - ray.m_fShearX * az;
+	float ay = TriangleMesh_Axis(a, ray.m_nY) - ray.m_fShearY * az;
+	float bx = TriangleMesh_Axis(b, ray.m_nX) - ray.m_fShearX * bz;
+	float by = TriangleMesh_Axis(b, ray.m_nY) - ray.m_fShearY * bz;
+	float cx = TriangleMesh_Axis(c, ray.m_nX) - ray.m_fShearX * cz;
+	float cy = TriangleMesh_Axis(c, ray.m_nY) - ray.m_fShearY * cz;
+
+	// Scaled barycentric coordinates from 2D edge functions.
+	float u = cx * by - cy * bx;
+	float v = ax * cy - ay * cx;
+	float w = bx * ay - by * ax;
+
+	// Exactly on an edge in single precision; decide in double so the two
+	// triangles sharing the edge agree.
+	if (u == 0.0f || v == 0.0f || w == 0.0f)
+	{
+		u = (float)((double)cx * by - (double)cy * bx);
+		v = (float)((double)ax * cy - (double)ay * cx);
+		w = (float)((double)bx * ay - (double)by * ax);
+	}
+
+	if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+	{
+		return false;
+	}
+
+	float det = u + v + w;
+	if (det == 0.0f)
+	{
+		return false;
+	}
+
+	float invDet = 1.0f / det;
+	float t = (u * az + v * bz + w * cz) * ray.m_fShearZ * invDet;
+	if (!(t > tMin && t < tMax))
+	{
+		return false;
+	}
+
+	*pT = t;
+	*pU = v * invDet;
+	*pV = w * invDet;
+	return true;
+}
+
+TriangleMesh::TriangleMesh()
+{
+	m_pPositions = NULL;
+	m_pNormals = NULL;
+	m_pIndices = NULL;
+	m_pNodes = NULL;
+	m_nVertexCount = 0;
+	m_nTriangleCount = 0;
+	m_nNodeCount = 0;
+	m_bMapped = false;
+	m_nBuildVersion = 0;
+	m_nSourceSize = 0;
+	m_nSourceTime = 0;
+}
+
+TriangleMesh::~TriangleMesh()
+{
+	Release();
+}
+
+void TriangleMesh::Release()
+{
+	m_positions.clear();
+	m_normals.clear();
+	m_indices.clear();
+	m_nodes.clear();
+	m_mappedFile.Close();
+	m_bMapped = false;
+	m_nSourceSize = 0;
+	m_nSourceTime = 0;
+	SetViews();
+}
+
+void TriangleMesh::SetViews()
+{
+	m_pPositions = m_positions.empty() ? NULL : &m_positions[0];
+	m_pNormals = m_normals.empty() ? NULL : &m_normals[0];
+	m_pIndices = m_indices.empty() ? NULL : &m_indices[0];
+	m_pNodes = m_nodes.empty() ? NULL : &m_nodes[0];
+	m_nVertexCount = m_positions.size();
+	m_nTriangleCount = m_indices.size() / 3;
+	m_nNodeCount = m_nodes.size();
+}
+
+// Copies a mapped cache into the vectors so the mesh can be edited.
+void TriangleMesh::Detach()
+{
+	if (!m_bMapped)
+	{
+		return;
+	}
+
+	m_positions.assign(m_pPositions, m_pPositions + m_nVertexCount);
+	if (m_pNormals)
+	{
+		m_normals.assign(m_pNormals, m_pNormals + m_nVertexCount);
+	}
+	m_indices.assign(m_pIndices, m_pIndices + m_nTriangleCount * 3);
+	m_nodes.assign(m_pNodes, m_pNodes + m_nNodeCount);
+	m_mappedFile.Close();
+	m_bMapped = false;
+	SetViews();
+}
+
+int TriangleMesh::AddVertex(const Vector3 &position)
+{
+	Detach();
+	m_positions.push_back(position);
+	m_nodes.clear();
+	SetViews();
+	return m_positions.size() - 1;
+}
+
+int TriangleMesh::AddVertex(const Vector3 &position, const Vector3 &normal)
+{
+	Detach();
+	m_positions.push_back(position);
+	m_normals.resize(m_positions.size() - 1);
+	m_normals.push_back(normal);
+	m_nodes.clear();
+	SetViews();
+	return m_positions.size() - 1;
+}
+
+int TriangleMesh::AddTriangle(int nVertex0, int nVertex1, int nVertex2)
+{
+	Detach();
+	m_indices.push_back(nVertex0);
+	m_indices.push_back(nVertex1);
+	m_indices.push_back(nVertex2);
+	m_nodes.clear();
+	SetViews();
+	return m_indices.size() / 3 - 1;
+}
+
+int TriangleMesh::GetVertexCount()
+{
+	return m_bMapped ? m_nVertexCount : (int)m_positions.size();
+}
+
+int TriangleMesh::GetTriangleCount()
+{
+	return m_bMapped ? m_nTriangleCount : (int)(m_indices.size() / 3);
+}
+
+bool TriangleMesh::IsMapped()
+{
+	return m_bMapped;
+}
+
+void TriangleMesh::Initialize()
+{
+	// A mapped cache already holds the BVH and the triangles in leaf order,
+	// and a built BVH stays valid until the next Add call or MarkChanged().
+	if (m_bMapped || (!m_nodes.empty() && m_nBuildVersion == m_nVersion))
+	{
+		return;
+	}
+
+	// Normals are per vertex or not at all.
+	if (!m_normals.empty() && m_normals.size() != m_positions.size())
+	{
+		m_normals.clear();
+	}
+
+	int nCount = m_indices.size() / 3;
+	std::vector<AABB> bounds(nCount);
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		bounds[i].Extend(m_positions[m_indices[i * 3 + 0]]);
+		bounds[i].Extend(m_positions[m_indices[i * 3 + 1]]);
+		bounds[i].Extend(m_positions[m_indices[i * 3 + 2]]);
+	}
+
+	BVHBuilder builder;
+	std::vector<int> order;
+	builder.Build(bounds, &m_nodes, &order);
+
+	std::vector<int> sorted(nCount * 3);
+	for (i = 0; i < nCount; i++)
+	{
+		sorted[i * 3 + 0] = m_indices[order[i] * 3 + 0];
+		sorted[i * 3 + 1] = m_indices[order[i] * 3 + 1];
+		sorted[i * 3 + 2] = m_indices[order[i] * 3 + 2];
+	}
+	m_indices.swap(sorted);
+	m_nBuildVersion = m_nVersion;
+
+	SetViews();
+}
+
+bool TriangleMesh::Intersect(Ray3 *ray, IntersectResult *intersectResult)
+{
+	if (m_nNodeCount == 0)
+	{
+		return false;
+	}
+
+	TriangleRay triangleRay;
+	TriangleMesh_SetupRay(ray, &triangleRay);
+
+	int nNearest = -1;
+	float fU = 0.0f;
+	float fV = 0.0f;
+	BVH_Traverse(m_pNodes, ray, 0.0f, &intersectResult->m_distance, [&](int nOffset, int nCount)
+	{
+		RT_STAT_ADD(STAT_TRIANGLE_TESTS, nCount);
+		int i;
+		for (i = nOffset; i < nOffset + nCount; i++)
+		{
+			const int *pTriangle = m_pIndices + i * 3;
+			float t;
+			float u;
+			float v;
+			if (TriangleMesh_IntersectTriangle(triangleRay, m_pPositions[pTriangle[0]], m_pPositions[pTriangle[1]],
+				m_pPositions[pTriangle[2]], TRIANGLEMESH_MIN_DISTANCE, intersectResult->m_distance, &t, &u, &v))
+			{
+				intersectResult->m_distance = t;
+				nNearest = i;
+				fU = u;
+				fV = v;
+			}
+		}
+		return false;
+	});
+
+	if (nNearest < 0)
+	{
+		return false;
+	}
+
+	intersectResult->m_geometry = this;
+	intersectResult->m_nPrimitive = nNearest;
+	intersectResult->m_u = fU;
+	intersectResult->m_v = fV;
+	return true;
+}
+
+void TriangleMesh::ComputeSurfaceInteraction(Ray3 *ray, IntersectResult *intersectResult)
+{
+	const int *pTriangle = m_pIndices + intersectResult->m_nPrimitive * 3;
+	const Vector3 &p0 = m_pPositions[pTriangle[0]];
+	const Vector3 &p1 = m_pPositions[pTriangle[1]];
+	const Vector3 &p2 = m_pPositions[pTriangle[2]];
+	float u = intersectResult->m_u;
+	float v = intersectResult->m_v;
+	float w = 1.0f - u - v;
+
+	// Interpolating the vertices keeps secondary ray origins on the triangle.
+	intersectResult->m_material = m_material;
+	intersectResult->m_position = p0 * w + p1 * u + p2 * v;
+
+	// Triangles are two-sided: both normals face the incoming ray.
+	Vector3 normal = (p1 - p0).Cross(p2 - p0).Normalize();
+	bool bFlip = normal.Dot(ray->m_direction) > 0.0f;
+	if (m_pNormals)
+	{
+		normal = (m_pNormals[pTriangle[0]] * w + m_pNormals[pTriangle[1]] * u + m_pNormals[pTriangle[2]] * v).Normalize();
+	}
+	intersectResult->m_normal = bFlip ? -normal : normal;
+}
+
+bool TriangleMesh::Occluded(Ray3 *ray, float tMin, float tMax)
+{
+	if (m_nNodeCount == 0)
+	{
+		return false;
+	}
+
+	TriangleRay triangleRay;
+	TriangleMesh_SetupRay(ray, &triangleRay);
+
+	float fMinDistance = MAX_(tMin, TRIANGLEMESH_MIN_DISTANCE);
+	return BVH_Traverse(m_pNodes, ray, tMin, &tMax, [&](int nOffset, int nCount)
+	{
+		RT_STAT_ADD(STAT_TRIANGLE_TESTS, nCount);
+		int i;
+		for (i = nOffset; i < nOffset + nCount; i++)
+		{
+			const int *pTriangle = m_pIndices + i * 3;
+			float t;
+			float u;
+			float v;
+			if (TriangleMesh_IntersectTriangle(triangleRay, m_pPositions[pTriangle[0]], m_pPositions[pTriangle[1]],
+				m_pPositions[pTriangle[2]], fMinDistance, tMax, &t, &u, &v))
+			{
+				return true;
+			}
+		}
+		return false;
+	});
+}
+
+bool TriangleMesh::GetBounds(AABB *bounds)
+{
+	if (m_nNodeCount == 0)
+	{
+		bounds->Reset();
+	}
+	else
+	{
+		*bounds = m_pNodes[0].m_bounds;
+	}
+	return true;
+}
+
+// OBJ parsing. The file is split into chunks at line starts and every chunk
+// is parsed on its own. Face indices are stored as they are resolved within
+// the chunk: absolute indices as zero-based values, relative (negative)
+// indices as a biased chunk-local index that is fixed up once the vertex
+// counts of the preceding chunks are known.
+
+#define OBJ_MIN_CHUNK_SIZE	(1 << 20)
+#define OBJ_NO_INDEX		INT_MIN
+#define OBJ_RELATIVE_BIAS	(1 << 30)
+
+class ObjChunk
+{
+public:
+	ObjChunk() { m_bValid = true; }
+public:
+	const char *m_pBegin;
+	const char *m_pEnd;
+	std::vector<Vector3> m_positions;
+	std::vector<Vector3> m_normals;
+	std::vector<int> m_positionIndices;
+	std::vector<int> m_normalIndices;
+	bool m_bValid;
+};
+
+static inline const char *Obj_SkipSpace(const char *p, const char *pEnd)
+{
+	while (p < pEnd && (*p == ' ' || *p == '\t'))
+	{
+		p++;
+	}
+	return p;
+}
+
+static const double s_objPowers[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Decimal float parser bounded by pEnd, since the mapping is not terminated.
+static const char *Obj_ParseFloat(const char *p, const char *pEnd, float *pValue)
+{
+	p = Obj_SkipSpace(p, pEnd);
+	bool bNegative = false;
+	if (p < pEnd && (*p == '-' || *p == '+'))
+	{
+		bNegative = *p == '-';
+		p++;
+	}
+
+	unsigned long long nMantissa = 0;
+	int nDigits = 0;
+	int nExponent = 0;
+	const char *pStart = p;
+	while (p < pEnd && *p >= '0' && *p <= '9')
+	{
+		if (nDigits < 18)
+		{
+			nMantissa = nMantissa * 10 + (*p - '0');
+			nDigits += nMantissa != 0;
+		}
+		else
+		{
+			nExponent++;
+		}
+		p++;
+	}
+	if (p < pEnd && *p == '.')
+	{
+		p++;
+		while (p < pEnd && *p >= '0' && *p <= '9')
+		{
+			if (nDigits < 18)
+			{
+				nMantissa = nMantissa * 10 + (*p - '0');
+				nDigits += nMantissa != 0;
+				nExponent--;
+			}
+			p++;
+		}
+	}
+	if (p == pStart || (p == pStart + 1 && *pStart == '.'))
+	{
+		return NULL;
+	}
+	if (p < pEnd && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool bNegativeExponent = false;
+		if (p < pEnd && (*p == '-' || *p == '+'))
+		{
+			bNegativeExponent = *p == '-';
+			p++;
+		}
+		int nValue = 0;
+		while (p < pEnd && *p >= '0' && *p <= '9')
+		{
+			nValue = MIN_(nValue * 10 + (*p - '0'), 10000);
+			p++;
+		}
+		nExponent += bNegativeExponent ? -nValue : nValue;
+	}
+
+	double fValue = (double)nMantissa;
+	if (nExponent < 0)
+	{
+		fValue = nExponent >= -22 ? fValue / s_objPowers[-nExponent] : fValue * pow(10.0, nExponent);
+	}
+	else if (nExponent > 0)
+	{
+		fValue = nExponent <= 22 ? fValue * s_objPowers[nExponent] : fValue * pow(10.0, nExponent);
+	}
+	*pValue = (float)(bNegative ? -fValue : fValue);
+
+	// Literals beyond the float range would put infinities into the bounds.
+	return isfinite(*pValue) ? p : NULL;
+}
+
+static const char *Obj_ParseInt(const char *p, const char *pEnd, int *pValue)
+{
+	bool bNegative = false;
+	if (p < pEnd && (*p == '-' || *p == '+'))
+	{
+		bNegative = *p == '-';
+		p++;
+	}
+	const char *pStart = p;
+	long long nValue = 0;
+	while (p < pEnd && *p >= '0' && *p <= '9')
+	{
+		nValue = MIN_(nValue * 10 + (*p - '0'), (long long)INT_MAX);
+		p++;
+	}
+	if (p == pStart)
+	{
+		return NULL;
+	}
+	*pValue = (int)(bNegative ? -nValue : nValue);
+	return p;
+}
+
+// Converts an OBJ index to the chunk encoding described above.
+static inline int Obj_EncodeIndex(int nIndex, int nLocalCount)
+{
+	if (nIndex > 0)
+	{
+		return nIndex - 1;
+	}
+	// Relative indices may reach into earlier chunks, giving a negative local
+	// index; the bias keeps every encoded value negative.
+	int nLocal = nLocalCount + nIndex;
+	if (nIndex == 0 || nLocal <= -OBJ_RELATIVE_BIAS)
+	{
+		return OBJ_NO_INDEX;
+	}
+	return nLocal - OBJ_RELATIVE_BIAS;
+}
+
+static inline int Obj_DecodeIndex(int nEncoded, int nBase)
+{
+	return nEncoded >= 0 ? nEncoded : nBase + nEncoded + OBJ_RELATIVE_BIAS;
+}
+
+static void Obj_ParseChunk(ObjChunk *chunk)
+{
+	const char *p = chunk->m_pBegin;
+	const char *pEnd = chunk->m_pEnd;
+	std::vector<int> facePositions;
+	std::vector<int> faceNormals;
+
+	while (p < pEnd && chunk->m_bValid)
+	{
+		const char *pLineEnd = (const char *)memchr(p, '\n', pEnd - p);
+		if (pLineEnd == NULL)
+		{
+			pLineEnd = pEnd;
+		}
+		const char *pNext = pLineEnd < pEnd ? pLineEnd + 1 : pEnd;
+		if (pLineEnd > p && pLineEnd[-1] == '\r')
+		{
+			pLineEnd--;
+		}
+
+		p = Obj_SkipSpace(p, pLineEnd);
+		if (pLineEnd - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			Vector3 v;
+			const char *q = Obj_ParseFloat(p + 2, pLineEnd, &v.m_x);
+			q = q ? Obj_ParseFloat(q, pLineEnd, &v.m_y) : NULL;
+			q = q ? Obj_ParseFloat(q, pLineEnd, &v.m_z) : NULL;
+			chunk->m_bValid = q != NULL;
+			chunk->m_positions.push_back(v);
+		}
+		else if (pLineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+		{
+			Vector3 n;
+			const char *q = Obj_ParseFloat(p + 3, pLineEnd, &n.m_x);
+			q = q ? Obj_ParseFloat(q, pLineEnd, &n.m_y) : NULL;
+			q = q ? Obj_ParseFloat(q, pLineEnd, &n.m_z) : NULL;
+			chunk->m_bValid = q != NULL;
+			chunk->m_normals.push_back(n);
+		}
+		else if (pLineEnd - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			// v, v/vt, v//vn or v/vt/vn per corner; polygons become fans.
+			facePositions.clear();
+			faceNormals.clear();
+			const char *q = Obj_SkipSpace(p + 2, pLineEnd);
+			while (q && q < pLineEnd)
+			{
+				int nPosition = 0;
+				int nNormal = 0;
+				q = Obj_ParseInt(q, pLineEnd, &nPosition);
+				if (q && q < pLineEnd && *q == '/')
+				{
+					q++;
+					int nTexcoord;
+					if (q < pLineEnd && *q != '/')
+					{
+						q = Obj_ParseInt(q, pLineEnd, &nTexcoord);
+					}
+					if (q && q < pLineEnd && *q == '/')
+					{
+						q = Obj_ParseInt(q + 1, pLineEnd, &nNormal);
+					}
+				}
+				if (q == NULL)
+				{
+					break;
+				}
+				facePositions.push_back(Obj_EncodeIndex(nPosition, chunk->m_positions.size()));
+				faceNormals.push_back(nNormal ? Obj_EncodeIndex(nNormal, chunk->m_normals.size()) : OBJ_NO_INDEX);
+				q = Obj_SkipSpace(q, pLineEnd);
+			}
+			if (q == NULL || facePositions.size() < 3)
+			{
+				chunk->m_bValid = false;
+				break;
+			}
+			int i;
+			for (i = 1; i + 1 < (int)facePositions.size(); i++)
+			{
+				chunk->m_positionIndices.push_back(facePositions[0]);
+				chunk->m_positionIndices.push_back(facePositions[i]);
+				chunk->m_positionIndices.push_back(facePositions[i + 1]);
+				chunk->m_normalIndices.push_back(faceNormals[0]);
+				chunk->m_normalIndices.push_back(faceNormals[i]);
+				chunk->m_normalIndices.push_back(faceNormals[i + 1]);
+			}
+		}
+		p = pNext;
+	}
+}
+
+bool TriangleMesh::LoadOBJ(const char *pszFileName, int nThreadCount)
+{
+	Release();
+
+	MappedFile file;
+	if (!file.Open(pszFileName))
+	{
+		return false;
+	}
+
+	struct stat st;
+	if (stat(pszFileName, &st) == 0)
+	{
+		m_nSourceSize = (long long)st.st_size;
+		m_nSourceTime = (long long)st.st_mtime;
+	}
+
+	if (nThreadCount <= 0)
+	{
+		nThreadCount = ThreadPool::GetHardwareThreadCount();
+	}
+
+	// Chunks end at line breaks; a few per thread let stealing even them out.
+	const char *pData = (const char *)file.GetData();
+	size_t nSize = file.GetSize();
+	int nChunkCount = (int)MIN_((size_t)nThreadCount * 4, nSize / OBJ_MIN_CHUNK_SIZE + 1);
+	std::vector<ObjChunk> chunks(nChunkCount);
+	const char *pBegin = pData;
+	int i;
+	for (i = 0; i < nChunkCount; i++)
+	{
+		const char *pEnd = pData + (size_t)((double)nSize * (i + 1) / nChunkCount);
+		if (i == nChunkCount - 1)
+		{
+			pEnd = pData + nSize;
+		}
+		else
+		{
+			pEnd = MAX_(pEnd, pBegin);
+			const char *pBreak = (const char *)memchr(pEnd, '\n', pData + nSize - pEnd);
+			pEnd = pBreak ? pBreak + 1 : pData + nSize;
+		}
+		chunks[i].m_pBegin = pBegin;
+		chunks[i].m_pEnd = pEnd;
+		pBegin = pEnd;
+	}
+
+	ThreadPool threadPool;
+	threadPool.Start(MIN_(nThreadCount, nChunkCount));
+	threadPool.Run(nChunkCount, [&](int nChunk, int nWorker)
+	{
+		Obj_ParseChunk(&chunks[nChunk]);
+	});
+	threadPool.Stop();
+
+	// Concatenate in file order and resolve the relative indices.
+	int nPositionCount = 0;
+	int nNormalCount = 0;
+	int nCornerCount = 0;
+	for (i = 0; i < nChunkCount; i++)
+	{
+		if (!chunks[i].m_bValid)
+		{
+			return false;
+		}
+		nPositionCount += chunks[i].m_positions.size();
+		nNormalCount += chunks[i].m_normals.size();
+		nCornerCount += chunks[i].m_positionIndices.size();
+	}
+
+	m_positions.reserve(nPositionCount);
+	m_indices.reserve(nCornerCount);
+	std::vector<Vector3> normals;
+	normals.reserve(nNormalCount);
+	bool bNormalsMatch = nNormalCount == nPositionCount;
+	int nPositionBase = 0;
+	int nNormalBase = 0;
+	for (i = 0; i < nChunkCount; i++)
+	{
+		ObjChunk &chunk = chunks[i];
+		m_positions.insert(m_positions.end(), chunk.m_positions.begin(), chunk.m_positions.end());
+		normals.insert(normals.end(), chunk.m_normals.begin(), chunk.m_normals.end());
+		int j;
+		for (j = 0; j < (int)chunk.m_positionIndices.size(); j++)
+		{
+			int nPosition = chunk.m_positionIndices[j];
+			if (nPosition == OBJ_NO_INDEX)
+			{
+				return false;
+			}
+			nPosition = Obj_DecodeIndex(nPosition, nPositionBase);
+			if (nPosition < 0 || nPosition >= nPositionCount)
+			{
+				return false;
+			}
+			m_indices.push_back(nPosition);
+
+			int nNormal = chunk.m_normalIndices[j];
+			if (nNormal != OBJ_NO_INDEX)
+			{
+				nNormal = Obj_DecodeIndex(nNormal, nNormalBase);
+			}
+			bNormalsMatch = bNormalsMatch && nNormal == nPosition;
+		}
+		nPositionBase += chunk.m_positions.size();
+		nNormalBase += chunk.m_normals.size();
+
+		// Free every chunk as soon as it is merged.
+		ObjChunk empty;
+		std::swap(chunk, empty);
+	}
+
+	// Shared vertices carry one normal each, so normals are kept only when
+	// every corner uses the same index for its position and its normal, as
+	// exporters writing one normal per vertex do. Other meshes are shaded
+	// with face normals.
+	if (bNormalsMatch)
+	{
+		m_normals.swap(normals);
+	}
+
+	SetViews();
+	return true;
+}
+
+// Binary cache layout: this header, then the positions, the normals (if
+// any), the triangle indices in leaf order and the BVH nodes, every block
+// starting on a 64 byte boundary. The data is written in the native layout of
+// Vector3 and BVHNode; m_nNodeSize and the version reject caches written by
+// an incompatible build.
+
+#define TRIANGLEMESH_CACHE_ALIGNMENT	64
+
+class TriangleMeshCacheHeader
+{
+public:
+	char m_szMagic[8];
+	int m_nVersion;
+	int m_nNodeSize;
+	int m_nVertexCount;
+	int m_nTriangleCount;
+	int m_nNodeCount;
+	int m_nHasNormals;
+	long long m_nSourceSize;
+	long long m_nSourceTime;
+	unsigned long long m_nPositionOffset;
+	unsigned long long m_nNormalOffset;
+	unsigned long long m_nIndexOffset;
+	unsigned long long m_nNodeOffset;
+	unsigned long long m_nFileSize;
+};
+
+static const char s_szMeshCacheMagic[8] = { 'R', 'T', 'M', 'E', 'S', 'H', 0, 0 };
+
+static unsigned long long TriangleMesh_AlignOffset(unsigned long long nOffset)
+{
+	return (nOffset + TRIANGLEMESH_CACHE_ALIGNMENT - 1) / TRIANGLEMESH_CACHE_ALIGNMENT * TRIANGLEMESH_CACHE_ALIGNMENT;
+}
+
+// Blocks are placed at offsets relative to nBase, the position the cache
+// starts at, so a cache can also be written into a larger file.
+static bool TriangleMesh_WriteBlock(FILE *pFile, long nBase, unsigned long long nOffset, const void *pData, size_t nSize)
+{
+	static const char s_padding[TRIANGLEMESH_CACHE_ALIGNMENT] = { 0 };
+	long nPosition = ftell(pFile) - nBase;
+	if (nPosition < 0 || (unsigned long long)nPosition > nOffset)
+	{
+		return false;
+	}
+	fwrite(s_padding, 1, (size_t)(nOffset - nPosition), pFile);
+	return nSize == 0 || fwrite(pData, 1, nSize, pFile) == nSize;
+}
+
+bool TriangleMesh::WriteCache(FILE *pFile)
+{
+	if (m_nNodeCount == 0)
+	{
+		return false;
+	}
+
+	TriangleMeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.m_szMagic, s_szMeshCacheMagic, sizeof(header.m_szMagic));
+	header.m_nVersion = TRIANGLEMESH_CACHE_VERSION;
+	header.m_nNodeSize = sizeof(BVHNode);
+	header.m_nVertexCount = m_nVertexCount;
+	header.m_nTriangleCount = m_nTriangleCount;
+	header.m_nNodeCount = m_nNodeCount;
+	header.m_nHasNormals = m_pNormals != NULL;
+	header.m_nSourceSize = m_nSourceSize;
+	header.m_nSourceTime = m_nSourceTime;
+
+	size_t nPositionSize = m_nVertexCount * sizeof(Vector3);
+	size_t nNormalSize = m_pNormals ? m_nVertexCount * sizeof(Vector3) : 0;
+	size_t nIndexSize = m_nTriangleCount * 3 * sizeof(int);
+	size_t nNodeSize = m_nNodeCount * sizeof(BVHNode);
+	header.m_nPositionOffset = TriangleMesh_AlignOffset(sizeof(header));
+	header.m_nNormalOffset = TriangleMesh_AlignOffset(header.m_nPositionOffset + nPositionSize);
+	header.m_nIndexOffset = TriangleMesh_AlignOffset(header.m_nNormalOffset + nNormalSize);
+	header.m_nNodeOffset = TriangleMesh_AlignOffset(header.m_nIndexOffset + nIndexSize);
+	header.m_nFileSize = header.m_nNodeOffset + nNodeSize;
+
+	long nBase = ftell(pFile);
+	return nBase >= 0 && fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+		TriangleMesh_WriteBlock(pFile, nBase, header.m_nPositionOffset, m_pPositions, nPositionSize) &&
+		TriangleMesh_WriteBlock(pFile, nBase, header.m_nNormalOffset, m_pNormals, nNormalSize) &&
+		TriangleMesh_WriteBlock(pFile, nBase, header.m_nIndexOffset, m_pIndices, nIndexSize) &&
+		TriangleMesh_WriteBlock(pFile, nBase, header.m_nNodeOffset, m_pNodes, nNodeSize);
+}
+
+bool TriangleMesh::SaveCache(const char *pszFileName)
+{
+	if (m_nNodeCount == 0)
+	{
+		return false;
+	}
+
+	// Write to a temporary name first so a reader never maps a partial cache.
+	std::string tempName = std::string(pszFileName) + ".tmp";
+	FILE *pFile = fopen(tempName.c_str(), "wb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+
+	bool bResult = WriteCache(pFile);
+	bResult = ferror(pFile) == 0 && bResult;
+	fclose(pFile);
+
+	if (bResult)
+	{
+		remove(pszFileName);
+		bResult = rename(tempName.c_str(), pszFileName) == 0;
+	}
+	if (!bResult)
+	{
+		remove(tempName.c_str());
+	}
+	return bResult;
+}
+
+bool TriangleMesh::LoadCache(const char *pszFileName)
+{
+	Release();
+
+	if (!m_mappedFile.Open(pszFileName) || !SetCacheViews(m_mappedFile.GetData(), m_mappedFile.GetSize()))
+	{
+		Release();
+		return false;
+	}
+	return true;
+}
+
+bool TriangleMesh::AttachCache(const unsigned char *pData, size_t nSize)
+{
+	Release();
+
+	if (!SetCacheViews(pData, nSize))
+	{
+		Release();
+		return false;
+	}
+	return true;
+}
+
+// Only the header and the block extents are checked; the blocks themselves
+// are used as they are, so pages are read on first touch.
+bool TriangleMesh::SetCacheViews(const unsigned char *pData, size_t nSize)
+{
+	TriangleMeshCacheHeader header;
+	if (nSize < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&header, pData, sizeof(header));
+
+	int nNormalCount = header.m_nHasNormals ? header.m_nVertexCount : 0;
+	if (memcmp(header.m_szMagic, s_szMeshCacheMagic, sizeof(header.m_szMagic)) != 0 ||
+		header.m_nVersion != TRIANGLEMESH_CACHE_VERSION ||
+		header.m_nNodeSize != (int)sizeof(BVHNode) ||
+		header.m_nFileSize != nSize ||
+		header.m_nVertexCount <= 0 || header.m_nTriangleCount <= 0 || header.m_nNodeCount <= 0 ||
+		!MappedFile_IsInRange(header.m_nPositionOffset, header.m_nVertexCount, sizeof(Vector3), nSize) ||
+		!MappedFile_IsInRange(header.m_nNormalOffset, nNormalCount, sizeof(Vector3), nSize) ||
+		!MappedFile_IsInRange(header.m_nIndexOffset, header.m_nTriangleCount, 3 * sizeof(int), nSize) ||
+		!MappedFile_IsInRange(header.m_nNodeOffset, header.m_nNodeCount, sizeof(BVHNode), nSize))
+	{
+		return false;
+	}
+
+	m_pPositions = (const Vector3 *)(pData + header.m_nPositionOffset);
+	m_pNormals = header.m_nHasNormals ? (const Vector3 *)(pData + header.m_nNormalOffset) : NULL;
+	m_pIndices = (const int *)(pData + header.m_nIndexOffset);
+	m_pNodes = (const BVHNode *)(pData + header.m_nNodeOffset);
+	m_nVertexCount = header.m_nVertexCount;
+	m_nTriangleCount = header.m_nTriangleCount;
+	m_nNodeCount = header.m_nNodeCount;
+	m_nSourceSize = header.m_nSourceSize;
+	m_nSourceTime = header.m_nSourceTime;
+	m_bMapped = true;
+	return true;
+}
+
+bool TriangleMesh::Load(const char *pszFileName, int nThreadCount)
+{
+	std::string cacheName = std::string(pszFileName) + ".rtmesh";
+
+	struct stat st;
+	if (stat(pszFileName, &st) != 0)
+	{
+		return false;
+	}
+	if (LoadCache(cacheName.c_str()) &&
+		m_nSourceSize == (long long)st.st_size &&
+		m_nSourceTime == (long long)st.st_mtime)
+	{
+		return true;
+	}
+
+	if (!LoadOBJ(pszFileName, nThreadCount))
+	{
+		return false;
+	}
+	Initialize();
+
+	// A failed cache write only costs the next start its fast path.
+	SaveCache(cacheName.c_str());
+	return true;
+}
\ No newline at end of file
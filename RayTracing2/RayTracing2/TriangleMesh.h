@@ -0,0 +1,74 @@
+#pragma once
+
+// Indexed triangle mesh with its own BVH. Triangles share the vertex buffer
+// m_positions (plus m_normals when the mesh has per-vertex normals) and
+// m_indices holds three vertex indices per triangle. Initialize() builds the
+// BVH and reorders the triangles into leaf order, so every leaf is a run of
+// triangles and m_nPrimitive of a hit indexes the reordered list. After
+// editing the public vectors in place, call MarkChanged() and the next
+// Initialize() rebuilds the BVH; the Add calls do this themselves. Rays are
+// tested with the watertight algorithm of Woop, Benthin and Wald, so no ray
+// slips through the edge shared by two triangles.
+//
+// LoadOBJ() memory-maps a Wavefront OBJ file and parses it in parallel
+// chunks. SaveCache() writes the vertices, the reordered triangles and the
+// BVH in a binary layout that LoadCache() maps and traces in place: nothing is
+// parsed, copied or built, and the vectors stay empty. Load() combines both,
+// keeping a cache file next to the OBJ file.
+
+#define TRIANGLEMESH_CACHE_VERSION		1
+
+// Hits closer than this are taken as the surface a secondary ray starts on.
+#define TRIANGLEMESH_MIN_DISTANCE		1e-4f
+
+class TriangleMesh : public Geometry
+{
+public:
+	TriangleMesh();
+	~TriangleMesh();
+	int AddVertex(const Vector3 &position);
+	int AddVertex(const Vector3 &position, const Vector3 &normal);
+	int AddTriangle(int nVertex0, int nVertex1, int nVertex2);
+	int GetVertexCount();
+	int GetTriangleCount();
+	void Initialize() override;
+	bool Intersect(Ray3 *ray, IntersectResult *intersectResult) override;
+	void ComputeSurfaceInteraction(Ray3 *ray, IntersectResult *intersectResult) override;
+	bool Occluded(Ray3 *ray, float tMin, float tMax) override;
+	bool GetBounds(AABB *bounds) override;
+	bool LoadOBJ(const char *pszFileName, int nThreadCount);
+	bool SaveCache(const char *pszFileName);
+	bool LoadCache(const char *pszFileName);
+	// Cache image written by WriteCache() into a larger file. AttachCache()
+	// traces it in place; the memory has to outlive the mesh.
+	bool WriteCache(FILE *pFile);
+	bool AttachCache(const unsigned char *pData, size_t nSize);
+	bool Load(const char *pszFileName, int nThreadCount);
+	bool IsMapped();
+public:
+	std::vector<Vector3> m_positions;
+	std::vector<Vector3> m_normals;
+	std::vector<int> m_indices;
+private:
+	void Release();
+	void Detach();
+	void SetViews();
+	bool SetCacheViews(const unsigned char *pData, size_t nSize);
+	std::vector<BVHNode> m_nodes;
+	MappedFile m_mappedFile;
+	// What tracing reads: the vectors above or the mapped cache.
+	const Vector3 *m_pPositions;
+	const Vector3 *m_pNormals;
+	const int *m_pIndices;
+	const BVHNode *m_pNodes;
+	int m_nVertexCount;
+	int m_nTriangleCount;
+	int m_nNodeCount;
+	bool m_bMapped;
+	// m_nVersion the BVH in m_nodes was built for.
+	unsigned int m_nBuildVersion;
+	// Size and modification time of the OBJ file the mesh came from, used
+	// to tell whether a cache is stale.
+	long long m_nSourceSize;
+	long long m_nSourceTime;
+};
\ No newline at end of file
@@ -0,0 +1,231 @@
+#pragma once
+
+// Header-only vector math. Vector3 and Color are trivially copyable value types
+// with constexpr constructors, operators and const member functions, so every
+// expression inlines into its caller. Each operation rounds exactly like the
+// out-of-line methods it replaced; the named methods (Add, Multiply, ...) stay
+// as aliases of the operators.
+//
+// Vec3A and Color4 hold the same three floats in one 16-byte SSE register with
+// an unused fourth lane. Their arithmetic is lane-wise and Dot sums x, y and z
+// in the same order as Vector3, so both forms produce bit-identical results.
+// NormalizeFast() trades the last bit of accuracy for a reciprocal square root
+// estimate refined by one Newton-Raphson step.
+
+#if defined(RT_SIMD_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RT_MATH_SSE
+#endif
+
+inline float Math_RSqrtFast(float x)
+{
+#ifdef RT_MATH_SSE
+	float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#else
+	float y = 1.0f / sqrtf(x);
+#endif
+	return y * (1.5f - 0.5f * x * y * y);
+}
+
+class Vector3
+{
+public:
+	constexpr Vector3() : m_x(0.0f), m_y(0.0f), m_z(0.0f) {}
+	constexpr Vector3(float x, float y, float z) : m_x(x), m_y(y), m_z(z) {}
+	constexpr Vector3 Copy() const { return *this; }
+	float Length() const { return sqrtf(SqrLength()); }
+	constexpr float SqrLength() const { return m_x * m_x + m_y * m_y + m_z * m_z; }
+	Vector3 Normalize() const { return *this * (1.0f / Length()); }
+	Vector3 NormalizeFast() const { return *this * Math_RSqrtFast(SqrLength()); }
+	constexpr Vector3 operator-() const { return Vector3(-m_x, -m_y, -m_z); }
+	constexpr Vector3 operator+(const Vector3 &v) const { return Vector3(m_x + v.m_x, m_y + v.m_y, m_z + v.m_z); }
+	constexpr Vector3 operator-(const Vector3 &v) const { return Vector3(m_x - v.m_x, m_y - v.m_y, m_z - v.m_z); }
+	constexpr Vector3 operator*(float f) const { return Vector3(m_x * f, m_y * f, m_z * f); }
+	// Divides through the reciprocal, like the original Divide().
+	constexpr Vector3 operator/(float f) const { return *this * (1.0f / f); }
+	Vector3 &operator+=(const Vector3 &v) { *this = *this + v; return *this; }
+	Vector3 &operator-=(const Vector3 &v) { *this = *this - v; return *this; }
+	Vector3 &operator*=(float f) { *this = *this * f; return *this; }
+	constexpr float Dot(const Vector3 &v) const { return m_x * v.m_x + m_y * v.m_y + m_z * v.m_z; }
+	constexpr Vector3 Cross(const Vector3 &v) const
+	{
+		return Vector3(-m_z * v.m_y + m_y * v.m_z,
+			m_z * v.m_x - m_x * v.m_z,
+			-m_y * v.m_x + m_x * v.m_y);
+	}
+	constexpr Vector3 Negate() const { return -*this; }
+	constexpr Vector3 Add(const Vector3 &v) const { return *this + v; }
+	constexpr Vector3 Subtract(const Vector3 &v) const { return *this - v; }
+	constexpr Vector3 Multiply(float f) const { return *this * f; }
+	constexpr Vector3 Divide(float f) const { return *this / f; }
+	static Vector3 s_zero;
+public:
+	float m_x;
+	float m_y;
+	float m_z;
+};
+
+constexpr Vector3 operator*(float f, const Vector3 &v)
+{
+	return v * f;
+}
+
+class Color
+{
+public:
+	constexpr Color() : m_r(0.0f), m_g(0.0f), m_b(0.0f) {}
+	constexpr Color(float r, float g, float b) : m_r(r), m_g(g), m_b(b) {}
+	constexpr Color operator+(const Color &c) const { return Color(m_r + c.m_r, m_g + c.m_g, m_b + c.m_b); }
+	constexpr Color operator*(float s) const { return Color(m_r * s, m_g * s, m_b * s); }
+	// Component-wise product, the original Modulate().
+	constexpr Color operator*(const Color &c) const { return Color(m_r * c.m_r, m_g * c.m_g, m_b * c.m_b); }
+	Color &operator+=(const Color &c) { *this = *this + c; return *this; }
+	Color &operator*=(float s) { *this = *this * s; return *this; }
+	constexpr Color Add(const Color &c) const { return *this + c; }
+	constexpr Color Multiply(float s) const { return *this * s; }
+	constexpr Color Modulate(const Color &c) const { return *this * c; }
+	void Saturate()
+	{
+		m_r = MIN_(m_r, 1.0f);
+		m_g = MIN_(m_g, 1.0f);
+		m_b = MIN_(m_b, 1.0f);
+	}
+public:
+	float m_r;
+	float m_g;
+	float m_b;
+public:
+	static Color s_black;
+	static Color s_white;
+	static Color s_red;
+	static Color s_green;
+	static Color s_blue;
+	static Color s_yellow;
+};
+
+constexpr Color operator*(float s, const Color &c)
+{
+	return c * s;
+}
+
+#ifdef RT_MATH_SSE
+
+class alignas(16) Vec3A
+{
+public:
+	Vec3A() : m_v(_mm_setzero_ps()) {}
+	explicit Vec3A(__m128 v) : m_v(v) {}
+	Vec3A(float x, float y, float z) : m_v(_mm_set_ps(0.0f, z, y, x)) {}
+	explicit Vec3A(const Vector3 &v) : m_v(_mm_set_ps(0.0f, v.m_z, v.m_y, v.m_x)) {}
+	Vector3 ToVector3() const
+	{
+		alignas(16) float f[4];
+		_mm_store_ps(f, m_v);
+		return Vector3(f[0], f[1], f[2]);
+	}
+	float X() const { return _mm_cvtss_f32(m_v); }
+	float Y() const { return _mm_cvtss_f32(_mm_shuffle_ps(m_v, m_v, _MM_SHUFFLE(1, 1, 1, 1))); }
+	float Z() const { return _mm_cvtss_f32(_mm_shuffle_ps(m_v, m_v, _MM_SHUFFLE(2, 2, 2, 2))); }
+	Vec3A operator-() const { return Vec3A(_mm_xor_ps(m_v, _mm_set1_ps(-0.0f))); }
+	Vec3A operator+(const Vec3A &v) const { return Vec3A(_mm_add_ps(m_v, v.m_v)); }
+	Vec3A operator-(const Vec3A &v) const { return Vec3A(_mm_sub_ps(m_v, v.m_v)); }
+	Vec3A operator*(float f) const { return Vec3A(_mm_mul_ps(m_v, _mm_set1_ps(f))); }
+	Vec3A operator/(float f) const { return *this * (1.0f / f); }
+	Vec3A &operator+=(const Vec3A &v) { m_v = _mm_add_ps(m_v, v.m_v); return *this; }
+	Vec3A &operator-=(const Vec3A &v) { m_v = _mm_sub_ps(m_v, v.m_v); return *this; }
+	Vec3A &operator*=(float f) { m_v = _mm_mul_ps(m_v, _mm_set1_ps(f)); return *this; }
+	float Dot(const Vec3A &v) const
+	{
+		__m128 p = _mm_mul_ps(m_v, v.m_v);
+		__m128 y = _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 z = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2));
+		return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(p, y), z));
+	}
+	// (y, z, x) * (v.z, v.x, v.y) - (z, x, y) * (v.y, v.z, v.x), which rounds
+	// like Vector3::Cross.
+	Vec3A Cross(const Vec3A &v) const
+	{
+		__m128 a = _mm_shuffle_ps(m_v, m_v, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 b = _mm_shuffle_ps(v.m_v, v.m_v, _MM_SHUFFLE(3, 1, 0, 2));
+		__m128 c = _mm_shuffle_ps(m_v, m_v, _MM_SHUFFLE(3, 1, 0, 2));
+		__m128 d = _mm_shuffle_ps(v.m_v, v.m_v, _MM_SHUFFLE(3, 0, 2, 1));
+		return Vec3A(_mm_sub_ps(_mm_mul_ps(a, b), _mm_mul_ps(c, d)));
+	}
+	float SqrLength() const { return Dot(*this); }
+	float Length() const { return sqrtf(SqrLength()); }
+	Vec3A Normalize() const { return *this * (1.0f / Length()); }
+	Vec3A NormalizeFast() const { return *this * Math_RSqrtFast(SqrLength()); }
+public:
+	__m128 m_v;
+};
+
+class alignas(16) Color4
+{
+public:
+	Color4() : m_v(_mm_setzero_ps()) {}
+	explicit Color4(__m128 v) : m_v(v) {}
+	Color4(float r, float g, float b) : m_v(_mm_set_ps(0.0f, b, g, r)) {}
+	explicit Color4(const Color &c) : m_v(_mm_set_ps(0.0f, c.m_b, c.m_g, c.m_r)) {}
+	Color ToColor() const
+	{
+		alignas(16) float f[4];
+		_mm_store_ps(f, m_v);
+		return Color(f[0], f[1], f[2]);
+	}
+	Color4 operator+(const Color4 &c) const { return Color4(_mm_add_ps(m_v, c.m_v)); }
+	Color4 operator*(float s) const { return Color4(_mm_mul_ps(m_v, _mm_set1_ps(s))); }
+	Color4 operator*(const Color4 &c) const { return Color4(_mm_mul_ps(m_v, c.m_v)); }
+	Color4 &operator+=(const Color4 &c) { m_v = _mm_add_ps(m_v, c.m_v); return *this; }
+	Color4 &operator*=(float s) { m_v = _mm_mul_ps(m_v, _mm_set1_ps(s)); return *this; }
+public:
+	__m128 m_v;
+};
+
+#else
+
+// Scalar stand-ins with the same interface for targets without SSE.
+
+class alignas(16) Vec3A
+{
+public:
+	Vec3A() : m_v(0.0f, 0.0f, 0.0f) {}
+	Vec3A(float x, float y, float z) : m_v(x, y, z) {}
+	explicit Vec3A(const Vector3 &v) : m_v(v) {}
+	Vector3 ToVector3() const { return m_v; }
+	float X() const { return m_v.m_x; }
+	float Y() const { return m_v.m_y; }
+	float Z() const { return m_v.m_z; }
+	Vec3A operator-() const { return Vec3A(-m_v); }
+	Vec3A operator+(const Vec3A &v) const { return Vec3A(m_v + v.m_v); }
+	Vec3A operator-(const Vec3A &v) const { return Vec3A(m_v - v.m_v); }
+	Vec3A operator*(float f) const { return Vec3A(m_v * f); }
+	Vec3A operator/(float f) const { return Vec3A(m_v / f); }
+	Vec3A &operator+=(const Vec3A &v) { m_v += v.m_v; return *this; }
+	Vec3A &operator-=(const Vec3A &v) { m_v -= v.m_v; return *this; }
+	Vec3A &operator*=(float f) { m_v *= f; return *this; }
+	float Dot(const Vec3A &v) const { return m_v.Dot(v.m_v); }
+	Vec3A Cross(const Vec3A &v) const { return Vec3A(m_v.Cross(v.m_v)); }
+	float SqrLength() const { return m_v.SqrLength(); }
+	float Length() const { return m_v.Length(); }
+	Vec3A Normalize() const { return Vec3A(m_v.Normalize()); }
+	Vec3A NormalizeFast() const { return Vec3A(m_v.NormalizeFast()); }
+public:
+	Vector3 m_v;
+};
+
+class alignas(16) Color4
+{
+public:
+	Color4() : m_v(0.0f, 0.0f, 0.0f) {}
+	Color4(float r, float g, float b) : m_v(r, g, b) {}
+	explicit Color4(const Color &c) : m_v(c) {}
+	Color ToColor() const { return m_v; }
+	Color4 operator+(const Color4 &c) const { return Color4(m_v + c.m_v); }
+	Color4 operator*(float s) const { return Color4(m_v * s); }
+	Color4 operator*(const Color4 &c) const { return Color4(m_v * c.m_v); }
+	Color4 &operator+=(const Color4 &c) { m_v += c.m_v; return *this; }
+	Color4 &operator*=(float s) { m_v *= s; return *this; }
+public:
+	Color m_v;
+};
+
+#endif
\ No newline at end of file
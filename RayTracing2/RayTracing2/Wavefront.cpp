@@ -0,0 +1,443 @@
+#include "Wavefront.h"
+
+#define WAVEFRONT_MAX_BOUNCES	(RENDER_MAX_REFLECT + 1)
+
+WavefrontRenderer::WavefrontRenderer()
+{
+	m_nCapacity = 0;
+	m_nPathCount = 0;
+	m_nRayCount = 0;
+	m_nHitCount = 0;
+	m_nShadowCount = 0;
+	m_pKernels = NULL;
+}
+
+WavefrontRenderer::~WavefrontRenderer()
+{
+
+}
+
+void WavefrontRenderer::Reserve(int nCapacity)
+{
+	if (nCapacity <= m_nCapacity)
+	{
+		return;
+	}
+	m_nCapacity = nCapacity;
+
+	m_rayPath.resize(nCapacity);
+	m_rayOriginX.resize(nCapacity);
+	m_rayOriginY.resize(nCapacity);
+	m_rayOriginZ.resize(nCapacity);
+	m_rayDirectionX.resize(nCapacity);
+	m_rayDirectionY.resize(nCapacity);
+	m_rayDirectionZ.resize(nCapacity);
+
+	m_hitRay.resize(nCapacity);
+	m_hitGeometry.resize(nCapacity);
+	m_hitPrimitive.resize(nCapacity);
+	m_hitDistance.resize(nCapacity);
+	m_hitU.resize(nCapacity);
+	m_hitV.resize(nCapacity);
+	m_hitMaterial.resize(nCapacity);
+	m_hitPositionX.resize(nCapacity);
+	m_hitPositionY.resize(nCapacity);
+	m_hitPositionZ.resize(nCapacity);
+	m_hitNormalX.resize(nCapacity);
+	m_hitNormalY.resize(nCapacity);
+	m_hitNormalZ.resize(nCapacity);
+	m_hitColor.resize(nCapacity);
+	m_hitLight.resize(nCapacity);
+	m_hitMaterialIndex.resize(nCapacity);
+	m_shadeOrder.resize(nCapacity);
+
+	m_shadowHit.resize(nCapacity);
+	m_shadowDistance.resize(nCapacity);
+	m_shadowLX.resize(nCapacity);
+	m_shadowLY.resize(nCapacity);
+	m_shadowLZ.resize(nCapacity);
+	m_shadowLight.resize(nCapacity);
+	m_shadowOccluded.resize(nCapacity);
+
+	m_pathDepth.resize(nCapacity);
+	m_pathColor.resize(nCapacity * WAVEFRONT_MAX_BOUNCES);
+	m_pathReflect.resize(nCapacity * WAVEFRONT_MAX_BOUNCES);
+}
+
+unsigned int WavefrontRenderer::RenderChunk(Scene *scene, PerspectiveCamera *camera, FrameBuffer *frameBuffer, int nBegin, int nEnd, bool bPackets)
+{
+	Reserve(nEnd - nBegin);
+	m_pKernels = bPackets ? Simd_GetKernels() : NULL;
+
+	unsigned int nRayCount = 0;
+	{
+		RT_STAT_TIMER(STAT_TIMER_GENERATE);
+		Generate(camera, frameBuffer, nBegin, nEnd);
+	}
+	RT_STAT_ADD(STAT_PRIMARY_RAYS, m_nRayCount);
+
+	int nDepth;
+	for (nDepth = 0; nDepth <= RENDER_MAX_REFLECT && m_nRayCount > 0; nDepth++)
+	{
+		nRayCount += m_nRayCount;
+		{
+			RT_STAT_TIMER(STAT_TIMER_TRAVERSE);
+			Extend(scene);
+		}
+		RT_STAT_TIMER(STAT_TIMER_SHADE);
+		Shade(scene);
+		Compact(nDepth);
+	}
+
+	Resolve(frameBuffer, nBegin);
+	return nRayCount;
+}
+
+void WavefrontRenderer::Generate(PerspectiveCamera *camera, FrameBuffer *frameBuffer, int nBegin, int nEnd)
+{
+	int nWidth = frameBuffer->m_nWidth;
+	int nHeight = frameBuffer->m_nHeight;
+	Ray3 ray;
+
+	m_nPathCount = nEnd - nBegin;
+	m_nRayCount = m_nPathCount;
+	int i;
+	for (i = 0; i < m_nRayCount; i++)
+	{
+		int x = (nBegin + i) % nWidth;
+		int y = (nBegin + i) / nWidth;
+		float sy = 1 - y / (float)nHeight;
+		float sx = x / (float)nWidth;
+		camera->GenerateRay(sx, sy, &ray);
+
+		m_rayPath[i] = i;
+		m_rayOriginX[i] = ray.m_origin.m_x;
+		m_rayOriginY[i] = ray.m_origin.m_y;
+		m_rayOriginZ[i] = ray.m_origin.m_z;
+		m_rayDirectionX[i] = ray.m_direction.m_x;
+		m_rayDirectionY[i] = ray.m_direction.m_y;
+		m_rayDirectionZ[i] = ray.m_direction.m_z;
+		m_pathDepth[i] = 0;
+	}
+}
+
+void WavefrontRenderer::Extend(Scene *scene)
+{
+	// A miss ends its path with a black bounce; hits are appended in ray order.
+	m_nHitCount = 0;
+	int i;
+	if (m_pKernels)
+	{
+		// The queue is already structure of arrays, so it is cut straight into
+		// packets of the native SIMD width.
+		int nWidth = m_pKernels->m_nWidth;
+		RayPacket packet;
+		int nBase;
+		for (nBase = 0; nBase < m_nRayCount; nBase += nWidth)
+		{
+			int nSize = MIN_(nWidth, m_nRayCount - nBase);
+			packet.Reset(nWidth, (1u << nSize) - 1);
+			for (i = 0; i < nWidth; i++)
+			{
+				int nRay = nBase + MIN_(i, nSize - 1);
+				packet.m_originX[i] = m_rayOriginX[nRay];
+				packet.m_originY[i] = m_rayOriginY[nRay];
+				packet.m_originZ[i] = m_rayOriginZ[nRay];
+				packet.m_directionX[i] = m_rayDirectionX[nRay];
+				packet.m_directionY[i] = m_rayDirectionY[nRay];
+				packet.m_directionZ[i] = m_rayDirectionZ[nRay];
+			}
+			scene->m_root->IntersectPacket(&packet);
+			for (i = 0; i < nSize; i++)
+			{
+				if (packet.m_geometry[i])
+				{
+					int nHit = m_nHitCount++;
+					m_hitRay[nHit] = nBase + i;
+					m_hitGeometry[nHit] = packet.m_geometry[i];
+					m_hitPrimitive[nHit] = packet.m_nPrimitive[i];
+					m_hitDistance[nHit] = packet.m_distance[i];
+					m_hitU[nHit] = packet.m_u[i];
+					m_hitV[nHit] = packet.m_v[i];
+				}
+				else
+				{
+					AddMiss(nBase + i);
+				}
+			}
+		}
+		return;
+	}
+
+	for (i = 0; i < m_nRayCount; i++)
+	{
+		Ray3 ray(Vector3(m_rayOriginX[i], m_rayOriginY[i], m_rayOriginZ[i]),
+			Vector3(m_rayDirectionX[i], m_rayDirectionY[i], m_rayDirectionZ[i]));
+		IntersectResult result;
+		if (!scene->m_root->Intersect(&ray, &result))
+		{
+			AddMiss(i);
+			continue;
+		}
+
+		int nHit = m_nHitCount++;
+		m_hitRay[nHit] = i;
+		m_hitGeometry[nHit] = result.m_geometry;
+		m_hitPrimitive[nHit] = result.m_nPrimitive;
+		m_hitDistance[nHit] = result.m_distance;
+		m_hitU[nHit] = result.m_u;
+		m_hitV[nHit] = result.m_v;
+	}
+}
+
+void WavefrontRenderer::AddMiss(int nRay)
+{
+	int nPath = m_rayPath[nRay];
+	int nBounce = nPath * WAVEFRONT_MAX_BOUNCES + m_pathDepth[nPath]++;
+	m_pathColor[nBounce] = Color::s_black;
+	m_pathReflect[nBounce] = 0.0f;
+}
+
+void WavefrontRenderer::Shade(Scene *scene)
+{
+	int i;
+	for (i = 0; i < m_nHitCount; i++)
+	{
+		int nRay = m_hitRay[i];
+		Ray3 ray(Vector3(m_rayOriginX[nRay], m_rayOriginY[nRay], m_rayOriginZ[nRay]),
+			Vector3(m_rayDirectionX[nRay], m_rayDirectionY[nRay], m_rayDirectionZ[nRay]));
+		IntersectResult result;
+		result.m_geometry = m_hitGeometry[i];
+		result.m_nPrimitive = m_hitPrimitive[i];
+		result.m_distance = m_hitDistance[i];
+		result.m_u = m_hitU[i];
+		result.m_v = m_hitV[i];
+		result.m_geometry->ComputeSurfaceInteraction(&ray, &result);
+
+		m_hitMaterial[i] = result.m_material;
+		m_hitPositionX[i] = result.m_position.m_x;
+		m_hitPositionY[i] = result.m_position.m_y;
+		m_hitPositionZ[i] = result.m_position.m_z;
+		m_hitNormalX[i] = result.m_normal.m_x;
+		m_hitNormalY[i] = result.m_normal.m_y;
+		m_hitNormalZ[i] = result.m_normal.m_z;
+		m_hitLight[i] = Color::s_black;
+	}
+
+	// Group the hits by material with a counting sort so consecutive Sample
+	// calls go through the same virtual function and material data. Scenes
+	// have few materials, so a linear lookup with a one entry cache is enough.
+	m_materials.clear();
+	m_materialCounts.clear();
+	int nMaterial = -1;
+	for (i = 0; i < m_nHitCount; i++)
+	{
+		if (nMaterial < 0 || m_materials[nMaterial] != m_hitMaterial[i])
+		{
+			nMaterial = std::find(m_materials.begin(), m_materials.end(), m_hitMaterial[i]) - m_materials.begin();
+			if (nMaterial == (int)m_materials.size())
+			{
+				m_materials.push_back(m_hitMaterial[i]);
+				m_materialCounts.push_back(0);
+			}
+		}
+		m_hitMaterialIndex[i] = nMaterial;
+		m_materialCounts[nMaterial]++;
+	}
+	int nOffset = 0;
+	int j;
+	for (j = 0; j < (int)m_materialCounts.size(); j++)
+	{
+		int nCount = m_materialCounts[j];
+		m_materialCounts[j] = nOffset;
+		nOffset += nCount;
+	}
+	for (i = 0; i < m_nHitCount; i++)
+	{
+		m_shadeOrder[m_materialCounts[m_hitMaterialIndex[i]]++] = i;
+	}
+
+	for (i = 0; i < m_nHitCount; i++)
+	{
+		int nHit = m_shadeOrder[i];
+		int nRay = m_hitRay[nHit];
+		Ray3 ray(Vector3(m_rayOriginX[nRay], m_rayOriginY[nRay], m_rayOriginZ[nRay]),
+			Vector3(m_rayDirectionX[nRay], m_rayDirectionY[nRay], m_rayDirectionZ[nRay]));
+		Vector3 position(m_hitPositionX[nHit], m_hitPositionY[nHit], m_hitPositionZ[nHit]);
+		Vector3 normal(m_hitNormalX[nHit], m_hitNormalY[nHit], m_hitNormalZ[nHit]);
+		m_hitColor[nHit] = m_hitMaterial[nHit]->Sample(&ray, &position, &normal);
+	}
+
+	// Lights are the outer loop so every hit accumulates them in scene order,
+	// like Renderer::Shade. Light sampling does not depend on the material, so
+	// it walks the hits sequentially.
+	int nLightCount = scene->m_vecLightList.size();
+	int nLight;
+	for (nLight = 0; nLight < nLightCount; nLight++)
+	{
+		Light *light = scene->m_vecLightList[nLight];
+		m_nShadowCount = 0;
+		RT_STAT_ADD(STAT_LIGHT_SAMPLES, m_nHitCount);
+		for (i = 0; i < m_nHitCount; i++)
+		{
+			Vector3 position(m_hitPositionX[i], m_hitPositionY[i], m_hitPositionZ[i]);
+			LightSample lightSample;
+			float distance;
+			if (!light->Illuminate(&lightSample, position, &distance))
+			{
+				continue;
+			}
+			if (lightSample.m_EL.m_r <= 0.0f &&
+				lightSample.m_EL.m_g <= 0.0f &&
+				lightSample.m_EL.m_b <= 0.0f)
+			{
+				continue;
+			}
+
+			Vector3 normal(m_hitNormalX[i], m_hitNormalY[i], m_hitNormalZ[i]);
+			float NdotL = normal.Dot(lightSample.m_L);
+			if (NdotL <= 0.0f)
+			{
+				continue;
+			}
+
+			Color contribution = lightSample.m_EL.Multiply(NdotL);
+			if (!light->m_shadow)
+			{
+				m_hitLight[i] = m_hitLight[i].Add(contribution);
+				continue;
+			}
+
+			// Only lit hits that face the light need a shadow ray.
+			int nShadow = m_nShadowCount++;
+			m_shadowHit[nShadow] = i;
+			m_shadowDistance[nShadow] = distance;
+			m_shadowLX[nShadow] = lightSample.m_L.m_x;
+			m_shadowLY[nShadow] = lightSample.m_L.m_y;
+			m_shadowLZ[nShadow] = lightSample.m_L.m_z;
+			m_shadowLight[nShadow] = contribution;
+		}
+
+		Shadow(scene);
+
+		for (i = 0; i < m_nShadowCount; i++)
+		{
+			if (!m_shadowOccluded[i])
+			{
+				int nHit = m_shadowHit[i];
+				m_hitLight[nHit] = m_hitLight[nHit].Add(m_shadowLight[i]);
+			}
+		}
+	}
+
+	for (i = 0; i < m_nHitCount; i++)
+	{
+		float reflectiveness = m_hitMaterial[i]->m_reflectiveness;
+		Color color = m_hitColor[i].Modulate(m_hitLight[i]);
+		color = color.Multiply(1 - reflectiveness);
+
+		int nPath = m_rayPath[m_hitRay[i]];
+		int nBounce = nPath * WAVEFRONT_MAX_BOUNCES + m_pathDepth[nPath]++;
+		m_pathColor[nBounce] = color;
+		m_pathReflect[nBounce] = reflectiveness;
+	}
+}
+
+void WavefrontRenderer::Shadow(Scene *scene)
+{
+	RT_STAT_ADD(STAT_SHADOW_RAYS, m_nShadowCount);
+	RT_STAT_TIMER(STAT_TIMER_TRAVERSE);
+	int i;
+	if (m_pKernels)
+	{
+		int nWidth = m_pKernels->m_nWidth;
+		RayPacket packet;
+		int nBase;
+		for (nBase = 0; nBase < m_nShadowCount; nBase += nWidth)
+		{
+			int nSize = MIN_(nWidth, m_nShadowCount - nBase);
+			packet.Reset(nWidth, (1u << nSize) - 1);
+			for (i = 0; i < nWidth; i++)
+			{
+				int nShadow = nBase + MIN_(i, nSize - 1);
+				int nHit = m_shadowHit[nShadow];
+				packet.m_originX[i] = m_hitPositionX[nHit];
+				packet.m_originY[i] = m_hitPositionY[nHit];
+				packet.m_originZ[i] = m_hitPositionZ[nHit];
+				packet.m_directionX[i] = m_shadowLX[nShadow];
+				packet.m_directionY[i] = m_shadowLY[nShadow];
+				packet.m_directionZ[i] = m_shadowLZ[nShadow];
+				packet.m_distance[i] = m_shadowDistance[nShadow];
+			}
+			scene->m_root->OccludedPacket(&packet, 0.0f);
+			for (i = 0; i < nSize; i++)
+			{
+				m_shadowOccluded[nBase + i] = (packet.m_nOccludedMask >> i) & 1;
+			}
+		}
+		return;
+	}
+
+	for (i = 0; i < m_nShadowCount; i++)
+	{
+		int nHit = m_shadowHit[i];
+		Ray3 shadowRay(Vector3(m_hitPositionX[nHit], m_hitPositionY[nHit], m_hitPositionZ[nHit]),
+			Vector3(m_shadowLX[i], m_shadowLY[i], m_shadowLZ[i]));
+		m_shadowOccluded[i] = scene->m_root->Occluded(&shadowRay, 0.0f, m_shadowDistance[i]) ? 1 : 0;
+	}
+}
+
+void WavefrontRenderer::Compact(int nDepth)
+{
+	// Reflection rays overwrite the ray queue in place: hit i belongs to a ray
+	// at index >= i, so the source is always read before it is overwritten.
+	int nCount = 0;
+	int i;
+	for (i = 0; i < m_nHitCount; i++)
+	{
+		float reflectiveness = m_hitMaterial[i]->m_reflectiveness;
+		if (reflectiveness <= 0 || nDepth >= RENDER_MAX_REFLECT)
+		{
+			continue;
+		}
+
+		int nRay = m_hitRay[i];
+		Vector3 direction(m_rayDirectionX[nRay], m_rayDirectionY[nRay], m_rayDirectionZ[nRay]);
+		Vector3 normal(m_hitNormalX[i], m_hitNormalY[i], m_hitNormalZ[i]);
+		Vector3 r = normal.Multiply(-2.0f * normal.Dot(direction)).Add(direction);
+
+		m_rayPath[nCount] = m_rayPath[nRay];
+		m_rayOriginX[nCount] = m_hitPositionX[i];
+		m_rayOriginY[nCount] = m_hitPositionY[i];
+		m_rayOriginZ[nCount] = m_hitPositionZ[i];
+		m_rayDirectionX[nCount] = r.m_x;
+		m_rayDirectionY[nCount] = r.m_y;
+		m_rayDirectionZ[nCount] = r.m_z;
+		nCount++;
+	}
+	m_nRayCount = nCount;
+	RT_STAT_ADD(STAT_REFLECTION_RAYS, nCount);
+}
+
+void WavefrontRenderer::Resolve(FrameBuffer *frameBuffer, int nBegin)
+{
+	int nWidth = frameBuffer->m_nWidth;
+	int nPath;
+	for (nPath = 0; nPath < m_nPathCount; nPath++)
+	{
+		// Innermost bounce first, in the order the recursion unwinds.
+		Color *pColors = &m_pathColor[nPath * WAVEFRONT_MAX_BOUNCES];
+		float *pReflect = &m_pathReflect[nPath * WAVEFRONT_MAX_BOUNCES];
+		int nBounce = m_pathDepth[nPath] - 1;
+		RT_STAT_INC(STAT_DEPTH_0 + nBounce);
+		Color color = pColors[nBounce];
+		while (nBounce > 0)
+		{
+			nBounce--;
+			color = pColors[nBounce].Add(color.Multiply(pReflect[nBounce]));
+		}
+
+		int nPixel = nBegin + nPath;
+		frameBuffer->SetColor(nPixel % nWidth, nPixel / nWidth, color);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+// Breadth-first alternative to Renderer::RayTraceRecursive. A chunk of pixels
+// is traced one stage at a time over structure-of-arrays queues: generate the
+// camera rays, extend every ray to its closest hit, shade the hits grouped by
+// material, test the shadow rays of each light in one batch, and compact the
+// reflecting paths into the ray queue of the next bounce. Each bounce records
+// its local color and reflection weight; Resolve composes them back to front
+// in the same order as Renderer::Shade, so the image is bit-identical.
+
+#define WAVEFRONT_CHUNK_SIZE	4096
+
+class WavefrontRenderer
+{
+public:
+	WavefrontRenderer();
+	~WavefrontRenderer();
+	// Renders pixels [nBegin, nEnd) in scanline order; returns the number of
+	// camera and reflection rays traced. bPackets runs the extend and shadow
+	// stages in SIMD packets when the CPU has packet kernels.
+	unsigned int RenderChunk(Scene *scene, PerspectiveCamera *camera, FrameBuffer *frameBuffer, int nBegin, int nEnd, bool bPackets);
+private:
+	void Reserve(int nCapacity);
+	void Generate(PerspectiveCamera *camera, FrameBuffer *frameBuffer, int nBegin, int nEnd);
+	void Extend(Scene *scene);
+	void AddMiss(int nRay);
+	void Shade(Scene *scene);
+	void Shadow(Scene *scene);
+	void Compact(int nDepth);
+	void Resolve(FrameBuffer *frameBuffer, int nBegin);
+private:
+	int m_nCapacity;
+	int m_nPathCount;
+	const SimdKernels *m_pKernels;
+
+	// Rays of the current bounce.
+	int m_nRayCount;
+	std::vector<int> m_rayPath;
+	std::vector<float> m_rayOriginX;
+	std::vector<float> m_rayOriginY;
+	std::vector<float> m_rayOriginZ;
+	std::vector<float> m_rayDirectionX;
+	std::vector<float> m_rayDirectionY;
+	std::vector<float> m_rayDirectionZ;
+
+	// Closest hits of the current bounce, in ray order.
+	int m_nHitCount;
+	std::vector<int> m_hitRay;
+	std::vector<Geometry *> m_hitGeometry;
+	std::vector<int> m_hitPrimitive;
+	std::vector<float> m_hitDistance;
+	std::vector<float> m_hitU;
+	std::vector<float> m_hitV;
+	std::vector<Material *> m_hitMaterial;
+	std::vector<float> m_hitPositionX;
+	std::vector<float> m_hitPositionY;
+	std::vector<float> m_hitPositionZ;
+	std::vector<float> m_hitNormalX;
+	std::vector<float> m_hitNormalY;
+	std::vector<float> m_hitNormalZ;
+	std::vector<Color> m_hitColor;
+	std::vector<Color> m_hitLight;
+	// Hit indices sorted by material for the shading stage.
+	std::vector<int> m_hitMaterialIndex;
+	std::vector<int> m_shadeOrder;
+	std::vector<Material *> m_materials;
+	std::vector<int> m_materialCounts;
+
+	// Shadow rays of one light.
+	int m_nShadowCount;
+	std::vector<int> m_shadowHit;
+	std::vector<float> m_shadowDistance;
+	std::vector<float> m_shadowLX;
+	std::vector<float> m_shadowLY;
+	std::vector<float> m_shadowLZ;
+	std::vector<Color> m_shadowLight;
+	std::vector<unsigned char> m_shadowOccluded;
+
+	// Per path: the number of bounces and, for every bounce, its local color
+	// and the weight of the reflection traced from it.
+	std::vector<int> m_pathDepth;
+	std::vector<Color> m_pathColor;
+	std::vector<float> m_pathReflect;
+};
\ No newline at end of file
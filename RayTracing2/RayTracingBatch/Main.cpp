@@ -0,0 +1,564 @@
+#include "../RayTracing2/CoreHeaders.h"
+
+#include "../RayTracing2/Core.cpp"
+
+#include <chrono>
+
+#include <algorithm>
+
+// Headless batch renderer: renders the scene a number of times without any
+// window system and writes every frame as PPM, PFM and/or OpenEXR.
+
+class BatchOptions
+{
+public:
+	BatchOptions();
+	bool Parse(int argc, char **argv);
+	bool ParseFormat(const char *pszValue);
+	static void PrintUsage();
+public:
+	int m_nWidth;
+	int m_nHeight;
+	int m_nFrames;
+	int m_nThreadCount;
+	int m_nTileSize;
+	bool m_bPacketTracing;
+	bool m_bWavefront;
+	bool m_bWritePPM;
+	bool m_bWritePFM;
+	bool m_bWriteEXR;
+	ResolveSettings m_resolveSettings;
+	SampleSettings m_sampleSettings;
+	const char *m_pszOutput;
+	std::vector<const char *> m_vecScenes;
+	const char *m_pszCompile;
+	const char *m_pszStats;
+	// Heatmap metric, HEATMAP_METRIC_COUNT for all of them, or -1.
+	int m_nHeatmap;
+	float m_fHeatmapScale;
+	// Texture cache budget in megabytes, 0 for the default.
+	int m_nTextureCacheMB;
+};
+
+BatchOptions::BatchOptions()
+{
+	m_nWidth = 512;
+	m_nHeight = 512;
+	m_nFrames = 1;
+	m_nThreadCount = 0;
+	m_nTileSize = 32;
+	m_bPacketTracing = true;
+	m_bWavefront = false;
+	m_bWritePPM = true;
+	m_bWritePFM = false;
+	m_bWriteEXR = false;
+	m_pszOutput = "frame";
+	m_pszCompile = NULL;
+	m_pszStats = NULL;
+	m_nHeatmap = -1;
+	m_fHeatmapScale = 0.0f;
+	m_nTextureCacheMB = 0;
+}
+
+void BatchOptions::PrintUsage()
+{
+	printf("usage: RayTracingBatch [options]\n");
+	printf("  -w <width>        image width (default 512)\n");
+	printf("  -h <height>       image height (default 512)\n");
+	printf("  -n <frames>       number of frames to render (default 1)\n");
+	printf("  -threads <count>  render threads, 0 = all cores (default 0)\n");
+	printf("  -tile <size>      tile size in pixels (default 32)\n");
+	printf("  -packets <on|off> trace primary rays in SIMD packets (default on)\n");
+	printf("  -wavefront <on|off> breadth-first wavefront pipeline (default off)\n");
+	printf("  -format <fmt>     comma separated list of ppm, pfm and exr,\n");
+	printf("                    or both (ppm,pfm) or none (default ppm)\n");
+	printf("  -exposure <scale> linear exposure applied before tone mapping (default 1)\n");
+	printf("  -tonemap <op>     clamp, reinhard or aces (default clamp)\n");
+	printf("  -srgb <on|off>    sRGB encode the 8-bit output (default off)\n");
+	printf("  -aa <mode>        off, uniform or adaptive (default off)\n");
+	printf("  -aa-grid <n>      strata per pixel side when refined (default 4)\n");
+	printf("  -aa-threshold <t> contrast that triggers refinement (default 0.05)\n");
+	printf("  -light-samples <n> pick n point and spot lights per hit from the light tree,\n");
+	printf("                    0 = shade with every light (default 0); frame n uses seed n\n");
+	printf("  -o <prefix>       output file prefix (default frame)\n");
+	printf("  -scene <file>     scene file, text or compiled; repeat to render several\n");
+	printf("                    scenes in turn (default: the built-in scene)\n");
+	printf("  -compile <file>   write the scene as a compiled scene file and exit\n");
+	printf("  -stats <file>     write per-frame statistics as JSON (build with make STATS=1)\n");
+	printf("  -heatmap <metric> also write a per-pixel cost image: cycles, intersections,\n");
+	printf("                    shadow, reflections or all (the middle two need make STATS=1)\n");
+	printf("  -heatmap-scale <n> cost shown as red (default: the 99th percentile of each frame)\n");
+	printf("  -texture-cache <MB> memory for texture tiles (default %d)\n", TEXTURECACHE_DEFAULT_BUDGET / (1024 * 1024));
+}
+
+bool BatchOptions::ParseFormat(const char *pszValue)
+{
+	m_bWritePPM = false;
+	m_bWritePFM = false;
+	m_bWriteEXR = false;
+	if (strcmp(pszValue, "none") == 0)
+	{
+		return true;
+	}
+	if (strcmp(pszValue, "both") == 0)
+	{
+		m_bWritePPM = true;
+		m_bWritePFM = true;
+		return true;
+	}
+
+	char szFormat[16];
+	while (*pszValue)
+	{
+		int nLength = (int)strcspn(pszValue, ",");
+		if (nLength == 0 || nLength >= (int)sizeof(szFormat))
+		{
+			return false;
+		}
+		memcpy(szFormat, pszValue, nLength);
+		szFormat[nLength] = 0;
+		if (strcmp(szFormat, "ppm") == 0)
+		{
+			m_bWritePPM = true;
+		}
+		else if (strcmp(szFormat, "pfm") == 0)
+		{
+			m_bWritePFM = true;
+		}
+		else if (strcmp(szFormat, "exr") == 0)
+		{
+			m_bWriteEXR = true;
+		}
+		else
+		{
+			return false;
+		}
+		pszValue += nLength;
+		if (*pszValue == ',')
+		{
+			pszValue++;
+		}
+	}
+	return true;
+}
+
+bool BatchOptions::Parse(int argc, char **argv)
+{
+	int i;
+	for (i = 1; i < argc; i++)
+	{
+		const char *pszArg = argv[i];
+		const char *pszValue = i + 1 < argc ? argv[i + 1] : NULL;
+		if (strcmp(pszArg, "-help") == 0 || strcmp(pszArg, "--help") == 0)
+		{
+			return false;
+		}
+		if (pszValue == NULL)
+		{
+			fprintf(stderr, "missing value for %s\n", pszArg);
+			return false;
+		}
+		if (strcmp(pszArg, "-w") == 0)
+		{
+			m_nWidth = atoi(pszValue);
+		}
+		else if (strcmp(pszArg, "-h") == 0)
+		{
+			m_nHeight = atoi(pszValue);
+		}
+		else if (strcmp(pszArg, "-n") == 0)
+		{
+			m_nFrames = atoi(pszValue);
+		}
+		else if (strcmp(pszArg, "-threads") == 0)
+		{
+			m_nThreadCount = atoi(pszValue);
+		}
+		else if (strcmp(pszArg, "-tile") == 0)
+		{
+			m_nTileSize = atoi(pszValue);
+		}
+		else if (strcmp(pszArg, "-packets") == 0)
+		{
+			m_bPacketTracing = strcmp(pszValue, "off") != 0;
+		}
+		else if (strcmp(pszArg, "-wavefront") == 0)
+		{
+			m_bWavefront = strcmp(pszValue, "on") == 0;
+		}
+		else if (strcmp(pszArg, "-format") == 0)
+		{
+			if (!ParseFormat(pszValue))
+			{
+				fprintf(stderr, "unknown format %s\n", pszValue);
+				return false;
+			}
+		}
+		else if (strcmp(pszArg, "-exposure") == 0)
+		{
+			m_resolveSettings.m_fExposure = (float)atof(pszValue);
+		}
+		else if (strcmp(pszArg, "-tonemap") == 0)
+		{
+			if (strcmp(pszValue, "clamp") == 0)
+			{
+				m_resolveSettings.m_nTonemap = TONEMAP_CLAMP;
+			}
+			else if (strcmp(pszValue, "reinhard") == 0)
+			{
+				m_resolveSettings.m_nTonemap = TONEMAP_REINHARD;
+			}
+			else if (strcmp(pszValue, "aces") == 0)
+			{
+				m_resolveSettings.m_nTonemap = TONEMAP_ACES;
+			}
+			else
+			{
+				fprintf(stderr, "unknown tone mapping %s\n", pszValue);
+				return false;
+			}
+		}
+		else if (strcmp(pszArg, "-srgb") == 0)
+		{
+			m_resolveSettings.m_bSRGB = strcmp(pszValue, "on") == 0;
+		}
+		else if (strcmp(pszArg, "-aa") == 0)
+		{
+			if (strcmp(pszValue, "off") == 0)
+			{
+				m_sampleSettings.m_nMode = SAMPLING_SINGLE;
+			}
+			else if (strcmp(pszValue, "uniform") == 0)
+			{
+				m_sampleSettings.m_nMode = SAMPLING_UNIFORM;
+			}
+			else if (strcmp(pszValue, "adaptive") == 0)
+			{
+				m_sampleSettings.m_nMode = SAMPLING_ADAPTIVE;
+			}
+			else
+			{
+				fprintf(stderr, "unknown anti-aliasing mode %s\n", pszValue);
+				return false;
+			}
+		}
+		else if (strcmp(pszArg, "-aa-grid") == 0)
+		{
+			m_sampleSettings.m_nMaxGrid = atoi(pszValue);
+		}
+		else if (strcmp(pszArg, "-aa-threshold") == 0)
+		{
+			m_sampleSettings.m_fThreshold = (float)atof(pszValue);
+		}
+		else if (strcmp(pszArg, "-light-samples") == 0)
+		{
+			m_sampleSettings.m_nLightSamples = atoi(pszValue);
+		}
+		else if (strcmp(pszArg, "-o") == 0)
+		{
+			m_pszOutput = pszValue;
+		}
+		else if (strcmp(pszArg, "-scene") == 0)
+		{
+			m_vecScenes.push_back(pszValue);
+		}
+		else if (strcmp(pszArg, "-compile") == 0)
+		{
+			m_pszCompile = pszValue;
+		}
+		else if (strcmp(pszArg, "-stats") == 0)
+		{
+			m_pszStats = pszValue;
+		}
+		else if (strcmp(pszArg, "-heatmap") == 0)
+		{
+			m_nHeatmap = strcmp(pszValue, "all") == 0 ? HEATMAP_METRIC_COUNT : Heatmap_FindMetric(pszValue);
+			if (m_nHeatmap < 0)
+			{
+				fprintf(stderr, "unknown heatmap metric %s\n", pszValue);
+				return false;
+			}
+		}
+		else if (strcmp(pszArg, "-heatmap-scale") == 0)
+		{
+			m_fHeatmapScale = (float)atof(pszValue);
+		}
+		else if (strcmp(pszArg, "-texture-cache") == 0)
+		{
+			m_nTextureCacheMB = atoi(pszValue);
+			if (m_nTextureCacheMB <= 0)
+			{
+				fprintf(stderr, "texture cache size must be positive\n");
+				return false;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", pszArg);
+			return false;
+		}
+		i++;
+	}
+
+	if (m_nWidth <= 0 || m_nHeight <= 0 || m_nFrames <= 0)
+	{
+		fprintf(stderr, "width, height and frame count must be positive\n");
+		return false;
+	}
+	if (m_pszCompile && m_vecScenes.size() != 1)
+	{
+		fprintf(stderr, "-compile needs exactly one -scene\n");
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	BatchOptions options;
+	if (!options.Parse(argc, argv))
+	{
+		BatchOptions::PrintUsage();
+		return 1;
+	}
+
+	if (options.m_pszCompile)
+	{
+		SceneFile sceneFile;
+		if (!sceneFile.Load(options.m_vecScenes[0]) || !sceneFile.SaveBinary(options.m_pszCompile, options.m_nThreadCount))
+		{
+			fprintf(stderr, "%s\n", sceneFile.GetError());
+			return 1;
+		}
+		printf("compiled %s to %s\n", options.m_vecScenes[0], options.m_pszCompile);
+		return 0;
+	}
+
+	Scene scene;
+	if (options.m_nTextureCacheMB > 0)
+	{
+		scene.m_textureCache.SetBudget((size_t)options.m_nTextureCacheMB * 1024 * 1024);
+	}
+
+	FrameBuffer frameBuffer;
+	frameBuffer.Create(options.m_nWidth, options.m_nHeight);
+
+	Renderer renderer;
+	renderer.SetThreadCount(options.m_nThreadCount);
+	renderer.SetTileSize(options.m_nTileSize);
+	renderer.SetPacketTracing(options.m_bPacketTracing);
+	renderer.SetWavefront(options.m_bWavefront);
+	renderer.SetResolveSettings(options.m_resolveSettings);
+	renderer.SetSampleSettings(options.m_sampleSettings);
+
+	// Heatmap frames trace pixel by pixel; the image itself stays the same.
+	CostBuffer costBuffer;
+	FrameBuffer heatmapBuffer;
+	if (options.m_nHeatmap >= 0)
+	{
+		if ((options.m_nHeatmap == HEATMAP_INTERSECTIONS || options.m_nHeatmap == HEATMAP_SHADOW_RAYS ||
+			options.m_nHeatmap == HEATMAP_METRIC_COUNT) && !RenderStats::IsEnabled())
+		{
+			fprintf(stderr, "intersection and shadow ray costs are compiled out; rebuild with make STATS=1\n");
+		}
+		costBuffer.Create(options.m_nWidth, options.m_nHeight);
+		heatmapBuffer.Create(options.m_nWidth, options.m_nHeight);
+		renderer.SetCostBuffer(&costBuffer);
+	}
+
+	std::vector<double> vecFrameTimes;
+	char szPrefix[1024];
+	char szFileName[1100];
+	int nFailed = 0;
+
+	// Statistics go out as a JSON array with one frame object per line.
+	FILE *pStatsFile = NULL;
+	if (options.m_pszStats)
+	{
+		if (!RenderStats::IsEnabled())
+		{
+			fprintf(stderr, "statistics are compiled out; rebuild with make STATS=1\n");
+		}
+		pStatsFile = fopen(options.m_pszStats, "w");
+		if (pStatsFile == NULL)
+		{
+			fprintf(stderr, "failed to write %s\n", options.m_pszStats);
+			return 1;
+		}
+		fprintf(pStatsFile, "[\n");
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Several scenes render one after the other into numbered outputs.
+	int nSceneCount = MAX_((int)options.m_vecScenes.size(), 1);
+	int nScene;
+	for (nScene = 0; nScene < nSceneCount; nScene++)
+	{
+		if (options.m_vecScenes.empty())
+		{
+			scene.CreateDefault();
+		}
+		else
+		{
+			std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+			SceneFile sceneFile;
+			if (!sceneFile.Load(options.m_vecScenes[nScene]) || !sceneFile.CreateScene(&scene, options.m_nThreadCount))
+			{
+				fprintf(stderr, "%s\n", sceneFile.GetError());
+				nFailed++;
+				continue;
+			}
+			double fLoadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+			printf("scene %s: %d geometries, %d lights, loaded in %.3f ms (%s)\n", options.m_vecScenes[nScene],
+				sceneFile.m_nGeometryCount, sceneFile.m_nLightCount, fLoadTime * 1000.0, sceneFile.IsBinary() ? "compiled" : "text");
+		}
+
+		if (nSceneCount > 1)
+		{
+			snprintf(szPrefix, sizeof(szPrefix), "%s_%02d", options.m_pszOutput, nScene);
+		}
+		else
+		{
+			snprintf(szPrefix, sizeof(szPrefix), "%s", options.m_pszOutput);
+		}
+
+		int nFrame;
+		for (nFrame = 0; nFrame < options.m_nFrames; nFrame++)
+		{
+			unsigned long long nRaysBefore = renderer.GetRayCount();
+			unsigned long long nSamplesBefore = renderer.GetSampleCount();
+			scene.m_textureCache.ResetStats();
+			std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
+			// Light tree picks change from frame to frame, so frames can be averaged.
+			if (options.m_sampleSettings.m_nLightSamples > 0)
+			{
+				SampleSettings sampleSettings = options.m_sampleSettings;
+				sampleSettings.m_nSeed = nFrame;
+				renderer.SetSampleSettings(sampleSettings);
+			}
+			renderer.RenderScene(&scene, &frameBuffer);
+
+			double fFrameTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+			unsigned long long nRays = renderer.GetRayCount() - nRaysBefore;
+			unsigned long long nSamples = renderer.GetSampleCount() - nSamplesBefore;
+			vecFrameTimes.push_back(fFrameTime);
+
+			printf("frame %d: %.3f ms, %llu primary+reflection rays, %.2f Mrays/s, %llu samples (%.2f per pixel)\n",
+				nFrame, fFrameTime * 1000.0, nRays, nRays / fFrameTime * 1e-6,
+				nSamples, nSamples / (double)(frameBuffer.m_nWidth * frameBuffer.m_nHeight));
+			if (!scene.m_vecTextureList.empty())
+			{
+				unsigned long long nHits = scene.m_textureCache.GetHitCount();
+				unsigned long long nMisses = scene.m_textureCache.GetMissCount();
+				printf("  textures: %llu tile hits, %llu misses (%.2f%% hit), %.1f MB resident\n", nHits, nMisses,
+					nHits * 100.0 / MAX_(nHits + nMisses, 1ULL), scene.m_textureCache.GetResidentSize() / (1024.0 * 1024.0));
+			}
+
+			if (pStatsFile)
+			{
+				RenderStats stats;
+				renderer.GetFrameStats(&stats);
+				fprintf(pStatsFile, vecFrameTimes.size() > 1 ? ",\n" : "");
+				stats.WriteJSON(pStatsFile, (int)vecFrameTimes.size() - 1);
+			}
+
+			if (options.m_bWritePPM)
+			{
+				snprintf(szFileName, sizeof(szFileName), "%s_%04d.ppm", szPrefix, nFrame);
+				if (!frameBuffer.SavePPM(szFileName))
+				{
+					fprintf(stderr, "failed to write %s\n", szFileName);
+					nFailed++;
+				}
+			}
+			if (options.m_nHeatmap >= 0)
+			{
+				int nMetric;
+				for (nMetric = 0; nMetric < HEATMAP_METRIC_COUNT; nMetric++)
+				{
+					if (options.m_nHeatmap != nMetric && options.m_nHeatmap != HEATMAP_METRIC_COUNT)
+					{
+						continue;
+					}
+					float fReference = costBuffer.Resolve(nMetric, &heatmapBuffer, options.m_fHeatmapScale);
+					snprintf(szFileName, sizeof(szFileName), "%s_%s_%04d.ppm", szPrefix, Heatmap_GetMetricName(nMetric), nFrame);
+					printf("  %s: total %llu, 99th percentile %u, max %u, red at %.0f\n", Heatmap_GetMetricName(nMetric),
+						costBuffer.GetTotal(nMetric), costBuffer.GetPercentile(nMetric, HEATMAP_REFERENCE_PERCENTILE),
+						costBuffer.GetPercentile(nMetric, 1.0f), fReference);
+					if (!heatmapBuffer.SavePPM(szFileName))
+					{
+						fprintf(stderr, "failed to write %s\n", szFileName);
+						nFailed++;
+					}
+				}
+			}
+			if (options.m_bWritePFM)
+			{
+				snprintf(szFileName, sizeof(szFileName), "%s_%04d.pfm", szPrefix, nFrame);
+				if (!frameBuffer.SavePFM(szFileName))
+				{
+					fprintf(stderr, "failed to write %s\n", szFileName);
+					nFailed++;
+				}
+			}
+			if (options.m_bWriteEXR)
+			{
+				snprintf(szFileName, sizeof(szFileName), "%s_%04d.exr", szPrefix, nFrame);
+				if (!frameBuffer.SaveEXR(szFileName))
+				{
+					fprintf(stderr, "failed to write %s\n", szFileName);
+					nFailed++;
+				}
+			}
+		}
+	}
+
+	double fWallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (pStatsFile)
+	{
+		fprintf(pStatsFile, "\n]\n");
+		if (ferror(pStatsFile))
+		{
+			fprintf(stderr, "failed to write %s\n", options.m_pszStats);
+			nFailed++;
+		}
+		fclose(pStatsFile);
+	}
+	if (vecFrameTimes.empty())
+	{
+		return 1;
+	}
+
+	// Rays counted are camera and reflection rays traced through the scene.
+	std::vector<double> vecSorted = vecFrameTimes;
+	std::sort(vecSorted.begin(), vecSorted.end());
+	double fRenderTime = 0.0;
+	int i;
+	for (i = 0; i < (int)vecSorted.size(); i++)
+	{
+		fRenderTime += vecSorted[i];
+	}
+	unsigned long long nTotalRays = renderer.GetRayCount();
+
+	if (options.m_bWavefront)
+	{
+		printf("frames: %d (%dx%d), wavefront\n", (int)vecFrameTimes.size(), options.m_nWidth, options.m_nHeight);
+	}
+	else
+	{
+		printf("frames: %d (%dx%d), packets: %s\n", (int)vecFrameTimes.size(), options.m_nWidth, options.m_nHeight,
+			options.m_bPacketTracing && Simd_GetKernels() ? Simd_GetWidthName(Simd_GetNativeWidth()) : "off");
+	}
+	printf("wall time: %.3f s (render %.3f s)\n", fWallTime, fRenderTime);
+	printf("frame latency: min %.3f ms, median %.3f ms, max %.3f ms, mean %.3f ms\n",
+		vecSorted.front() * 1000.0,
+		vecSorted[vecSorted.size() / 2] * 1000.0,
+		vecSorted.back() * 1000.0,
+		fRenderTime / vecSorted.size() * 1000.0);
+	printf("primary+reflection rays: %llu, %.2f Mrays/s\n", nTotalRays, nTotalRays / fRenderTime * 1e-6);
+	printf("samples: %llu\n", renderer.GetSampleCount());
+
+	return nFailed ? 1 : 0;
+}
\ No newline at end of file
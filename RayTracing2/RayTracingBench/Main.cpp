@@ -0,0 +1,2521 @@
+#include "../RayTracing2/CoreHeaders.h"
+
+#include "../RayTracing2/Core.cpp"
+
+#include <chrono>
+#include <algorithm>
+
+// Benchmarks for the ray tracing core:
+//   bvh     closest-hit cost per ray for a linear Union and for the BVH over
+//           random sphere fields of growing size, and builds over degenerate
+//           centroid extents
+//   packet  primary ray throughput of single rays against SIMD ray packets
+//   sphereset  closest-hit cost per ray for a BVH of Sphere objects against
+//           one SphereSet holding the same spheres, with the same shading
+//   resolve HDR to ARGB8 resolve throughput, scalar against SIMD rows
+//   math    camera ray plus sphere hit and normal per ray with Vector3,
+//           Vec3A and Vec3A with the fast reciprocal square root
+//   arena   Union closest-hit cost for spheres scattered over the heap against
+//           spheres in a SceneArena, and scene teardown/reload cost and memory
+//   mesh    OBJ load on one and on all threads, BVH build, binary cache save
+//           and mapped cache load for a tessellated sphere, plus closest-hit
+//           cost per ray for the loaded and the mapped mesh; damaged compiled
+//           scenes and infinite OBJ coordinates must fail to load
+//   aa      samples, rays and error of single, adaptive and uniform sampling
+//   jobs    concurrent Render_Frame calls sharing one scene handle
+//   async   camera updates faster than frames through an AsyncRenderer: time
+//           from a camera change to its first tile, tiles traced after a
+//           cancel, and the last frame against a blocking render
+//   progressive  time to the 1/16 and 1/4 resolution previews and to the
+//           final image of progressive frames against a blocking frame, for
+//           packets, single rays and adaptive sampling; every final image
+//           must match the blocking one
+//   dynamic per-frame BVH update against a full rebuild for 100000 moving
+//           spheres, with the ray cost of both trees
+//   instances  trees placed as instances of one mesh against the same trees
+//           as separate meshes, then a forest of 1000000 instances
+//   textures  textured floor and spheres over 4 textures of 4096x4096 rendered
+//           with texture cache budgets of 256 MB down to 1 MB: frame time,
+//           tile hit rate and resident memory; all budgets give the same image
+//   lights  every light against light tree picks for 16 to 4096 point
+//           lights: frame time, shadow rays and error, also after averaging
+//           frames with different seeds
+//
+// The suite modes measure for comparison between commits and can write the
+// results as JSON (-json <file>):
+//   micro   ns per Vector3 operation, Sphere and Plane intersection, camera
+//           ray and light sample
+//   mid     ns per ray for a Union and a BVH of 1 to 1024 spheres
+//   macro   frame time, primary+reflection Mrays/s and thread scaling
+//           efficiency for the default scene and sphere fields of 1000 and
+//           100000 spheres at several resolutions
+//   suite   all three
+
+class BenchRandom
+{
+public:
+	BenchRandom(unsigned int nSeed) { m_nState = nSeed; }
+	float Next()
+	{
+		m_nState = m_nState * 1664525u + 1013904223u;
+		return (m_nState >> 8) * (1.0f / 16777216.0f);
+	}
+	float Next(float fMin, float fMax) { return fMin + (fMax - fMin) * Next(); }
+private:
+	unsigned int m_nState;
+};
+
+// Spheres fill a fixed cube with constant total volume, so the chance of a
+// ray hitting something does not change with the sphere count.
+static void CreateSphereField(std::vector<Geometry *> *pGeometries, int nCount)
+{
+	BenchRandom random(12345);
+	float fRadius = 100.0f * powf(0.05f / nCount, 1.0f / 3.0f);
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		Sphere *sphere = new Sphere(Vector3(random.Next(-100, 100), random.Next(-100, 100), random.Next(-100, 100)), fRadius);
+		pGeometries->push_back(sphere);
+	}
+}
+
+static void CreateRays(std::vector<Ray3> *pRays, int nCount)
+{
+	BenchRandom random(6789);
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		Vector3 origin = Vector3(random.Next(-1, 1), random.Next(-1, 1), random.Next(-1, 1)).Normalize().Multiply(300.0f);
+		Vector3 target(random.Next(-100, 100), random.Next(-100, 100), random.Next(-100, 100));
+		pRays->push_back(Ray3(origin, target.Subtract(origin).Normalize()));
+	}
+}
+
+// Returns nanoseconds per ray, repeating the ray set for at least fMinSeconds.
+static double MeasureIntersect(Geometry *geometry, std::vector<Ray3> &rays, double fMinSeconds, int *pHits)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	long long nRays = 0;
+	double fSeconds = 0.0;
+	int nHits = 0;
+	do
+	{
+		nHits = 0;
+		int i;
+		for (i = 0; i < (int)rays.size(); i++)
+		{
+			IntersectResult result;
+			geometry->Intersect(&rays[i], &result);
+			nHits += result.m_geometry != NULL;
+		}
+		nRays += rays.size();
+		fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (fSeconds < fMinSeconds);
+
+	*pHits = nHits;
+	return fSeconds * 1e9 / nRays;
+}
+
+static int BenchBVH(int nMaxCount, int nMaxUnionCount)
+{
+	std::vector<Ray3> rays;
+	CreateRays(&rays, 4096);
+
+	printf("%10s %14s %14s %10s %16s\n", "spheres", "union ns/ray", "bvh ns/ray", "bvh depth", "bvh ns/log2(N)");
+
+	int nCount;
+	for (nCount = 16; nCount <= nMaxCount; nCount *= 4)
+	{
+		std::vector<Geometry *> geometries;
+		CreateSphereField(&geometries, nCount);
+
+		BVH bvh;
+		int i;
+		for (i = 0; i < nCount; i++)
+		{
+			bvh.AddGeometry(geometries[i]);
+		}
+		bvh.Initialize();
+
+		int nBVHHits = 0;
+		double fBVHTime = MeasureIntersect(&bvh, rays, 0.2, &nBVHHits);
+
+		double fUnionTime = 0.0;
+		if (nCount <= nMaxUnionCount)
+		{
+			Union scene;
+			for (i = 0; i < nCount; i++)
+			{
+				scene.AddGeometry(geometries[i]);
+			}
+			scene.Initialize();
+
+			int nUnionHits = 0;
+			fUnionTime = MeasureIntersect(&scene, rays, 0.2, &nUnionHits);
+			if (nUnionHits != nBVHHits)
+			{
+				fprintf(stderr, "hit count mismatch at %d spheres: union %d, bvh %d\n", nCount, nUnionHits, nBVHHits);
+				return 1;
+			}
+		}
+
+		if (fUnionTime > 0.0)
+		{
+			printf("%10d %14.1f %14.1f %10d %16.2f\n", nCount, fUnionTime, fBVHTime, bvh.GetDepth(), fBVHTime / log2((double)nCount));
+		}
+		else
+		{
+			printf("%10d %14s %14.1f %10d %16.2f\n", nCount, "-", fBVHTime, bvh.GetDepth(), fBVHTime / log2((double)nCount));
+		}
+
+		for (i = 0; i < nCount; i++)
+		{
+			delete geometries[i];
+		}
+	}
+
+	// Centroids spread over a denormal and over an infinite extent cannot be
+	// binned; the builder must still put every primitive in exactly one leaf.
+	const float fSpreads[] = { FLT_MIN / 64.0f, FLT_MAX };
+	int nSpread;
+	for (nSpread = 0; nSpread < 2; nSpread++)
+	{
+		std::vector<AABB> bounds(64);
+		int i;
+		for (i = 0; i < 64; i++)
+		{
+			float fX = (i / 63.0f - 0.5f) * fSpreads[nSpread] * (nSpread ? 2.0f : 1.0f);
+			bounds[i].Extend(Vector3(fX, 0, 0));
+			bounds[i].Extend(Vector3(fX, 1, 1));
+		}
+		BVHBuilder builder;
+		std::vector<BVHNode> nodes;
+		std::vector<int> order;
+		builder.Build(bounds, &nodes, &order);
+		std::sort(order.begin(), order.end());
+		bool bComplete = order.size() == 64;
+		for (i = 0; i < 64 && bComplete; i++)
+		{
+			bComplete = order[i] == i;
+		}
+		if (!bComplete)
+		{
+			fprintf(stderr, "BVH build over a degenerate extent lost primitives\n");
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int BenchSphereSet(int nCount)
+{
+	std::vector<Ray3> rays;
+	CreateRays(&rays, 4096);
+
+	std::vector<Geometry *> geometries;
+	CreateSphereField(&geometries, nCount);
+
+	BVH bvh;
+	SphereSet sphereSet;
+	CheckerMaterial materials[3] = { CheckerMaterial(1.0f, 0.0f), CheckerMaterial(2.0f, 0.0f), CheckerMaterial(3.0f, 0.0f) };
+	int i;
+	for (i = 0; i < 3; i++)
+	{
+		sphereSet.AddMaterial(&materials[i]);
+	}
+	for (i = 0; i < nCount; i++)
+	{
+		Sphere *sphere = (Sphere *)geometries[i];
+		sphere->m_material = &materials[i % 3];
+		bvh.AddGeometry(sphere);
+		sphereSet.AddSphere(sphere->m_center, sphere->m_radius, i % 3);
+	}
+	bvh.Initialize();
+	sphereSet.Initialize();
+
+	int nBVHHits = 0;
+	double fBVHTime = MeasureIntersect(&bvh, rays, 0.5, &nBVHHits);
+	int nSetHits = 0;
+	double fSetTime = MeasureIntersect(&sphereSet, rays, 0.5, &nSetHits);
+
+	// Both must shade every hit with the same material and normal.
+	int nShadingErrors = 0;
+	for (i = 0; i < (int)rays.size(); i++)
+	{
+		IntersectResult bvhResult;
+		IntersectResult setResult;
+		if (bvh.Intersect(&rays[i], &bvhResult) && sphereSet.Intersect(&rays[i], &setResult))
+		{
+			bvhResult.m_geometry->ComputeSurfaceInteraction(&rays[i], &bvhResult);
+			sphereSet.ComputeSurfaceInteraction(&rays[i], &setResult);
+			nShadingErrors += bvhResult.m_material != setResult.m_material ||
+				bvhResult.m_normal.Subtract(setResult.m_normal).Length() > 1e-4f;
+		}
+	}
+
+	for (i = 0; i < nCount; i++)
+	{
+		delete geometries[i];
+	}
+
+	if (nBVHHits != nSetHits || nShadingErrors > 0)
+	{
+		fprintf(stderr, "hit count mismatch: bvh %d, sphere set %d, %d hits shaded differently\n", nBVHHits, nSetHits,
+			nShadingErrors);
+		return 1;
+	}
+
+	const SimdKernels *pKernels = Simd_GetKernels();
+	printf("%d spheres, %s leaves\n", nCount, pKernels ? Simd_GetWidthName(pKernels->m_nWidth) : "scalar");
+	printf("%14s %14s\n", "geometry", "ns/ray");
+	printf("%14s %14.1f\n", "bvh", fBVHTime);
+	printf("%14s %14.1f\n", "sphere set", fSetTime);
+	printf("speedup %.2fx\n", fBVHTime / fSetTime);
+	return 0;
+}
+
+// Camera ray generation plus closest hit for every pixel of the default scene,
+// one ray at a time and in packets of the native SIMD width.
+static int BenchPacket(int nWidth, int nHeight)
+{
+	Scene scene;
+	scene.CreateDefault();
+
+	const SimdKernels *pKernels = Simd_GetKernels();
+	if (pKernels == NULL)
+	{
+		printf("packets are not supported on this CPU\n");
+		return 0;
+	}
+
+	int nScalarHits = 0;
+	long long nScalarRays = 0;
+	double fScalarSeconds = 0.0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	do
+	{
+		nScalarHits = 0;
+		Ray3 ray;
+		int x;
+		int y;
+		for (y = 0; y < nHeight; y++)
+		{
+			float sy = 1 - y / (float)nHeight;
+			for (x = 0; x < nWidth; x++)
+			{
+				float sx = x / (float)nWidth;
+				scene.m_camera->GenerateRay(sx, sy, &ray);
+				IntersectResult result;
+				scene.m_root->Intersect(&ray, &result);
+				nScalarHits += result.m_geometry != NULL;
+			}
+		}
+		nScalarRays += nWidth * nHeight;
+		fScalarSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (fScalarSeconds < 0.5);
+
+	int nPacketWidth = pKernels->m_nWidth >= 8 ? 4 : 2;
+	int nPacketHeight = pKernels->m_nWidth / nPacketWidth;
+	int nPacketHits = 0;
+	long long nPacketRays = 0;
+	double fPacketSeconds = 0.0;
+	RayPacket packet;
+	start = std::chrono::steady_clock::now();
+	do
+	{
+		nPacketHits = 0;
+		int nBlockX;
+		int nBlockY;
+		for (nBlockY = 0; nBlockY < nHeight; nBlockY += nPacketHeight)
+		{
+			for (nBlockX = 0; nBlockX < nWidth; nBlockX += nPacketWidth)
+			{
+				unsigned int nActiveMask = 0;
+				int i;
+				for (i = 0; i < pKernels->m_nWidth; i++)
+				{
+					packet.m_nX[i] = nBlockX + i % nPacketWidth;
+					packet.m_nY[i] = nBlockY + i / nPacketWidth;
+					if (packet.m_nX[i] < nWidth && packet.m_nY[i] < nHeight)
+					{
+						nActiveMask |= 1u << i;
+					}
+				}
+				packet.Reset(pKernels->m_nWidth, nActiveMask);
+				pKernels->m_pfnGeneratePrimary(scene.m_camera, &packet, (float)nWidth, (float)nHeight);
+				scene.m_root->IntersectPacket(&packet);
+				for (i = 0; i < pKernels->m_nWidth; i++)
+				{
+					nPacketHits += packet.m_geometry[i] != NULL;
+				}
+			}
+		}
+		nPacketRays += nWidth * nHeight;
+		fPacketSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (fPacketSeconds < 0.5);
+
+	if (nScalarHits != nPacketHits)
+	{
+		fprintf(stderr, "hit count mismatch: single %d, packet %d\n", nScalarHits, nPacketHits);
+		return 1;
+	}
+
+	double fScalarRate = nScalarRays / fScalarSeconds * 1e-6;
+	double fPacketRate = nPacketRays / fPacketSeconds * 1e-6;
+	printf("primary rays %dx%d, %s packets\n", nWidth, nHeight, Simd_GetWidthName(pKernels->m_nWidth));
+	printf("%10s %14s\n", "path", "Mrays/s");
+	printf("%10s %14.2f\n", "single", fScalarRate);
+	printf("%10s %14.2f\n", "packet", fPacketRate);
+	printf("speedup %.2fx\n", fPacketRate / fScalarRate);
+	return 0;
+}
+
+static double MeasureResolve(FrameBuffer *frameBuffer, const ResolveSettings &settings, const SimdKernels *pKernels)
+{
+	long long nPixels = 0;
+	double fSeconds = 0.0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	do
+	{
+		frameBuffer->Resolve(settings, 0, frameBuffer->m_nHeight, pKernels);
+		nPixels += frameBuffer->m_nWidth * frameBuffer->m_nHeight;
+		fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (fSeconds < 0.5);
+	return nPixels / fSeconds * 1e-6;
+}
+
+// Single threaded resolve of a frame of random HDR colors for every tone
+// mapping operator, with and without sRGB encoding.
+static int BenchResolve(int nWidth, int nHeight)
+{
+	const SimdKernels *pKernels = Simd_GetKernels();
+	if (pKernels == NULL)
+	{
+		printf("SIMD resolve is not supported on this CPU\n");
+		return 0;
+	}
+
+	FrameBuffer frameBuffer;
+	frameBuffer.Create(nWidth, nHeight);
+	BenchRandom random(7);
+	int i;
+	for (i = 0; i < nWidth * nHeight; i++)
+	{
+		frameBuffer.m_pColors[i] = Color(random.Next(0.0f, 2.0f), random.Next(0.0f, 2.0f), random.Next(0.0f, 2.0f));
+	}
+	std::vector<unsigned char> vecScalar(frameBuffer.m_nStride * nHeight);
+
+	const char *pszTonemaps[3] = { "clamp", "reinhard", "aces" };
+	printf("resolve %dx%d, %s rows\n", nWidth, nHeight, Simd_GetWidthName(pKernels->m_nWidth));
+	printf("%10s %6s %14s %14s %10s\n", "tonemap", "srgb", "scalar Mpix/s", "simd Mpix/s", "speedup");
+	int nTonemap;
+	for (nTonemap = TONEMAP_CLAMP; nTonemap <= TONEMAP_ACES; nTonemap++)
+	{
+		int nSRGB;
+		for (nSRGB = 0; nSRGB < 2; nSRGB++)
+		{
+			ResolveSettings settings;
+			settings.m_fExposure = 1.5f;
+			settings.m_nTonemap = nTonemap;
+			settings.m_bSRGB = nSRGB != 0;
+
+			double fScalarRate = MeasureResolve(&frameBuffer, settings, NULL);
+			memcpy(&vecScalar[0], frameBuffer.m_pPixels, vecScalar.size());
+			double fSimdRate = MeasureResolve(&frameBuffer, settings, pKernels);
+			if (memcmp(&vecScalar[0], frameBuffer.m_pPixels, vecScalar.size()) != 0)
+			{
+				fprintf(stderr, "resolve mismatch: %s, srgb %d\n", pszTonemaps[nTonemap], nSRGB);
+				return 1;
+			}
+			printf("%10s %6s %14.1f %14.1f %9.2fx\n", pszTonemaps[nTonemap], nSRGB ? "on" : "off",
+				fScalarRate, fSimdRate, fSimdRate / fScalarRate);
+		}
+	}
+	return 0;
+}
+
+// Every variant generates the camera ray of each pixel, intersects it with one
+// sphere and normalizes the hit normal: the vector work of one primary ray.
+template <class VectorType, bool bFast>
+static double MeasureMath(PerspectiveCamera *camera, const Vector3 &center, float fRadius, int nSize, float *pChecksum)
+{
+	VectorType right(camera->m_right);
+	VectorType up(camera->m_up);
+	VectorType front(camera->m_front);
+	VectorType eye(camera->m_eye);
+	VectorType sphereCenter(center);
+	float fSqrRadius = fRadius * fRadius;
+	float fScale = camera->m_fovScale;
+
+	long long nRays = 0;
+	double fSeconds = 0.0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	do
+	{
+		float fChecksum = 0.0f;
+		int x;
+		int y;
+		for (y = 0; y < nSize; y++)
+		{
+			float sy = 1 - y / (float)nSize;
+			for (x = 0; x < nSize; x++)
+			{
+				float sx = x / (float)nSize;
+				VectorType direction = front + right * ((sx - 0.5f) * fScale) + up * ((sy - 0.5f) * fScale);
+				direction = bFast ? direction.NormalizeFast() : direction.Normalize();
+				VectorType v = eye - sphereCenter;
+				float a0 = v.SqrLength() - fSqrRadius;
+				float DdotV = direction.Dot(v);
+				if (DdotV <= 0.0f)
+				{
+					float discr = DdotV * DdotV - a0;
+					if (discr >= 0.0f)
+					{
+						float t = -DdotV - sqrtf(discr);
+						VectorType normal = eye + direction * t - sphereCenter;
+						normal = bFast ? normal.NormalizeFast() : normal.Normalize();
+						fChecksum += normal.Dot(direction);
+					}
+				}
+			}
+		}
+		*pChecksum = fChecksum;
+		nRays += nSize * nSize;
+		fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (fSeconds < 0.5);
+	return fSeconds * 1e9 / nRays;
+}
+
+static int BenchMath(int nSize)
+{
+	Scene scene;
+	scene.CreateDefault();
+	Vector3 center(-10, 10, 0);
+	float fRadius = 10.0f;
+
+	float fVector3Sum = 0.0f;
+	float fVec3ASum = 0.0f;
+	float fFastSum = 0.0f;
+	double fVector3Time = MeasureMath<Vector3, false>(scene.m_camera, center, fRadius, nSize, &fVector3Sum);
+	double fVec3ATime = MeasureMath<Vec3A, false>(scene.m_camera, center, fRadius, nSize, &fVec3ASum);
+	double fFastTime = MeasureMath<Vec3A, true>(scene.m_camera, center, fRadius, nSize, &fFastSum);
+
+	// Vector3 and Vec3A round identically; the fast path only approximately.
+	if (fVector3Sum != fVec3ASum)
+	{
+		fprintf(stderr, "checksum mismatch: vector3 %f, vec3a %f\n", fVector3Sum, fVec3ASum);
+		return 1;
+	}
+
+	printf("vector math per primary ray, %dx%d\n", nSize, nSize);
+	printf("%16s %14s %14s\n", "type", "ns/ray", "checksum");
+	printf("%16s %14.2f %14.4f\n", "Vector3", fVector3Time, fVector3Sum);
+	printf("%16s %14.2f %14.4f\n", "Vec3A", fVec3ATime, fVec3ASum);
+	printf("%16s %14.2f %14.4f\n", "Vec3A fast rsqrt", fFastTime, fFastSum);
+	return 0;
+}
+
+// Writes a sphere of radius 100 as quads with per-vertex normals. Every other
+// ring uses relative indices so both index forms are parsed.
+static bool WriteSphereOBJ(const char *pszFileName, int nRings, int nSegments)
+{
+	FILE *pFile = fopen(pszFileName, "wb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+
+	int nRing;
+	int nSegment;
+	for (nRing = 0; nRing <= nRings; nRing++)
+	{
+		float fTheta = M_PI_F * nRing / nRings;
+		for (nSegment = 0; nSegment < nSegments; nSegment++)
+		{
+			float fPhi = 2.0f * M_PI_F * nSegment / nSegments;
+			Vector3 normal(sinf(fTheta) * cosf(fPhi), cosf(fTheta), sinf(fTheta) * sinf(fPhi));
+			fprintf(pFile, "v %.6f %.6f %.6f\n", normal.m_x * 100.0f, normal.m_y * 100.0f, normal.m_z * 100.0f);
+			fprintf(pFile, "vn %.6f %.6f %.6f\n", normal.m_x, normal.m_y, normal.m_z);
+		}
+	}
+
+	int nVertexCount = (nRings + 1) * nSegments;
+	for (nRing = 0; nRing < nRings; nRing++)
+	{
+		for (nSegment = 0; nSegment < nSegments; nSegment++)
+		{
+			int a = nRing * nSegments + nSegment + 1;
+			int b = nRing * nSegments + (nSegment + 1) % nSegments + 1;
+			int c = b + nSegments;
+			int d = a + nSegments;
+			if (nRing & 1)
+			{
+				a -= nVertexCount + 1;
+				b -= nVertexCount + 1;
+				c -= nVertexCount + 1;
+				d -= nVertexCount + 1;
+			}
+			fprintf(pFile, "f %d//%d %d//%d %d//%d %d//%d\n", a, a, b, b, c, c, d, d);
+		}
+	}
+
+	fclose(pFile);
+	return true;
+}
+
+static bool ReadFileBytes(const char *pszFileName, std::vector<unsigned char> *pBytes)
+{
+	FILE *pFile = fopen(pszFileName, "rb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+	fseek(pFile, 0, SEEK_END);
+	pBytes->resize((size_t)ftell(pFile));
+	fseek(pFile, 0, SEEK_SET);
+	bool bResult = fread(pBytes->data(), 1, pBytes->size(), pFile) == pBytes->size();
+	fclose(pFile);
+	return bResult;
+}
+
+static bool WriteFileBytes(const char *pszFileName, const unsigned char *pBytes, size_t nSize)
+{
+	FILE *pFile = fopen(pszFileName, "wb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+	bool bResult = fwrite(pBytes, 1, nSize, pFile) == nSize;
+	fclose(pFile);
+	return bResult;
+}
+
+// Loads a damaged copy of a compiled scene, which must fail with an error
+// before anything reads outside the file.
+static bool LoadCorruptScene(const char *pszFileName, const std::vector<unsigned char> &bytes, size_t nSize)
+{
+	if (!WriteFileBytes(pszFileName, bytes.data(), nSize))
+	{
+		return false;
+	}
+	Scene scene;
+	SceneFile sceneFile;
+	bool bLoaded = sceneFile.Load(pszFileName) && sceneFile.CreateScene(&scene, 1);
+	remove(pszFileName);
+	return !bLoaded;
+}
+
+// Compiles a scene around the OBJ file, then truncates it and points its
+// sections and its embedded mesh outside the file.
+static bool CheckCorruptScenes(const char *pszObjName)
+{
+	const char *pszSceneName = "bench_mesh.scene";
+	const char *pszCompiledName = "bench_mesh.rtscene";
+	const char *pszCorruptName = "bench_corrupt.rtscene";
+	FILE *pFile = fopen(pszSceneName, "wb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+	fprintf(pFile, "camera 0 0 300  0 0 -1  0 1 0  60\n");
+	fprintf(pFile, "material phong red 1 0 0  1 1 1  16 0\nmesh %s red\n", pszObjName);
+	fclose(pFile);
+
+	SceneFile sceneFile;
+	std::vector<unsigned char> bytes;
+	bool bResult = sceneFile.Load(pszSceneName) && sceneFile.SaveBinary(pszCompiledName, 1) &&
+		ReadFileBytes(pszCompiledName, &bytes) && bytes.size() > sizeof(SceneFileHeader);
+	remove(pszSceneName);
+	remove(pszCompiledName);
+	if (!bResult)
+	{
+		return false;
+	}
+
+	SceneFileHeader header;
+	memcpy(&header, bytes.data(), sizeof(header));
+	std::vector<unsigned char> corrupt;
+
+	// The undamaged copy must still load.
+	bResult = !LoadCorruptScene(pszCorruptName, bytes, bytes.size());
+	bResult = LoadCorruptScene(pszCorruptName, bytes, sizeof(header) - 1) && bResult;
+	bResult = LoadCorruptScene(pszCorruptName, bytes, bytes.size() / 2) && bResult;
+
+	// Offset plus size of the section wraps around to 0.
+	SceneFileHeader wrapped = header;
+	wrapped.m_nMaterialCount = 1 << 20;
+	wrapped.m_nMaterialOffset = 0 - (unsigned long long)wrapped.m_nMaterialCount * sizeof(SceneMaterialRecord);
+	corrupt = bytes;
+	memcpy(corrupt.data(), &wrapped, sizeof(wrapped));
+	bResult = LoadCorruptScene(pszCorruptName, corrupt, corrupt.size()) && bResult;
+
+	SceneMeshRecord mesh;
+	memcpy(&mesh, bytes.data() + header.m_nMeshOffset, sizeof(mesh));
+	mesh.m_nOffset = 0 - mesh.m_nSize / 2;
+	corrupt = bytes;
+	memcpy(corrupt.data() + header.m_nMeshOffset, &mesh, sizeof(mesh));
+	bResult = LoadCorruptScene(pszCorruptName, corrupt, corrupt.size()) && bResult;
+
+	// The same for the vertex positions inside the embedded mesh cache.
+	memcpy(&mesh, bytes.data() + header.m_nMeshOffset, sizeof(mesh));
+	TriangleMeshCacheHeader meshHeader;
+	memcpy(&meshHeader, bytes.data() + mesh.m_nOffset, sizeof(meshHeader));
+	meshHeader.m_nPositionOffset = 0 - (unsigned long long)meshHeader.m_nVertexCount * sizeof(Vector3);
+	corrupt = bytes;
+	memcpy(corrupt.data() + mesh.m_nOffset, &meshHeader, sizeof(meshHeader));
+	bResult = LoadCorruptScene(pszCorruptName, corrupt, corrupt.size()) && bResult;
+	return bResult;
+}
+
+static double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Spheres allocated between unrelated blocks of random size, the layout a
+// long-running process ends up with when objects are created one by one.
+static void CreateScatteredSpheres(const std::vector<Geometry *> &field, std::vector<Sphere *> *pSpheres,
+	std::vector<char *> *pFiller)
+{
+	BenchRandom random(4242);
+	int i;
+	for (i = 0; i < (int)field.size(); i++)
+	{
+		pFiller->push_back(new char[16 + (int)random.Next(0, 2048)]);
+		Sphere *sphere = (Sphere *)field[i];
+		pSpheres->push_back(new Sphere(sphere->m_center, sphere->m_radius));
+	}
+}
+
+static int BenchArena(int nCount, int nReloadCount, int nReloadSpheres)
+{
+	std::vector<Ray3> rays;
+	CreateRays(&rays, 4096);
+
+	std::vector<Geometry *> field;
+	CreateSphereField(&field, nCount);
+
+	std::vector<Sphere *> scattered;
+	std::vector<char *> filler;
+	CreateScatteredSpheres(field, &scattered, &filler);
+	Union heapUnion;
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		heapUnion.AddGeometry(scattered[i]);
+	}
+	heapUnion.Initialize();
+
+	SceneArena arena;
+	Union *arenaUnion = arena.Create<Union>();
+	for (i = 0; i < nCount; i++)
+	{
+		Sphere *sphere = (Sphere *)field[i];
+		arenaUnion->AddGeometry(arena.Create<Sphere>(sphere->m_center, sphere->m_radius));
+	}
+	arenaUnion->Initialize();
+
+	int nHeapHits = 0;
+	double fHeapTime = MeasureIntersect(&heapUnion, rays, 0.5, &nHeapHits);
+	int nArenaHits = 0;
+	double fArenaTime = MeasureIntersect(arenaUnion, rays, 0.5, &nArenaHits);
+
+	for (i = 0; i < nCount; i++)
+	{
+		delete scattered[i];
+		delete[] filler[i];
+		delete field[i];
+	}
+
+	if (nHeapHits != nArenaHits)
+	{
+		fprintf(stderr, "hit count mismatch: heap %d, arena %d\n", nHeapHits, nArenaHits);
+		return 1;
+	}
+
+	printf("union of %d spheres\n", nCount);
+	printf("%14s %14s\n", "storage", "ns/ray");
+	printf("%14s %14.1f\n", "heap", fHeapTime);
+	printf("%14s %14.1f\n", "arena", fArenaTime);
+
+	// Reloading reuses the arena blocks, so the reserved size stays flat.
+	Scene scene;
+	printf("reload of a %d sphere scene\n", nReloadSpheres);
+	printf("%8s %14s %14s %14s\n", "reload", "create ms", "release ms", "reserved KB");
+	BenchRandom random(777);
+	int nReload;
+	for (nReload = 0; nReload < nReloadCount; nReload++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		scene.CreateCamera<PerspectiveCamera>(Vector3(0, 5, 25), Vector3(0, 0, -1), Vector3(0, 1, 0), 90.0f);
+		Material *material = scene.CreateMaterial<PhongMaterial>(Color::s_red, Color::s_white, 16.0f, 0.25f);
+		Union *root = scene.CreateGeometry<Union>();
+		for (i = 0; i < nReloadSpheres; i++)
+		{
+			Sphere *sphere = scene.CreateGeometry<Sphere>(Vector3(random.Next(-100, 100), random.Next(-100, 100),
+				random.Next(-100, 100)), 1.0f);
+			sphere->m_material = material;
+			root->AddGeometry(sphere);
+		}
+		scene.m_root = root;
+		scene.CreateLight<PointLight>(Color::s_white, Vector3(0, 30, 0));
+		double fCreateTime = SecondsSince(start);
+
+		size_t nReserved = scene.m_arena.GetReservedSize();
+		start = std::chrono::steady_clock::now();
+		scene.Release();
+		double fReleaseTime = SecondsSince(start);
+		printf("%8d %14.3f %14.3f %14.1f\n", nReload, fCreateTime * 1e3, fReleaseTime * 1e3, nReserved / 1024.0);
+	}
+	return 0;
+}
+
+static int BenchMesh(int nTriangleCount)
+{
+	const char *pszFileName = "bench_mesh.obj";
+	const char *pszCacheName = "bench_mesh.obj.rtmesh";
+	int nSegments = MAX_((int)sqrtf(nTriangleCount * 0.5f), 3);
+	int nRings = MAX_(nTriangleCount / (2 * nSegments), 2);
+	if (!WriteSphereOBJ(pszFileName, nRings, nSegments))
+	{
+		fprintf(stderr, "cannot write %s\n", pszFileName);
+		return 1;
+	}
+
+	int nThreadCount = ThreadPool::GetHardwareThreadCount();
+	TriangleMesh serialMesh;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool bResult = serialMesh.LoadOBJ(pszFileName, 1);
+	double fSerialTime = SecondsSince(start);
+
+	TriangleMesh mesh;
+	start = std::chrono::steady_clock::now();
+	bResult = mesh.LoadOBJ(pszFileName, nThreadCount) && bResult;
+	double fParallelTime = SecondsSince(start);
+
+	if (!bResult || serialMesh.m_indices != mesh.m_indices || mesh.m_normals.empty())
+	{
+		fprintf(stderr, "OBJ load failed or differs between thread counts\n");
+		remove(pszFileName);
+		return 1;
+	}
+
+	start = std::chrono::steady_clock::now();
+	mesh.Initialize();
+	double fBuildTime = SecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	bResult = mesh.SaveCache(pszCacheName);
+	double fSaveTime = SecondsSince(start);
+
+	TriangleMesh mappedMesh;
+	start = std::chrono::steady_clock::now();
+	bResult = mappedMesh.LoadCache(pszCacheName) && bResult;
+	double fMapTime = SecondsSince(start);
+
+	std::vector<Ray3> rays;
+	CreateRays(&rays, 4096);
+	int nHits = 0;
+	double fMeshTime = bResult ? MeasureIntersect(&mesh, rays, 0.5, &nHits) : 0.0;
+	int nMappedHits = 0;
+	double fMappedTime = bResult ? MeasureIntersect(&mappedMesh, rays, 0.5, &nMappedHits) : 0.0;
+
+	// Vertices moved in place and marked changed get a new BVH, so rays moved
+	// along with them hit as often as before.
+	Vector3 offset(500.0f, 0.0f, 0.0f);
+	std::vector<Ray3> movedRays;
+	int i;
+	for (i = 0; i < (int)mesh.m_positions.size(); i++)
+	{
+		mesh.m_positions[i] = mesh.m_positions[i].Add(offset);
+	}
+	for (i = 0; i < (int)rays.size(); i++)
+	{
+		movedRays.push_back(Ray3(rays[i].m_origin.Add(offset), rays[i].m_direction));
+	}
+	mesh.MarkChanged();
+	mesh.Initialize();
+	int nMovedHits = 0;
+	MeasureIntersect(&mesh, movedRays, 0.0, &nMovedHits);
+
+	mappedMesh.LoadCache("");
+	bool bCorruptRejected = CheckCorruptScenes(pszFileName);
+
+	// A coordinate beyond the float range fails the load like any malformed line.
+	const char *pszInfiniteName = "bench_infinite.obj";
+	const char szInfinite[] = "v 1e400 0 0\nv 0 1 0\nv 0 0 1\nf 1 2 3\n";
+	TriangleMesh infiniteMesh;
+	bool bInfiniteRejected = WriteFileBytes(pszInfiniteName, (const unsigned char *)szInfinite, sizeof(szInfinite) - 1) &&
+		!infiniteMesh.LoadOBJ(pszInfiniteName, 1);
+	remove(pszInfiniteName);
+	remove(pszCacheName);
+	remove(pszFileName);
+
+	if (!bResult || nHits != nMappedHits)
+	{
+		fprintf(stderr, "cache failed or hit count mismatch: mesh %d, mapped %d\n", nHits, nMappedHits);
+		return 1;
+	}
+	if (nMovedHits != nHits)
+	{
+		fprintf(stderr, "edited mesh kept a stale BVH: %d hits, %d before the edit\n", nMovedHits, nHits);
+		return 1;
+	}
+	if (!bCorruptRejected)
+	{
+		fprintf(stderr, "a truncated or corrupt compiled scene was not rejected\n");
+		return 1;
+	}
+	if (!bInfiniteRejected)
+	{
+		fprintf(stderr, "an OBJ file with an infinite vertex was not rejected\n");
+		return 1;
+	}
+
+	printf("%d triangles, %d vertices, %d threads\n", mesh.GetTriangleCount(), mesh.GetVertexCount(), nThreadCount);
+	printf("%20s %14s\n", "step", "ms");
+	printf("%20s %14.1f\n", "obj load 1 thread", fSerialTime * 1e3);
+	printf("%20s %14.1f\n", "obj load threads", fParallelTime * 1e3);
+	printf("%20s %14.1f\n", "bvh build", fBuildTime * 1e3);
+	printf("%20s %14.1f\n", "cache save", fSaveTime * 1e3);
+	printf("%20s %14.3f\n", "cache load", fMapTime * 1e3);
+	printf("%20s %14s %14s\n", "mesh", "ns/ray", "hits");
+	printf("%20s %14.1f %14d\n", "loaded", fMeshTime, nHits);
+	printf("%20s %14.1f %14d\n", "mapped", fMappedTime, nMappedHits);
+	return 0;
+}
+
+// Renders the default scene through several cameras, one job after the other
+// and then all at once from their own threads, which must give the same
+// pixels while sharing a single scene handle.
+static int BenchJobs(int nJobCount, int nWidth, int nHeight)
+{
+	RenderSceneHandle scene = Render_CreateDefaultScene();
+	PerspectiveCamera sceneCamera = Render_GetSceneCamera(scene);
+	std::vector<PerspectiveCamera> cameras;
+	int i;
+	for (i = 0; i < nJobCount; i++)
+	{
+		float fAngle = 0.2f * (i - nJobCount / 2);
+		PerspectiveCamera camera = sceneCamera;
+		camera.m_eye = Vector3(sinf(fAngle) * 15.0f, 10.0f, cosf(fAngle) * 15.0f);
+		camera.m_front = Vector3(-sinf(fAngle), -0.5f, -cosf(fAngle)).Normalize();
+		cameras.push_back(camera);
+	}
+
+	int nStride = nWidth * 4;
+	std::vector<unsigned char> serial(nJobCount * nStride * nHeight);
+	std::vector<unsigned char> concurrent(nJobCount * nStride * nHeight);
+	RenderOptions options;
+	unsigned long long nRayCount = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (i = 0; i < nJobCount; i++)
+	{
+		RenderTarget target;
+		target.m_nWidth = nWidth;
+		target.m_nHeight = nHeight;
+		target.m_nStride = nStride;
+		target.m_pPixels = &serial[i * nStride * nHeight];
+		unsigned long long nJobRays = 0;
+		Render_Frame(scene, cameras[i], options, &target, &nJobRays);
+		nRayCount += nJobRays;
+	}
+	double fSerialTime = SecondsSince(start);
+
+	std::vector<std::thread> threads;
+	std::atomic<int> nFailed(0);
+	start = std::chrono::steady_clock::now();
+	for (i = 0; i < nJobCount; i++)
+	{
+		threads.push_back(std::thread([&, i]()
+		{
+			RenderTarget target;
+			target.m_nWidth = nWidth;
+			target.m_nHeight = nHeight;
+			target.m_nStride = nStride;
+			target.m_pPixels = &concurrent[i * nStride * nHeight];
+			if (!Render_Frame(scene, cameras[i], options, &target, NULL))
+			{
+				nFailed++;
+			}
+		}));
+	}
+	for (i = 0; i < nJobCount; i++)
+	{
+		threads[i].join();
+	}
+	double fConcurrentTime = SecondsSince(start);
+
+	if (nFailed > 0 || serial != concurrent)
+	{
+		fprintf(stderr, "concurrent jobs differ from serial jobs\n");
+		return 1;
+	}
+
+	printf("%d jobs of %dx%d, %llu rays\n", nJobCount, nWidth, nHeight, nRayCount);
+	printf("%14s %14s %14s\n", "jobs", "ms", "jobs/s");
+	printf("%14s %14.1f %14.1f\n", "serial", fSerialTime * 1e3, nJobCount / fSerialTime);
+	printf("%14s %14.1f %14.1f\n", "concurrent", fConcurrentTime * 1e3, nJobCount / fConcurrentTime);
+	return 0;
+}
+
+// Root mean square difference of two 8-bit frames.
+static double FrameError(const std::vector<unsigned char> &a, const std::vector<unsigned char> &b)
+{
+	double fSum = 0.0;
+	int i;
+	for (i = 0; i < (int)a.size(); i++)
+	{
+		double fDelta = (double)a[i] - (double)b[i];
+		fSum += fDelta * fDelta;
+	}
+	return sqrt(fSum / a.size());
+}
+
+// Compares one sample per pixel and adaptive sampling against uniform 4x4
+// supersampling of the default scene, which serves as the reference image.
+static int BenchAntialias(int nWidth, int nHeight)
+{
+	RenderSceneHandle scene = Render_CreateDefaultScene();
+	PerspectiveCamera camera = Render_GetSceneCamera(scene);
+	const int nModes[] = { SAMPLING_UNIFORM, SAMPLING_SINGLE, SAMPLING_ADAPTIVE };
+	const char *pszNames[] = { "uniform 4x4", "single", "adaptive" };
+	std::vector<unsigned char> reference;
+
+	printf("%dx%d default scene\n", nWidth, nHeight);
+	printf("%14s %14s %14s %14s %14s\n", "sampling", "ms", "samples/pixel", "prim+refl rays", "rms error");
+	int i;
+	for (i = 0; i < 3; i++)
+	{
+		std::vector<unsigned char> pixels(nWidth * 4 * nHeight);
+		RenderTarget target;
+		target.m_nWidth = nWidth;
+		target.m_nHeight = nHeight;
+		target.m_nStride = nWidth * 4;
+		target.m_pPixels = &pixels[0];
+		RenderOptions options;
+		options.m_nThreadCount = 0;
+		options.m_sampleSettings.m_nMode = nModes[i];
+
+		unsigned long long nRayCount = 0;
+		unsigned long long nSampleCount = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Render_Frame(scene, camera, options, &target, &nRayCount, &nSampleCount);
+		double fTime = SecondsSince(start);
+		if (reference.empty())
+		{
+			reference = pixels;
+		}
+		printf("%14s %14.1f %14.2f %14llu %14.3f\n", pszNames[i], fTime * 1e3, nSampleCount / (double)(nWidth * nHeight),
+			nRayCount, FrameError(reference, pixels));
+	}
+	return 0;
+}
+
+// Floor, a ring of spheres and nLights point lights of random colour scattered
+// above them, with the same total intensity for every count.
+static void CreateManyLightScene(Scene *scene, int nLights)
+{
+	scene->Release();
+	scene->CreateCamera<PerspectiveCamera>(Vector3(0, 40, 90), Vector3(0, -0.5f, -1).Normalize(),
+		Vector3(0, 1, -0.5f).Normalize(), 70.0f);
+
+	Union *root = scene->CreateGeometry<Union>();
+	Plane *plane = scene->CreateGeometry<Plane>(Vector3(0, 1, 0), 0.0f);
+	plane->m_material = scene->CreateMaterial<CheckerMaterial>(0.1f, 0.0f);
+	root->AddGeometry(plane);
+	Material *material = scene->CreateMaterial<PhongMaterial>(Color::s_white, Color::s_white, 16.0f, 0.0f);
+	int i;
+	for (i = 0; i < 12; i++)
+	{
+		float fAngle = i * (2.0f * M_PI_F / 12);
+		Sphere *sphere = scene->CreateGeometry<Sphere>(Vector3(cosf(fAngle) * 30.0f, 5.0f, sinf(fAngle) * 30.0f), 5.0f);
+		sphere->m_material = material;
+		root->AddGeometry(sphere);
+	}
+	scene->m_root = root;
+
+	BenchRandom random(4242);
+	float fIntensity = 20000.0f / nLights;
+	for (i = 0; i < nLights; i++)
+	{
+		Color color(random.Next(0.2f, 1.0f), random.Next(0.2f, 1.0f), random.Next(0.2f, 1.0f));
+		scene->CreateLight<PointLight>(color * fIntensity, Vector3(random.Next(-60, 60), random.Next(8, 30), random.Next(-60, 60)));
+	}
+	scene->Initialize();
+}
+
+// RMS difference of two HDR frames in 8-bit units of the displayable range.
+static double ColorError(const FrameBuffer &a, const Color *pColors)
+{
+	double fSum = 0.0;
+	int nCount = a.m_nWidth * a.m_nHeight;
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		Color ca = a.m_pColors[i];
+		Color cb = pColors[i];
+		ca.Saturate();
+		cb.Saturate();
+		double dr = (ca.m_r - cb.m_r) * 255.0;
+		double dg = (ca.m_g - cb.m_g) * 255.0;
+		double db = (ca.m_b - cb.m_b) * 255.0;
+		fSum += dr * dr + dg * dg + db * db;
+	}
+	return sqrt(fSum / (nCount * 3));
+}
+
+// Shading every hit with every light against picking a few from the light
+// tree, for growing light counts. The error of the picks is measured against
+// the full sum for one frame and for frames accumulated over 16 seeds.
+static int BenchLights(int nMaxLights, int nWidth, int nHeight)
+{
+	const int nAccumulate = 16;
+	int nResult = 0;
+	printf("%dx%d, point lights over a floor and 12 spheres\n", nWidth, nHeight);
+	printf("%8s %10s %12s %12s %14s %12s %14s\n", "lights", "samples", "ms", "speedup", "shadow/pixel", "rms error", "rms x16 frames");
+	Scene scene;
+	int nLights;
+	for (nLights = 16; nLights <= nMaxLights; nLights *= 4)
+	{
+		CreateManyLightScene(&scene, nLights);
+
+		// Every light is reachable with the probability Sample() reports.
+		BenchRandom random(7);
+		int nCheck;
+		for (nCheck = 0; nCheck < 8; nCheck++)
+		{
+			Vector3 position(random.Next(-50, 50), 0.0f, random.Next(-50, 50));
+			Vector3 normal(0, 1, 0);
+			double fSum = 0.0;
+			int i;
+			for (i = 0; i < scene.m_lightTree.GetLightCount(); i++)
+			{
+				fSum += scene.m_lightTree.GetProbability(position, normal, i);
+			}
+			if (fabs(fSum - 1.0) > 1e-3)
+			{
+				printf("light probabilities sum to %f\n", fSum);
+				nResult = 1;
+			}
+		}
+
+		FrameBuffer reference;
+		reference.Create(nWidth, nHeight);
+		double fReferenceTime = 0.0;
+		const int nSampleCounts[] = { 0, 1, 4 };
+		int nMode;
+		for (nMode = 0; nMode < 3; nMode++)
+		{
+			Renderer renderer;
+			SampleSettings settings;
+			settings.m_nLightSamples = nSampleCounts[nMode];
+			renderer.SetSampleSettings(settings);
+
+			FrameBuffer frameBuffer;
+			frameBuffer.Create(nWidth, nHeight);
+			RenderStats stats;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			renderer.RenderScene(&scene, nMode == 0 ? &reference : &frameBuffer);
+			double fTime = SecondsSince(start);
+			renderer.GetFrameStats(&stats);
+
+			char szShadow[32] = "-";
+			if (RenderStats::IsEnabled())
+			{
+				snprintf(szShadow, sizeof(szShadow), "%.1f", stats.m_nCounters[STAT_SHADOW_RAYS] / (double)(nWidth * nHeight));
+			}
+			if (nMode == 0)
+			{
+				fReferenceTime = fTime;
+				printf("%8d %10s %12.1f %12s %14s %12s %14s\n", nLights, "all", fTime * 1000.0, "1.0", szShadow, "0", "0");
+				continue;
+			}
+
+			// Frames with different seeds average towards the reference.
+			std::vector<Color> sum(frameBuffer.m_pColors, frameBuffer.m_pColors + nWidth * nHeight);
+			double fError = ColorError(reference, &sum[0]);
+			int nFrame;
+			for (nFrame = 1; nFrame < nAccumulate; nFrame++)
+			{
+				settings.m_nSeed = nFrame;
+				renderer.SetSampleSettings(settings);
+				renderer.RenderScene(&scene, &frameBuffer);
+				int i;
+				for (i = 0; i < nWidth * nHeight; i++)
+				{
+					sum[i] += frameBuffer.m_pColors[i];
+				}
+			}
+			int i;
+			for (i = 0; i < nWidth * nHeight; i++)
+			{
+				sum[i] *= 1.0f / nAccumulate;
+			}
+			printf("%8d %10d %12.1f %12.1f %14s %12.2f %14.2f\n", nLights, nSampleCounts[nMode], fTime * 1000.0,
+				fReferenceTime / fTime, szShadow, fError, ColorError(reference, &sum[0]));
+		}
+	}
+
+	// Lights moved by animation must move in the light tree after Update().
+	CreateManyLightScene(&scene, 256);
+	int i;
+	for (i = 0; i < (int)scene.m_vecLightList.size(); i++)
+	{
+		PointLight *light = (PointLight *)scene.m_vecLightList[i];
+		light->m_position += Vector3(0, 0, 200.0f);
+		light->MarkChanged();
+	}
+	scene.Update(NULL);
+	int nStale = 0;
+	for (i = 0; i < (int)scene.m_lightTree.m_vecNodes.size(); i++)
+	{
+		const LightTreeNode &node = scene.m_lightTree.m_vecNodes[i];
+		if (node.m_bLeaf)
+		{
+			LightBounds bounds;
+			scene.m_lightTree.m_vecLights[node.m_nOffset]->GetBounds(&bounds);
+			const Vector3 &p = bounds.m_position;
+			nStale += p.m_x < node.m_bounds.m_min.m_x || p.m_x > node.m_bounds.m_max.m_x ||
+				p.m_y < node.m_bounds.m_min.m_y || p.m_y > node.m_bounds.m_max.m_y ||
+				p.m_z < node.m_bounds.m_min.m_z || p.m_z > node.m_bounds.m_max.m_z;
+		}
+	}
+	if (nStale > 0)
+	{
+		printf("%d moved lights outside their light tree leaves\n", nStale);
+		nResult = 1;
+	}
+	return nResult;
+}
+
+// Animates a field of spheres and keeps one BVH up to date with Update() on
+// one thread and one on every thread, against building a BVH from scratch
+// every frame. Every phase moves all spheres a little each frame. The second
+// also makes a few jump within their neighbourhood, which degrades subtrees
+// until they are rebuilt; the third throws a few across the field, which only
+// a full rebuild can fix. Ray cost is compared with the fresh BVH at the end
+// of each phase, and the closest hits must agree.
+// Primitive tests per closest-hit ray, which unlike the time does not vary
+// from run to run.
+static double CountPrimitiveTests(BVH *bvh, std::vector<Ray3> &rays)
+{
+	unsigned long long nTests = 0;
+	int i;
+	for (i = 0; i < (int)rays.size(); i++)
+	{
+		IntersectResult result;
+		BVH_Traverse(&bvh->m_nodes[0], &rays[i], 0.0f, &result.m_distance, [&](int nOffset, int nLeafCount)
+		{
+			int j;
+			for (j = nOffset; j < nOffset + nLeafCount; j++)
+			{
+				bvh->m_primitives[j]->Intersect(&rays[i], &result);
+			}
+			nTests += nLeafCount;
+			return false;
+		});
+	}
+	return (double)nTests / rays.size();
+}
+
+static int BenchDynamic(int nCount)
+{
+	const int nFrames = 30;
+	std::vector<Geometry *> field;
+	CreateSphereField(&field, nCount);
+	BenchRandom random(555);
+	std::vector<Vector3> velocities(nCount);
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		velocities[i] = Vector3(random.Next(-1, 1), random.Next(-1, 1), random.Next(-1, 1)).Normalize() * 0.1f;
+	}
+
+	BVH rebuilt;
+	BVH refitSerial;
+	BVH refitParallel;
+	for (i = 0; i < nCount; i++)
+	{
+		rebuilt.AddGeometry(field[i]);
+		refitSerial.AddGeometry(field[i]);
+		refitParallel.AddGeometry(field[i]);
+	}
+	rebuilt.Initialize();
+	refitSerial.Initialize();
+	refitParallel.Initialize();
+
+	ThreadPool serialPool;
+	serialPool.Start(1);
+	ThreadPool parallelPool;
+	parallelPool.Start(ThreadPool::GetHardwareThreadCount());
+
+	std::vector<Ray3> rays;
+	CreateRays(&rays, 4096);
+
+	printf("%d spheres, %d frames per phase, %d threads\n", nCount, nFrames, parallelPool.GetThreadCount());
+	printf("%10s %12s %12s %12s %10s %12s %12s %12s %12s %12s\n", "phase", "rebuild ms", "update ms", "update mt ms",
+		"rebuilt", "fresh ns/ray", "refit ns/ray", "fresh tests", "refit tests", "cost ratio");
+	int nResult = 0;
+	const char *pszPhases[] = { "drift", "shuffle", "scatter" };
+	int nPhase;
+	for (nPhase = 0; nPhase < 3; nPhase++)
+	{
+		double fRebuildTime = 0.0;
+		double fSerialTime = 0.0;
+		double fParallelTime = 0.0;
+		int nRebuilt = 0;
+		int nFrame;
+		for (nFrame = 0; nFrame < nFrames; nFrame++)
+		{
+			for (i = 0; i < nCount; i++)
+			{
+				Sphere *sphere = (Sphere *)field[i];
+				Vector3 center = sphere->m_center + velocities[i];
+				if (fabsf(center.m_x) > 100.0f || fabsf(center.m_y) > 100.0f || fabsf(center.m_z) > 100.0f)
+				{
+					velocities[i] = -velocities[i];
+					center = sphere->m_center + velocities[i];
+				}
+				if (nPhase == 1 && random.Next() < 0.05f)
+				{
+					center += Vector3(random.Next(-4, 4), random.Next(-4, 4), random.Next(-4, 4));
+				}
+				else if (nPhase == 2 && random.Next() < 0.01f)
+				{
+					center = Vector3(random.Next(-100, 100), random.Next(-100, 100), random.Next(-100, 100));
+				}
+				sphere->m_center = center;
+				sphere->MarkChanged();
+			}
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			rebuilt.Initialize();
+			fRebuildTime += SecondsSince(start);
+
+			start = std::chrono::steady_clock::now();
+			refitSerial.Update(&serialPool);
+			fSerialTime += SecondsSince(start);
+			nRebuilt += refitSerial.GetRebuildCount();
+
+			start = std::chrono::steady_clock::now();
+			refitParallel.Update(&parallelPool);
+			fParallelTime += SecondsSince(start);
+		}
+
+		for (i = 0; i < (int)rays.size(); i++)
+		{
+			IntersectResult fresh;
+			IntersectResult refit;
+			rebuilt.Intersect(&rays[i], &fresh);
+			refitSerial.Intersect(&rays[i], &refit);
+			if (fresh.m_distance != refit.m_distance)
+			{
+				printf("ray %d: refit BVH hits at %f, fresh BVH at %f\n", i, refit.m_distance, fresh.m_distance);
+				nResult = 1;
+				break;
+			}
+		}
+
+		int nHits = 0;
+		double fFresh = MeasureIntersect(&rebuilt, rays, 0.2, &nHits);
+		double fRefit = MeasureIntersect(&refitSerial, rays, 0.2, &nHits);
+		printf("%10s %12.2f %12.2f %12.2f %10d %12.1f %12.1f %12.1f %12.1f %12.2f\n", pszPhases[nPhase],
+			fRebuildTime * 1000.0 / nFrames, fSerialTime * 1000.0 / nFrames, fParallelTime * 1000.0 / nFrames,
+			nRebuilt, fFresh, fRefit, CountPrimitiveTests(&rebuilt, rays), CountPrimitiveTests(&refitSerial, rays),
+			refitSerial.GetCost() / rebuilt.GetCost());
+	}
+
+	// Spheres moved below a nested BVH and a Union must move the boxes of
+	// the top level too.
+	BVH top;
+	BVH nested;
+	Union group;
+	int nNested = MIN_(nCount, 1024);
+	for (i = 0; i < nNested; i++)
+	{
+		if (i & 1)
+		{
+			nested.AddGeometry(field[i]);
+		}
+		else
+		{
+			group.AddGeometry(field[i]);
+		}
+	}
+	for (i = nNested; i < MIN_(nCount, 2 * nNested); i++)
+	{
+		top.AddGeometry(field[i]);
+	}
+	top.AddGeometry(&nested);
+	top.AddGeometry(&group);
+	top.Initialize();
+	for (i = 0; i < nNested; i++)
+	{
+		Sphere *sphere = (Sphere *)field[i];
+		sphere->m_center += Vector3(0, 150.0f, 0);
+		sphere->MarkChanged();
+	}
+	top.Update(&serialPool);
+	BVH fresh;
+	for (i = 0; i < MIN_(nCount, 2 * nNested); i++)
+	{
+		fresh.AddGeometry(field[i]);
+	}
+	fresh.Initialize();
+	std::vector<Ray3> upRays;
+	BenchRandom rayRandom(7);
+	for (i = 0; i < 4096; i++)
+	{
+		Ray3 ray;
+		ray.m_origin = Vector3(rayRandom.Next(-100, 100), 400.0f, rayRandom.Next(-100, 100));
+		ray.m_direction = Vector3(rayRandom.Next(-0.1f, 0.1f), -1.0f, rayRandom.Next(-0.1f, 0.1f)).Normalize();
+		upRays.push_back(ray);
+	}
+	int nMissed = 0;
+	for (i = 0; i < (int)upRays.size(); i++)
+	{
+		IntersectResult freshResult;
+		IntersectResult topResult;
+		fresh.Intersect(&upRays[i], &freshResult);
+		top.Intersect(&upRays[i], &topResult);
+		nMissed += freshResult.m_distance != topResult.m_distance;
+	}
+	if (nMissed > 0)
+	{
+		printf("nested update: %d of %d rays hit differently from a fresh BVH\n", nMissed, (int)upRays.size());
+		nResult = 1;
+	}
+
+	for (i = 0; i < nCount; i++)
+	{
+		delete field[i];
+	}
+	return nResult;
+}
+
+// A small tree: a closed cylinder for the trunk under a closed cone, about
+// 4 * nSegments triangles, one unit across and three high.
+static void CreateTreeMesh(TriangleMesh *mesh, int nSegments)
+{
+	int nBottom = mesh->AddVertex(Vector3(0.0f, 0.0f, 0.0f));
+	int nBase = mesh->AddVertex(Vector3(0.0f, 0.8f, 0.0f));
+	int nApex = mesh->AddVertex(Vector3(0.0f, 3.0f, 0.0f));
+	int nFirst = mesh->GetVertexCount();
+	int i;
+	for (i = 0; i < nSegments; i++)
+	{
+		float fPhi = 2.0f * M_PI_F * i / nSegments;
+		float c = cosf(fPhi);
+		float s = sinf(fPhi);
+		mesh->AddVertex(Vector3(c * 0.12f, 0.0f, s * 0.12f));
+		mesh->AddVertex(Vector3(c * 0.12f, 0.8f, s * 0.12f));
+		mesh->AddVertex(Vector3(c * 0.5f, 0.8f, s * 0.5f));
+	}
+	for (i = 0; i < nSegments; i++)
+	{
+		int a = nFirst + i * 3;
+		int b = nFirst + (i + 1) % nSegments * 3;
+		mesh->AddTriangle(nBottom, a, b);
+		mesh->AddTriangle(a, a + 1, b + 1);
+		mesh->AddTriangle(a, b + 1, b);
+		mesh->AddTriangle(nBase, b + 2, a + 2);
+		mesh->AddTriangle(a + 2, b + 2, nApex);
+	}
+}
+
+static AffineTransform CreateTreeTransform(BenchRandom *random, float fExtent, float fHeight)
+{
+	float fScale = random->Next(2.0f, 6.0f);
+	return AffineTransform::Translation(Vector3(random->Next(-fExtent, fExtent), random->Next(-fHeight, fHeight), random->Next(-fExtent, fExtent))) *
+		AffineTransform::Rotation(Vector3(random->Next(-0.3f, 0.3f), 1.0f, random->Next(-0.3f, 0.3f)), random->Next(0.0f, 360.0f)) *
+		AffineTransform::Scale(Vector3(fScale, fScale * random->Next(0.8f, 1.2f), fScale));
+}
+
+static size_t GetMeshSize(TriangleMesh *mesh)
+{
+	// The cache image holds the vertices, triangles and nodes the mesh keeps.
+	FILE *pFile = tmpfile();
+	if (pFile == NULL)
+	{
+		return 0;
+	}
+	mesh->WriteCache(pFile);
+	size_t nSize = (size_t)ftell(pFile);
+	fclose(pFile);
+	return nSize;
+}
+
+static size_t GetBVHSize(BVH *bvh)
+{
+	return bvh->m_nodes.capacity() * sizeof(BVHNode) +
+		(bvh->m_geometies.capacity() + bvh->m_primitives.capacity() + bvh->m_unbounded.capacity()) * sizeof(Geometry *) +
+		bvh->m_primitives.size() * sizeof(unsigned int);
+}
+
+// Trees placed by instances of one mesh against the same trees as separate
+// meshes with transformed vertices: memory, build time, ray cost and agreement
+// of the hits. Then a forest of nForestCount instances.
+static int BenchInstances(int nCompareCount, int nForestCount)
+{
+	TriangleMesh prototype;
+	CreateTreeMesh(&prototype, 64);
+	prototype.Initialize();
+	size_t nPrototypeSize = GetMeshSize(&prototype);
+
+	SceneArena arena;
+	BVH instanced;
+	std::vector<TriangleMesh *> copies;
+	BVH flattened;
+	BenchRandom random(4242);
+	int i;
+	for (i = 0; i < nCompareCount; i++)
+	{
+		AffineTransform transform = CreateTreeTransform(&random, 100.0f, 100.0f);
+		instanced.AddGeometry(arena.Create<Instance>(&prototype, transform));
+
+		TriangleMesh *mesh = new TriangleMesh();
+		int j;
+		for (j = 0; j < prototype.GetVertexCount(); j++)
+		{
+			mesh->AddVertex(transform.TransformPoint(prototype.m_positions[j]));
+		}
+		mesh->m_indices = prototype.m_indices;
+		copies.push_back(mesh);
+		flattened.AddGeometry(mesh);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	instanced.Initialize();
+	double fInstancedBuild = SecondsSince(start);
+	start = std::chrono::steady_clock::now();
+	flattened.Initialize();
+	double fFlattenedBuild = SecondsSince(start);
+
+	size_t nInstancedSize = nPrototypeSize + arena.GetUsedSize() + GetBVHSize(&instanced);
+	size_t nFlattenedSize = GetBVHSize(&flattened) + copies.size() * sizeof(TriangleMesh);
+	for (i = 0; i < (int)copies.size(); i++)
+	{
+		nFlattenedSize += GetMeshSize(copies[i]);
+	}
+
+	std::vector<Ray3> rays;
+	CreateRays(&rays, 4096);
+	int nMismatches = 0;
+	for (i = 0; i < (int)rays.size(); i++)
+	{
+		IntersectResult a;
+		IntersectResult b;
+		bool bHitA = instanced.Intersect(&rays[i], &a);
+		bool bHitB = flattened.Intersect(&rays[i], &b);
+		if (bHitA != bHitB || fabsf(a.m_distance - b.m_distance) > 1e-3f * MAX_(a.m_distance, 1.0f))
+		{
+			nMismatches++;
+			continue;
+		}
+		if (bHitA)
+		{
+			a.m_geometry->ComputeSurfaceInteraction(&rays[i], &a);
+			b.m_geometry->ComputeSurfaceInteraction(&rays[i], &b);
+			if (a.m_normal.Dot(b.m_normal) < 0.999f)
+			{
+				nMismatches++;
+			}
+		}
+	}
+
+	int nInstancedHits = 0;
+	int nFlattenedHits = 0;
+	double fInstancedTime = MeasureIntersect(&instanced, rays, 0.3, &nInstancedHits);
+	double fFlattenedTime = MeasureIntersect(&flattened, rays, 0.3, &nFlattenedHits);
+
+	printf("%d trees of %d triangles\n", nCompareCount, prototype.GetTriangleCount());
+	printf("%12s %12s %12s %12s %10s\n", "trees", "MB", "build ms", "ns/ray", "hits");
+	printf("%12s %12.2f %12.1f %12.1f %10d\n", "instanced", nInstancedSize / 1048576.0, fInstancedBuild * 1e3,
+		fInstancedTime, nInstancedHits);
+	printf("%12s %12.2f %12.1f %12.1f %10d\n", "flattened", nFlattenedSize / 1048576.0, fFlattenedBuild * 1e3,
+		fFlattenedTime, nFlattenedHits);
+
+	for (i = 0; i < (int)copies.size(); i++)
+	{
+		delete copies[i];
+	}
+
+	// Too many differing hits means the instance transform is off; a few come
+	// from rays grazing triangle edges, which round differently in the two spaces.
+	if (nMismatches > (int)rays.size() / 1000)
+	{
+		printf("%d of %d rays hit differently\n", nMismatches, (int)rays.size());
+		return 1;
+	}
+
+	// Instances of an animated prototype follow it through Update().
+	std::vector<Geometry *> field;
+	CreateSphereField(&field, 256);
+	BVH animated;
+	for (i = 0; i < (int)field.size(); i++)
+	{
+		animated.AddGeometry(field[i]);
+	}
+	animated.Initialize();
+	BVH placed;
+	for (i = 0; i < 16; i++)
+	{
+		placed.AddGeometry(arena.Create<Instance>(&animated, AffineTransform::Translation(Vector3(i * 250.0f, 0, 0))));
+	}
+	placed.Initialize();
+	for (i = 0; i < (int)field.size(); i++)
+	{
+		Sphere *sphere = (Sphere *)field[i];
+		sphere->m_center += Vector3(0, 150.0f, 0);
+		sphere->MarkChanged();
+	}
+	animated.Update(NULL);
+	placed.Update(NULL);
+	BVH placedFresh;
+	for (i = 0; i < (int)placed.m_geometies.size(); i++)
+	{
+		placedFresh.AddGeometry(placed.m_geometies[i]);
+	}
+	placedFresh.Initialize();
+	int nStale = 0;
+	for (i = 0; i < 4096; i++)
+	{
+		Ray3 ray(Vector3(random.Next(-100, 3850), random.Next(50, 250), 400.0f), Vector3(0, 0, -1));
+		IntersectResult a;
+		IntersectResult b;
+		placed.Intersect(&ray, &a);
+		placedFresh.Intersect(&ray, &b);
+		nStale += a.m_distance != b.m_distance;
+	}
+	for (i = 0; i < (int)field.size(); i++)
+	{
+		delete field[i];
+	}
+	if (nStale > 0)
+	{
+		printf("%d rays missed instances of a moved prototype\n", nStale);
+		return 1;
+	}
+
+	arena.Reset();
+	BVH forest;
+	// About one tree per 10x10 units of ground.
+	float fExtent = 5.0f * sqrtf((float)nForestCount);
+	start = std::chrono::steady_clock::now();
+	for (i = 0; i < nForestCount; i++)
+	{
+		forest.AddGeometry(arena.Create<Instance>(&prototype, CreateTreeTransform(&random, fExtent, 0.0f)));
+	}
+	forest.Initialize();
+	double fForestBuild = SecondsSince(start);
+	size_t nForestSize = nPrototypeSize + arena.GetUsedSize() + GetBVHSize(&forest);
+
+	std::vector<Ray3> forestRays;
+	BenchRandom rayRandom(31);
+	for (i = 0; i < 4096; i++)
+	{
+		Vector3 origin(rayRandom.Next(-fExtent, fExtent), 50.0f, rayRandom.Next(-fExtent, fExtent));
+		Vector3 target = origin + Vector3(rayRandom.Next(-200, 200), -50.0f, rayRandom.Next(-200, 200));
+		forestRays.push_back(Ray3(origin, (target - origin).Normalize()));
+	}
+	int nForestHits = 0;
+	double fForestTime = MeasureIntersect(&forest, forestRays, 0.3, &nForestHits);
+
+	printf("forest of %d instances, %lld triangles placed\n", nForestCount,
+		(long long)nForestCount * prototype.GetTriangleCount());
+	printf("%12s %12s %12s %12s %10s\n", "", "MB", "build ms", "ns/ray", "hits");
+	printf("%12s %12.2f %12.1f %12.1f %10d\n", "forest", nForestSize / 1048576.0, fForestBuild * 1e3,
+		fForestTime, nForestHits);
+	printf("%12s %12.1f\n", "bytes/tree", (double)nForestSize / MAX_(nForestCount, 1));
+	return 0;
+}
+
+// One measurement of the suite. Metrics that do not apply are negative and
+// left out of the JSON.
+class BenchRecord
+{
+public:
+	std::string m_level;
+	std::string m_name;
+	std::string m_config;
+	double m_fNsPerOp;
+	double m_fMraysPerSecond;
+	double m_fScaling;
+};
+
+// Options and results of the micro, mid and macro suites.
+class BenchSuite
+{
+public:
+	BenchSuite();
+	bool Parse(int argc, char **argv, int nFirst);
+	void Add(const char *pszLevel, const char *pszName, const char *pszConfig, double fNsPerOp,
+		double fMraysPerSecond, double fScaling);
+	bool WriteJSON();
+public:
+	std::vector<BenchRecord> m_records;
+	std::vector<int> m_threadCounts;
+	const char *m_pszJSON;
+	bool m_bQuick;
+	double m_fMinSeconds;
+};
+
+BenchSuite::BenchSuite()
+{
+	m_pszJSON = NULL;
+	m_bQuick = false;
+	m_fMinSeconds = 0.2;
+}
+
+bool BenchSuite::Parse(int argc, char **argv, int nFirst)
+{
+	int i;
+	for (i = nFirst; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-quick") == 0)
+		{
+			m_bQuick = true;
+			m_fMinSeconds = 0.05;
+		}
+		else if (strcmp(argv[i], "-json") == 0 && i + 1 < argc)
+		{
+			m_pszJSON = argv[++i];
+		}
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+		{
+			// Comma separated thread counts, the first one is the scaling baseline.
+			const char *psz = argv[++i];
+			while (*psz)
+			{
+				int nThreads = atoi(psz);
+				if (nThreads <= 0)
+				{
+					fprintf(stderr, "bad thread count list %s\n", argv[i]);
+					return false;
+				}
+				m_threadCounts.push_back(nThreads);
+				psz = strchr(psz, ',');
+				if (psz == NULL)
+				{
+					break;
+				}
+				psz++;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "unknown suite option %s\n", argv[i]);
+			return false;
+		}
+	}
+
+	// 1, powers of two and the hardware thread count by default.
+	if (m_threadCounts.empty())
+	{
+		int nHardware = ThreadPool::GetHardwareThreadCount();
+		int nThreads;
+		for (nThreads = 1; nThreads < nHardware; nThreads *= 2)
+		{
+			m_threadCounts.push_back(nThreads);
+		}
+		m_threadCounts.push_back(nHardware);
+	}
+	return true;
+}
+
+void BenchSuite::Add(const char *pszLevel, const char *pszName, const char *pszConfig, double fNsPerOp,
+	double fMraysPerSecond, double fScaling)
+{
+	BenchRecord record;
+	record.m_level = pszLevel;
+	record.m_name = pszName;
+	record.m_config = pszConfig;
+	record.m_fNsPerOp = fNsPerOp;
+	record.m_fMraysPerSecond = fMraysPerSecond;
+	record.m_fScaling = fScaling;
+	m_records.push_back(record);
+
+	char szNs[32] = "-";
+	char szMrays[32] = "-";
+	char szScaling[32] = "-";
+	if (fNsPerOp >= 0.0)
+	{
+		snprintf(szNs, sizeof(szNs), "%.2f", fNsPerOp);
+	}
+	if (fMraysPerSecond >= 0.0)
+	{
+		snprintf(szMrays, sizeof(szMrays), "%.2f", fMraysPerSecond);
+	}
+	if (fScaling >= 0.0)
+	{
+		snprintf(szScaling, sizeof(szScaling), "%.2f", fScaling);
+	}
+	printf("%-6s %-26s %-22s %12s %12s %10s\n", pszLevel, pszName, pszConfig, szNs, szMrays, szScaling);
+	fflush(stdout);
+}
+
+// One record per line, so results of two commits can be diffed or grepped
+// as well as parsed.
+bool BenchSuite::WriteJSON()
+{
+	if (m_pszJSON == NULL)
+	{
+		return true;
+	}
+	FILE *pFile = fopen(m_pszJSON, "w");
+	if (pFile == NULL)
+	{
+		fprintf(stderr, "cannot write %s\n", m_pszJSON);
+		return false;
+	}
+	fprintf(pFile, "{\"simd\": \"%s\", \"hardware_threads\": %d, \"quick\": %s, \"results\": [\n",
+		Simd_GetKernels() ? Simd_GetWidthName(Simd_GetNativeWidth()) : "off", ThreadPool::GetHardwareThreadCount(),
+		m_bQuick ? "true" : "false");
+	int i;
+	for (i = 0; i < (int)m_records.size(); i++)
+	{
+		const BenchRecord &record = m_records[i];
+		fprintf(pFile, "{\"level\": \"%s\", \"name\": \"%s\", \"config\": \"%s\"",
+			record.m_level.c_str(), record.m_name.c_str(), record.m_config.c_str());
+		if (record.m_fNsPerOp >= 0.0)
+		{
+			fprintf(pFile, ", \"ns_per_op\": %.3f", record.m_fNsPerOp);
+		}
+		if (record.m_fMraysPerSecond >= 0.0)
+		{
+			fprintf(pFile, ", \"mrays_per_s\": %.3f", record.m_fMraysPerSecond);
+		}
+		if (record.m_fScaling >= 0.0)
+		{
+			fprintf(pFile, ", \"scaling_efficiency\": %.3f", record.m_fScaling);
+		}
+		fprintf(pFile, i + 1 < (int)m_records.size() ? "},\n" : "}\n");
+	}
+	fprintf(pFile, "]}\n");
+	bool bResult = ferror(pFile) == 0;
+	fclose(pFile);
+	return bResult;
+}
+
+// Keeps the measured operations from being optimized away.
+static volatile float s_fBenchSink;
+
+// Returns nanoseconds per call of op(i), run in batches of nBatch calls for at
+// least fMinSeconds. op returns a value that feeds the sink.
+template <class Op>
+static double MeasureOp(double fMinSeconds, int nBatch, Op op)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	long long nOps = 0;
+	double fSeconds = 0.0;
+	float fSum = 0.0f;
+	do
+	{
+		int i;
+		for (i = 0; i < nBatch; i++)
+		{
+			fSum += op(i);
+		}
+		nOps += nBatch;
+		fSeconds = SecondsSince(start);
+	} while (fSeconds < fMinSeconds);
+	s_fBenchSink = fSum;
+	return fSeconds * 1e9 / nOps;
+}
+
+static int SuiteMicro(BenchSuite *suite)
+{
+	const int nCount = 4096;
+	const int nMask = nCount - 1;
+	double fMin = suite->m_fMinSeconds;
+	BenchRandom random(31337);
+	std::vector<Vector3> a(nCount);
+	std::vector<Vector3> b(nCount);
+	int i;
+	for (i = 0; i < nCount; i++)
+	{
+		a[i] = Vector3(random.Next(-1, 1), random.Next(-1, 1), random.Next(-1, 1));
+		b[i] = Vector3(random.Next(-1, 1), random.Next(-1, 1), random.Next(-1, 1));
+	}
+
+	suite->Add("micro", "vector3_add", "", MeasureOp(fMin, nCount, [&](int n) { return (a[n] + b[n]).m_x; }), -1, -1);
+	suite->Add("micro", "vector3_dot", "", MeasureOp(fMin, nCount, [&](int n) { return a[n].Dot(b[n]); }), -1, -1);
+	suite->Add("micro", "vector3_cross", "", MeasureOp(fMin, nCount, [&](int n) { return a[n].Cross(b[n]).m_y; }), -1, -1);
+	suite->Add("micro", "vector3_normalize", "", MeasureOp(fMin, nCount, [&](int n) { return a[n].Normalize().m_z; }), -1, -1);
+
+	std::vector<Ray3> rays;
+	CreateRays(&rays, nCount);
+	Sphere sphere(Vector3(0, 0, 0), 50.0f);
+	sphere.Initialize();
+	Plane plane(Vector3(0, 1, 0), 0.0f);
+	plane.Initialize();
+	suite->Add("micro", "sphere_intersect", "half hit", MeasureOp(fMin, nCount, [&](int n)
+	{
+		IntersectResult result;
+		sphere.Intersect(&rays[n & nMask], &result);
+		return result.m_distance;
+	}), -1, -1);
+	suite->Add("micro", "plane_intersect", "half hit", MeasureOp(fMin, nCount, [&](int n)
+	{
+		IntersectResult result;
+		plane.Intersect(&rays[n & nMask], &result);
+		return result.m_distance;
+	}), -1, -1);
+
+	PerspectiveCamera camera(Vector3(0, 5, 25), Vector3(0, 0, -1), Vector3(0, 1, 0), 90.0f);
+	camera.Initialize();
+	suite->Add("micro", "camera_generate_ray", "", MeasureOp(fMin, nCount, [&](int n)
+	{
+		Ray3 ray;
+		camera.GenerateRay((n & 63) * (1.0f / 64.0f), (n >> 6) * (1.0f / 64.0f), &ray);
+		return ray.m_direction.m_x;
+	}), -1, -1);
+
+	// Lights of the default scene, sampled from points on its floor with
+	// shadow rays against its geometry.
+	Scene scene;
+	scene.CreateDefault();
+	std::vector<Vector3> positions(nCount);
+	for (i = 0; i < nCount; i++)
+	{
+		positions[i] = Vector3(random.Next(-30, 30), 0.0f, random.Next(-30, 30));
+	}
+	const char *pszLightNames[] = { "light_sample_directional", "light_sample_point", "light_sample_spot" };
+	Light *lights[3];
+	lights[0] = scene.m_vecLightList[0];
+	PointLight pointLight(Color::s_white * 1000.0f, Vector3(0, 30.0f, 0));
+	pointLight.Initialize();
+	lights[1] = &pointLight;
+	lights[2] = scene.m_vecLightList[1];
+	for (i = 0; i < 3; i++)
+	{
+		Light *light = lights[i];
+		suite->Add("micro", pszLightNames[i], "shadowed", MeasureOp(fMin, nCount, [&](int n)
+		{
+			LightSample lightSample;
+			light->Sample(&lightSample, scene.m_root, positions[n & nMask]);
+			return lightSample.m_EL.m_r;
+		}), -1, -1);
+	}
+	return 0;
+}
+
+static int SuiteMid(BenchSuite *suite)
+{
+	std::vector<Ray3> rays;
+	CreateRays(&rays, 4096);
+	int nMaxCount = suite->m_bQuick ? 256 : 1024;
+	int nCount;
+	for (nCount = 1; nCount <= nMaxCount; nCount *= 4)
+	{
+		std::vector<Geometry *> field;
+		CreateSphereField(&field, nCount);
+		Union unionGeometry;
+		BVH bvh;
+		int i;
+		for (i = 0; i < nCount; i++)
+		{
+			unionGeometry.AddGeometry(field[i]);
+			bvh.AddGeometry(field[i]);
+		}
+		unionGeometry.Initialize();
+		bvh.Initialize();
+
+		char szConfig[64];
+		snprintf(szConfig, sizeof(szConfig), "n=%d", nCount);
+		int nHits = 0;
+		suite->Add("mid", "union_intersect", szConfig, MeasureIntersect(&unionGeometry, rays, suite->m_fMinSeconds, &nHits), -1, -1);
+		suite->Add("mid", "bvh_intersect", szConfig, MeasureIntersect(&bvh, rays, suite->m_fMinSeconds, &nHits), -1, -1);
+
+		for (i = 0; i < nCount; i++)
+		{
+			delete field[i];
+		}
+	}
+	return 0;
+}
+
+// Spheres resting on a checker floor in a 200 x 200 square under a sun and a
+// point light, at a density that keeps the covered area the same for every
+// count.
+static void CreateSphereFieldScene(Scene *scene, int nCount)
+{
+	scene->Release();
+	scene->CreateCamera<PerspectiveCamera>(Vector3(0, 60, 170), Vector3(0, -0.25f, -1).Normalize(),
+		Vector3(0, 1, -0.25f).Normalize(), 60.0f);
+
+	const Color colors[] = { Color::s_red, Color::s_green, Color::s_blue, Color::s_yellow };
+	Material *materials[4];
+	int i;
+	for (i = 0; i < 4; i++)
+	{
+		materials[i] = scene->CreateMaterial<PhongMaterial>(colors[i], Color::s_white, 16.0f, 0.25f);
+	}
+
+	BVH *root = scene->CreateGeometry<BVH>();
+	Plane *plane = scene->CreateGeometry<Plane>(Vector3(0, 1, 0), 0.0f);
+	plane->m_material = scene->CreateMaterial<CheckerMaterial>(0.1f, 0.5f);
+	root->AddGeometry(plane);
+
+	BenchRandom random(2024);
+	float fRadius = 60.0f / sqrtf((float)nCount);
+	for (i = 0; i < nCount; i++)
+	{
+		Sphere *sphere = scene->CreateGeometry<Sphere>(Vector3(random.Next(-100, 100), fRadius, random.Next(-100, 100)), fRadius);
+		sphere->m_material = materials[i & 3];
+		root->AddGeometry(sphere);
+	}
+	scene->m_root = root;
+
+	scene->CreateLight<DirectionalLight>(Color::s_white, Vector3(-1.75f, -2.0f, -1.5f));
+	scene->CreateLight<PointLight>(Color::s_white * 4000.0f, Vector3(0, 80.0f, 40.0f));
+	scene->Initialize();
+}
+
+// Median of nRuns frames after a warm-up frame, in seconds; *pRays is the
+// primary and reflection ray count of one frame.
+static double MeasureFrame(Renderer *renderer, Scene *scene, FrameBuffer *frameBuffer, int nRuns, unsigned long long *pRays)
+{
+	renderer->RenderScene(scene, frameBuffer);
+	std::vector<double> times;
+	int i;
+	for (i = 0; i < nRuns; i++)
+	{
+		unsigned long long nRaysBefore = renderer->GetRayCount();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		renderer->RenderScene(scene, frameBuffer);
+		times.push_back(SecondsSince(start));
+		*pRays = renderer->GetRayCount() - nRaysBefore;
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+// Procedural texture with detail at every scale, so each mip level differs.
+static void CreateTexturePixels(std::vector<unsigned int> *pPixels, int nSize, int nSeed)
+{
+	pPixels->resize((size_t)nSize * nSize);
+	int nY;
+	for (nY = 0; nY < nSize; nY++)
+	{
+		int nX;
+		for (nX = 0; nX < nSize; nX++)
+		{
+			unsigned int nCell = (unsigned int)((nX >> 5) * 73856093 ^ (nY >> 5) * 19349663 ^ nSeed * 83492791);
+			int r = ((nX ^ nY) & 0xff);
+			int g = (int)(nCell >> 8) & 0xff;
+			int b = (((nX >> 8) + (nY >> 8)) & 1) ? 0xe0 : 0x40;
+			(*pPixels)[(size_t)nY * nSize + nX] = 0xff000000 | (r << 16) | (g << 8) | b;
+		}
+	}
+}
+
+// Renders a textured floor and spheres whose textures add up to far more than
+// the cache budget, at budgets from 1 MB to 256 MB. Every budget must give the
+// same pixels; smaller budgets only trade memory for misses.
+static int BenchTextures(int nTextureSize, int nWidth, int nHeight)
+{
+	const int nTextureCount = 4;
+	char szFileNames[nTextureCount][32];
+	std::vector<unsigned int> pixels;
+	unsigned long long nFileBytes = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int i;
+	for (i = 0; i < nTextureCount; i++)
+	{
+		snprintf(szFileNames[i], sizeof(szFileNames[i]), "bench_texture_%d.rttex", i);
+		CreateTexturePixels(&pixels, nTextureSize, i);
+		if (!Texture::SaveTiled(szFileNames[i], nTextureSize, nTextureSize, &pixels[0], 0, 0))
+		{
+			fprintf(stderr, "cannot write %s\n", szFileNames[i]);
+			return 1;
+		}
+		FILE *pFile = fopen(szFileNames[i], "rb");
+		if (pFile)
+		{
+			fseek(pFile, 0, SEEK_END);
+			nFileBytes += (unsigned long long)ftell(pFile);
+			fclose(pFile);
+		}
+	}
+	double fConvertTime = SecondsSince(start);
+	pixels = std::vector<unsigned int>();
+
+	Scene scene;
+	scene.CreateCamera<PerspectiveCamera>(Vector3(0, 12, 40), Vector3(0, -0.3f, -1).Normalize(),
+		Vector3(0, 1, -0.3f).Normalize(), 70.0f);
+	Texture *textures[nTextureCount];
+	for (i = 0; i < nTextureCount; i++)
+	{
+		textures[i] = scene.CreateTexture();
+		if (!textures[i]->Load(szFileNames[i]))
+		{
+			fprintf(stderr, "cannot open %s\n", szFileNames[i]);
+			return 1;
+		}
+	}
+
+	// A level whose tiles would end past 2^64 bytes must not open.
+	const char *pszCorruptName = "bench_corrupt.rttex";
+	std::vector<unsigned char> bytes;
+	TextureFileHeader header;
+	bool bCorruptOpened = true;
+	if (ReadFileBytes(szFileNames[0], &bytes) && bytes.size() > sizeof(header))
+	{
+		memcpy(&header, bytes.data(), sizeof(header));
+		TextureLevel &level = header.m_levels[header.m_nLevelCount - 1];
+		level.m_nOffset = 0 - (unsigned long long)level.m_nTilesX * level.m_nTilesY * TEXTURE_TILE_BYTES;
+		memcpy(bytes.data(), &header, sizeof(header));
+		bCorruptOpened = !WriteFileBytes(pszCorruptName, bytes.data(), bytes.size()) ||
+			scene.CreateTexture()->Open(pszCorruptName);
+		remove(pszCorruptName);
+	}
+	bytes = std::vector<unsigned char>();
+	if (bCorruptOpened)
+	{
+		fprintf(stderr, "a corrupt tiled texture was not rejected\n");
+		return 1;
+	}
+
+	BVH *root = scene.CreateGeometry<BVH>();
+	Plane *plane = scene.CreateGeometry<Plane>(Vector3(0, 1, 0), 0.0f);
+	plane->m_material = scene.CreateMaterial<TextureMaterial>(textures[0], TEXTURE_PROJECTION_PLANAR, 0.02f, 0.0f);
+	root->AddGeometry(plane);
+	for (i = 0; i < 9; i++)
+	{
+		Sphere *sphere = scene.CreateGeometry<Sphere>(Vector3((i % 3 - 1) * 16.0f, 5.0f, (i / 3 - 1) * 16.0f - 10.0f), 5.0f);
+		sphere->m_material = scene.CreateMaterial<TextureMaterial>(textures[1 + i % 3], TEXTURE_PROJECTION_SPHERICAL,
+			1.0f, 0.25f);
+		root->AddGeometry(sphere);
+	}
+	scene.m_root = root;
+	scene.CreateLight<DirectionalLight>(Color::s_white, Vector3(-1.75f, -2.0f, -1.5f));
+	scene.Initialize();
+
+	printf("%d textures of %dx%d, %.1f MB of tiled files written in %.1f ms, %dx%d frame\n", nTextureCount,
+		nTextureSize, nTextureSize, nFileBytes / 1048576.0, fConvertTime * 1e3, nWidth, nHeight);
+	printf("%12s %12s %12s %12s %12s %12s\n", "budget MB", "cold ms", "warm ms", "hit %", "misses", "resident MB");
+
+	Renderer renderer;
+	FrameBuffer reference;
+	reference.Create(nWidth, nHeight);
+	FrameBuffer frameBuffer;
+	frameBuffer.Create(nWidth, nHeight);
+	int nResult = 0;
+	const int nBudgets[] = { 256, 16, 4, 1 };
+	for (i = 0; i < 4; i++)
+	{
+		scene.m_textureCache.SetBudget((size_t)nBudgets[i] * 1048576);
+		FrameBuffer *target = i == 0 ? &reference : &frameBuffer;
+		start = std::chrono::steady_clock::now();
+		renderer.RenderScene(&scene, target);
+		double fColdTime = SecondsSince(start);
+
+		scene.m_textureCache.ResetStats();
+		unsigned long long nRays = 0;
+		double fWarmTime = MeasureFrame(&renderer, &scene, target, 3, &nRays);
+		unsigned long long nHits = scene.m_textureCache.GetHitCount();
+		unsigned long long nMisses = scene.m_textureCache.GetMissCount();
+		printf("%12d %12.1f %12.1f %12.2f %12llu %12.1f\n", nBudgets[i], fColdTime * 1e3, fWarmTime * 1e3,
+			nHits * 100.0 / MAX_(nHits + nMisses, 1ULL), nMisses, scene.m_textureCache.GetResidentSize() / 1048576.0);
+
+		if (i > 0 && memcmp(reference.m_pColors, frameBuffer.m_pColors, sizeof(Color) * nWidth * nHeight) != 0)
+		{
+			printf("budget %d MB renders differently\n", nBudgets[i]);
+			nResult = 1;
+		}
+	}
+
+	scene.Release();
+	for (i = 0; i < nTextureCount; i++)
+	{
+		remove(szFileNames[i]);
+	}
+	return nResult;
+}
+
+// The sphere field camera turned by fDegrees around the vertical axis.
+static PerspectiveCamera CreateOrbitCamera(const PerspectiveCamera &camera, float fDegrees)
+{
+	AffineTransform rotation = AffineTransform::Rotation(Vector3(0, 1, 0), fDegrees);
+	PerspectiveCamera orbit(rotation.TransformPoint(camera.m_eye), rotation.TransformVector(camera.m_front),
+		rotation.TransformVector(camera.m_refUp), camera.m_fov);
+	orbit.Initialize();
+	return orbit;
+}
+
+// Headless stand-in for a viewer whose camera moves faster than frames
+// finish. A UI thread submits a new orbit camera to an AsyncRenderer every
+// few milliseconds, which cancels the frame in progress, and measures the
+// time from each submit to the first tile of its frame. The last frame must
+// complete and match a blocking render through the same camera, and a
+// cancelled frame may only finish the tiles that were in flight.
+static int BenchAsync(int nUpdates, int nWidth, int nHeight)
+{
+	Scene scene;
+	CreateSphereFieldScene(&scene, 1000);
+	PerspectiveCamera baseCamera = *scene.m_camera;
+	RenderOptions options;
+	options.m_nThreadCount = 0;
+	int nThreadCount = ThreadPool::GetHardwareThreadCount();
+
+	PerspectiveCamera finalCamera = CreateOrbitCamera(baseCamera, (float)nUpdates);
+	Renderer renderer;
+	renderer.SetCamera(&finalCamera);
+	FrameBuffer reference;
+	reference.Create(nWidth, nHeight);
+	unsigned long long nRays = 0;
+	double fFrameTime = MeasureFrame(&renderer, &scene, &reference, 3, &nRays);
+	int nTileCount = ((nWidth + options.m_nTileSize - 1) / options.m_nTileSize) *
+		((nHeight + options.m_nTileSize - 1) / options.m_nTileSize);
+
+	AsyncRenderer asyncRenderer;
+	FrameBuffer frameBuffer;
+	frameBuffer.Create(nWidth, nHeight);
+	std::vector<double> submitTimes(nUpdates);
+	std::vector<double> firstTileTimes(nUpdates);
+	std::vector<std::atomic<int> > lateTiles(nUpdates);
+	std::vector<std::shared_ptr<RenderJob> > jobs(nUpdates);
+	std::atomic<int> nLatest(-1);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	BenchRandom random(99);
+	int i;
+	for (i = 0; i < nUpdates; i++)
+	{
+		firstTileTimes[i] = -1.0;
+		lateTiles[i] = 0;
+	}
+	for (i = 0; i < nUpdates; i++)
+	{
+		// Tiles of older frames that end after this point were in flight
+		// when the new camera arrived.
+		nLatest = i;
+		submitTimes[i] = SecondsSince(start);
+		// Moves the scene's camera while jobs render, as the viewer does.
+		*scene.m_camera = CreateOrbitCamera(baseCamera, (float)(i + 1));
+		scene.m_camera->MarkChanged();
+		jobs[i] = asyncRenderer.Submit(&scene, *scene.m_camera, &frameBuffer, options,
+			[&, i](RenderJob *job, const FrameRect &rect)
+		{
+			if (job->GetTilesDone() == 1)
+			{
+				firstTileTimes[i] = SecondsSince(start);
+			}
+			if (nLatest > i)
+			{
+				lateTiles[i]++;
+			}
+		});
+		if (i + 1 < nUpdates)
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double>(random.Next(0.05f, 0.5f) * fFrameTime));
+		}
+	}
+	int nFinalState = jobs[nUpdates - 1]->Wait();
+	asyncRenderer.WaitIdle();
+
+	int nResult = 0;
+	int nCancelled = 0;
+	int nMaxLate = 0;
+	std::vector<double> latencies;
+	for (i = 0; i < nUpdates; i++)
+	{
+		int nState = jobs[i]->GetState();
+		nCancelled += nState == RENDERJOB_CANCELLED;
+		nMaxLate = MAX_(nMaxLate, (int)lateTiles[i]);
+		if (firstTileTimes[i] >= 0.0)
+		{
+			latencies.push_back(firstTileTimes[i] - submitTimes[i]);
+		}
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	printf("%dx%d, %d tiles, %d threads, %d camera updates every %.0f-%.0f ms\n", nWidth, nHeight, nTileCount,
+		nThreadCount, nUpdates, fFrameTime * 50.0, fFrameTime * 500.0);
+	printf("%24s %12.2f\n", "blocking frame ms", fFrameTime * 1e3);
+	printf("%24s %12.2f\n", "ms per tile", fFrameTime * 1e3 * nThreadCount / nTileCount);
+	if (!latencies.empty())
+	{
+		printf("%24s %12.2f\n", "first tile median ms", latencies[latencies.size() / 2] * 1e3);
+		printf("%24s %12.2f\n", "first tile p90 ms", latencies[latencies.size() * 9 / 10] * 1e3);
+		printf("%24s %12.2f\n", "first tile max ms", latencies.back() * 1e3);
+	}
+	printf("%24s %12d of %d\n", "frames cancelled", nCancelled, nUpdates);
+	printf("%24s %12d\n", "max tiles after cancel", nMaxLate);
+
+	if (nFinalState != RENDERJOB_DONE ||
+		memcmp(reference.m_pColors, frameBuffer.m_pColors, sizeof(Color) * nWidth * nHeight) != 0 ||
+		memcmp(reference.m_pPixels, frameBuffer.m_pPixels, (size_t)reference.m_nStride * nHeight) != 0)
+	{
+		printf("last frame incomplete or different from the blocking render\n");
+		nResult = 1;
+	}
+	// The UI thread may update the latest index just before the cancel flag
+	// is raised, which lets one more tile start.
+	if (nMaxLate > nThreadCount + 1)
+	{
+		printf("cancelled frames went on for %d tiles\n", nMaxLate);
+		nResult = 1;
+	}
+	return nResult;
+}
+
+// A progressive frame is timed at every pass and its final image compared
+// with a blocking frame of the same settings; the last case runs it as a
+// RenderJob, whose tile count covers every pass.
+static int BenchProgressive(int nWidth, int nHeight)
+{
+	Scene scene;
+	CreateSphereFieldScene(&scene, 1000);
+	int nThreadCount = ThreadPool::GetHardwareThreadCount();
+	printf("%dx%d, %d threads, first pass step %d\n", nWidth, nHeight, nThreadCount, RENDER_PROGRESSIVE_STEP);
+	printf("%10s %12s %12s %12s %12s %12s %10s\n", "mode", "blocking ms", "1/16 ms", "1/4 ms", "final ms", "samples",
+		"speedup");
+
+	const char *pszNames[] = { "packets", "single", "adaptive" };
+	int nResult = 0;
+	int nCase;
+	for (nCase = 0; nCase < 3; nCase++)
+	{
+		Renderer renderer;
+		renderer.SetPacketTracing(nCase == 0);
+		if (nCase == 2)
+		{
+			SampleSettings sampleSettings;
+			sampleSettings.m_nMode = SAMPLING_ADAPTIVE;
+			renderer.SetSampleSettings(sampleSettings);
+		}
+		FrameBuffer reference;
+		reference.Create(nWidth, nHeight);
+		unsigned long long nRays = 0;
+		double fFrameTime = MeasureFrame(&renderer, &scene, &reference, 3, &nRays);
+		unsigned long long nSamplesBefore = renderer.GetSampleCount();
+		renderer.RenderScene(&scene, &reference);
+		unsigned long long nFrameSamples = renderer.GetSampleCount() - nSamplesBefore;
+
+		FrameBuffer frameBuffer;
+		frameBuffer.Create(nWidth, nHeight);
+		std::vector<double> passTimes[RENDER_PROGRESSIVE_PASSES];
+		std::chrono::steady_clock::time_point start;
+		int nPass = 0;
+		renderer.SetProgressive(true, [&](int nStep)
+		{
+			passTimes[nPass++].push_back(SecondsSince(start));
+		});
+		unsigned long long nSamples = 0;
+		int i;
+		for (i = 0; i < 3; i++)
+		{
+			nPass = 0;
+			nSamplesBefore = renderer.GetSampleCount();
+			start = std::chrono::steady_clock::now();
+			renderer.RenderScene(&scene, &frameBuffer);
+			nSamples = renderer.GetSampleCount() - nSamplesBefore;
+		}
+		for (i = 0; i < RENDER_PROGRESSIVE_PASSES; i++)
+		{
+			std::sort(passTimes[i].begin(), passTimes[i].end());
+		}
+		double fFirst = passTimes[0][1];
+		printf("%10s %12.2f %12.2f %12.2f %12.2f %12.2f %9.1fx\n", pszNames[nCase], fFrameTime * 1e3, fFirst * 1e3,
+			passTimes[1][1] * 1e3, passTimes[2][1] * 1e3, (double)nSamples / nFrameSamples, fFrameTime / fFirst);
+
+		if (memcmp(reference.m_pColors, frameBuffer.m_pColors, sizeof(Color) * nWidth * nHeight) != 0 ||
+			memcmp(reference.m_pPixels, frameBuffer.m_pPixels, (size_t)reference.m_nStride * nHeight) != 0)
+		{
+			printf("%s: progressive frame differs from the blocking frame\n", pszNames[nCase]);
+			nResult = 1;
+		}
+		if (nSamples != nFrameSamples)
+		{
+			printf("%s: %llu samples instead of %llu\n", pszNames[nCase], nSamples, nFrameSamples);
+			nResult = 1;
+		}
+	}
+
+	RenderOptions options;
+	options.m_nThreadCount = 0;
+	options.m_nTileSize = 30;
+	options.m_bProgressive = true;
+	Renderer renderer;
+	renderer.SetTileSize(options.m_nTileSize);
+	FrameBuffer reference;
+	reference.Create(nWidth, nHeight);
+	renderer.RenderScene(&scene, &reference);
+	FrameBuffer frameBuffer;
+	frameBuffer.Create(nWidth, nHeight);
+	AsyncRenderer asyncRenderer;
+	std::shared_ptr<RenderJob> job = asyncRenderer.Submit(&scene, *scene.m_camera, &frameBuffer, options);
+	if (job->Wait() != RENDERJOB_DONE || job->GetTilesDone() != job->GetTileCount() ||
+		memcmp(reference.m_pColors, frameBuffer.m_pColors, sizeof(Color) * nWidth * nHeight) != 0 ||
+		memcmp(reference.m_pPixels, frameBuffer.m_pPixels, (size_t)reference.m_nStride * nHeight) != 0)
+	{
+		printf("progressive job incomplete or different from the blocking frame\n");
+		nResult = 1;
+	}
+	return nResult;
+}
+
+static int SuiteMacro(BenchSuite *suite)
+{
+	const char *pszScenes[] = { "default", "spheres_1k", "spheres_100k" };
+	const int nSphereCounts[] = { 0, 1000, 100000 };
+	const int nResolutions[][2] = { { 320, 240 }, { 1280, 720 }, { 1920, 1080 } };
+	int nResolutionCount = suite->m_bQuick ? 1 : 3;
+	int nRuns = suite->m_bQuick ? 1 : 3;
+
+	Scene scene;
+	int nScene;
+	for (nScene = 0; nScene < 3; nScene++)
+	{
+		if (nSphereCounts[nScene] == 0)
+		{
+			scene.CreateDefault();
+		}
+		else
+		{
+			CreateSphereFieldScene(&scene, nSphereCounts[nScene]);
+		}
+
+		int nResolution;
+		for (nResolution = 0; nResolution < nResolutionCount; nResolution++)
+		{
+			FrameBuffer frameBuffer;
+			frameBuffer.Create(nResolutions[nResolution][0], nResolutions[nResolution][1]);
+			double fBaseTime = 0.0;
+			int nBaseThreads = 0;
+			int i;
+			for (i = 0; i < (int)suite->m_threadCounts.size(); i++)
+			{
+				int nThreads = suite->m_threadCounts[i];
+				Renderer renderer;
+				renderer.SetThreadCount(nThreads);
+				unsigned long long nRays = 0;
+				double fTime = MeasureFrame(&renderer, &scene, &frameBuffer, nRuns, &nRays);
+				if (i == 0)
+				{
+					fBaseTime = fTime;
+					nBaseThreads = nThreads;
+				}
+
+				// Speedup over the first thread count per added thread.
+				char szConfig[64];
+				snprintf(szConfig, sizeof(szConfig), "%dx%d threads=%d", frameBuffer.m_nWidth, frameBuffer.m_nHeight, nThreads);
+				double fScaling = fBaseTime * nBaseThreads / (fTime * nThreads);
+				suite->Add("macro", pszScenes[nScene], szConfig, fTime * 1e9 / nRays, nRays / fTime * 1e-6, fScaling);
+			}
+		}
+	}
+	return 0;
+}
+
+static int BenchSuiteMain(const char *pszMode, int argc, char **argv)
+{
+	BenchSuite suite;
+	if (!suite.Parse(argc, argv, 2))
+	{
+		fprintf(stderr, "usage: RayTracingBench suite|micro|mid|macro [-json <file>] [-threads <n,n,...>] [-quick]\n");
+		return 1;
+	}
+
+	printf("%-6s %-26s %-22s %12s %12s %10s\n", "level", "name", "config", "ns/op", "Mrays/s", "scaling");
+	printf("macro ns/op and Mrays/s count primary+reflection rays; shadow rays are not included\n");
+	bool bAll = strcmp(pszMode, "suite") == 0;
+	int nResult = 0;
+	if (bAll || strcmp(pszMode, "micro") == 0)
+	{
+		nResult |= SuiteMicro(&suite);
+	}
+	if (bAll || strcmp(pszMode, "mid") == 0)
+	{
+		nResult |= SuiteMid(&suite);
+	}
+	if (bAll || strcmp(pszMode, "macro") == 0)
+	{
+		nResult |= SuiteMacro(&suite);
+	}
+	if (!suite.WriteJSON())
+	{
+		nResult = 1;
+	}
+	return nResult;
+}
+
+int main(int argc, char **argv)
+{
+	const char *pszMode = argc > 1 ? argv[1] : "all";
+	int nResult = 0;
+
+	if (strcmp(pszMode, "suite") == 0 || strcmp(pszMode, "micro") == 0 ||
+		strcmp(pszMode, "mid") == 0 || strcmp(pszMode, "macro") == 0)
+	{
+		return BenchSuiteMain(pszMode, argc, argv);
+	}
+
+	if (strcmp(pszMode, "bvh") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		int nMaxCount = argc > 2 ? atoi(argv[2]) : 262144;
+		int nMaxUnionCount = argc > 3 ? atoi(argv[3]) : 4096;
+		nResult |= BenchBVH(nMaxCount, nMaxUnionCount);
+	}
+	if (strcmp(pszMode, "packet") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchPacket(512, 512);
+	}
+	if (strcmp(pszMode, "sphereset") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchSphereSet(argc > 2 && strcmp(pszMode, "sphereset") == 0 ? atoi(argv[2]) : 100000);
+	}
+	if (strcmp(pszMode, "resolve") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchResolve(1920, 1080);
+	}
+	if (strcmp(pszMode, "math") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchMath(512);
+	}
+	if (strcmp(pszMode, "arena") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchArena(4096, 5, 100000);
+	}
+	if (strcmp(pszMode, "mesh") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchMesh(argc > 2 && strcmp(pszMode, "mesh") == 0 ? atoi(argv[2]) : 1000000);
+	}
+	if (strcmp(pszMode, "aa") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchAntialias(640, 480);
+	}
+	if (strcmp(pszMode, "lights") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchLights(argc > 2 && strcmp(pszMode, "lights") == 0 ? atoi(argv[2]) : 4096, 320, 240);
+	}
+	if (strcmp(pszMode, "instances") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchInstances(1000, argc > 2 && strcmp(pszMode, "instances") == 0 ? atoi(argv[2]) : 1000000);
+	}
+	if (strcmp(pszMode, "textures") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchTextures(argc > 2 && strcmp(pszMode, "textures") == 0 ? atoi(argv[2]) : 4096, 640, 480);
+	}
+	if (strcmp(pszMode, "async") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchAsync(argc > 2 && strcmp(pszMode, "async") == 0 ? atoi(argv[2]) : 60, 640, 480);
+	}
+	if (strcmp(pszMode, "progressive") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchProgressive(640, 480);
+	}
+	if (strcmp(pszMode, "dynamic") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchDynamic(argc > 2 && strcmp(pszMode, "dynamic") == 0 ? atoi(argv[2]) : 100000);
+	}
+	if (strcmp(pszMode, "jobs") == 0 || strcmp(pszMode, "all") == 0)
+	{
+		nResult |= BenchJobs(argc > 2 && strcmp(pszMode, "jobs") == 0 ? atoi(argv[2]) : 8, 320, 240);
+	}
+	return nResult;
+}
\ No newline at end of file